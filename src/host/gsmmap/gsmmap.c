@@ -524,11 +524,13 @@ int main(int argc, char *argv[])
 	if (argc <= 2) {
 usage:
 		fprintf(stderr, "Usage: %s <file.log> <file.kml> "
-			"[lines] [debug]\n", argv[0]);
+			"[lines] [debug] [networks <file>]\n", argv[0]);
 		fprintf(stderr, "lines: Add lines between cell and "
 			"Measurement point\n");
 		fprintf(stderr, "debug: Add debugging of location algorithm.\n"
 			);
+		fprintf(stderr, "networks: Load network names from file, "
+			"one '<MCC> <MNC> <name>' per line\n");
 		return 0;
 	}
 
@@ -537,7 +539,14 @@ usage:
 			log_lines = 1;
 		else if (!strcmp(argv[i], "debug"))
 			log_debug = 1;
-		else goto usage;
+		else if (!strcmp(argv[i], "networks") && i + 1 < argc) {
+			n = gsm_networks_load(argv[++i]);
+			if (n < 0) {
+				fprintf(stderr, "Failed to load '%s'\n",
+					argv[i]);
+				return -EIO;
+			}
+		} else goto usage;
 	}
 
 	infp = fopen(argv[1], "r");
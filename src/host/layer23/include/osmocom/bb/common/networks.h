@@ -19,6 +19,8 @@ const char *gsm_imsi_mcc(char *imsi);
 const char *gsm_imsi_mnc(char *imsi);
 const uint16_t gsm_input_mcc(char *string);
 const uint16_t gsm_input_mnc(char *string);
+int gsm_networks_load(const char *path);
+void gsm_networks_unload(void);
 
 #endif /* _NETWORKS_H */
 
@@ -61,11 +61,17 @@ enum {
 	MS_SHUTDOWN_COMPL = 3,
 };
 
+/* Receive buffer of the L1CTL socket, holds a few frames */
+#define L2_RX_BUF_LEN (8 * (2 + 256))
+
 /* One Mobilestation for osmocom */
 struct osmocom_ms {
 	struct llist_head entity;
 	char *name;
 	struct osmo_wqueue l2_wq, sap_wq;
+	/* buffered L1CTL framing, see l1l2_interface.c */
+	uint8_t l2_rx_buf[L2_RX_BUF_LEN];
+	unsigned int l2_rx_len, l2_tx_off;
 	uint16_t test_arfcn;
 	struct osmol1_entity l1_entity;
 
@@ -164,6 +164,9 @@ struct gsm322_cellsel {
 	struct llist_head	ba_list; /* BCCH Allocation per PLMN */
 	struct gsm322_cs_list	list[1024+299];
 					/* cell selection list per frequency. */
+	uint32_t		rxlev_map[64][(1024+299+31) / 32];
+					/* frequencies of each rx level, to
+					 * find the next one to scan */
 	/* scan and tune state */
 	struct osmo_timer_list	timer; /* cell selection timer */
 	uint16_t		mcc, mnc; /* current network to search for */
@@ -248,6 +251,10 @@ int gsm322_l1_signal(unsigned int subsys, unsigned int signal,
 		     void *handler_data, void *signal_data);
 
 int gsm322_meas(struct osmocom_ms *ms, uint8_t rx_lev);
+void gsm322_smax_band_init(void);
+void gsm322_cs_set_rxlev(struct gsm322_cellsel *cs, int i, uint8_t rxlev);
+uint32_t gsm322_cs_next(struct gsm322_cellsel *cs, int skip_max_per_band,
+	int *band);
 
 char *gsm_print_rxlev(uint8_t rxlev);
 
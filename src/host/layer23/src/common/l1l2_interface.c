@@ -30,6 +30,7 @@
 
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 
 #include <arpa/inet.h>
 
@@ -41,64 +42,148 @@
 
 #define GSM_L2_LENGTH 256
 #define GSM_L2_HEADROOM 32
+#define L2_TX_IOV_MAX 32
 
-static int layer2_read(struct osmo_fd *fd)
+/* Handle all complete frames in the receive buffer */
+static int layer2_rx_frames(struct osmocom_ms *ms)
 {
+	unsigned int off = 0;
 	struct msgb *msg;
 	uint16_t len;
+	int rc = 0;
+
+	while (ms->l2_rx_len - off >= sizeof(len)) {
+		len = (ms->l2_rx_buf[off] << 8) | ms->l2_rx_buf[off + 1];
+		if (len > GSM_L2_LENGTH) {
+			/* no way to find the next frame */
+			LOGP(DL1C, LOGL_ERROR, "Length is too big: %u\n", len);
+			layer2_close(ms);
+			return -EINVAL;
+		}
+
+		if (ms->l2_rx_len - off < sizeof(len) + len)
+			break;
+
+		msg = msgb_alloc_headroom(GSM_L2_LENGTH+GSM_L2_HEADROOM, GSM_L2_HEADROOM, "Layer2");
+		if (!msg) {
+			LOGP(DL1C, LOGL_ERROR, "Failed to allocate msg.\n");
+			/* drop what was delivered, keep the rest */
+			rc = -ENOMEM;
+			break;
+		}
+
+		msg->l1h = msgb_put(msg, len);
+		memcpy(msg->l1h, ms->l2_rx_buf + off + sizeof(len), len);
+		off += sizeof(len) + len;
+
+		l1ctl_recv(ms, msg);
+
+		if (ms->l2_wq.bfd.fd < 0)
+			return 0;
+	}
+
+	/* keep what is left at the front */
+	ms->l2_rx_len -= off;
+	if (off > 0 && ms->l2_rx_len > 0)
+		memmove(ms->l2_rx_buf, ms->l2_rx_buf + off, ms->l2_rx_len);
+
+	return rc;
+}
+
+static int layer2_read(struct osmo_fd *fd)
+{
+	struct osmocom_ms *ms = fd->data;
 	int rc;
 
-	msg = msgb_alloc_headroom(GSM_L2_LENGTH+GSM_L2_HEADROOM, GSM_L2_HEADROOM, "Layer2");
-	if (!msg) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to allocate msg.\n");
-		return -ENOMEM;
-	}
+	/* frames left over after an allocation failure come first */
+	if (ms->l2_rx_len == sizeof(ms->l2_rx_buf))
+		return layer2_rx_frames(ms);
 
-	rc = read(fd->fd, &len, sizeof(len));
-	if (rc < sizeof(len)) {
+	/* a partial frame never fills the buffer, so there is room */
+	rc = read(fd->fd, ms->l2_rx_buf + ms->l2_rx_len,
+		  sizeof(ms->l2_rx_buf) - ms->l2_rx_len);
+	if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+	if (rc <= 0) {
 		fprintf(stderr, "Layer2 socket failed\n");
-		msgb_free(msg);
-		if (rc >= 0)
+		if (rc == 0)
 			rc = -EIO;
-		layer2_close((struct osmocom_ms *) fd->data);
+		layer2_close(ms);
 		return rc;
 	}
 
-	len = ntohs(len);
-	if (len > GSM_L2_LENGTH) {
-		LOGP(DL1C, LOGL_ERROR, "Length is too big: %u\n", len);
-		msgb_free(msg);
-		return -EINVAL;
+	ms->l2_rx_len += rc;
+
+	return layer2_rx_frames(ms);
+}
+
+/* write as many queued messages as possible with one writev() */
+static int layer2_write(struct osmo_fd *fd)
+{
+	struct osmocom_ms *ms = fd->data;
+	struct osmo_wqueue *wq = &ms->l2_wq;
+	struct iovec iov[L2_TX_IOV_MAX];
+	struct msgb *msg;
+	ssize_t rc;
+	int n = 0;
+
+	llist_for_each_entry(msg, &wq->msg_queue, list) {
+		iov[n].iov_base = msg->data;
+		iov[n].iov_len = msg->len;
+		if (++n == L2_TX_IOV_MAX)
+			break;
+	}
+
+	if (n == 0) {
+		fd->when &= ~BSC_FD_WRITE;
+		return 0;
+	}
+
+	/* the first message may be written partially */
+	iov[0].iov_base = (uint8_t *) iov[0].iov_base + ms->l2_tx_off;
+	iov[0].iov_len -= ms->l2_tx_off;
+
+	rc = writev(fd->fd, iov, n);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		LOGP(DL1C, LOGL_ERROR, "Failed to write data: %s\n",
+		     strerror(errno));
+		osmo_wqueue_clear(wq);
+		ms->l2_tx_off = 0;
+		return -EIO;
 	}
 
+	/* release completely written messages */
+	ms->l2_tx_off += rc;
+	while (!llist_empty(&wq->msg_queue)) {
+		msg = llist_entry(wq->msg_queue.next, struct msgb, list);
+		if (ms->l2_tx_off < msg->len)
+			break;
 
-	msg->l1h = msgb_put(msg, len);
-	rc = read(fd->fd, msg->l1h, msgb_l1len(msg));
-	if (rc != msgb_l1len(msg)) {
-		LOGP(DL1C, LOGL_ERROR, "Can not read data: len=%d rc=%d "
-		     "errno=%d\n", len, rc, errno);
+		ms->l2_tx_off -= msg->len;
+		llist_del(&msg->list);
+		wq->current_length--;
 		msgb_free(msg);
-		return rc;
 	}
 
-	l1ctl_recv((struct osmocom_ms *) fd->data, msg);
+	if (llist_empty(&wq->msg_queue))
+		fd->when &= ~BSC_FD_WRITE;
 
 	return 0;
 }
 
-static int layer2_write(struct osmo_fd *fd, struct msgb *msg)
+static int layer2_cb(struct osmo_fd *fd, unsigned int what)
 {
-	int rc;
-
-	if (fd->fd <= 0)
-		return -EINVAL;
-
-	rc = write(fd->fd, msg->data, msg->len);
-	if (rc != msg->len) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to write data: rc: %d\n", rc);
-		return rc;
+	if (what & BSC_FD_READ) {
+		layer2_read(fd);
+		if (fd->fd < 0)
+			return 0;
 	}
 
+	if (what & BSC_FD_WRITE)
+		layer2_write(fd);
+
 	return 0;
 }
 
@@ -129,8 +214,10 @@ int layer2_open(struct osmocom_ms *ms, const char *socket_path)
 	osmo_wqueue_init(&ms->l2_wq, 100);
 	ms->l2_wq.bfd.data = ms;
 	ms->l2_wq.bfd.when = BSC_FD_READ;
-	ms->l2_wq.read_cb = layer2_read;
-	ms->l2_wq.write_cb = layer2_write;
+	/* framing is done here, the queue only holds the messages */
+	ms->l2_wq.bfd.cb = layer2_cb;
+	ms->l2_rx_len = 0;
+	ms->l2_tx_off = 0;
 
 	rc = osmo_fd_register(&ms->l2_wq.bfd);
 	if (rc != 0) {
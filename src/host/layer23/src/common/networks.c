@@ -1,6 +1,8 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 
 #include <osmocom/bb/common/networks.h>
 
@@ -1900,24 +1902,229 @@ const uint16_t gsm_input_mnc(char *string)
 	return mnc;
 }
 
-const char *gsm_get_mcc(uint16_t mcc)
+/*
+ * Lookup index
+ *
+ * The table above is sorted by country name, not by number, so lookups
+ * go through an index sorted by (MCC, MNC). Country entries (MNC -1)
+ * sort first within their MCC. Entries loaded from a file come before
+ * the built-in ones and replace them: any other entry with the key of a
+ * loaded one is left out of the index. Other equal keys keep their table
+ * order, so the first matching entry is found, as before.
+ */
+
+struct gsm_networks_idx {
+	uint32_t key;
+	uint32_t seq;
+	const struct gsm_networks *net;
+};
+
+static struct gsm_networks_idx *net_idx;
+static int net_idx_num;
+
+/* entries loaded by gsm_networks_load() */
+static struct gsm_networks *net_loaded;
+static int net_loaded_num;
+
+static inline uint32_t net_key(uint16_t mcc, int16_t mnc)
+{
+	return ((uint32_t)mcc << 16) | (uint16_t)(mnc + 1);
+}
+
+static int net_idx_cmp(const void *a, const void *b)
+{
+	const struct gsm_networks_idx *ia = a, *ib = b;
+
+	if (ia->key != ib->key)
+		return (ia->key < ib->key) ? -1 : 1;
+	return (ia->seq < ib->seq) ? -1 : (ia->seq > ib->seq);
+}
+
+static int net_idx_build(void)
+{
+	struct gsm_networks_idx *idx;
+	int i, j, num = 0, builtin = 0;
+
+	while (gsm_networks[builtin].name)
+		builtin++;
+
+	idx = malloc((net_loaded_num + builtin) * sizeof(*idx));
+	if (!idx)
+		return -ENOMEM;
+
+	for (i = 0; i < net_loaded_num; i++, num++) {
+		idx[num].key = net_key(net_loaded[i].mcc, net_loaded[i].mnc);
+		idx[num].seq = num;
+		idx[num].net = &net_loaded[i];
+	}
+	for (i = 0; i < builtin; i++, num++) {
+		idx[num].key = net_key(gsm_networks[i].mcc, gsm_networks[i].mnc);
+		idx[num].seq = num;
+		idx[num].net = &gsm_networks[i];
+	}
+
+	qsort(idx, num, sizeof(*idx), net_idx_cmp);
+
+	/* drop entries overridden by a loaded one, which sorts first */
+	for (i = j = 0; i < num; i++) {
+		if (j && idx[j - 1].key == idx[i].key
+		 && idx[j - 1].seq < net_loaded_num)
+			continue;
+		idx[j++] = idx[i];
+	}
+	num = j;
+
+	free(net_idx);
+	net_idx = idx;
+	net_idx_num = num;
+
+	return 0;
+}
+
+/* return the position of the first entry with a key >= the given key */
+static int net_idx_lower(uint32_t key)
+{
+	int lo = 0, hi, mid;
+
+	if (!net_idx && net_idx_build() < 0)
+		return 0;
+
+	hi = net_idx_num;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (net_idx[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static const char *net_idx_find(uint16_t mcc, int16_t mnc)
+{
+	uint32_t key = net_key(mcc, mnc);
+	int i = net_idx_lower(key);
+
+	if (i < net_idx_num && net_idx[i].key == key)
+		return net_idx[i].net->name;
+
+	return NULL;
+}
+
+/* Load additional networks from a file, one per line:
+ *   <MCC> <MNC> <name>
+ * An MNC of "-" gives the name of the country. Empty lines and lines
+ * starting with '#' are skipped. Loaded entries override built-in ones.
+ * Returns the number of networks loaded or a negative error. */
+int gsm_networks_load(const char *path)
+{
+	struct gsm_networks *nets = NULL, *tmp;
+	char line[256], mcc_str[8], mnc_str[8], *name, *nl;
+	int num = 0, alloc = 0, lineno = 0, n;
+	uint16_t mcc, mnc_in;
+	int16_t mnc;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -errno;
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		if ((nl = strchr(line, '\n')))
+			*nl = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (sscanf(line, "%7s %7s %n", mcc_str, mnc_str, &n) != 2
+		 || line[n] == '\0') {
+			fprintf(stderr, "%s:%d: expecting '<MCC> <MNC> "
+				"<name>'\n", path, lineno);
+			continue;
+		}
+		name = line + n;
+
+		mcc = gsm_input_mcc(mcc_str);
+		if (!strcmp(mnc_str, "-"))
+			mnc = -1;
+		else {
+			mnc_in = gsm_input_mnc(mnc_str);
+			if (mnc_in == GSM_INPUT_INVALID || mnc_in == 0)
+				mcc = GSM_INPUT_INVALID;
+			mnc = mnc_in;
+		}
+		if (mcc == GSM_INPUT_INVALID) {
+			fprintf(stderr, "%s:%d: invalid MCC/MNC '%s %s'\n",
+				path, lineno, mcc_str, mnc_str);
+			continue;
+		}
+
+		if (num == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			tmp = realloc(nets, alloc * sizeof(*nets));
+			if (!tmp)
+				goto nomem;
+			nets = tmp;
+		}
+		nets[num].name = strdup(name);
+		if (!nets[num].name)
+			goto nomem;
+		nets[num].mcc = mcc;
+		nets[num].mnc = mnc;
+		num++;
+	}
+	fclose(fp);
+
+	gsm_networks_unload();
+	net_loaded = nets;
+	net_loaded_num = num;
+	free(net_idx);
+	net_idx = NULL;
+
+	return num;
+
+nomem:
+	fclose(fp);
+	while (num--)
+		free((char *)nets[num].name);
+	free(nets);
+	return -ENOMEM;
+}
+
+/* drop networks loaded by gsm_networks_load() */
+void gsm_networks_unload(void)
 {
 	int i;
 
-	for (i = 0; gsm_networks[i].name; i++)
-		if (gsm_networks[i].mnc < 0 && gsm_networks[i].mcc == mcc)
-			return gsm_networks[i].name;
+	for (i = 0; i < net_loaded_num; i++)
+		free((char *)net_loaded[i].name);
+	free(net_loaded);
+	net_loaded = NULL;
+	net_loaded_num = 0;
+
+	free(net_idx);
+	net_idx = NULL;
+	net_idx_num = 0;
+}
+
+const char *gsm_get_mcc(uint16_t mcc)
+{
+	const char *name = net_idx_find(mcc, -1);
+
+	if (name)
+		return name;
 
 	return gsm_print_mcc(mcc);
 }
 
 const char *gsm_get_mnc(uint16_t mcc, uint16_t mnc)
 {
-	int i;
+	const char *name = net_idx_find(mcc, mnc);
 
-	for (i = 0; gsm_networks[i].name; i++)
-		if (gsm_networks[i].mcc == mcc && gsm_networks[i].mnc == mnc)
-			return gsm_networks[i].name;
+	if (name)
+		return name;
 
 	return gsm_print_mnc(mnc);
 }
@@ -1925,23 +2132,18 @@ const char *gsm_get_mnc(uint16_t mcc, uint16_t mnc)
 /* get MCC from IMSI */
 const char *gsm_imsi_mcc(char *imsi)
 {
-	int i, found = 0;
+	int i;
 	uint16_t mcc;
 
 	mcc = ((imsi[0] - '0') << 8)
 	    | ((imsi[1] - '0') << 4)
 	    | ((imsi[2] - '0'));
 
-	for (i = 0; gsm_networks[i].name; i++) {
-		if (gsm_networks[i].mcc == mcc) {
-			found = 1;
-			break;
-		}
-	}
-	if (found == 0)
+	i = net_idx_lower(net_key(mcc, -1));
+	if (i >= net_idx_num || net_idx[i].net->mcc != mcc)
 		return "Unknown";
 
-	return gsm_networks[i].name;
+	return net_idx[i].net->name;
 }
 
 /* get MNC from IMSI */
@@ -1949,6 +2151,7 @@ const char *gsm_imsi_mnc(char *imsi)
 {
 	int i, found = 0, position = 0;
 	uint16_t mcc, mnc2, mnc3;
+	const struct gsm_networks *net;
 
 	mcc = ((imsi[0] - '0') << 8)
 	    | ((imsi[1] - '0') << 4)
@@ -1960,16 +2163,20 @@ const char *gsm_imsi_mnc(char *imsi)
 	     + ((imsi[4] - '0') << 4)
 	     + imsi[5] - '0';
 
-	for (i = 0; gsm_networks[i].name; i++) {
-		if (gsm_networks[i].mcc != mcc)
+	/* only the entries of this MCC */
+	for (i = net_idx_lower(net_key(mcc, -1)); i < net_idx_num; i++) {
+		net = net_idx[i].net;
+		if (net->mcc != mcc)
+			break;
+		if (net->mnc < 0)
 			continue;
-		if ((gsm_networks[i].mnc & 0x00f) == 0x00f) {
-			if (mnc2 == gsm_networks[i].mnc) {
+		if ((net->mnc & 0x00f) == 0x00f) {
+			if (mnc2 == net->mnc) {
 				found++;
 				position = i;
 			}
 		} else {
-			if (mnc3 == gsm_networks[i].mnc) {
+			if (mnc3 == net->mnc) {
 				found++;
 				position = i;
 			}
@@ -1980,7 +2187,6 @@ const char *gsm_imsi_mnc(char *imsi)
 		return "Unknown";
 	if (found > 1)
 		return "Ambiguous";
-	return gsm_networks[position].name;
+	return net_idx[position].net->name;
 }
 
-
@@ -0,0 +1,82 @@
+/* Checks for the network name lookups and loaded overrides */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/bb/common/networks.h>
+
+#define NETS_FILE	"networks_test.txt"
+
+static int errors;
+
+static void expect(const char *what, const char *got, const char *want)
+{
+	printf("%s: %s\n", what, got);
+	if (strcmp(got, want)) {
+		printf("  expected %s\n", want);
+		errors++;
+	}
+}
+
+static void check(const char *imsi, const char *want)
+{
+	char buf[16];
+
+	/* gsm_imsi_mnc() takes a non-const string */
+	strncpy(buf, imsi, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	expect(imsi, gsm_imsi_mnc(buf), want);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *fp;
+	int rc;
+
+	printf("Built-in table\n");
+	check("262011234567890", "T-Mobile");
+	/* the built-in table lists this network more than once */
+	check("234031234567890", "Ambiguous");
+
+	fp = fopen(NETS_FILE, "w");
+	if (!fp) {
+		perror(NETS_FILE);
+		return 1;
+	}
+	fprintf(fp, "# overrides\n262 01 MyTelekom\n262 01 Shadowed\n");
+	fclose(fp);
+
+	rc = gsm_networks_load(NETS_FILE);
+	unlink(NETS_FILE);
+	printf("Loaded %d networks\n", rc);
+	if (rc != 2)
+		errors++;
+
+	/* the loaded entry replaces the built-in one, first line wins */
+	check("262011234567890", "MyTelekom");
+	expect("gsm_get_mnc(262, 01)", gsm_get_mnc(0x262, 0x01f), "MyTelekom");
+	check("234031234567890", "Ambiguous");
+
+	gsm_networks_unload();
+	printf("Unloaded\n");
+	check("262011234567890", "T-Mobile");
+	expect("gsm_get_mnc(262, 01)", gsm_get_mnc(0x262, 0x01f), "T-Mobile");
+
+	printf("%s\n", errors ? "FAILED" : "Done");
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/* Check and time the search for the next frequency to scan */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* gsm322_cs_next() is run against the linear search it replaced, on
+ * random frequency lists with random flags, cell selection states and
+ * skip_max_per_band settings. Both must pick the same frequencies in the
+ * same order. Then a full search over all frequencies is timed with
+ * both. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/bb/common/osmocom_data.h>
+
+#define NUM_FREQ	(1024+299)
+#define NUM_LISTS	300
+
+static struct gsm322_cellsel cs;
+static uint32_t seq_ref[NUM_FREQ + 1], seq_new[NUM_FREQ + 1];
+
+/* the search as it was, visiting every frequency on every call */
+static uint32_t ref_cs_next(struct gsm322_cellsel *cs, int skip_max_per_band,
+	int *band)
+{
+	int i;
+	int j;
+	uint8_t mask, flags;
+	uint32_t weight = 0, test = cs->scan_state;
+
+	mask = GSM322_CS_FLAG_SUPPORT | GSM322_CS_FLAG_POWER
+		| GSM322_CS_FLAG_SIGNAL;
+	if (cs->state == GSM322_C2_STORED_CELL_SEL
+	 || cs->state == GSM322_C5_CHOOSE_CELL)
+		mask |= GSM322_CS_FLAG_BA;
+	flags = mask;
+	for (i = 0; i <= 1023+299; i++) {
+		j = 0;
+		if (!skip_max_per_band) {
+			for (j = 0; gsm_sup_smax[j].max; j++) {
+				if (gsm_sup_smax[j].end >
+						gsm_sup_smax[j].start) {
+					if (gsm_sup_smax[j].start <= i
+					 && gsm_sup_smax[j].end >= i)
+						break;
+				} else {
+					if (gsm_sup_smax[j].start <= i
+					 && 1023 >= i)
+						break;
+					if (0 <= i
+					 && gsm_sup_smax[j].end >= i)
+						break;
+				}
+			}
+			if (gsm_sup_smax[j].max) {
+				if (gsm_sup_smax[j].temp == gsm_sup_smax[j].max)
+					continue;
+			}
+		}
+
+		if ((cs->list[i].flags & mask) == flags) {
+			test = cs->list[i].rxlev + 1;
+			test = (test << 16) | i;
+			if (test >= cs->scan_state)
+				continue;
+			if (test > weight) {
+				weight = test;
+				*band = j;
+			}
+		}
+	}
+
+	return weight;
+}
+
+/* run a full search as gsm322_cs_scan() does, return the number of
+ * frequencies picked */
+static int run(int use_ref, int skip_max_per_band, uint32_t *seq)
+{
+	int i, band, n = 0;
+	uint32_t weight;
+
+	for (i = 0; gsm_sup_smax[i].max; i++)
+		gsm_sup_smax[i].temp = 0;
+	cs.scan_state = 0xffffffff;
+
+	while (1) {
+		band = 0;
+		if (use_ref)
+			weight = ref_cs_next(&cs, skip_max_per_band, &band);
+		else
+			weight = gsm322_cs_next(&cs, skip_max_per_band, &band);
+		cs.scan_state = weight;
+		if (!weight)
+			break;
+		if (seq)
+			seq[n] = weight;
+		n++;
+		if (!skip_max_per_band && gsm_sup_smax[band].max)
+			gsm_sup_smax[band].temp++;
+	}
+
+	return n;
+}
+
+static void random_list(int it)
+{
+	int i;
+
+	memset(&cs, 0, sizeof(cs));
+	cs.state = (it % 4 == 1) ? GSM322_C2_STORED_CELL_SEL
+				 : GSM322_C1_NORMAL_CELL_SEL;
+
+	for (i = 0; i < NUM_FREQ; i++) {
+		cs.list[i].flags = ((rand() % 8) ? GSM322_CS_FLAG_SUPPORT : 0)
+			| ((rand() % 2) ? GSM322_CS_FLAG_BA : 0)
+			| ((rand() % 6) ? GSM322_CS_FLAG_POWER : 0)
+			| ((rand() % (it % 5 + 1)) ? 0 : GSM322_CS_FLAG_SIGNAL);
+		gsm322_cs_set_rxlev(&cs, i, rand() % 64);
+		/* measured again */
+		if (rand() % 3 == 0)
+			gsm322_cs_set_rxlev(&cs, i, rand() % 64);
+	}
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	int it, i, n_ref, n_new, skip, errors = 0;
+	double t;
+
+	srand(1);
+	gsm322_smax_band_init();
+
+	for (it = 0; it < NUM_LISTS; it++) {
+		random_list(it);
+		skip = (it % 3 == 0);
+		n_ref = run(1, skip, seq_ref);
+		n_new = run(0, skip, seq_new);
+		if (n_ref != n_new
+		 || memcmp(seq_ref, seq_new, n_ref * sizeof(*seq_ref))) {
+			printf("list %d: scan order differs\n", it);
+			errors++;
+		}
+	}
+	printf("%d random lists compared, %d differ\n", NUM_LISTS, errors);
+
+	/* all frequencies have signal */
+	memset(&cs, 0, sizeof(cs));
+	for (i = 0; i < NUM_FREQ; i++) {
+		cs.list[i].flags = GSM322_CS_FLAG_SUPPORT
+			| GSM322_CS_FLAG_POWER | GSM322_CS_FLAG_SIGNAL;
+		gsm322_cs_set_rxlev(&cs, i, rand() % 64);
+	}
+
+	t = now_ms();
+	n_ref = run(1, 1, NULL);
+	printf("linear search: %d frequencies in %.3f ms\n", n_ref,
+		now_ms() - t);
+	t = now_ms();
+	n_new = run(0, 1, NULL);
+	printf("rx level map:  %d frequencies in %.3f ms\n", n_new,
+		now_ms() - t);
+
+	return errors ? 1 : 0;
+}
@@ -2184,59 +2184,10 @@ static int gsm322_search_end(struct osmocom_ms *ms)
 static int gsm322_cs_scan(struct osmocom_ms *ms)
 {
 	struct gsm322_cellsel *cs = &ms->cellsel;
-	int i;
-	int j, band = 0;
-	uint8_t mask, flags;
-	uint32_t weight = 0, test = cs->scan_state;
-
-	/* search for strongest unscanned cell */
-	mask = GSM322_CS_FLAG_SUPPORT | GSM322_CS_FLAG_POWER
-		| GSM322_CS_FLAG_SIGNAL;
-	if (cs->state == GSM322_C2_STORED_CELL_SEL
-	 || cs->state == GSM322_C5_CHOOSE_CELL)
-		mask |= GSM322_CS_FLAG_BA;
-	flags = mask; /* all masked flags are requied */
-	for (i = 0; i <= 1023+299; i++) {
-		j = 0; /* make gcc happy */
-		if (!ms->settings.skip_max_per_band) {
-			/* skip if band has enough freqs. scanned (3.2.1) */
-			for (j = 0; gsm_sup_smax[j].max; j++) {
-				if (gsm_sup_smax[j].end >
-						gsm_sup_smax[j].start) {
-					if (gsm_sup_smax[j].start <= i
-					 && gsm_sup_smax[j].end >= i)
-						break;
-				} else {
-					if (gsm_sup_smax[j].start <= i
-					 && 1023 >= i)
-						break;
-					if (0 <= i
-					 && gsm_sup_smax[j].end >= i)
-						break;
-				}
-			}
-			if (gsm_sup_smax[j].max) {
-				if (gsm_sup_smax[j].temp == gsm_sup_smax[j].max)
-					continue;
-			}
-		}
-
-		/* search for unscanned frequency */
-		if ((cs->list[i].flags & mask) == flags) {
-			/* weight depends on the power level
-			 * if it is the same, it depends on arfcn
-			 */
-			test = cs->list[i].rxlev + 1;
-			test = (test << 16) | i;
-			if (test >= cs->scan_state)
-				continue;
-			if (test > weight) {
-				weight = test;
-				band = j;
-			}
+	int band = 0;
+	uint32_t weight;
 
-		}
-	}
+	weight = gsm322_cs_next(cs, ms->settings.skip_max_per_band, &band);
 	cs->scan_state = weight;
 
 	/* if all frequencies have been searched */
@@ -2902,7 +2853,7 @@ int gsm322_l1_signal(unsigned int subsys, unsigned int signal,
 				"twice. Overwriting the first! Please fix "
 				"prim_pm.c\n", gsm_print_arfcn(index2arfcn(i)));
 		}
-		cs->list[i].rxlev = rxlev;
+		gsm322_cs_set_rxlev(cs, i, rxlev);
 		cs->list[i].flags |= GSM322_CS_FLAG_POWER;
 		cs->list[i].flags &= ~GSM322_CS_FLAG_SIGNAL;
 		/* if minimum level is reached or if we stick to a cell */
@@ -5059,6 +5010,8 @@ int gsm322_init(struct osmocom_ms *ms)
 	INIT_LLIST_HEAD(&cs->ba_list);
 	INIT_LLIST_HEAD(&cs->nb_list);
 
+	gsm322_smax_band_init();
+
 	/* set supported frequencies in cell selection list */
 	for (i = 0; i <= 1023+299; i++)
 		if ((ms->settings.freq_map[i >> 3] & (1 << (i & 7))))
@@ -0,0 +1,131 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Search of the next frequency to scan during cell selection. This does
+ * not depend on L1 or any timers, so it is kept apart from gsm322.c and
+ * can be checked by cs_scan_bench. */
+
+#include <stdint.h>
+
+#include <osmocom/bb/common/osmocom_data.h>
+
+/* entry of gsm_sup_smax[] for each frequency index, the terminating entry
+ * if the frequency is not within any range */
+static uint8_t gsm322_smax_band[1024+299];
+
+void gsm322_smax_band_init(void)
+{
+	int i, j;
+
+	for (i = 0; i <= 1023+299; i++) {
+		for (j = 0; gsm_sup_smax[j].max; j++) {
+			if (gsm_sup_smax[j].end > gsm_sup_smax[j].start) {
+				if (gsm_sup_smax[j].start <= i
+				 && gsm_sup_smax[j].end >= i)
+					break;
+			} else {
+				if (gsm_sup_smax[j].start <= i
+				 && 1023 >= i)
+					break;
+				if (0 <= i
+				 && gsm_sup_smax[j].end >= i)
+					break;
+			}
+		}
+		gsm322_smax_band[i] = j;
+	}
+}
+
+/* store the rx level of a frequency and keep it in the rx level map */
+void gsm322_cs_set_rxlev(struct gsm322_cellsel *cs, int i, uint8_t rxlev)
+{
+	cs->rxlev_map[cs->list[i].rxlev & 63][i >> 5] &= ~(1U << (i & 31));
+	cs->list[i].rxlev = rxlev;
+	cs->rxlev_map[rxlev & 63][i >> 5] |= 1U << (i & 31);
+}
+
+/* highest frequency index below 'limit' in a row of the rx level map */
+static int gsm322_rxlev_map_prev(const uint32_t *map, int limit)
+{
+	int w;
+	uint32_t bits;
+
+	if (limit <= 0)
+		return -1;
+	limit--;
+	w = limit >> 5;
+	bits = map[w] & (0xffffffff >> (31 - (limit & 31)));
+	while (!bits) {
+		if (--w < 0)
+			return -1;
+		bits = map[w];
+	}
+
+	return (w << 5) + 31 - __builtin_clz(bits);
+}
+
+/* find the strongest unscanned frequency below the one scanned before
+ * (cs->scan_state). return its weight, 0 if there is none left, and the
+ * gsm_sup_smax[] entry of its band */
+uint32_t gsm322_cs_next(struct gsm322_cellsel *cs, int skip_max_per_band,
+	int *band)
+{
+	int i, j, limit, level;
+	uint8_t mask, flags;
+	uint32_t weight = 0;
+
+	/* search for strongest unscanned cell */
+	mask = GSM322_CS_FLAG_SUPPORT | GSM322_CS_FLAG_POWER
+		| GSM322_CS_FLAG_SIGNAL;
+	if (cs->state == GSM322_C2_STORED_CELL_SEL
+	 || cs->state == GSM322_C5_CHOOSE_CELL)
+		mask |= GSM322_CS_FLAG_BA;
+	flags = mask; /* all masked flags are requied */
+
+	/* the weight depends on the power level, if it is the same, it
+	 * depends on arfcn. it must be below the weight of the frequency
+	 * scanned before, so we continue where the last search stopped,
+	 * walking the rx level map from strongest to weakest. */
+	level = cs->scan_state >> 16;
+	limit = cs->scan_state & 0xffff;
+	if (level > 64) {
+		level = 64;
+		limit = 1024+299;
+	}
+	for (; level > 0 && !weight; level--, limit = 1024+299) {
+		i = limit;
+		while ((i = gsm322_rxlev_map_prev(cs->rxlev_map[level - 1], i))
+				>= 0) {
+			/* search for unscanned frequency */
+			if ((cs->list[i].flags & mask) != flags)
+				continue;
+
+			j = gsm322_smax_band[i];
+			/* skip if band has enough freqs. scanned (3.2.1) */
+			if (!skip_max_per_band
+			 && gsm_sup_smax[j].max
+			 && gsm_sup_smax[j].temp == gsm_sup_smax[j].max)
+				continue;
+
+			weight = (level << 16) | i;
+			*band = j;
+			break;
+		}
+	}
+
+	return weight;
+}
@@ -23,6 +23,7 @@
 
 #include <osmocom/bb/common/osmocom_data.h>
 #include <osmocom/bb/common/logging.h>
+#include <osmocom/bb/common/networks.h>
 #include <osmocom/bb/mobile/app_mobile.h>
 
 #include <osmocom/core/talloc.h>
@@ -205,7 +206,7 @@ void sighandler(int sigset)
 
 int main(int argc, char **argv)
 {
-	char *config_file;
+	char *config_file, *networks_file;
 	int quit = 0;
 	int rc;
 
@@ -256,6 +257,19 @@ int main(int argc, char **argv)
 	config_dir = talloc_strdup(l23_ctx, config_file);
 	config_dir = dirname(config_dir);
 
+	/* optional list of networks, overriding the built-in one */
+	networks_file = talloc_asprintf(l23_ctx, "%s/networks.txt", config_dir);
+	if (access(networks_file, R_OK) == 0) {
+		rc = gsm_networks_load(networks_file);
+		if (rc < 0)
+			fprintf(stderr, "Failed to load '%s': %s\n",
+				networks_file, strerror(-rc));
+		else
+			printf("Loaded %d networks from '%s'\n", rc,
+				networks_file);
+	}
+	talloc_free(networks_file);
+
 	if (use_mncc_sock)
 		rc = l23_app_init(mncc_recv_socket, config_file, vty_ip, vty_port);
 	else
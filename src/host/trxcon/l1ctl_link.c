@@ -30,7 +30,9 @@
 #include <string.h>
 #include <assert.h>
 
+#include <fcntl.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
@@ -68,71 +70,161 @@ static struct osmo_fsm l1ctl_fsm = {
 	.event_names = l1ctl_evt_names,
 };
 
-static int l1ctl_link_read_cb(struct osmo_fd *bfd)
+/* Handle all complete frames in the receive buffer */
+static int l1ctl_link_rx_frames(struct l1ctl_link *l1l)
 {
-	struct l1ctl_link *l1l = (struct l1ctl_link *) bfd->data;
+	unsigned int off = 0;
 	struct msgb *msg;
 	uint16_t len;
+	int rc = 0;
+
+	while (l1l->rx_len - off >= L1CTL_MSG_LEN_FIELD) {
+		/* Check message length */
+		len = (l1l->rx_buf[off] << 8) | l1l->rx_buf[off + 1];
+		if (len > L1CTL_LENGTH) {
+			/* There is no way to find the next frame */
+			LOGP(DL1D, LOGL_ERROR, "Length is too big: %u\n", len);
+			l1ctl_link_close_conn(l1l);
+			return -EINVAL;
+		}
+
+		/* Wait for the rest of this frame */
+		if (l1l->rx_len - off < L1CTL_MSG_LEN_FIELD + len)
+			break;
+
+		/* Allocate a new msg */
+		msg = msgb_alloc_headroom(L1CTL_LENGTH + L1CTL_HEADROOM,
+			L1CTL_HEADROOM, "l1ctl_rx_msg");
+		if (!msg) {
+			LOGP(DL1D, LOGL_ERROR, "Failed to allocate msg\n");
+			/* Keep the rest, but not what was delivered */
+			rc = -ENOMEM;
+			break;
+		}
+
+		msg->l1h = msgb_put(msg, len);
+		memcpy(msg->l1h, l1l->rx_buf + off + L1CTL_MSG_LEN_FIELD, len);
+		off += L1CTL_MSG_LEN_FIELD + len;
+
+		/* Debug print */
+		LOGP(DL1D, LOGL_DEBUG, "RX: '%s'\n",
+			osmo_hexdump(msg->data, msg->len));
+
+		/* Call L1CTL handler */
+		l1ctl_rx_cb(l1l, msg);
+
+		/* The handler may have dropped the connection */
+		if (l1l->wq.bfd.fd == -1)
+			return 0;
+	}
+
+	/* Move what is left to the front */
+	l1l->rx_len -= off;
+	if (off > 0 && l1l->rx_len > 0)
+		memmove(l1l->rx_buf, l1l->rx_buf + off, l1l->rx_len);
+
+	return rc;
+}
+
+static int l1ctl_link_read_cb(struct osmo_fd *bfd)
+{
+	struct l1ctl_link *l1l = (struct l1ctl_link *) bfd->data;
 	int rc;
 
-	/* Attempt to read from socket */
-	rc = read(bfd->fd, &len, L1CTL_MSG_LEN_FIELD);
-	if (rc < L1CTL_MSG_LEN_FIELD) {
+	/* Frames left over after an allocation failure come first */
+	if (l1l->rx_len == sizeof(l1l->rx_buf))
+		return l1ctl_link_rx_frames(l1l);
+
+	/**
+	 * Read as much as there is room for, a partial frame
+	 * never takes more than L1CTL_MSG_LEN_FIELD + L1CTL_LENGTH.
+	 */
+	rc = read(bfd->fd, l1l->rx_buf + l1l->rx_len,
+		sizeof(l1l->rx_buf) - l1l->rx_len);
+	if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+	if (rc <= 0) {
 		LOGP(DL1D, LOGL_NOTICE, "L1CTL has lost connection\n");
-		if (rc >= 0)
+		if (rc == 0)
 			rc = -EIO;
 		l1ctl_link_close_conn(l1l);
 		return rc;
 	}
 
-	/* Check message length */
-	len = ntohs(len);
-	if (len > L1CTL_LENGTH) {
-		LOGP(DL1D, LOGL_ERROR, "Length is too big: %u\n", len);
-		return -EINVAL;
+	l1l->rx_len += rc;
+
+	return l1ctl_link_rx_frames(l1l);
+}
+
+/* Write as many queued messages as possible using a single writev() */
+static int l1ctl_link_write_cb(struct osmo_fd *bfd)
+{
+	struct l1ctl_link *l1l = (struct l1ctl_link *) bfd->data;
+	struct iovec iov[L1CTL_TX_IOV_MAX];
+	struct osmo_wqueue *wq = &l1l->wq;
+	struct msgb *msg;
+	ssize_t rc;
+	int n = 0;
+
+	llist_for_each_entry(msg, &wq->msg_queue, list) {
+		iov[n].iov_base = msg->data;
+		iov[n].iov_len = msg->len;
+		if (++n == L1CTL_TX_IOV_MAX)
+			break;
 	}
 
-	/* Allocate a new msg */
-	msg = msgb_alloc_headroom(L1CTL_LENGTH + L1CTL_HEADROOM,
-		L1CTL_HEADROOM, "l1ctl_rx_msg");
-	if (!msg) {
-		LOGP(DL1D, LOGL_ERROR, "Failed to allocate msg\n");
-		return -ENOMEM;
+	if (n == 0) {
+		bfd->when &= ~BSC_FD_WRITE;
+		return 0;
 	}
 
-	msg->l1h = msgb_put(msg, len);
-	rc = read(bfd->fd, msg->l1h, msgb_l1len(msg));
-	if (rc != len) {
-		LOGP(DL1D, LOGL_ERROR, "Can not read data: len=%d < rc=%d: "
-			"%s\n", len, rc, strerror(errno));
-		msgb_free(msg);
-		return rc;
+	/* The first message may be partially written */
+	iov[0].iov_base = (uint8_t *) iov[0].iov_base + l1l->tx_off;
+	iov[0].iov_len -= l1l->tx_off;
+
+	rc = writev(bfd->fd, iov, n);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		LOGP(DL1D, LOGL_ERROR, "Failed to write data: %s\n",
+			strerror(errno));
+		osmo_wqueue_clear(wq);
+		l1l->tx_off = 0;
+		return -EIO;
 	}
 
-	/* Debug print */
-	LOGP(DL1D, LOGL_DEBUG, "RX: '%s'\n",
-		osmo_hexdump(msg->data, msg->len));
+	/* Release completely written messages */
+	l1l->tx_off += rc;
+	while (!llist_empty(&wq->msg_queue)) {
+		msg = llist_entry(wq->msg_queue.next, struct msgb, list);
+		if (l1l->tx_off < msg->len)
+			break;
+
+		l1l->tx_off -= msg->len;
+		llist_del(&msg->list);
+		wq->current_length--;
+		msgb_free(msg);
+	}
 
-	/* Call L1CTL handler */
-	l1ctl_rx_cb(l1l, msg);
+	if (llist_empty(&wq->msg_queue))
+		bfd->when &= ~BSC_FD_WRITE;
 
 	return 0;
 }
 
-static int l1ctl_link_write_cb(struct osmo_fd *bfd, struct msgb *msg)
+static int l1ctl_link_fd_cb(struct osmo_fd *bfd, unsigned int what)
 {
-	int len;
+	if (what & BSC_FD_READ) {
+		l1ctl_link_read_cb(bfd);
 
-	if (bfd->fd <= 0)
-		return -EINVAL;
-
-	len = write(bfd->fd, msg->data, msg->len);
-	if (len != msg->len) {
-		LOGP(DL1D, LOGL_ERROR, "Failed to write data: "
-			"written (%d) < msg_len (%d)\n", len, msg->len);
-		return -1;
+		/* Connection might be closed */
+		if (bfd->fd == -1)
+			return 0;
 	}
 
+	if (what & BSC_FD_WRITE)
+		l1ctl_link_write_cb(bfd);
+
 	return 0;
 }
 
@@ -163,8 +255,8 @@ static int l1ctl_link_accept(struct osmo_fd *bfd, unsigned int flags)
 	osmo_wqueue_init(&l1l->wq, 100);
 	INIT_LLIST_HEAD(&conn_bfd->list);
 
-	l1l->wq.write_cb = l1ctl_link_write_cb;
-	l1l->wq.read_cb = l1ctl_link_read_cb;
+	/* Framing is done here, the queue only holds messages */
+	conn_bfd->cb = l1ctl_link_fd_cb;
 	conn_bfd->when = BSC_FD_READ;
 	conn_bfd->data = l1l;
 	conn_bfd->fd = cfd;
@@ -222,6 +314,8 @@ int l1ctl_link_close_conn(struct l1ctl_link *l1l)
 
 	/* Clear pending messages */
 	osmo_wqueue_clear(&l1l->wq);
+	l1l->rx_len = 0;
+	l1l->tx_off = 0;
 
 	osmo_fsm_inst_dispatch(trxcon_fsm, L1CTL_EVENT_DISCONNECT, l1l);
 	osmo_fsm_inst_state_chg(l1l->fsm, L1CTL_STATE_IDLE, 0, 0);
@@ -278,6 +372,69 @@ int l1ctl_link_init(struct l1ctl_link **l1l, const char *sock_path)
 	return 0;
 }
 
+/**
+ * Write L1CTL messages to a file (with the usual length prefix)
+ * instead of serving a socket, e.g. to process recorded bursts
+ * without a layer23 application.
+ */
+int l1ctl_link_init_file(struct l1ctl_link **l1l, const char *path)
+{
+	struct l1ctl_link *l1l_new;
+	struct osmo_fd *conn_bfd;
+	int fd;
+
+	LOGP(DL1C, LOGL_NOTICE, "Init L1CTL link (file %s)\n", path);
+
+	l1l_new = talloc_zero(tall_trx_ctx, struct l1ctl_link);
+	if (!l1l_new) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to allocate memory\n");
+		return -ENOMEM;
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Could not open '%s': %s\n",
+			path, strerror(errno));
+		talloc_free(l1l_new);
+		return -errno;
+	}
+
+	/* Nothing to listen on */
+	l1l_new->listen_bfd.fd = -1;
+
+	/* Set up the connection as if it was accepted, but write-only */
+	conn_bfd = &l1l_new->wq.bfd;
+	osmo_wqueue_init(&l1l_new->wq, 100);
+	INIT_LLIST_HEAD(&conn_bfd->list);
+
+	conn_bfd->cb = l1ctl_link_fd_cb;
+	conn_bfd->when = 0;
+	conn_bfd->data = l1l_new;
+	conn_bfd->fd = fd;
+
+	if (osmo_fd_register(conn_bfd) != 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to register file fd\n");
+		close(fd);
+		talloc_free(l1l_new);
+		return -EIO;
+	}
+
+	/* Bind shutdown handler */
+	l1l_new->shutdown_cb = l1ctl_shutdown_cb;
+
+	/* Allocate a new dedicated state machine */
+	osmo_fsm_register(&l1ctl_fsm);
+	l1l_new->fsm = osmo_fsm_inst_alloc(&l1ctl_fsm, l1l_new,
+		NULL, LOGL_DEBUG, "l1ctl_link");
+
+	osmo_fsm_inst_dispatch(trxcon_fsm, L1CTL_EVENT_CONNECT, l1l_new);
+	osmo_fsm_inst_state_chg(l1l_new->fsm, L1CTL_STATE_CONNECTED, 0, 0);
+
+	*l1l = l1l_new;
+
+	return 0;
+}
+
 void l1ctl_link_shutdown(struct l1ctl_link *l1l)
 {
 	struct osmo_fd *listen_bfd;
@@ -17,6 +17,14 @@
  */
 #define L1CTL_MSG_LEN_FIELD 2
 
+/**
+ * Received bytes are buffered, so all complete frames
+ * are handled per wakeup, and queued messages are
+ * written in batches of up to L1CTL_TX_IOV_MAX.
+ */
+#define L1CTL_RX_BUF_LEN (8 * (L1CTL_MSG_LEN_FIELD + L1CTL_LENGTH))
+#define L1CTL_TX_IOV_MAX 32
+
 /* Forward declaration to avoid mutual include */
 struct trx_instance;
 
@@ -37,11 +45,18 @@ struct l1ctl_link {
 	struct osmo_timer_list fbsb_timer;
 	uint8_t fbsb_conf_sent;
 
+	/* Receive buffer, holds rx_len bytes of unparsed frames */
+	uint8_t rx_buf[L1CTL_RX_BUF_LEN];
+	unsigned int rx_len;
+	/* Bytes of the first queued message already written */
+	unsigned int tx_off;
+
 	/* Shutdown callback */
 	void (*shutdown_cb)(struct l1ctl_link *l1l);
 };
 
 int l1ctl_link_init(struct l1ctl_link **l1l, const char *sock_path);
+int l1ctl_link_init_file(struct l1ctl_link **l1l, const char *path);
 void l1ctl_link_shutdown(struct l1ctl_link *l1l);
 
 int l1ctl_link_send(struct l1ctl_link *l1l, struct msgb *msg);
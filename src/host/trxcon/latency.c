@@ -0,0 +1,339 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * Latency histograms of the TDMA scheduler
+ *
+ * (C) 2017 by Vadim Yanitskiy <axilirator@gmail.com>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/logging.h>
+
+#include "latency.h"
+#include "sched_trx.h"
+#include "logging.h"
+#include "trxcon.h"
+
+struct lat_stats lat_stats;
+
+static struct osmo_fd lat_sock_ofd = { .fd = -1 };
+
+/* Clients still being sent a dump, the oldest is dropped beyond that */
+#define LAT_SOCK_MAX_PENDING	4
+
+struct lat_sock_client {
+	struct llist_head list;
+	struct osmo_fd ofd;
+	char *buf;
+	size_t buf_len;
+	size_t off;
+};
+
+static LLIST_HEAD(lat_sock_clients);
+static unsigned int lat_sock_num_clients;
+
+static const char *lat_hist_names[_LAT_MAX] = {
+	[LAT_RX_IND]		= "rx-ind",
+	[LAT_CLCK_JITTER]	= "clck-jitter",
+	[LAT_TX_LEAD]		= "tx-lead",
+};
+
+static inline unsigned int lat_hist_index(uint32_t v)
+{
+	unsigned int shift;
+
+	if (v < LAT_HIST_SUB)
+		return v;
+
+	shift = 31 - __builtin_clz(v) - LAT_HIST_SUB_BITS;
+	return (shift + 1) * LAT_HIST_SUB + (v >> shift) - LAT_HIST_SUB;
+}
+
+/* Highest value falling into a bucket */
+static uint32_t lat_hist_value(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < LAT_HIST_SUB)
+		return idx;
+
+	shift = idx / LAT_HIST_SUB - 1;
+	return ((uint32_t) (LAT_HIST_SUB + idx % LAT_HIST_SUB) << shift)
+		+ ((1U << shift) - 1);
+}
+
+void lat_hist_record(struct lat_hist *h, int32_t us)
+{
+	if (h->count == 0 || us < h->min)
+		h->min = us;
+	if (h->count == 0 || us > h->max)
+		h->max = us;
+
+	h->count++;
+
+	if (us < 0) {
+		h->negative++;
+		us = 0;
+	}
+
+	h->sum += us;
+	h->buckets[lat_hist_index(us)]++;
+}
+
+/* Value below which pct percent of the recorded values are */
+uint32_t lat_hist_percentile(const struct lat_hist *h, double pct)
+{
+	uint64_t want, seen = 0;
+	unsigned int i;
+
+	if (h->count == 0)
+		return 0;
+
+	want = h->count * pct / 100.0;
+	if (want == 0)
+		want = 1;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= want)
+			break;
+	}
+
+	/* The bucket may reach beyond the largest value */
+	if (h->max >= 0 && lat_hist_value(i) > (uint32_t) h->max)
+		return h->max;
+
+	return lat_hist_value(i);
+}
+
+static void lat_hist_dump(FILE *out, const char *name,
+	const struct lat_hist *h)
+{
+	fprintf(out, "%-16s %10llu %7d %7u %7u %7u %7u %7d %7llu %8llu\n",
+		name, (unsigned long long) h->count, h->min,
+		lat_hist_percentile(h, 50.0),
+		lat_hist_percentile(h, 90.0),
+		lat_hist_percentile(h, 99.0),
+		lat_hist_percentile(h, 99.9), h->max,
+		(unsigned long long) (h->sum / h->count),
+		(unsigned long long) h->negative);
+}
+
+/* Prints count, percentiles etc. of all non-empty histograms */
+void lat_stats_dump(FILE *out)
+{
+	char name[32];
+	int i;
+
+	fprintf(out, "%-16s %10s %7s %7s %7s %7s %7s %7s %7s %8s\n",
+		"# latency (us)", "count", "min", "p50", "p90", "p99",
+		"p99.9", "max", "mean", "negative");
+
+	for (i = 0; i < _LAT_MAX; i++) {
+		if (lat_stats.hist[i].count)
+			lat_hist_dump(out, lat_hist_names[i],
+				&lat_stats.hist[i]);
+	}
+
+	for (i = 0; i < _TRX_CHAN_MAX; i++) {
+		if (!lat_stats.dec[i].count)
+			continue;
+
+		snprintf(name, sizeof(name), "dec/%s", trx_lchan_desc[i].name);
+		lat_hist_dump(out, name, &lat_stats.dec[i]);
+	}
+
+	fflush(out);
+}
+
+void lat_stats_reset(void)
+{
+	memset(&lat_stats, 0, sizeof(lat_stats));
+}
+
+/**
+ * Sends as much of a dump as the socket takes. Returns 1 once
+ * all is sent, 0 if the rest has to wait, negative on error.
+ */
+static int lat_sock_send(int fd, const char *buf, size_t buf_len,
+	size_t *off)
+{
+	ssize_t n;
+
+	while (*off < buf_len) {
+		n = send(fd, buf + *off, buf_len - *off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (n < 0)
+			return -errno;
+		*off += n;
+	}
+
+	return 1;
+}
+
+static void lat_sock_client_free(struct lat_sock_client *cl)
+{
+	osmo_fd_unregister(&cl->ofd);
+	close(cl->ofd.fd);
+	llist_del(&cl->list);
+	lat_sock_num_clients--;
+	free(cl->buf);
+	talloc_free(cl);
+}
+
+static int lat_sock_client_write(struct osmo_fd *ofd, unsigned int what)
+{
+	struct lat_sock_client *cl = ofd->data;
+	int rc;
+
+	rc = lat_sock_send(ofd->fd, cl->buf, cl->buf_len, &cl->off);
+	if (rc != 0)
+		lat_sock_client_free(cl);
+
+	return 0;
+}
+
+/* Every connection gets a dump and is closed once it's sent */
+static int lat_stats_sock_accept(struct osmo_fd *ofd, unsigned int what)
+{
+	struct lat_sock_client *cl;
+	struct sockaddr_un un_addr;
+	size_t buf_len = 0, off = 0;
+	char *buf = NULL;
+	socklen_t len;
+	FILE *out;
+	int cfd, rc;
+
+	len = sizeof(un_addr);
+	cfd = accept(ofd->fd, (struct sockaddr *) &un_addr, &len);
+	if (cfd < 0) {
+		LOGP(DAPP, LOGL_ERROR, "Failed to accept a stats connection\n");
+		return -1;
+	}
+
+	/**
+	 * Don't let a client that doesn't read stall the main loop:
+	 * what doesn't fit into the socket buffer is sent as it reads.
+	 */
+	rc = fcntl(cfd, F_GETFL);
+	if (rc < 0 || fcntl(cfd, F_SETFL, rc | O_NONBLOCK) < 0) {
+		close(cfd);
+		return -1;
+	}
+
+	/**
+	 * Format into memory and send() it, so a client
+	 * that is gone already doesn't raise SIGPIPE.
+	 */
+	out = open_memstream(&buf, &buf_len);
+	if (out == NULL) {
+		close(cfd);
+		return -1;
+	}
+
+	lat_stats_dump(out);
+	fclose(out);
+
+	if (lat_sock_send(cfd, buf, buf_len, &off) != 0)
+		goto done;
+
+	if (lat_sock_num_clients >= LAT_SOCK_MAX_PENDING) {
+		LOGP(DAPP, LOGL_NOTICE, "Dropping a stats connection "
+			"that doesn't read\n");
+		lat_sock_client_free(llist_entry(lat_sock_clients.next,
+			struct lat_sock_client, list));
+	}
+
+	cl = talloc_zero(tall_trx_ctx, struct lat_sock_client);
+	if (cl == NULL)
+		goto done;
+
+	cl->buf = buf;
+	cl->buf_len = buf_len;
+	cl->off = off;
+	cl->ofd.fd = cfd;
+	cl->ofd.when = BSC_FD_WRITE;
+	cl->ofd.cb = lat_sock_client_write;
+	cl->ofd.data = cl;
+	if (osmo_fd_register(&cl->ofd) < 0) {
+		talloc_free(cl);
+		goto done;
+	}
+
+	llist_add_tail(&cl->list, &lat_sock_clients);
+	lat_sock_num_clients++;
+
+	return 0;
+
+done:
+	free(buf);
+	close(cfd);
+
+	return 0;
+}
+
+int lat_stats_sock_init(const char *sock_path)
+{
+	int rc;
+
+	rc = osmo_sock_unix_init_ofd(&lat_sock_ofd, SOCK_STREAM, 0,
+		sock_path, OSMO_SOCK_F_BIND);
+	if (rc < 0) {
+		LOGP(DAPP, LOGL_ERROR, "Could not create stats socket: %s\n",
+			strerror(errno));
+		return rc;
+	}
+
+	lat_sock_ofd.cb = lat_stats_sock_accept;
+	lat_sock_ofd.when = BSC_FD_READ;
+
+	LOGP(DAPP, LOGL_NOTICE, "Latency stats on %s\n", sock_path);
+
+	return 0;
+}
+
+void lat_stats_sock_close(void)
+{
+	if (lat_sock_ofd.fd < 0)
+		return;
+
+	osmo_fd_unregister(&lat_sock_ofd);
+	close(lat_sock_ofd.fd);
+	lat_sock_ofd.fd = -1;
+
+	while (!llist_empty(&lat_sock_clients))
+		lat_sock_client_free(llist_entry(lat_sock_clients.next,
+			struct lat_sock_client, list));
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sched_trx.h"
+
+/**
+ * Log-linear histogram buckets (like HdrHistogram): values below
+ * 2^LAT_HIST_SUB_BITS are exact, above each power of two is split
+ * in 2^LAT_HIST_SUB_BITS buckets, i.e. the relative error is 1/16.
+ */
+#define LAT_HIST_SUB_BITS	4
+#define LAT_HIST_SUB		(1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS	((32 - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+
+enum lat_hist_type {
+	/*! \brief RX burst (last of a block) until L1CTL indication */
+	LAT_RX_IND,
+	/*! \brief Frame clock timer wake up vs. frame boundary */
+	LAT_CLCK_JITTER,
+	/*! \brief Time left until an UL burst is due at the transceiver */
+	LAT_TX_LEAD,
+	_LAT_MAX
+};
+
+/*! \brief Histogram of latencies in microseconds */
+struct lat_hist {
+	uint64_t buckets[LAT_HIST_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	/*! \brief Negative values, recorded as 0 */
+	uint64_t negative;
+	int32_t min;
+	int32_t max;
+};
+
+struct lat_stats {
+	struct lat_hist hist[_LAT_MAX];
+	/*! \brief Decoding time per lchan type */
+	struct lat_hist dec[_TRX_CHAN_MAX];
+};
+
+extern struct lat_stats lat_stats;
+
+/* Monotonic time stamp in microseconds */
+static inline uint64_t lat_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void lat_hist_record(struct lat_hist *h, int32_t us);
+uint32_t lat_hist_percentile(const struct lat_hist *h, double pct);
+
+#define LAT_RECORD(type, us) \
+	lat_hist_record(&lat_stats.hist[type], us)
+#define LAT_RECORD_DEC(chan, us) \
+	lat_hist_record(&lat_stats.dec[chan], us)
+
+void lat_stats_dump(FILE *out);
+void lat_stats_reset(void);
+int lat_stats_sock_init(const char *sock_path);
+void lat_stats_sock_close(void);
@@ -0,0 +1,163 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: micro-benchmark
+ *
+ * Drives synthetic bursts through the scheduler on all 8 timeslots,
+ * without any transceiver or L1CTL peer attached.
+ *
+ * (C) 2017 by Vadim Yanitskiy <axilirator@gmail.com>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include <osmocom/core/fsm.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/write_queue.h>
+
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include "trxcon.h"
+#include "trx_if.h"
+#include "logging.h"
+#include "l1ctl_link.h"
+#include "scheduler.h"
+#include "sched_trx.h"
+
+#define BENCH_FRAMES	(26 * 2000)
+
+void *tall_trx_ctx = NULL;
+struct osmo_fsm_inst *trxcon_fsm = NULL;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void push_facch(struct trx_instance *trx, uint8_t tn)
+{
+	struct trx_ts_prim *prim;
+	uint8_t chan_nr = RSL_CHAN_Bm_ACCHs | tn;
+
+	if (sched_prim_init(trx, &prim, GSM_MACBLOCK_LEN, chan_nr, 0x00))
+		return;
+
+	memset(prim->payload, 0x2b, GSM_MACBLOCK_LEN);
+	if (sched_prim_push(trx, prim, chan_nr))
+		talloc_free(prim);
+}
+
+static void run(struct trx_instance *trx, struct l1ctl_link *l1l,
+	const char *name, int traffic)
+{
+	sbit_t bits[GSM_BURST_LEN];
+	double start, stop;
+	uint32_t fn;
+	int i, tn;
+
+	for (i = 0; i < GSM_BURST_LEN; i++)
+		bits[i] = (rand() % 255) - 127;
+
+	start = now_us();
+
+	for (fn = 0; fn < BENCH_FRAMES; fn++) {
+		/* Uplink: one FACCH block per timeslot every 8 frames */
+		if (traffic && fn % 8 == 0) {
+			for (tn = 0; tn < TRX_TS_COUNT; tn++)
+				push_facch(trx, tn);
+		}
+
+		/* Downlink bursts of all timeslots */
+		for (tn = 0; tn < TRX_TS_COUNT; tn++)
+			sched_trx_handle_rx_burst(trx, tn, fn, bits,
+				GSM_BURST_LEN, -60, 0);
+
+		/* Uplink frame clock */
+		trx->sched.fn_counter_proc = fn;
+		trx->sched.clock_cb(&trx->sched);
+
+		/* Nobody reads L1CTL messages here */
+		osmo_wqueue_clear(&l1l->wq);
+	}
+
+	stop = now_us();
+
+	printf("%-8s: %7.1f ns per burst, %7.2f us per TDMA frame\n", name,
+		(stop - start) * 1e3 / (BENCH_FRAMES * TRX_TS_COUNT),
+		(stop - start) / BENCH_FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+	struct trx_instance *trx;
+	struct l1ctl_link *l1l;
+	int tn;
+
+	tall_trx_ctx = talloc_named_const(NULL, 1, "sched_bench context");
+	trx_log_init(NULL);
+	log_set_log_level(osmo_stderr_target, LOGL_FATAL);
+
+	l1l = talloc_zero(tall_trx_ctx, struct l1ctl_link);
+	osmo_wqueue_init(&l1l->wq, INT_MAX);
+	l1l->wq.bfd.fd = -1;
+
+	if (trx_if_open(&trx, "127.0.0.1", "127.0.0.1", 6700)) {
+		fprintf(stderr, "Failed to open transceiver interface\n");
+		return EXIT_FAILURE;
+	}
+
+	trx->l1l = l1l;
+	l1l->trx = trx;
+	sched_trx_init(trx, 3);
+
+	/* TCH/F on all timeslots */
+	for (tn = 0; tn < TRX_TS_COUNT; tn++) {
+		if (sched_trx_configure_ts(trx, tn, GSM_PCHAN_TCH_F)) {
+			fprintf(stderr, "Failed to configure TS%d\n", tn);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* Logical channels inactive: lookup and dispatch only */
+	run(trx, l1l, "dispatch", 0);
+
+	for (tn = 0; tn < TRX_TS_COUNT; tn++)
+		sched_trx_set_lchans(trx->ts_list[tn], RSL_CHAN_Bm_ACCHs | tn,
+			1, GSM48_CMODE_SIGN);
+
+	/* Active TCH/F + SACCH/F: decoding, encoding and L1CTL messages */
+	run(trx, l1l, "traffic", 1);
+
+	sched_trx_shutdown(trx);
+	trx_if_close(trx);
+	talloc_free(l1l);
+
+	return EXIT_SUCCESS;
+}
@@ -28,6 +28,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/timerfd.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/msgb.h>
@@ -39,97 +43,243 @@
 #include "logging.h"
 #include "trx_if.h"
 #include "trxcon.h"
+#include "latency.h"
 
-#define FRAME_DURATION_uS	4615
 #define MAX_FN_SKEW		50
 #define TRX_LOSS_FRAMES	400
 
-static void sched_clck_tick(void *data)
+/**
+ * The local frame clock is a second order PLL: every clock indication
+ * (a burst with fn % 51 == 0) yields the phase error between its time
+ * of arrival and the predicted start of that frame. A part of it
+ * corrects the phase, another part the estimated frame duration, so
+ * the clock follows the transceiver even if its reference and the PC
+ * clock drift apart, while the arrival jitter is smoothed out.
+ *
+ * With gains of 1/16 and 1/256 the loop is about critically damped
+ * (poles at |z| = 0.97) and settles within ~30 indications, i.e. 7 s,
+ * while hundreds of us of arrival jitter move the estimated drift by
+ * up to some 25 ppm and well below 1 ppm on average, as
+ * sched_clck_sim shows.
+ */
+#define PLL_KP_SHIFT		4
+#define PLL_KI_SHIFT		8
+/* Larger errors are not jitter: the phase is set, the drift kept */
+#define PLL_MAX_ERR_NS		(2 * FRAME_DURATION_nS)
+/* Bounds of the estimated drift */
+#define PLL_MAX_PPM		200
+
+#define FRAC(ns)		((int64_t) (ns) * (1 << SCHED_CLCK_FRAC_BITS))
+#define UNFRAC(q)		((int64_t) (q) >> SCHED_CLCK_FRAC_BITS)
+#define PERIOD_NOMINAL		(FRAC(120000000) / 26)
+
+/* CLOCK_MONOTONIC in ns, the clock simulation brings its own */
+#ifndef SCHED_CLCK_NOW_NS
+static uint64_t sched_clck_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#define SCHED_CLCK_NOW_NS	sched_clck_now_ns
+#endif
+
+/**
+ * All fixed point times are relative to clock_base, which follows the
+ * clock. So they stay small, however long the process runs, and are
+ * compared by their signed differences.
+ */
+static int64_t clck_now(struct trx_sched *sched)
+{
+	return FRAC((int64_t) (SCHED_CLCK_NOW_NS() - sched->clock_base));
+}
+
+/* Move the whole ns of the clock to its base */
+static void sched_clck_rebase(struct trx_sched *sched)
+{
+	int64_t ns = UNFRAC(sched->clock);
+
+	sched->clock_base += ns;
+	sched->clock -= FRAC(ns);
+}
+
+/* Arm the timer for the start of the frame after fn_counter_proc */
+static int sched_clck_arm(struct trx_sched *sched)
+{
+	uint64_t next_ns = sched->clock_base
+		+ UNFRAC(sched->clock + (int64_t) sched->period);
+	struct itimerspec its = {
+		.it_value = {
+			.tv_sec = next_ns / 1000000000,
+			.tv_nsec = next_ns % 1000000000,
+		},
+	};
+
+	return timerfd_settime(sched->clock_ofd.fd,
+		TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void sched_clck_disarm(struct trx_sched *sched)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (sched->clock_ofd.fd >= 0)
+		timerfd_settime(sched->clock_ofd.fd, 0, &its, NULL);
+}
+
+/* Process all frames starting (up to half a frame) before now */
+static void sched_clck_advance(struct trx_sched *sched, int64_t now)
+{
+	while (now - sched->clock >= (int64_t) sched->period / 2) {
+		sched->clock += sched->period;
+		sched->fn_counter_proc = (sched->fn_counter_proc + 1)
+			% GSM_HYPERFRAME;
+		sched->frame_us = (sched->clock_base
+			+ UNFRAC(sched->clock)) / 1000;
+
+		/* Call frame callback */
+		if (sched->clock_cb)
+			sched->clock_cb(sched);
+	}
+
+	sched_clck_rebase(sched);
+}
+
+static int sched_clck_tick(struct osmo_fd *ofd, unsigned int what)
 {
-	struct trx_sched *sched = (struct trx_sched *) data;
-	struct timeval tv_now, *tv_clock;
-	int32_t elapsed;
+	struct trx_sched *sched = (struct trx_sched *) ofd->data;
+	uint64_t expirations;
+	int64_t now, elapsed;
+
+	if (read(ofd->fd, &expirations, sizeof(expirations)) < 0)
+		return 0;
 
 	/* Check if transceiver is still alive */
-	if (sched->fn_counter_lost++ == TRX_LOSS_FRAMES) {
+	sched->fn_counter_lost += expirations;
+	if (sched->fn_counter_lost >= TRX_LOSS_FRAMES) {
 		LOGP(DSCH, LOGL_DEBUG, "No more clock from transceiver\n");
 		sched->state = SCH_CLCK_STATE_WAIT;
 
-		return;
+		return 0;
 	}
 
-	/* Get actual / previous frame time */
-	gettimeofday(&tv_now, NULL);
-	tv_clock = &sched->clock;
-
-	elapsed = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-		+ (tv_now.tv_usec - tv_clock->tv_usec);
+	/* Time since the start of the last processed frame */
+	now = clck_now(sched);
+	elapsed = now - sched->clock;
 
-	/* If someone played with clock, or if the process stalled */
-	if (elapsed > FRAME_DURATION_uS * MAX_FN_SKEW || elapsed < 0) {
+	/* If the process stalled for too long */
+	if (elapsed > FRAC(FRAME_DURATION_nS) * MAX_FN_SKEW) {
 		LOGP(DSCH, LOGL_NOTICE, "PC clock skew: "
-			"elapsed uS %d\n", elapsed);
+			"elapsed uS %lld\n", (long long) UNFRAC(elapsed) / 1000);
 
 		sched->state = SCH_CLCK_STATE_WAIT;
 
-		return;
+		return 0;
 	}
 
-	/* Schedule next FN clock */
-	while (elapsed > FRAME_DURATION_uS / 2) {
-		tv_clock->tv_usec += FRAME_DURATION_uS;
-		elapsed -= FRAME_DURATION_uS;
+	/* The timer was set for the end of the last processed frame */
+	LAT_RECORD(LAT_CLCK_JITTER,
+		UNFRAC(elapsed - (int64_t) sched->period) / 1000);
 
-		if (tv_clock->tv_usec >= 1000000) {
-			tv_clock->tv_sec++;
-			tv_clock->tv_usec -= 1000000;
-		}
+	sched_clck_advance(sched, now);
+	sched_clck_arm(sched);
 
-		sched->fn_counter_proc = (sched->fn_counter_proc + 1)
-			% GSM_HYPERFRAME;
+	return 0;
+}
 
-		/* Call frame callback */
-		if (sched->clock_cb)
-			sched->clock_cb(sched);
+/* The timer is created on the first clock indication, so that
+ * neither the replay mode nor the benchmark need one */
+static int sched_clck_open(struct trx_sched *sched)
+{
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		LOGP(DSCH, LOGL_ERROR, "Failed to create the frame clock "
+			"timer: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	sched->clock_base = SCHED_CLCK_NOW_NS();
+
+	sched->clock_ofd.fd = fd;
+	sched->clock_ofd.when = BSC_FD_READ;
+	sched->clock_ofd.cb = sched_clck_tick;
+	sched->clock_ofd.data = sched;
+
+	if (osmo_fd_register(&sched->clock_ofd) != 0) {
+		close(fd);
+		sched->clock_ofd.fd = -1;
+		return -EIO;
 	}
 
-	osmo_timer_schedule(&sched->clock_timer, 0,
-		FRAME_DURATION_uS - elapsed);
+	return 0;
 }
 
 static void sched_clck_correct(struct trx_sched *sched,
-	struct timeval *tv_now, uint32_t fn)
+	int64_t now, uint32_t fn)
 {
 	sched->fn_counter_proc = fn;
+	sched->fn_counter_sync = fn;
+	sched->clock = now;
+	sched_clck_rebase(sched);
+	sched->frame_us = (sched->clock_base + UNFRAC(sched->clock)) / 1000;
+
+	/* Keep the drift learned so far */
+	if (!sched->period)
+		sched->period = PERIOD_NOMINAL;
 
 	/* Call frame callback */
 	if (sched->clock_cb)
 		sched->clock_cb(sched);
 
 	/* Schedule first FN clock */
-	memcpy(&sched->clock, tv_now, sizeof(struct timeval));
-	memset(&sched->clock_timer, 0, sizeof(sched->clock_timer));
+	sched_clck_arm(sched);
+}
+
+/* Feed the phase error measured synced_fn frames after the last one */
+static void sched_clck_pll(struct trx_sched *sched, int64_t err,
+	int32_t synced_fn)
+{
+	int64_t max_dev = PERIOD_NOMINAL * PLL_MAX_PPM / 1000000;
+	int64_t dev;
+
+	if (err > FRAC(PLL_MAX_ERR_NS) || err < -FRAC(PLL_MAX_ERR_NS)) {
+		sched->clock += err;
+		return;
+	}
+
+	sched->clock += err >> PLL_KP_SHIFT;
+
+	dev = (int64_t) sched->period - PERIOD_NOMINAL;
+	dev += (err / synced_fn) >> PLL_KI_SHIFT;
+	if (dev > max_dev)
+		dev = max_dev;
+	else if (dev < -max_dev)
+		dev = -max_dev;
 
-	sched->clock_timer.cb = sched_clck_tick;
-	sched->clock_timer.data = sched;
-	osmo_timer_schedule(&sched->clock_timer, 0, FRAME_DURATION_uS);
+	sched->period = PERIOD_NOMINAL + dev;
 }
 
-int sched_clck_handle(struct trx_sched *sched, uint32_t fn)
+int sched_clck_handle(struct trx_sched *sched, uint32_t fn, uint64_t rx_us)
 {
-	struct timeval tv_now, *tv_clock;
-	int32_t elapsed, elapsed_fn;
+	int32_t elapsed_fn, synced_fn;
+	int64_t now, err;
 
 	/* Reset lost counter */
 	sched->fn_counter_lost = 0;
 
-	/* Get actual / previous frame time */
-	gettimeofday(&tv_now, NULL);
-	tv_clock = &sched->clock;
+	if (sched->clock_ofd.fd < 0 && sched_clck_open(sched) != 0)
+		return -EIO;
+
+	/* The time the burst was received */
+	now = FRAC((int64_t) (rx_us * 1000 - sched->clock_base));
 
 	/* If this is the first CLCK IND */
 	if (sched->state == SCH_CLCK_STATE_WAIT) {
-		sched_clck_correct(sched, &tv_now, fn);
+		sched_clck_correct(sched, now, fn);
 
 		LOGP(DSCH, LOGL_DEBUG, "Initial clock received: fn=%u\n", fn);
 		sched->state = SCH_CLCK_STATE_OK;
@@ -139,11 +289,7 @@ int sched_clck_handle(struct trx_sched *sched, uint32_t fn)
 
 	LOGP(DSCH, LOGL_NOTICE, "Clock indication: fn=%u\n", fn);
 
-	osmo_timer_del(&sched->clock_timer);
-
-	/* Calculate elapsed time / frames since last processed fn */
-	elapsed = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-		+ (tv_now.tv_usec - tv_clock->tv_usec);
+	/* Calculate elapsed frames since last processed fn */
 	elapsed_fn = (fn + GSM_HYPERFRAME - sched->fn_counter_proc)
 		% GSM_HYPERFRAME;
 
@@ -155,36 +301,57 @@ int sched_clck_handle(struct trx_sched *sched, uint32_t fn)
 		LOGP(DSCH, LOGL_NOTICE, "GSM clock skew: old fn=%u, "
 			"new fn=%u\n", sched->fn_counter_proc, fn);
 
-		sched_clck_correct(sched, &tv_now, fn);
+		sched_clck_correct(sched, now, fn);
 		return 0;
 	}
 
-	LOGP(DSCH, LOGL_INFO, "GSM clock jitter: %d\n",
-		elapsed_fn * FRAME_DURATION_uS - elapsed);
+	/* Received vs. expected start of the indicated frame */
+	err = now - sched->clock - elapsed_fn * (int64_t) sched->period;
+
+	/* Bursts on several timeslots indicate the same FN */
+	synced_fn = (fn + GSM_HYPERFRAME - sched->fn_counter_sync)
+		% GSM_HYPERFRAME;
+	if (synced_fn > 0) {
+		sched_clck_pll(sched, err, synced_fn);
+		sched->fn_counter_sync = fn;
+
+		LOGP(DSCH, LOGL_INFO, "GSM clock jitter: %lld us, "
+			"drift %+.2f ppm\n", (long long) UNFRAC(err) / 1000,
+			((double) sched->period / PERIOD_NOMINAL - 1.0) * 1e6);
+	}
+
+	/* Transmit what we still need to transmit */
+	sched_clck_advance(sched, clck_now(sched));
+
+	/* Schedule next FN to be transmitted */
+	sched_clck_arm(sched);
+
+	return 0;
+}
 
-	/* Too many frames have been processed already */
-	if (elapsed_fn < 0) {
-		/**
-		 * Set clock to the time or last FN should
-		 * have been transmitted
-		 */
-		tv_clock->tv_sec = tv_now.tv_sec;
-		tv_clock->tv_usec = tv_now.tv_usec +
-			(0 - elapsed_fn) * FRAME_DURATION_uS;
+/**
+ * Virtual clock, used when processing recorded bursts: the frame
+ * callback is called for every frame up to the given one, as fast
+ * as the bursts come in, without any timer.
+ */
+int sched_clck_virt_handle(struct trx_sched *sched, uint32_t fn)
+{
+	int32_t elapsed_fn;
 
-		if (tv_clock->tv_usec >= 1000000) {
-			tv_clock->tv_sec++;
-			tv_clock->tv_usec -= 1000000;
-		}
+	/* The first burst, or a gap in the recording */
+	elapsed_fn = (fn + GSM_HYPERFRAME - sched->fn_counter_proc)
+		% GSM_HYPERFRAME;
+	if (sched->state != SCH_CLCK_STATE_OK || elapsed_fn > MAX_FN_SKEW) {
+		sched->state = SCH_CLCK_STATE_OK;
+		sched->fn_counter_proc = fn;
 
-		/* Set time to the time our next FN has to be transmitted */
-		osmo_timer_schedule(&sched->clock_timer, 0,
-			FRAME_DURATION_uS * (1 - elapsed_fn));
+		/* Call frame callback */
+		if (sched->clock_cb)
+			sched->clock_cb(sched);
 
 		return 0;
 	}
 
-	/* Transmit what we still need to transmit */
 	while (fn != sched->fn_counter_proc) {
 		sched->fn_counter_proc = (sched->fn_counter_proc + 1)
 			% GSM_HYPERFRAME;
@@ -194,10 +361,6 @@ int sched_clck_handle(struct trx_sched *sched, uint32_t fn)
 			sched->clock_cb(sched);
 	}
 
-	/* Schedule next FN to be transmitted */
-	memcpy(tv_clock, &tv_now, sizeof(struct timeval));
-	osmo_timer_schedule(&sched->clock_timer, 0, FRAME_DURATION_uS);
-
 	return 0;
 }
 
@@ -207,9 +370,27 @@ void sched_clck_reset(struct trx_sched *sched)
 	sched->state = SCH_CLCK_STATE_WAIT;
 
 	/* Stop clock timer */
-	osmo_timer_del(&sched->clock_timer);
+	sched_clck_disarm(sched);
 
 	/* Flush counters */
 	sched->fn_counter_proc = 0;
 	sched->fn_counter_lost = 0;
+
+	/* The transceiver may have changed */
+	sched->period = 0;
+}
+
+void sched_clck_init(struct trx_sched *sched)
+{
+	sched->clock_ofd.fd = -1;
+}
+
+void sched_clck_shutdown(struct trx_sched *sched)
+{
+	if (sched->clock_ofd.fd < 0)
+		return;
+
+	osmo_fd_unregister(&sched->clock_ofd);
+	close(sched->clock_ofd.fd);
+	sched->clock_ofd.fd = -1;
 }
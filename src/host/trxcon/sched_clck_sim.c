@@ -0,0 +1,180 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: frame clock simulation
+ *
+ * Runs the frame clock of sched_clck.c on a simulated CLOCK_MONOTONIC,
+ * fed with clock indications of a transceiver whose clock is off by
+ * some ppm and which arrive with some jitter, and checks that the
+ * local clock locks to it. The start times include a long uptime,
+ * where the fixed point times used to overflow.
+ *
+ * (C) 2017 by Vadim Yanitskiy <axilirator@gmail.com>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+
+static uint64_t sim_ns;
+
+static uint64_t sim_now_ns(void)
+{
+	return sim_ns;
+}
+
+/* The clock under test, with the simulated time */
+#define SCHED_CLCK_NOW_NS	sim_now_ns
+#include "sched_clck.c"
+
+#include <math.h>
+
+#include <osmocom/core/application.h>
+
+#define SIM_SECONDS		120
+/* The loop has settled after this, see sched_clck.c */
+#define SIM_SETTLE_SECONDS	30
+/* Limits once settled: the mean and the worst estimated drift */
+#define SIM_MAX_PPM_MEAN	1.0
+#define SIM_MAX_PPM_ERR		40.0
+#define SIM_MAX_PHASE_US	200
+
+#define DAY_NS			(86400ULL * 1000000000)
+
+void *tall_trx_ctx = NULL;
+struct osmo_fsm_inst *trxcon_fsm = NULL;
+
+static struct {
+	double ppm;		/* drift of the transceiver */
+	double period_ns;	/* frame duration of the transceiver */
+	uint64_t start_ns;	/* start of the first frame */
+	uint64_t k;		/* frames since the start */
+	uint64_t frames;	/* frame callbacks */
+	uint64_t fn_errors;	/* frames skipped or repeated */
+	int64_t max_phase_ns;	/* local vs. transceiver, once settled */
+	double ppm_sum;		/* estimated drift, once settled */
+	double max_ppm_err;
+	uint64_t settled;
+} sim;
+
+/* Start of the transceiver's k-th frame */
+static uint64_t sim_frame_ns(uint64_t k)
+{
+	return sim.start_ns + (uint64_t) llround(k * sim.period_ns);
+}
+
+static void sim_frame_cb(struct trx_sched *sched)
+{
+	int64_t phase;
+	double ppm;
+
+	/* The first callback is for the first indication, frame 0 */
+	if (sim.frames++)
+		sim.k++;
+	if (sched->fn_counter_proc != sim.k % GSM_HYPERFRAME)
+		sim.fn_errors++;
+
+	if (sim.k * sim.period_ns < SIM_SETTLE_SECONDS * 1e9)
+		return;
+
+	phase = (int64_t) (sched->clock_base + UNFRAC(sched->clock)
+		- sim_frame_ns(sim.k));
+	if (llabs(phase) > sim.max_phase_ns)
+		sim.max_phase_ns = llabs(phase);
+
+	ppm = ((double) sched->period / PERIOD_NOMINAL - 1.0) * 1e6;
+	if (fabs(ppm - sim.ppm) > sim.max_ppm_err)
+		sim.max_ppm_err = fabs(ppm - sim.ppm);
+	sim.ppm_sum += ppm;
+	sim.settled++;
+}
+
+static int sim_run(double ppm, int jitter_us, uint64_t start_ns)
+{
+	struct trx_sched sched;
+	uint64_t k_ind = 0, ind_ns, timer_ns, end_ns;
+	double mean_ppm;
+	int ok;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.ppm = ppm;
+	sim.period_ns = 120e6 / 26 * (1 + ppm * 1e-6);
+	sim.start_ns = start_ns;
+
+	memset(&sched, 0, sizeof(sched));
+	sched_clck_init(&sched);
+	sched.clock_cb = sim_frame_cb;
+
+	end_ns = sim_frame_ns(SIM_SECONDS * 1e9 / sim.period_ns);
+	ind_ns = sim_frame_ns(0);
+
+	/* The clock indications and the timer, whichever comes first */
+	for (sim_ns = ind_ns; sim_ns < end_ns; ) {
+		if (sched.state == SCH_CLCK_STATE_OK) {
+			timer_ns = sched.clock_base
+				+ UNFRAC(sched.clock + (int64_t) sched.period);
+			if (timer_ns < ind_ns) {
+				sim_ns = timer_ns;
+				sched_clck_advance(&sched, clck_now(&sched));
+				continue;
+			}
+		}
+
+		sim_ns = ind_ns;
+		sched_clck_handle(&sched, k_ind % GSM_HYPERFRAME,
+			sim_ns / 1000);
+
+		k_ind += 51;
+		ind_ns = sim_frame_ns(k_ind);
+		if (jitter_us)
+			ind_ns += (rand() % (2 * jitter_us + 1) - jitter_us)
+				* 1000LL;
+	}
+
+	mean_ppm = sim.settled ? sim.ppm_sum / sim.settled : 0;
+	ok = !sim.fn_errors && sim.settled
+		&& fabs(mean_ppm - ppm) <= SIM_MAX_PPM_MEAN
+		&& sim.max_ppm_err <= SIM_MAX_PPM_ERR
+		&& sim.max_phase_ns <= SIM_MAX_PHASE_US * 1000;
+
+	printf("%+4.0f ppm, jitter %3d us, uptime %4llu d: drift %+6.1f "
+		"(+-%4.1f) ppm, phase %3lld us, %llu frames, %s\n",
+		ppm, jitter_us, (unsigned long long) (start_ns / DAY_NS),
+		mean_ppm, sim.max_ppm_err, (long long) sim.max_phase_ns / 1000,
+		(unsigned long long) sim.frames, ok ? "ok" : "FAILED");
+
+	sched_clck_shutdown(&sched);
+
+	return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int rc = 0;
+
+	trx_log_init(NULL);
+	log_set_log_level(osmo_stderr_target, LOGL_FATAL);
+	srand(1);
+
+	rc |= sim_run(50, 0, DAY_NS);
+	rc |= sim_run(-30, 300, DAY_NS);
+	/* Beyond 2^55 and 2^56 ns of uptime */
+	rc |= sim_run(50, 0, 420 * DAY_NS);
+	rc |= sim_run(-30, 300, 1000 * DAY_NS);
+	rc |= sim_run(-30, 300, (1ULL << 56) - 60ULL * 1000000000);
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
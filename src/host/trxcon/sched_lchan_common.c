@@ -32,6 +32,7 @@
 
 #include <osmocom/core/logging.h>
 #include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
 
 #include <osmocom/codec/codec.h>
 
@@ -83,8 +84,9 @@ const uint8_t sched_nb_training_bits[8][26] = {
 };
 
 int sched_send_dt_ind(struct trx_instance *trx, struct trx_ts *ts,
-	struct trx_lchan_state *lchan, uint8_t *l2, size_t l2_len,
-	int bit_error_count, bool dec_failed, bool traffic)
+	struct trx_lchan_state *lchan, uint32_t first_fn, float rssi,
+	uint8_t *l2, size_t l2_len, int bit_error_count,
+	bool dec_failed, bool traffic)
 {
 	const struct trx_lchan_desc *lchan_desc;
 	struct l1ctl_info_dl dl_hdr;
@@ -96,8 +98,9 @@ int sched_send_dt_ind(struct trx_instance *trx, struct trx_ts *ts,
 	dl_hdr.chan_nr = lchan_desc->chan_nr | ts->index;
 	dl_hdr.link_id = lchan_desc->link_id;
 	dl_hdr.band_arfcn = htons(trx->band_arfcn);
-	dl_hdr.frame_nr = htonl(lchan->rx_first_fn);
-	dl_hdr.rx_level = -(lchan->meas.rssi_sum / lchan->meas.rssi_num);
+	dl_hdr.frame_nr = htonl(first_fn);
+	/* Converting a float out of the range of uint8_t is undefined */
+	dl_hdr.rx_level = rssi < 0 ? -OSMO_MAX(rssi, -255) : 0;
 	dl_hdr.num_biterr = bit_error_count;
 
 	/* FIXME: set proper values */
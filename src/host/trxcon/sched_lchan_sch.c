@@ -42,6 +42,7 @@
 #include "trx_if.h"
 #include "trxcon.h"
 #include "l1ctl.h"
+#include "latency.h"
 
 static void decode_sb(struct gsm_time *time, uint8_t *bsic, uint8_t *sb_info)
 {
@@ -76,6 +77,7 @@ int rx_sch_fn(struct trx_instance *trx, struct trx_ts *ts,
 	sbit_t payload[2 * 39];
 	struct gsm_time time;
 	uint8_t sb_info[4];
+	uint64_t start;
 	uint8_t bsic;
 	int rc;
 
@@ -84,7 +86,9 @@ int rx_sch_fn(struct trx_instance *trx, struct trx_ts *ts,
 	memcpy(payload + 39, bits + 3 + 39 + 64, 39);
 
 	/* Attempt to decode */
+	start = lat_now_us();
 	rc = gsm0503_sch_decode(sb_info, payload);
+	LAT_RECORD_DEC(lchan->type, lat_now_us() - start);
 	if (rc) {
 		LOGP(DSCHD, LOGL_ERROR, "Received bad SCH burst at fn=%u\n", fn);
 		return rc;
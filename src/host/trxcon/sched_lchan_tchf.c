@@ -39,6 +39,7 @@
 #include "l1ctl_proto.h"
 #include "scheduler.h"
 #include "sched_trx.h"
+#include "sched_worker.h"
 #include "logging.h"
 #include "trx_if.h"
 #include "trxcon.h"
@@ -49,12 +50,10 @@ int rx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
 	sbit_t *bits, int8_t rssi, int16_t toa256)
 {
 	const struct trx_lchan_desc *lchan_desc;
-	int n_errors = -1, n_bits_total, rc;
-	uint8_t rsl_cmode, tch_mode, mode;
+	struct sched_dec_job job_buf, *job;
 	sbit_t *buffer, *offset;
-	uint8_t l2[128], *mask;
 	uint32_t *first_fn;
-	size_t l2_len;
+	uint8_t *mask;
 
 	/* Set up pointers */
 	lchan_desc = &trx_lchan_desc[lchan->type];
@@ -93,13 +92,14 @@ int rx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
 		return 0;
 
 	/**
-	 * Get current RSL / TCH modes
-	 *
-	 * FIXME: we do support speech only, and
-	 * CSD support may be implemented latter.
+	 * The BFI of an incomplete frame also goes through the
+	 * decoder queue, so frames are still delivered in order.
 	 */
-	rsl_cmode = RSL_CMOD_SPD_SPEECH;
-	tch_mode = lchan->tch_mode;
+	job = sched_dec_job_alloc(trx, ts, lchan, fn, &job_buf);
+	if (job == NULL)
+		return -ENOBUFS;
+
+	job->type = SCHED_DEC_TCHF;
 
 	/* Check for complete set of bursts */
 	if ((*mask & 0xf) != 0xf) {
@@ -110,21 +110,18 @@ int rx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
 			lchan_desc->name);
 
 		/* Send BFI */
-		goto bfi;
+		job->no_decode = true;
+		return sched_dec_job_submit(trx, job);
 	}
 
-	mode = rsl_cmode != RSL_CMOD_SPD_SPEECH ?
-		GSM48_CMODE_SPEECH_V1 : tch_mode;
-
-	switch (mode) {
+	/**
+	 * FIXME: we do support speech only, and
+	 * CSD support may be implemented latter.
+	 */
+	switch (lchan->tch_mode) {
 	case GSM48_CMODE_SIGN:
 	case GSM48_CMODE_SPEECH_V1: /* FR */
-		rc = gsm0503_tch_fr_decode(l2, buffer,
-			1, 0, &n_errors, &n_bits_total);
-		break;
 	case GSM48_CMODE_SPEECH_EFR: /* EFR */
-		rc = gsm0503_tch_fr_decode(l2, buffer,
-			1, 1, &n_errors, &n_bits_total);
 		break;
 	case GSM48_CMODE_SPEECH_AMR: /* AMR */
 		/**
@@ -134,24 +131,46 @@ int rx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
 		LOGP(DSCHD, LOGL_ERROR, "AMR isn't supported yet\n");
 		return -ENOTSUP;
 	default:
-		LOGP(DSCHD, LOGL_ERROR, "Invalid TCH mode: %u\n", tch_mode);
+		LOGP(DSCHD, LOGL_ERROR, "Invalid TCH mode: %u\n",
+			lchan->tch_mode);
 		return -EINVAL;
 	}
 
+	memcpy(job->bursts, buffer, 8 * 116);
+
 	/* Shift buffer by 4 bursts for interleaving */
 	memcpy(buffer, buffer + 464, 464);
 
+	return sched_dec_job_submit(trx, job);
+}
+
+int rx_tchf_done(struct trx_instance *trx, struct trx_ts *ts,
+	struct trx_lchan_state *lchan, struct sched_dec_job *job)
+{
+	const struct trx_lchan_desc *lchan_desc;
+	int n_errors = job->n_errors;
+	uint8_t rsl_cmode, l2[128];
+	size_t l2_len;
+	int rc = job->rc;
+
+	lchan_desc = &trx_lchan_desc[lchan->type];
+	rsl_cmode = RSL_CMOD_SPD_SPEECH;
+
+	/* Incomplete set of bursts */
+	if (job->no_decode)
+		goto bfi;
+
 	/* Check decoding result */
 	if (rc < 4) {
 		LOGP(DSCHD, LOGL_ERROR, "Received bad TCH frame ending at "
-			"fn=%u for %s\n", fn, lchan_desc->name);
+			"fn=%u for %s\n", job->fn, lchan_desc->name);
 
 		/* Send BFI */
 		goto bfi;
 	} else if (rc == GSM_MACBLOCK_LEN) {
 		/* FACCH received, forward it to the higher layers */
-		sched_send_dt_ind(trx, ts, lchan, l2, GSM_MACBLOCK_LEN,
-			n_errors, false, false);
+		sched_send_dt_ind(trx, ts, lchan, job->first_fn, job->rssi,
+			job->l2, GSM_MACBLOCK_LEN, n_errors, false, false);
 
 		/* Send BFI instead of stolen TCH frame */
 		goto bfi;
@@ -161,20 +180,20 @@ int rx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
 	}
 
 	/* Send a traffic frame to the higher layers */
-	return sched_send_dt_ind(trx, ts, lchan, l2, l2_len,
-		n_errors, false, true);
+	return sched_send_dt_ind(trx, ts, lchan, job->first_fn, job->rssi,
+		job->l2, l2_len, n_errors, false, true);
 
 bfi:
 	/* Bad frame indication */
-	l2_len = sched_bad_frame_ind(l2, rsl_cmode, tch_mode);
+	l2_len = sched_bad_frame_ind(l2, rsl_cmode, job->tch_mode);
 
 	/* Didn't try to decode */
 	if (n_errors < 0)
 		n_errors = 116 * 4;
 
 	/* Send a BFI frame to the higher layers */
-	return sched_send_dt_ind(trx, ts, lchan, l2, l2_len,
-		n_errors, true, true);
+	return sched_send_dt_ind(trx, ts, lchan, job->first_fn, job->rssi,
+		l2, l2_len, n_errors, true, true);
 }
 
 int tx_tchf_fn(struct trx_instance *trx, struct trx_ts *ts,
@@ -36,6 +36,7 @@
 #include "l1ctl_proto.h"
 #include "scheduler.h"
 #include "sched_trx.h"
+#include "sched_worker.h"
 #include "logging.h"
 #include "trx_if.h"
 #include "trxcon.h"
@@ -46,10 +47,10 @@ int rx_data_fn(struct trx_instance *trx, struct trx_ts *ts,
 	sbit_t *bits, int8_t rssi, int16_t toa256)
 {
 	const struct trx_lchan_desc *lchan_desc;
-	uint8_t l2[GSM_MACBLOCK_LEN], *mask;
-	int n_errors, n_bits_total, rc;
+	struct sched_dec_job job_buf, *job;
 	sbit_t *buffer, *offset;
 	uint32_t *first_fn;
+	uint8_t *mask;
 
 	/* Set up pointers */
 	lchan_desc = &trx_lchan_desc[lchan->type];
@@ -96,12 +97,28 @@ int rx_data_fn(struct trx_instance *trx, struct trx_ts *ts,
 			lchan_desc->name);
 	}
 
-	/* Attempt to decode */
-	rc = gsm0503_xcch_decode(l2, buffer, &n_errors, &n_bits_total);
-	if (rc) {
+	/* Hand the bursts over to the decoder */
+	job = sched_dec_job_alloc(trx, ts, lchan, fn, &job_buf);
+	if (job == NULL)
+		return -ENOBUFS;
+
+	job->type = SCHED_DEC_XCCH;
+	memcpy(job->bursts, buffer, 4 * 116);
+
+	return sched_dec_job_submit(trx, job);
+}
+
+int rx_data_done(struct trx_instance *trx, struct trx_ts *ts,
+	struct trx_lchan_state *lchan, struct sched_dec_job *job)
+{
+	const struct trx_lchan_desc *lchan_desc;
+
+	lchan_desc = &trx_lchan_desc[lchan->type];
+
+	if (job->rc) {
 		LOGP(DSCHD, LOGL_ERROR, "Received bad data frame at fn=%u "
-			"(%u/%u) for %s\n", *first_fn,
-			(*first_fn) % ts->mf_layout->period,
+			"(%u/%u) for %s\n", job->first_fn,
+			job->first_fn % ts->mf_layout->period,
 			ts->mf_layout->period,
 			lchan_desc->name);
 
@@ -109,13 +126,13 @@ int rx_data_fn(struct trx_instance *trx, struct trx_ts *ts,
 		 * We should anyway send dummy frame for
 		 * proper measurement reporting...
 		 */
-		return sched_send_dt_ind(trx, ts, lchan, NULL, 0,
-			n_errors, true, false);
+		return sched_send_dt_ind(trx, ts, lchan, job->first_fn,
+			job->rssi, NULL, 0, job->n_errors, true, false);
 	}
 
 	/* Send a L2 frame to the higher layers */
-	return sched_send_dt_ind(trx, ts, lchan, l2, GSM_MACBLOCK_LEN,
-		n_errors, false, false);
+	return sched_send_dt_ind(trx, ts, lchan, job->first_fn, job->rssi,
+		job->l2, GSM_MACBLOCK_LEN, job->n_errors, false, false);
 }
 
 int tx_data_fn(struct trx_instance *trx, struct trx_ts *ts,
@@ -88,8 +88,8 @@ int sched_prim_init(struct trx_instance *trx,
 }
 
 /**
- * Adds a primitive to the end of transmit queue of a particular
- * timeslot, whose index is parsed from chan_nr.
+ * Adds a primitive to the end of transmit queue of its logical
+ * channel on a particular timeslot, whose index is parsed from chan_nr.
  *
  * @param  trx     TRX instance
  * @param  prim    to be enqueued primitive
@@ -99,6 +99,7 @@ int sched_prim_init(struct trx_instance *trx,
 int sched_prim_push(struct trx_instance *trx,
 	struct trx_ts_prim *prim, uint8_t chan_nr)
 {
+	struct trx_lchan_state *lchan;
 	struct trx_ts *ts;
 	uint8_t tn;
 
@@ -116,14 +117,22 @@ int sched_prim_push(struct trx_instance *trx,
 		return -EINVAL;
 	}
 
+	/* Make sure that the lchan is a part of multiframe layout */
+	lchan = ts->lchan_tab[prim->chan];
+	if (lchan == NULL) {
+		LOGP(DSCH, LOGL_ERROR, "Logical channel %s isn't allocated "
+			"on ts=%u\n", trx_lchan_desc[prim->chan].name, tn);
+		return -EINVAL;
+	}
+
 	/**
 	 * Change talloc context of primitive
-	 * from trx to the parent ts
+	 * from trx to the parent lchan
 	 */
-	talloc_steal(ts, prim);
+	talloc_steal(lchan, prim);
 
-	/* Add primitive to TS transmit queue */
-	llist_add_tail(&prim->list, &ts->tx_prims);
+	/* Add primitive to lchan transmit queue */
+	llist_add_tail(&prim->list, &lchan->tx_prims);
 
 	return 0;
 }
@@ -133,7 +142,7 @@ int sched_prim_push(struct trx_instance *trx,
  * In case if a FACCH frame is found, a TCH frame is being
  * dropped (i.e. replaced).
  *
- * @param  queue a transmit queue to take a prim from
+ * @param  queue a transmit queue of TCH lchan to take a prim from
  * @return       a FACCH or TCH primitive, otherwise NULL
  */
 static struct trx_ts_prim *sched_prim_dequeue_tch(struct llist_head *queue)
@@ -186,34 +195,28 @@ static struct trx_ts_prim *sched_prim_dequeue_tch(struct llist_head *queue)
 }
 
 /**
- * Dequeues a single primitive of required type
- * from a specified transmit queue.
+ * Dequeues a single primitive from the transmit
+ * queue of a specified logical channel.
  *
- * @param  queue      a transmit queue to take a prim from
- * @param  lchan_type required primitive type
- * @return            a primitive or NULL if not found
+ * @param  lchan a logical channel to take a prim from
+ * @return       a primitive or NULL if the queue is empty
  */
-struct trx_ts_prim *sched_prim_dequeue(struct llist_head *queue,
-	enum trx_lchan_type lchan_type)
+struct trx_ts_prim *sched_prim_dequeue(struct trx_lchan_state *lchan)
 {
 	struct trx_ts_prim *prim;
 
 	/* There is nothing to dequeue */
-	if (llist_empty(queue))
+	if (llist_empty(&lchan->tx_prims))
 		return NULL;
 
 	/* TCH requires FACCH prioritization, so handle it separately */
-	if (CHAN_IS_TCH(lchan_type))
-		return sched_prim_dequeue_tch(queue);
+	if (CHAN_IS_TCH(lchan->type))
+		return sched_prim_dequeue_tch(&lchan->tx_prims);
 
-	llist_for_each_entry(prim, queue, list) {
-		if (prim->chan == lchan_type) {
-			llist_del(&prim->list);
-			return prim;
-		}
-	}
+	prim = llist_entry(lchan->tx_prims.next, struct trx_ts_prim, list);
+	llist_del(&prim->list);
 
-	return NULL;
+	return prim;
 }
 
 /**
@@ -37,6 +37,7 @@
 #include "sched_trx.h"
 #include "trx_if.h"
 #include "logging.h"
+#include "latency.h"
 
 static void sched_frame_clck_cb(struct trx_sched *sched)
 {
@@ -95,7 +96,7 @@ static void sched_frame_clck_cb(struct trx_sched *sched)
 		 * attempt to obtain a new one from queue
 		 */
 		if (lchan->prim == NULL)
-			lchan->prim = sched_prim_dequeue(&ts->tx_prims, chan);
+			lchan->prim = sched_prim_dequeue(lchan);
 
 		/* TODO: report TX buffers health to the higher layers */
 
@@ -117,6 +118,17 @@ static void sched_frame_clck_cb(struct trx_sched *sched)
 		/* Poke lchan handler */
 		handler(trx, ts, lchan, fn, bid);
 	}
+
+	/* Send all bursts of this frame at once */
+	if (trx_if_flush_bursts(trx) > 0 && !sched->clock_virt
+	    && sched->frame_us) {
+		int64_t due;
+
+		/* How long until the transceiver needs the bursts */
+		due = sched->frame_us
+			+ sched->fn_counter_advance * FRAME_DURATION_uS;
+		LAT_RECORD(LAT_TX_LEAD, due - (int64_t) lat_now_us());
+	}
 }
 
 int sched_trx_init(struct trx_instance *trx, uint32_t fn_advance)
@@ -141,6 +153,9 @@ int sched_trx_init(struct trx_instance *trx, uint32_t fn_advance)
 	/* Set frame counter advance */
 	sched->fn_counter_advance = fn_advance;
 
+	/* The frame clock timer is created on demand */
+	sched_clck_init(sched);
+
 	return 0;
 }
 
@@ -157,6 +172,8 @@ int sched_trx_shutdown(struct trx_instance *trx)
 	for (i = 0; i < TRX_TS_COUNT; i++)
 		sched_trx_del_ts(trx, i);
 
+	sched_clck_shutdown(&trx->sched);
+
 	return 0;
 }
 
@@ -215,15 +232,13 @@ void sched_trx_del_ts(struct trx_instance *trx, int tn)
 	/* Deactivate all logical channels */
 	sched_trx_deactivate_all_lchans(ts);
 
-	/* Free channel states */
+	/* Free channel states and their queued primitives */
 	llist_for_each_entry_safe(lchan, lchan_next, &ts->lchans, list) {
+		sched_prim_flush_queue(&lchan->tx_prims);
 		llist_del(&lchan->list);
 		talloc_free(lchan);
 	}
 
-	/* Flush queue primitives for TX */
-	sched_prim_flush_queue(&ts->tx_prims);
-
 	/* Remove ts from list and free memory */
 	trx->ts_list[tn] = NULL;
 	talloc_free(ts);
@@ -262,8 +277,6 @@ int sched_trx_configure_ts(struct trx_instance *trx, int tn,
 	LOGP(DSCH, LOGL_NOTICE, "(Re)configure TDMA timeslot #%u as %s\n",
 		tn, ts->mf_layout->name);
 
-	/* Init queue primitives for TX */
-	INIT_LLIST_HEAD(&ts->tx_prims);
 	/* Init logical channels list */
 	INIT_LLIST_HEAD(&ts->lchans);
 
@@ -280,8 +293,12 @@ int sched_trx_configure_ts(struct trx_instance *trx, int tn,
 		/* Set channel type */
 		lchan->type = type;
 
-		/* Add to the list of channel states */
+		/* Init queue primitives for TX */
+		INIT_LLIST_HEAD(&lchan->tx_prims);
+
+		/* Add to the list and lookup table of channel states */
 		llist_add_tail(&lchan->list, &ts->lchans);
+		ts->lchan_tab[type] = lchan;
 
 		/* Enable channel automatically if required */
 		if (trx_lchan_desc[type].flags & TRX_CH_FLAG_AUTO)
@@ -311,18 +328,19 @@ int sched_trx_reset_ts(struct trx_instance *trx, int tn)
 	/* Undefine multiframe layout */
 	ts->mf_layout = NULL;
 
-	/* Flush queue primitives for TX */
-	sched_prim_flush_queue(&ts->tx_prims);
-
 	/* Deactivate all logical channels */
 	sched_trx_deactivate_all_lchans(ts);
 
-	/* Free channel states */
+	/* Free channel states and their queued primitives */
 	llist_for_each_entry_safe(lchan, lchan_next, &ts->lchans, list) {
+		sched_prim_flush_queue(&lchan->tx_prims);
 		llist_del(&lchan->list);
 		talloc_free(lchan);
 	}
 
+	/* Clear the lookup table */
+	memset(ts->lchan_tab, 0x00, sizeof(ts->lchan_tab));
+
 	/* Notify transceiver about that */
 	trx_if_cmd_setslot(trx, tn, 0);
 
@@ -363,13 +381,10 @@ int sched_trx_start_ciphering(struct trx_ts *ts, uint8_t algo,
 struct trx_lchan_state *sched_trx_find_lchan(struct trx_ts *ts,
 	enum trx_lchan_type chan)
 {
-	struct trx_lchan_state *lchan;
-
-	llist_for_each_entry(lchan, &ts->lchans, list)
-		if (lchan->type == chan)
-			return lchan;
+	if (chan >= _TRX_CHAN_MAX)
+		return NULL;
 
-	return NULL;
+	return ts->lchan_tab[chan];
 }
 
 int sched_trx_set_lchans(struct trx_ts *ts, uint8_t chan_nr, int active, uint8_t tch_mode)
@@ -400,6 +415,9 @@ int sched_trx_set_lchans(struct trx_ts *ts, uint8_t chan_nr, int active, uint8_t
 	return rc;
 }
 
+/* Distinguishes activations of the same lchan */
+static uint32_t lchan_gen = 0;
+
 int sched_trx_activate_lchan(struct trx_ts *ts, enum trx_lchan_type chan)
 {
 	const struct trx_lchan_desc *lchan_desc = &trx_lchan_desc[chan];
@@ -435,6 +453,7 @@ int sched_trx_activate_lchan(struct trx_ts *ts, enum trx_lchan_type chan)
 	}
 
 	/* Finally, update channel status */
+	lchan->gen = ++lchan_gen;
 	lchan->active = 1;
 
 	return 0;
@@ -457,8 +476,9 @@ static void sched_trx_reset_lchan(struct trx_lchan_state *lchan)
 	lchan->rx_bursts = NULL;
 	lchan->tx_bursts = NULL;
 
-	/* Forget the current prim */
+	/* Forget the current prim and flush the queue */
 	sched_prim_drop(lchan);
+	sched_prim_flush_queue(&lchan->tx_prims);
 
 	/* TCH specific variables */
 	if (CHAN_IS_TCH(lchan->type)) {
@@ -148,6 +148,8 @@ struct trx_lchan_state {
 	enum trx_lchan_type type;
 	/*! \brief Channel status */
 	uint8_t active;
+	/*! \brief Activation counter, to drop late decoded blocks */
+	uint32_t gen;
 	/*! \brief Link to a list of channels */
 	struct llist_head list;
 
@@ -164,6 +166,8 @@ struct trx_lchan_state {
 	/*! \brief Burst buffer for TX */
 	ubit_t *tx_bursts;
 
+	/*! \brief Queue of primitives for TX */
+	struct llist_head tx_prims;
 	/*! \brief A primitive being sent */
 	struct trx_ts_prim *prim;
 
@@ -226,13 +230,13 @@ struct trx_ts {
 	const struct trx_multiframe *mf_layout;
 	/*! \brief Channel states for logical channels */
 	struct llist_head lchans;
-	/*! \brief Queue primitives for TX */
-	struct llist_head tx_prims;
+	/*! \brief The same channel states, indexed by type */
+	struct trx_lchan_state *lchan_tab[_TRX_CHAN_MAX];
 };
 
-/* Represents one TX primitive in the queue of trx_ts */
+/* Represents one TX primitive in the queue of trx_lchan_state */
 struct trx_ts_prim {
-	/*! \brief Link to queue of TS */
+	/*! \brief Link to queue of lchan */
 	struct llist_head list;
 	/*! \brief Logical channel type */
 	enum trx_lchan_type chan;
@@ -301,8 +305,7 @@ int sched_prim_push(struct trx_instance *trx,
 #define PRIM_IS_FACCH(prim) \
 	CHAN_IS_TCH(prim->chan) && prim->payload_len == GSM_MACBLOCK_LEN
 
-struct trx_ts_prim *sched_prim_dequeue(struct llist_head *queue,
-	enum trx_lchan_type lchan_type);
+struct trx_ts_prim *sched_prim_dequeue(struct trx_lchan_state *lchan);
 int sched_prim_dummy(struct trx_lchan_state *lchan);
 void sched_prim_drop(struct trx_lchan_state *lchan);
 void sched_prim_flush_queue(struct llist_head *list);
@@ -319,7 +322,8 @@ extern const uint8_t sched_nb_training_bits[8][26];
 
 size_t sched_bad_frame_ind(uint8_t *l2, uint8_t rsl_cmode, uint8_t tch_mode);
 int sched_send_dt_ind(struct trx_instance *trx, struct trx_ts *ts,
-	struct trx_lchan_state *lchan, uint8_t *l2, size_t l2_len,
-	int bit_error_count, bool dec_failed, bool traffic);
+	struct trx_lchan_state *lchan, uint32_t first_fn, float rssi,
+	uint8_t *l2, size_t l2_len, int bit_error_count,
+	bool dec_failed, bool traffic);
 int sched_send_dt_conf(struct trx_instance *trx, struct trx_ts *ts,
 	struct trx_lchan_state *lchan, uint32_t fn, bool traffic);
@@ -0,0 +1,383 @@
+/*
+ * OsmocomBB <-> SDR connection bridge
+ * TDMA scheduler: pool of burst decoding threads
+ *
+ * (C) 2017 by Vadim Yanitskiy <axilirator@gmail.com>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/bits.h>
+
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include "scheduler.h"
+#include "sched_trx.h"
+#include "sched_worker.h"
+#include "logging.h"
+#include "latency.h"
+#include "trx_if.h"
+
+/**
+ * Runs the channel decoder of a job. This is the only part
+ * executed by the worker threads, so it shall not touch
+ * anything but the job itself, and shall not log.
+ */
+static void sched_dec_job_decode(struct sched_dec_job *job)
+{
+	uint64_t start;
+
+	job->dec_us = -1;
+	job->n_errors = -1;
+	job->n_bits_total = 0;
+
+	if (job->no_decode) {
+		job->rc = -1;
+		return;
+	}
+
+	start = lat_now_us();
+
+	switch (job->type) {
+	case SCHED_DEC_XCCH:
+		job->rc = gsm0503_xcch_decode(job->l2, job->bursts,
+			&job->n_errors, &job->n_bits_total);
+		break;
+	case SCHED_DEC_TCHF:
+		job->rc = gsm0503_tch_fr_decode(job->l2, job->bursts, 1,
+			job->tch_mode == GSM48_CMODE_SPEECH_EFR,
+			&job->n_errors, &job->n_bits_total);
+		break;
+	}
+
+	job->dec_us = lat_now_us() - start;
+}
+
+/* Hands a decoded job over to the lchan handler, if still relevant */
+static int sched_dec_job_complete(struct trx_instance *trx,
+	struct sched_dec_job *job)
+{
+	struct trx_lchan_state *lchan;
+	struct trx_ts *ts;
+	int rc = -EINVAL;
+
+	if (job->dec_us >= 0)
+		LAT_RECORD_DEC(job->chan, job->dec_us);
+
+	ts = trx->ts_list[job->tn];
+	if (ts == NULL)
+		return 0;
+
+	/* The lchan may be gone or re-activated in the meantime */
+	lchan = ts->lchan_tab[job->chan];
+	if (lchan == NULL || !lchan->active || lchan->gen != job->lchan_gen) {
+		LOGP(DSCHD, LOGL_DEBUG, "Dropping a stale decoded block "
+			"at fn=%u for %s\n", job->first_fn,
+			trx_lchan_desc[job->chan].name);
+		return 0;
+	}
+
+	switch (job->type) {
+	case SCHED_DEC_XCCH:
+		rc = rx_data_done(trx, ts, lchan, job);
+		break;
+	case SCHED_DEC_TCHF:
+		rc = rx_tchf_done(trx, ts, lchan, job);
+		break;
+	}
+
+	/* The indication is queued to L1CTL by now */
+	if (job->rx_us)
+		LAT_RECORD(LAT_RX_IND, lat_now_us() - job->rx_us);
+
+	return rc;
+}
+
+/* Completes all the decoded jobs of a ring, in order */
+static void sched_dec_ring_complete(struct trx_instance *trx,
+	struct sched_dec_ring *ring)
+{
+	unsigned int done;
+
+	done = atomic_load_explicit(&ring->done, memory_order_acquire);
+	while (ring->tail != done) {
+		sched_dec_job_complete(trx,
+			&ring->jobs[ring->tail % SCHED_DEC_RING_LEN]);
+		ring->tail++;
+	}
+}
+
+static int sched_worker_done_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct sched_worker_pool *pool = ofd->data;
+	eventfd_t val;
+	int i;
+
+	if (eventfd_read(ofd->fd, &val) < 0)
+		return 0;
+
+	for (i = 0; i < TRX_TS_COUNT; i++)
+		sched_dec_ring_complete(pool->trx, &pool->rings[i]);
+
+	return 0;
+}
+
+static void *sched_worker_main(void *data)
+{
+	struct sched_worker *worker = data;
+	struct sched_worker_pool *pool = worker->pool;
+	struct sched_dec_ring *ring;
+	unsigned int head, done;
+	bool progress;
+	eventfd_t val;
+	int i;
+
+	while (!atomic_load(&pool->quit)) {
+		if (eventfd_read(worker->efd, &val) < 0)
+			continue;
+
+		do {
+			progress = false;
+
+			/* Each worker serves every num_workers-th timeslot */
+			for (i = worker->index; i < TRX_TS_COUNT;
+			     i += pool->num_workers) {
+				ring = &pool->rings[i];
+				head = atomic_load_explicit(&ring->head,
+					memory_order_acquire);
+				done = atomic_load_explicit(&ring->done,
+					memory_order_relaxed);
+
+				while (done != head) {
+					sched_dec_job_decode(
+						&ring->jobs[done % SCHED_DEC_RING_LEN]);
+					done++;
+					atomic_store_explicit(&ring->done, done,
+						memory_order_release);
+					progress = true;
+				}
+			}
+
+			if (progress)
+				eventfd_write(pool->done_ofd.fd, 1);
+		} while (progress);
+	}
+
+	return NULL;
+}
+
+int sched_worker_pool_init(struct trx_instance *trx, unsigned int num_workers)
+{
+	struct sched_worker_pool *pool;
+	struct sched_worker *worker;
+	unsigned int i;
+	int rc;
+
+	if (num_workers == 0)
+		return 0;
+	if (num_workers > SCHED_WORKERS_MAX)
+		num_workers = SCHED_WORKERS_MAX;
+
+	pool = talloc_zero(trx, struct sched_worker_pool);
+	if (pool == NULL)
+		return -ENOMEM;
+
+	pool->trx = trx;
+	pool->num_workers = num_workers;
+
+	pool->done_ofd.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (pool->done_ofd.fd < 0) {
+		talloc_free(pool);
+		return -errno;
+	}
+
+	pool->done_ofd.cb = sched_worker_done_cb;
+	pool->done_ofd.when = BSC_FD_READ;
+	pool->done_ofd.data = pool;
+
+	/* Before any thread is started, so there is nothing to stop yet */
+	rc = osmo_fd_register(&pool->done_ofd);
+	if (rc < 0) {
+		close(pool->done_ofd.fd);
+		talloc_free(pool);
+		return rc;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+
+		worker->efd = eventfd(0, EFD_CLOEXEC);
+		if (worker->efd < 0) {
+			rc = -errno;
+			goto error;
+		}
+
+		rc = pthread_create(&worker->thread, NULL,
+			sched_worker_main, worker);
+		if (rc) {
+			close(worker->efd);
+			rc = -rc;
+			goto error;
+		}
+	}
+
+	trx->dec_pool = pool;
+
+	LOGP(DSCH, LOGL_NOTICE, "Decoding bursts in %u thread(s)\n",
+		num_workers);
+
+	return 0;
+
+error:
+	LOGP(DSCH, LOGL_ERROR, "Failed to start decoding threads (%d)\n", rc);
+	pool->num_workers = i;
+	trx->dec_pool = pool;
+	sched_worker_pool_free(trx);
+
+	return rc;
+}
+
+void sched_worker_pool_free(struct trx_instance *trx)
+{
+	struct sched_worker_pool *pool = trx->dec_pool;
+	unsigned int i;
+
+	if (pool == NULL)
+		return;
+
+	atomic_store(&pool->quit, 1);
+
+	for (i = 0; i < pool->num_workers; i++) {
+		eventfd_write(pool->workers[i].efd, 1);
+		pthread_join(pool->workers[i].thread, NULL);
+		close(pool->workers[i].efd);
+	}
+
+	osmo_fd_unregister(&pool->done_ofd);
+	close(pool->done_ofd.fd);
+
+	trx->dec_pool = NULL;
+	talloc_free(pool);
+}
+
+/**
+ * Waits until all the submitted jobs are decoded, and completes them.
+ * Useful when bursts are fed faster than in real time.
+ */
+void sched_worker_pool_sync(struct trx_instance *trx)
+{
+	struct sched_worker_pool *pool = trx->dec_pool;
+	struct sched_dec_ring *ring;
+	int i;
+
+	if (pool == NULL)
+		return;
+
+	for (i = 0; i < TRX_TS_COUNT; i++) {
+		ring = &pool->rings[i];
+
+		while (atomic_load_explicit(&ring->done, memory_order_acquire)
+		    != atomic_load_explicit(&ring->head, memory_order_relaxed))
+			sched_yield();
+
+		sched_dec_ring_complete(trx, ring);
+	}
+}
+
+/**
+ * Returns a job to be filled in by the lchan handler: a free slot
+ * of the timeslot's ring if the pool is running, job_buf otherwise.
+ * The slot is only handed to a worker by sched_dec_job_submit().
+ */
+struct sched_dec_job *sched_dec_job_alloc(struct trx_instance *trx,
+	struct trx_ts *ts, struct trx_lchan_state *lchan, uint32_t fn,
+	struct sched_dec_job *job_buf)
+{
+	struct sched_worker_pool *pool = trx->dec_pool;
+	struct sched_dec_ring *ring;
+	struct sched_dec_job *job;
+	unsigned int head;
+
+	if (pool == NULL) {
+		job = job_buf;
+	} else {
+		ring = &pool->rings[ts->index];
+		head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+		/* Whatever is decoded already makes room */
+		sched_dec_ring_complete(trx, ring);
+
+		if (head - ring->tail >= SCHED_DEC_RING_LEN) {
+			LOGP(DSCHD, LOGL_ERROR, "Decoding queue of ts=%u is "
+				"full, dropping a block of %s at fn=%u\n",
+				ts->index, trx_lchan_desc[lchan->type].name,
+				lchan->rx_first_fn);
+			return NULL;
+		}
+
+		job = &ring->jobs[head % SCHED_DEC_RING_LEN];
+	}
+
+	job->no_decode = false;
+	job->tn = ts->index;
+	job->chan = lchan->type;
+	job->lchan_gen = lchan->gen;
+	job->first_fn = lchan->rx_first_fn;
+	job->fn = fn;
+	job->rx_us = trx->rx_burst_us;
+	job->rssi = lchan->meas.rssi_num ?
+		lchan->meas.rssi_sum / lchan->meas.rssi_num : 0;
+	job->tch_mode = lchan->tch_mode;
+
+	return job;
+}
+
+int sched_dec_job_submit(struct trx_instance *trx, struct sched_dec_job *job)
+{
+	struct sched_worker_pool *pool = trx->dec_pool;
+	struct sched_dec_ring *ring;
+	unsigned int head;
+
+	/* No threads, decode right away */
+	if (pool == NULL) {
+		sched_dec_job_decode(job);
+		return sched_dec_job_complete(trx, job);
+	}
+
+	ring = &pool->rings[job->tn];
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	eventfd_write(pool->workers[job->tn % pool->num_workers].efd, 1);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/select.h>
+
+#include "sched_trx.h"
+
+/* Blocks in flight per timeslot, must be a power of 2 */
+#define SCHED_DEC_RING_LEN	16
+
+/* Maximum number of decoding threads, one timeslot is never shared */
+#define SCHED_WORKERS_MAX	TRX_TS_COUNT
+
+/* Forward declaration to avoid mutual include */
+struct trx_instance;
+
+enum sched_dec_type {
+	SCHED_DEC_XCCH,
+	SCHED_DEC_TCHF,
+};
+
+/* A block of bursts to be decoded, and the decoding result */
+struct sched_dec_job {
+	/*! \brief Which decoder to use */
+	enum sched_dec_type type;
+	/*! \brief Only report a bad frame, don't decode */
+	bool no_decode;
+
+	/*! \brief Timeslot and lchan the bursts were received on */
+	uint8_t tn;
+	enum trx_lchan_type chan;
+	/*! \brief Activation of the lchan (see trx_lchan_state) */
+	uint32_t lchan_gen;
+
+	/*! \brief Frame number of the first and the last burst */
+	uint32_t first_fn, fn;
+	/*! \brief Average RSSI of the bursts */
+	float rssi;
+	/*! \brief TCH mode at reception time */
+	uint8_t tch_mode;
+
+	/*! \brief Input: 4 (xCCH) or 8 (TCH/F) burst payloads */
+	sbit_t bursts[8 * GSM_BURST_PL_LEN];
+
+	/*! \brief Arrival time of the last burst, 0 if unknown */
+	uint64_t rx_us;
+	/*! \brief Output: time spent in the decoder */
+	int32_t dec_us;
+
+	/*! \brief Output: decoded L2 frame and decoder return code */
+	uint8_t l2[128];
+	int rc;
+	int n_errors;
+	int n_bits_total;
+};
+
+/**
+ * Pipeline of decoding jobs of one timeslot. The I/O thread fills the
+ * slots at head, one worker decodes them up to head and advances done,
+ * the I/O thread completes them up to done and advances tail.
+ */
+struct sched_dec_ring {
+	/*! \brief Written by the I/O thread only */
+	atomic_uint head;
+	/*! \brief Written by the worker only */
+	atomic_uint done;
+	/*! \brief Only used by the I/O thread */
+	unsigned int tail;
+
+	struct sched_dec_job jobs[SCHED_DEC_RING_LEN];
+};
+
+struct sched_worker_pool;
+
+struct sched_worker {
+	struct sched_worker_pool *pool;
+	unsigned int index;
+	pthread_t thread;
+	/*! \brief eventfd to wake the worker up */
+	int efd;
+};
+
+struct sched_worker_pool {
+	struct trx_instance *trx;
+
+	struct sched_worker workers[SCHED_WORKERS_MAX];
+	unsigned int num_workers;
+	atomic_int quit;
+
+	/*! \brief eventfd signalling decoded jobs to the I/O thread */
+	struct osmo_fd done_ofd;
+
+	struct sched_dec_ring rings[TRX_TS_COUNT];
+};
+
+int sched_worker_pool_init(struct trx_instance *trx, unsigned int num_workers);
+void sched_worker_pool_free(struct trx_instance *trx);
+void sched_worker_pool_sync(struct trx_instance *trx);
+
+struct sched_dec_job *sched_dec_job_alloc(struct trx_instance *trx,
+	struct trx_ts *ts, struct trx_lchan_state *lchan, uint32_t fn,
+	struct sched_dec_job *job_buf);
+int sched_dec_job_submit(struct trx_instance *trx, struct sched_dec_job *job);
+
+/* Completion handlers, called from the I/O thread */
+int rx_data_done(struct trx_instance *trx, struct trx_ts *ts,
+	struct trx_lchan_state *lchan, struct sched_dec_job *job);
+int rx_tchf_done(struct trx_instance *trx, struct trx_ts *ts,
+	struct trx_lchan_state *lchan, struct sched_dec_job *job);
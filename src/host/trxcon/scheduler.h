@@ -3,7 +3,11 @@
 #include <stdint.h>
 #include <time.h>
 
-#include <osmocom/core/timer.h>
+#include <osmocom/core/select.h>
+
+#define FRAME_DURATION_uS	4615
+/* 120 ms / 26 frames, the exact value is kept by the clock */
+#define FRAME_DURATION_nS	4615385
 
 #define GSM_SUPERFRAME		(26 * 51)
 #define GSM_HYPERFRAME		(2048 * GSM_SUPERFRAME)
@@ -20,21 +24,39 @@ struct trx_sched;
 struct trx_sched {
 	/*! \brief Clock state */
 	uint8_t state;
-	/*! \brief Local clock source */
-	struct timeval clock;
+	/*! \brief CLOCK_MONOTONIC in ns the clock is counted from */
+	uint64_t clock_base;
+	/*! \brief Start of frame fn_counter_proc since clock_base, in
+	 *  ns << SCHED_CLCK_FRAC_BITS */
+	int64_t clock;
+	/*! \brief Estimated frame duration as seen by the local clock, in
+	 *  ns << SCHED_CLCK_FRAC_BITS, 0 if nothing is known yet */
+	uint64_t period;
+	/*! \brief Last FN the clock was corrected with */
+	uint32_t fn_counter_sync;
+	/*! \brief Nominal start of frame fn_counter_proc, in us */
+	uint64_t frame_us;
 	/*! \brief Count of processed frames */
 	uint32_t fn_counter_proc;
 	/*! \brief Local frame counter advance */
 	uint32_t fn_counter_advance;
 	/*! \brief Frame counter */
 	uint32_t fn_counter_lost;
-	/*! \brief Frame callback timer */
-	struct osmo_timer_list clock_timer;
+	/*! \brief Frame callback timer (timerfd) */
+	struct osmo_fd clock_ofd;
+	/*! \brief Clocked by burst FNs instead of real time */
+	uint8_t clock_virt;
 	/*! \brief Frame callback */
 	void (*clock_cb)(struct trx_sched *sched);
 	/*! \brief Private data (e.g. pointer to trx instance) */
 	void *data;
 };
 
-int sched_clck_handle(struct trx_sched *sched, uint32_t fn);
+/* Fixed point fraction of the clock and frame duration */
+#define SCHED_CLCK_FRAC_BITS	8
+
+void sched_clck_init(struct trx_sched *sched);
+void sched_clck_shutdown(struct trx_sched *sched);
+int sched_clck_handle(struct trx_sched *sched, uint32_t fn, uint64_t rx_us);
+int sched_clck_virt_handle(struct trx_sched *sched, uint32_t fn);
 void sched_clck_reset(struct trx_sched *sched);
@@ -21,6 +21,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <errno.h>
 #include <stdint.h>
@@ -29,6 +31,7 @@
 #include <string.h>
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 
 #include <osmocom/core/logging.h>
 #include <osmocom/core/select.h>
@@ -43,6 +46,7 @@
 #include "trxcon.h"
 #include "trx_if.h"
 #include "logging.h"
+#include "latency.h"
 #include "scheduler.h"
 
 static struct value_string trx_evt_names[] = {
@@ -131,92 +135,212 @@ static void trx_udp_close(struct osmo_fd *ofd)
 /* Successful responses may include results, depending on the command type. */
 /* ------------------------------------------------------------------------ */
 
+/* Command names, how long to wait for a response and how to match it */
+static const struct trx_ctrl_cmd_desc {
+	const char *name;
+	int critical;
+	/* Nothing else may be in flight together with it */
+	int barrier;
+	/* The response repeats the parameters */
+	int echo_params;
+	/* Leading parameters telling what is set, e.g. the timeslot */
+	int key_params;
+	unsigned int timeout_ms;
+} trx_ctrl_cmds[_NUM_TRX_CTRL] = {
+	[TRX_CTRL_ECHO]		= { "ECHO",	1, 1, 0, 0, 500 },
+	[TRX_CTRL_POWERON]	= { "POWERON",	1, 1, 0, 0, 2000 },
+	[TRX_CTRL_POWEROFF]	= { "POWEROFF",	1, 1, 0, 0, 2000 },
+	[TRX_CTRL_SETPOWER]	= { "SETPOWER",	0, 0, 0, 0, 300 },
+	[TRX_CTRL_ADJPOWER]	= { "ADJPOWER",	0, 0, 0, 0, 300 },
+	[TRX_CTRL_SETSLOT]	= { "SETSLOT",	1, 0, 1, 1, 300 },
+	[TRX_CTRL_RXTUNE]	= { "RXTUNE",	1, 0, 1, 0, 300 },
+	[TRX_CTRL_TXTUNE]	= { "TXTUNE",	1, 0, 1, 0, 300 },
+	[TRX_CTRL_SETTA]	= { "SETTA",	0, 0, 1, 0, 300 },
+};
+
+/* Override the response timeout of all but the power control commands */
+void trx_if_ctrl_timeout(struct trx_instance *trx, unsigned int timeout_ms)
+{
+	int i;
+
+	for (i = 0; i < _NUM_TRX_CTRL; i++) {
+		if (timeout_ms && !trx_ctrl_cmds[i].barrier)
+			trx->trx_ctrl_timeout_ms[i] = timeout_ms;
+		else
+			trx->trx_ctrl_timeout_ms[i] = trx_ctrl_cmds[i].timeout_ms;
+	}
+}
+
 static void trx_ctrl_timer_cb(void *data);
+static void trx_pm_stop(struct trx_instance *trx);
+
+/* Put a command on the wire and start its expire timer */
+static void trx_ctrl_send_one(struct trx_instance *trx,
+	struct trx_ctrl_msg *tcm)
+{
+	unsigned int timeout_ms = trx->trx_ctrl_timeout_ms[tcm->type];
+	char buf[64];
+	int len, i;
+
+	len = snprintf(buf, sizeof(buf), "CMD %s",
+		trx_ctrl_cmds[tcm->type].name);
+	for (i = 0; i < tcm->num_params; i++)
+		len += snprintf(buf + len, sizeof(buf) - len, " %d",
+			tcm->params[i]);
+
+	LOGP(DTRX, LOGL_DEBUG, "Sending control '%s'\n", buf);
+	send(trx->trx_ofd_ctrl.fd, buf, len + 1, 0);
+
+	if (!tcm->in_flight) {
+		tcm->in_flight = 1;
+		trx->trx_ctrl_inflight++;
+	}
+
+	osmo_timer_schedule(&tcm->timer, timeout_ms / 1000,
+		(timeout_ms % 1000) * 1000);
+}
 
-/* Send first CTRL message and start timer */
+/* Whether a command of this type may be sent now */
+static int trx_ctrl_may_send(struct trx_instance *trx,
+	struct trx_ctrl_msg *tcm)
+{
+	struct trx_ctrl_msg *other;
+	int i;
+
+	if (trx->trx_ctrl_inflight >= TRX_CTRL_INFLIGHT_MAX)
+		return 0;
+	if (trx->trx_ctrl_inflight && trx_ctrl_cmds[tcm->type].barrier)
+		return 0;
+
+	llist_for_each_entry(other, &trx->trx_ctrl_list, list) {
+		if (!other->in_flight)
+			continue;
+		if (trx_ctrl_cmds[other->type].barrier)
+			return 0;
+		if (other->type != tcm->type)
+			continue;
+		/* Only one setting of the same thing at a time, so that a
+		 * command sent again can't overtake a later one */
+		for (i = 0; i < trx_ctrl_cmds[tcm->type].key_params; i++)
+			if (other->params[i] != tcm->params[i])
+				break;
+		if (i == trx_ctrl_cmds[tcm->type].key_params)
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Send queued CTRL messages, as many as may be in flight */
 static void trx_ctrl_send(struct trx_instance *trx)
 {
 	struct trx_ctrl_msg *tcm;
 
-	if (llist_empty(&trx->trx_ctrl_list))
-		return;
-	tcm = llist_entry(trx->trx_ctrl_list.next, struct trx_ctrl_msg, list);
+	llist_for_each_entry(tcm, &trx->trx_ctrl_list, list) {
+		if (tcm->in_flight)
+			continue;
+		/* Keep the order of commands */
+		if (!trx_ctrl_may_send(trx, tcm))
+			break;
 
-	/* Send command */
-	LOGP(DTRX, LOGL_DEBUG, "Sending control '%s'\n", tcm->cmd);
-	send(trx->trx_ofd_ctrl.fd, tcm->cmd, strlen(tcm->cmd) + 1, 0);
+		/* Trigger state machine */
+		if (trx->fsm->state != TRX_STATE_RSP_WAIT) {
+			trx->prev_state = trx->fsm->state;
+			osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_RSP_WAIT, 0, 0);
+		}
 
-	/* Trigger state machine */
-	if (trx->fsm->state != TRX_STATE_RSP_WAIT) {
-		trx->prev_state = trx->fsm->state;
-		osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_RSP_WAIT, 0, 0);
+		trx_ctrl_send_one(trx, tcm);
 	}
+}
 
-	/* Start expire timer */
-	trx->trx_ctrl_timer.data = trx;
-	trx->trx_ctrl_timer.cb = trx_ctrl_timer_cb;
-	osmo_timer_schedule(&trx->trx_ctrl_timer, 2, 0);
+/* Return a command slot to the free list */
+static void trx_ctrl_release(struct trx_instance *trx,
+	struct trx_ctrl_msg *tcm)
+{
+	osmo_timer_del(&tcm->timer);
+	if (tcm->in_flight)
+		trx->trx_ctrl_inflight--;
+	tcm->in_flight = 0;
+	llist_del(&tcm->list);
+	llist_add(&tcm->list, &trx->trx_ctrl_free);
 }
 
-static void trx_ctrl_timer_cb(void *data)
+/* Drop all queued and in flight commands, stopping their timers */
+static void trx_ctrl_flush(struct trx_instance *trx)
 {
-	struct trx_instance *trx = (struct trx_instance *) data;
 	struct trx_ctrl_msg *tcm;
 
-	/* Queue may be cleaned at this moment */
-	if (llist_empty(&trx->trx_ctrl_list))
-		return;
+	while (!llist_empty(&trx->trx_ctrl_list)) {
+		tcm = llist_entry(trx->trx_ctrl_list.next,
+			struct trx_ctrl_msg, list);
+		trx_ctrl_release(trx, tcm);
+	}
+}
 
-	LOGP(DTRX, LOGL_NOTICE, "No response from transceiver...\n");
+/* Give up on the transceiver. Nothing is left to be retried, so that
+ * the offline event is only sent once. */
+static void trx_offline(struct trx_instance *trx)
+{
+	LOGP(DTRX, LOGL_NOTICE, "Transceiver offline\n");
+	trx_pm_stop(trx);
+	trx_ctrl_flush(trx);
+	osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_OFFLINE, 0, 0);
+	osmo_fsm_inst_dispatch(trxcon_fsm, TRX_EVENT_OFFLINE, trx);
+}
+
+static void trx_ctrl_timer_cb(void *data)
+{
+	struct trx_ctrl_msg *tcm = (struct trx_ctrl_msg *) data;
+	struct trx_instance *trx = tcm->trx;
+
+	LOGP(DTRX, LOGL_NOTICE, "No response from transceiver "
+		"for '%s'...\n", trx_ctrl_cmds[tcm->type].name);
 
-	tcm = llist_entry(trx->trx_ctrl_list.next, struct trx_ctrl_msg, list);
 	if (++tcm->retry_cnt > 3) {
-		LOGP(DTRX, LOGL_NOTICE, "Transceiver offline\n");
-		osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_OFFLINE, 0, 0);
-		osmo_fsm_inst_dispatch(trxcon_fsm, TRX_EVENT_OFFLINE, trx);
+		trx_offline(trx);
 		return;
 	}
 
 	/* Attempt to send a command again */
-	trx_ctrl_send(trx);
+	trx_ctrl_send_one(trx, tcm);
 }
 
 /* Add a new CTRL command to the trx_ctrl_list */
-static int trx_ctrl_cmd(struct trx_instance *trx, int critical,
-	const char *cmd, const char *fmt, ...)
+static int trx_ctrl_cmd(struct trx_instance *trx,
+	enum trx_ctrl_cmd_type type, int num_params, int p0, int p1)
 {
 	struct trx_ctrl_msg *tcm;
-	int len, pending = 0;
-	va_list ap;
 
 	/* TODO: make sure that transceiver online */
 
-	if (!llist_empty(&trx->trx_ctrl_list))
-		pending = 1;
+	/* There is no transceiver in replay mode */
+	if (trx->trx_ofd_ctrl.fd < 0) {
+		LOGP(DTRX, LOGL_DEBUG, "No transceiver, ignoring "
+			"control '%s'\n", trx_ctrl_cmds[type].name);
+		return 0;
+	}
 
-	/* Allocate a message */
-	tcm = talloc_zero(trx, struct trx_ctrl_msg);
-	if (!tcm)
+	/* Take a preallocated slot */
+	if (llist_empty(&trx->trx_ctrl_free)) {
+		LOGP(DTRX, LOGL_ERROR, "Too many pending controls, "
+			"dropping '%s'\n", trx_ctrl_cmds[type].name);
 		return -ENOMEM;
-
-	/* Fill in command arguments */
-	if (fmt && fmt[0]) {
-		len = snprintf(tcm->cmd, sizeof(tcm->cmd) - 1, "CMD %s ", cmd);
-		va_start(ap, fmt);
-		vsnprintf(tcm->cmd + len, sizeof(tcm->cmd) - len - 1, fmt, ap);
-		va_end(ap);
-	} else {
-		snprintf(tcm->cmd, sizeof(tcm->cmd) - 1, "CMD %s", cmd);
 	}
+	tcm = llist_entry(trx->trx_ctrl_free.next, struct trx_ctrl_msg, list);
+	llist_del(&tcm->list);
 
-	tcm->cmd_len = strlen(cmd);
-	tcm->critical = critical;
+	tcm->type = type;
+	tcm->num_params = num_params;
+	tcm->params[0] = p0;
+	tcm->params[1] = p1;
+	tcm->retry_cnt = 0;
+	tcm->in_flight = 0;
 	llist_add_tail(&tcm->list, &trx->trx_ctrl_list);
-	LOGP(DTRX, LOGL_INFO, "Adding new control '%s'\n", tcm->cmd);
+	LOGP(DTRX, LOGL_INFO, "Adding new control '%s'\n",
+		trx_ctrl_cmds[type].name);
 
-	/* Send message, if no pending messages */
-	if (!pending)
-		trx_ctrl_send(trx);
+	/* Send message, if nothing stops it */
+	trx_ctrl_send(trx);
 
 	return 0;
 }
@@ -244,17 +368,17 @@ static int trx_ctrl_cmd(struct trx_instance *trx, int critical,
 
 int trx_if_cmd_echo(struct trx_instance *trx)
 {
-	return trx_ctrl_cmd(trx, 1, "ECHO", "");
+	return trx_ctrl_cmd(trx, TRX_CTRL_ECHO, 0, 0, 0);
 }
 
 int trx_if_cmd_poweroff(struct trx_instance *trx)
 {
-	return trx_ctrl_cmd(trx, 1, "POWEROFF", "");
+	return trx_ctrl_cmd(trx, TRX_CTRL_POWEROFF, 0, 0, 0);
 }
 
 int trx_if_cmd_poweron(struct trx_instance *trx)
 {
-	return trx_ctrl_cmd(trx, 1, "POWERON", "");
+	return trx_ctrl_cmd(trx, TRX_CTRL_POWERON, 0, 0, 0);
 }
 
 /*
@@ -266,7 +390,7 @@ int trx_if_cmd_poweron(struct trx_instance *trx)
 
 int trx_if_cmd_setpower(struct trx_instance *trx, int db)
 {
-	return trx_ctrl_cmd(trx, 0, "SETPOWER", "%d", db);
+	return trx_ctrl_cmd(trx, TRX_CTRL_SETPOWER, 1, db, 0);
 }
 
 /*
@@ -279,7 +403,7 @@ int trx_if_cmd_setpower(struct trx_instance *trx, int db)
 
 int trx_if_cmd_adjpower(struct trx_instance *trx, int db)
 {
-	return trx_ctrl_cmd(trx, 0, "ADJPOWER", "%d", db);
+	return trx_ctrl_cmd(trx, TRX_CTRL_ADJPOWER, 1, db, 0);
 }
 
 /*
@@ -295,7 +419,7 @@ int trx_if_cmd_adjpower(struct trx_instance *trx, int db)
 
 int trx_if_cmd_setslot(struct trx_instance *trx, uint8_t tn, uint8_t type)
 {
-	return trx_ctrl_cmd(trx, 1, "SETSLOT", "%d %d", tn, type);
+	return trx_ctrl_cmd(trx, TRX_CTRL_SETSLOT, 2, tn, type);
 }
 
 /*
@@ -321,7 +445,7 @@ int trx_if_cmd_rxtune(struct trx_instance *trx, uint16_t arfcn)
 		return -ENOTSUP;
 	}
 
-	return trx_ctrl_cmd(trx, 1, "RXTUNE", "%d", freq10 * 100);
+	return trx_ctrl_cmd(trx, TRX_CTRL_RXTUNE, 1, freq10 * 100, 0);
 }
 
 int trx_if_cmd_txtune(struct trx_instance *trx, uint16_t arfcn)
@@ -335,7 +459,7 @@ int trx_if_cmd_txtune(struct trx_instance *trx, uint16_t arfcn)
 		return -ENOTSUP;
 	}
 
-	return trx_ctrl_cmd(trx, 1, "TXTUNE", "%d", freq10 * 100);
+	return trx_ctrl_cmd(trx, TRX_CTRL_TXTUNE, 1, freq10 * 100, 0);
 }
 
 /*
@@ -348,54 +472,310 @@ int trx_if_cmd_txtune(struct trx_instance *trx, uint16_t arfcn)
  * previous frequency.
  * CMD MEASURE <kHz>
  * RSP MEASURE <status> <kHz> <dB>
+ *
+ * A compatible transceiver may also measure a range of
+ * frequencies in 200 kHz steps with a single request:
+ * CMD MEASURE <kHz start> <kHz stop>
+ * RSP MEASURE <status> <kHz start> <kHz stop> <dB> <dB> ...
+ *
+ * Measurement requests don't go through the CTRL queue: up
+ * to pm_window of them are kept in flight, so a range scan
+ * doesn't cost a round trip per ARFCN. The responses are
+ * matched by frequency, and the results are sent to L1CTL
+ * in ARFCN order.
  */
 
+#define TRX_PM_RING		(TRX_PM_WINDOW_MAX * TRX_PM_BATCH_MAX)
+#define TRX_PM_DBM_NONE		INT16_MIN
+/* Reported for ARFCNs without a known frequency */
+#define TRX_PM_DBM_UNDEF	-110
+
+static void trx_pm_timer_cb(void *data);
+
+void trx_if_pm_config(struct trx_instance *trx,
+	unsigned int window, unsigned int batch)
+{
+	trx->pm_window = OSMO_MAX(1, OSMO_MIN(window, TRX_PM_WINDOW_MAX));
+	trx->pm_batch = OSMO_MAX(1, OSMO_MIN(batch, TRX_PM_BATCH_MAX));
+}
+
+static void trx_pm_stop(struct trx_instance *trx)
+{
+	osmo_timer_del(&trx->pm_timer);
+	memset(trx->pm_req, 0, sizeof(trx->pm_req));
+	trx->pm_num = trx->pm_req_off = trx->pm_conf_off = 0;
+}
+
+static void trx_pm_send(struct trx_instance *trx, struct trx_pm_req *req)
+{
+	char buf[64];
+
+	req->batched = (trx->pm_batch > 1 && req->num > 1);
+	if (req->batched)
+		snprintf(buf, sizeof(buf), "CMD MEASURE %u %u", req->freq_khz,
+			req->freq_khz + (req->num - 1) * 200);
+	else
+		snprintf(buf, sizeof(buf), "CMD MEASURE %u", req->freq_khz);
+
+	LOGP(DTRX, LOGL_DEBUG, "Sending control '%s'\n", buf);
+	send(trx->trx_ofd_ctrl.fd, buf, strlen(buf) + 1, 0);
+}
+
+/* Go on with one frequency per request, sending the requests in flight
+ * again, if the transceiver doesn't know the range form of MEASURE.
+ * Returns whether there were such requests. */
+static int trx_pm_unbatch(struct trx_instance *trx)
+{
+	struct trx_pm_req *req;
+	unsigned int i;
+	int found = 0;
+
+	for (i = 0; i < trx->pm_window; i++) {
+		req = &trx->pm_req[i];
+		if (req->num && req->batched) {
+			if (!found)
+				LOGP(DTRX, LOGL_NOTICE, "Transceiver doesn't "
+					"support batched power measurement, "
+					"falling back to single requests\n");
+			trx->pm_batch = 1;
+			trx_pm_send(trx, req);
+			found = 1;
+		}
+	}
+
+	return found;
+}
+
+/* Whether another request fits without overrunning unconfirmed results */
+static int trx_pm_room(struct trx_instance *trx)
+{
+	return trx->pm_req_off < trx->pm_num
+		&& trx->pm_req_off - trx->pm_conf_off + trx->pm_batch
+			<= TRX_PM_RING;
+}
+
+/* Request measurements until the window is full */
+static void trx_pm_fill(struct trx_instance *trx)
+{
+	struct trx_pm_req *req;
+	uint16_t arfcn, freq10;
+	unsigned int i;
+
+	for (i = 0; i < trx->pm_window; i++) {
+		req = &trx->pm_req[i];
+		if (req->num)
+			continue;
+
+		/* Skip ARFCNs without a known frequency */
+		while (trx_pm_room(trx)) {
+			arfcn = trx->pm_arfcn_start + trx->pm_req_off;
+			if (gsm_arfcn2freq10(arfcn, 0) != 0xffff)
+				break;
+
+			LOGP(DTRX, LOGL_ERROR, "ARFCN %d not defined\n",
+				arfcn &~ ARFCN_FLAG_MASK);
+			trx->pm_dbm[trx->pm_req_off++ % TRX_PM_RING] =
+				TRX_PM_DBM_UNDEF;
+		}
+		if (!trx_pm_room(trx))
+			break;
+
+		arfcn = trx->pm_arfcn_start + trx->pm_req_off;
+		freq10 = gsm_arfcn2freq10(arfcn, 0);
+		req->arfcn = arfcn;
+		req->freq_khz = freq10 * 100;
+		req->num = 1;
+		trx->pm_req_off++;
+
+		/* Extend over the following frequencies, if allowed */
+		while (req->num < trx->pm_batch
+		    && trx->pm_req_off < trx->pm_num
+		    && gsm_arfcn2freq10(arfcn + req->num, 0)
+				== freq10 + 2 * req->num) {
+			req->num++;
+			trx->pm_req_off++;
+		}
+
+		trx_pm_send(trx, req);
+	}
+
+	if (!osmo_timer_pending(&trx->pm_timer))
+		osmo_timer_schedule(&trx->pm_timer, 2, 0);
+}
+
+/* Send the results to L1CTL in ARFCN order, as far as they are known */
+static void trx_pm_flush(struct trx_instance *trx)
+{
+	unsigned int idx;
+	uint16_t arfcn;
+	int dbm;
+
+	while (trx->pm_conf_off < trx->pm_req_off) {
+		idx = trx->pm_conf_off % TRX_PM_RING;
+		if (trx->pm_dbm[idx] == TRX_PM_DBM_NONE)
+			break;
+
+		dbm = trx->pm_dbm[idx];
+		trx->pm_dbm[idx] = TRX_PM_DBM_NONE;
+		arfcn = trx->pm_arfcn_start + trx->pm_conf_off++;
+
+		/* Send L1CTL_PM_CONF */
+		l1ctl_tx_pm_conf(trx->l1l, arfcn, dbm,
+			trx->pm_conf_off == trx->pm_num);
+	}
+
+	if (trx->pm_conf_off == trx->pm_num)
+		trx_pm_stop(trx);
+}
+
 int trx_if_cmd_measure(struct trx_instance *trx,
 	uint16_t arfcn_start, uint16_t arfcn_stop)
 {
-	uint16_t freq10;
+	unsigned int i;
+
+	/* Calculate a frequency for current ARFCN (DL) */
+	if (gsm_arfcn2freq10(arfcn_start, 0) == 0xffff) {
+		LOGP(DTRX, LOGL_ERROR, "ARFCN %d not defined\n", arfcn_start);
+		return -ENOTSUP;
+	}
+
+	/* There is no transceiver in replay mode */
+	if (trx->trx_ofd_ctrl.fd < 0) {
+		LOGP(DTRX, LOGL_DEBUG, "No transceiver, ignoring "
+			"control 'MEASURE'\n");
+		return 0;
+	}
+
+	/* A new request replaces the one in progress */
+	trx_pm_stop(trx);
+	for (i = 0; i < TRX_PM_RING; i++)
+		trx->pm_dbm[i] = TRX_PM_DBM_NONE;
 
 	/* Update ARFCN range for measurement */
 	trx->pm_arfcn_start = arfcn_start;
 	trx->pm_arfcn_stop = arfcn_stop;
+	trx->pm_num = arfcn_stop - arfcn_start + 1;
+	trx->pm_retry_cnt = 0;
 
-	/* Calculate a frequency for current ARFCN (DL) */
-	freq10 = gsm_arfcn2freq10(arfcn_start, 0);
-	if (freq10 == 0xffff) {
-		LOGP(DTRX, LOGL_ERROR, "ARFCN %d not defined\n", arfcn_start);
-		return -ENOTSUP;
+	trx_pm_fill(trx);
+	trx_pm_flush(trx);
+
+	return 0;
+}
+
+static void trx_pm_timer_cb(void *data)
+{
+	struct trx_instance *trx = (struct trx_instance *) data;
+	unsigned int i;
+
+	LOGP(DTRX, LOGL_NOTICE, "No power measurement response "
+		"from transceiver...\n");
+
+	/* A transceiver may not answer the range form of MEASURE at all */
+	if (trx_pm_unbatch(trx)) {
+		osmo_timer_schedule(&trx->pm_timer, 2, 0);
+		return;
+	}
+
+	if (++trx->pm_retry_cnt > 3) {
+		trx_offline(trx);
+		return;
 	}
 
-	return trx_ctrl_cmd(trx, 1, "MEASURE", "%d", freq10 * 100);
+	/* Attempt to send the requests in flight again */
+	for (i = 0; i < trx->pm_window; i++)
+		if (trx->pm_req[i].num)
+			trx_pm_send(trx, &trx->pm_req[i]);
+	osmo_timer_schedule(&trx->pm_timer, 2, 0);
 }
 
 static void trx_if_measure_rsp_cb(struct trx_instance *trx, char *resp)
 {
-	unsigned int freq10;
-	uint16_t arfcn;
-	int dbm;
+	struct trx_pm_req *req = NULL;
+	unsigned int freq_khz, stop_khz, i;
+	int status, dbm, n;
+	uint16_t off;
+	char *p = resp;
+
+	/* Parse status and (first) frequency */
+	if (sscanf(p, "%d %u%n", &status, &freq_khz, &n) != 2) {
+		LOGP(DTRX, LOGL_ERROR, "Malformed MEASURE response: '%s'\n",
+			resp);
+		return;
+	}
+	p += n;
+
+	for (i = 0; i < trx->pm_window; i++) {
+		if (trx->pm_req[i].num
+		 && trx->pm_req[i].freq_khz == freq_khz) {
+			req = &trx->pm_req[i];
+			break;
+		}
+	}
 
-	/* Parse freq. and power level */
-	sscanf(resp, "%u %d", &freq10, &dbm);
-	freq10 /= 100;
-
-	/* Check received ARFCN against expected */
-	arfcn = gsm_freq102arfcn((uint16_t) freq10, 0);
-	if (arfcn != trx->pm_arfcn_start) {
-		LOGP(DTRX, LOGL_ERROR, "Power measurement error: "
-			"response ARFCN=%u doesn't match expected ARFCN=%u\n",
-			arfcn &~ ARFCN_FLAG_MASK,
-			trx->pm_arfcn_start &~ ARFCN_FLAG_MASK);
+	/* Late response to a request that was sent again */
+	if (!req) {
+		LOGP(DTRX, LOGL_DEBUG, "Ignoring unexpected power "
+			"measurement response for %u kHz\n", freq_khz);
 		return;
 	}
 
-	/* Send L1CTL_PM_CONF */
-	l1ctl_tx_pm_conf(trx->l1l, arfcn, dbm,
-		arfcn == trx->pm_arfcn_stop);
+	trx->pm_retry_cnt = 0;
+	off = req->arfcn - trx->pm_arfcn_start;
+
+	if (req->batched) {
+		/* Parse the range and one level per frequency */
+		if (status == 0
+		 && sscanf(p, "%u%n", &stop_khz, &n) == 1
+		 && stop_khz == freq_khz + (req->num - 1) * 200) {
+			p += n;
+			for (i = 0; i < req->num; i++) {
+				if (sscanf(p, "%d%n", &dbm, &n) != 1)
+					break;
+				trx->pm_dbm[(off + i) % TRX_PM_RING] = dbm;
+				p += n;
+			}
+			if (i == req->num) {
+				req->num = 0;
+				goto done;
+			}
+		}
+
+		/* Partial results are measured again */
+		for (i = 0; i < req->num; i++)
+			trx->pm_dbm[(off + i) % TRX_PM_RING] = TRX_PM_DBM_NONE;
+
+		trx_pm_unbatch(trx);
+		return;
+	}
 
-	/* Schedule a next measurement */
-	if (arfcn != trx->pm_arfcn_stop)
-		trx_if_cmd_measure(trx, ++arfcn, trx->pm_arfcn_stop);
+	if (status) {
+		LOGP(DTRX, LOGL_FATAL, "Transceiver rejected TRX command "
+			"with response: 'RSP MEASURE %s'\n", resp);
+		trx_pm_stop(trx);
+		osmo_fsm_inst_dispatch(trxcon_fsm, TRX_EVENT_RSP_ERROR, trx);
+		return;
+	}
+
+	if (sscanf(p, "%d", &dbm) != 1) {
+		LOGP(DTRX, LOGL_ERROR, "Malformed MEASURE response: '%s'\n",
+			resp);
+		return;
+	}
+	trx->pm_dbm[off % TRX_PM_RING] = dbm;
+
+	/* The rest of a request, which was sent as a range, goes
+	 * on one frequency at a time */
+	if (--req->num) {
+		req->arfcn++;
+		req->freq_khz += 200;
+		trx_pm_send(trx, req);
+	}
+
+done:
+	osmo_timer_del(&trx->pm_timer);
+	trx_pm_fill(trx);
+	trx_pm_flush(trx);
 }
 
 /*
@@ -421,15 +801,16 @@ int trx_if_cmd_setta(struct trx_instance *trx, int8_t ta)
 		return -ENOTSUP;
 	}
 
-	return trx_ctrl_cmd(trx, 0, "SETTA", "%d", ta);
+	return trx_ctrl_cmd(trx, TRX_CTRL_SETTA, 1, ta, 0);
 }
 
 /* Get response from CTRL socket */
 static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct trx_instance *trx = ofd->data;
-	struct trx_ctrl_msg *tcm;
-	int len, resp, rsp_len;
+	struct trx_ctrl_msg *tcm, *found = NULL;
+	int len, resp, rsp_len, type, n, i;
+	int params[2], num_params = 0;
 	char buf[1500], *p;
 
 	len = recv(ofd->fd, buf, sizeof(buf) - 1, 0);
@@ -448,55 +829,87 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 
 	LOGP(DTRX, LOGL_INFO, "Response message: '%s'\n", buf);
 
-	/* Abort expire timer */
-	if (osmo_timer_pending(&trx->trx_ctrl_timer))
-		osmo_timer_del(&trx->trx_ctrl_timer);
-
-	/* Get command for response message */
-	if (llist_empty(&trx->trx_ctrl_list)) {
-		LOGP(DTRX, LOGL_NOTICE, "Response message without command\n");
-		return -EINVAL;
+	/* Power measurement responses bypass the CTRL queue */
+	if (rsp_len == 7 && !strncmp(buf + 4, "MEASURE", 7) && p) {
+		if (trx->pm_num)
+			trx_if_measure_rsp_cb(trx, p + 1);
+		return 0;
 	}
 
-	tcm = llist_entry(trx->trx_ctrl_list.next,
-		struct trx_ctrl_msg, list);
+	/* The answer to an unknown command, most likely the range form
+	 * of MEASURE if such requests are in flight */
+	if (rsp_len == 3 && !strncmp(buf + 4, "ERR", 3)
+	 && trx->pm_num && trx_pm_unbatch(trx))
+		return 0;
 
-	/* Check if response matches command */
-	if (!!strncmp(buf + 4, tcm->cmd + 4, rsp_len)) {
-		LOGP(DTRX, (tcm->critical) ? LOGL_FATAL : LOGL_ERROR,
-			"Response message '%s' does not match command "
-			"message '%s'\n", buf, tcm->cmd);
-		goto rsp_error;
+	/* Look up the command type */
+	for (type = 0; type < _NUM_TRX_CTRL; type++) {
+		if (strlen(trx_ctrl_cmds[type].name) == rsp_len
+		 && !strncmp(buf + 4, trx_ctrl_cmds[type].name, rsp_len))
+			break;
 	}
 
 	/* Check for response code */
-	sscanf(p + 1, "%d", &resp);
+	if (type == _NUM_TRX_CTRL || !p || sscanf(p + 1, "%d%n", &resp, &n) != 1) {
+		LOGP(DTRX, LOGL_NOTICE, "Unknown response on CTRL port: %s\n", buf);
+		return 0;
+	}
+
+	/* The parameters of the command, if any */
+	for (p += 1 + n; num_params < 2; num_params++, p += n) {
+		if (sscanf(p, "%d%n", &params[num_params], &n) != 1)
+			break;
+	}
+
+	/* Get the oldest command in flight for response message */
+	llist_for_each_entry(tcm, &trx->trx_ctrl_list, list) {
+		if (!tcm->in_flight || tcm->type != type)
+			continue;
+		if (trx_ctrl_cmds[type].echo_params) {
+			if (num_params < tcm->num_params)
+				continue;
+			for (i = 0; i < tcm->num_params; i++)
+				if (params[i] != tcm->params[i])
+					break;
+			if (i < tcm->num_params)
+				continue;
+		}
+		found = tcm;
+		break;
+	}
+
+	/* A duplicate response to a command sent again, most likely */
+	if (!found) {
+		LOGP(DTRX, LOGL_NOTICE, "Response message without "
+			"command: '%s'\n", buf);
+		return 0;
+	}
+	tcm = found;
+
 	if (resp) {
-		LOGP(DTRX, (tcm->critical) ? LOGL_FATAL : LOGL_ERROR,
+		LOGP(DTRX, (trx_ctrl_cmds[type].critical) ? LOGL_FATAL : LOGL_ERROR,
 			"Transceiver rejected TRX command with "
 			"response: '%s'\n", buf);
 
-		if (tcm->critical)
+		if (trx_ctrl_cmds[type].critical) {
+			trx_ctrl_release(trx, tcm);
 			goto rsp_error;
+		}
 	}
 
-	/* Trigger state machine */
-	if (!strncmp(tcm->cmd + 4, "POWERON", 7))
-		osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_ACTIVE, 0, 0);
-	else if (!strncmp(tcm->cmd + 4, "POWEROFF", 8))
-		osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_IDLE, 0, 0);
-	else if (!strncmp(tcm->cmd + 4, "MEASURE", 7))
-		trx_if_measure_rsp_cb(trx, buf + 14);
-	else if (!strncmp(tcm->cmd + 4, "ECHO", 4))
-		osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_IDLE, 0, 0);
-	else
-		osmo_fsm_inst_state_chg(trx->fsm, trx->prev_state, 0, 0);
+	/* Trigger state machine, once nothing is pending */
+	if (type == TRX_CTRL_POWERON)
+		trx->prev_state = TRX_STATE_ACTIVE;
+	else if (type == TRX_CTRL_POWEROFF || type == TRX_CTRL_ECHO)
+		trx->prev_state = TRX_STATE_IDLE;
 
 	/* Remove command from list */
-	llist_del(&tcm->list);
-	talloc_free(tcm);
+	trx_ctrl_release(trx, tcm);
+
+	if (llist_empty(&trx->trx_ctrl_list))
+		osmo_fsm_inst_state_chg(trx->fsm, trx->prev_state, 0, 0);
 
-	/* Send next message, if any */
+	/* Send next messages, if any */
 	trx_ctrl_send(trx);
 
 	return 0;
@@ -529,24 +942,18 @@ rsp_error:
 /* 148 bytes output symbol values, 0 & 1                                    */
 /* ------------------------------------------------------------------------ */
 
-static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
+/* Parse a TRXD burst message and feed it to the scheduler */
+void trx_if_handle_burst(struct trx_instance *trx, const uint8_t *buf, int len)
 {
-	struct trx_instance *trx = ofd->data;
-	uint8_t buf[256];
 	sbit_t bits[148];
 	int8_t rssi, tn;
 	int16_t toa256;
 	uint32_t fn;
-	int len;
-
-	len = recv(ofd->fd, buf, sizeof(buf), 0);
-	if (len <= 0)
-		return len;
 
-	if (len != 158) {
+	if (len != TRX_DATA_RX_LEN) {
 		LOGP(DTRXD, LOGL_ERROR, "Got data message with invalid "
 			"length '%d'\n", len);
-		return -EINVAL;
+		return;
 	}
 
 	tn = buf[0];
@@ -559,12 +966,12 @@ static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
 
 	if (tn >= 8) {
 		LOGP(DTRXD, LOGL_ERROR, "Illegal TS %d\n", tn);
-		return -EINVAL;
+		return;
 	}
 
 	if (fn >= 2715648) {
 		LOGP(DTRXD, LOGL_ERROR, "Illegal FN %u\n", fn);
-		return -EINVAL;
+		return;
 	}
 
 	LOGP(DTRXD, LOGL_DEBUG, "RX burst tn=%u fn=%u rssi=%d toa=%d\n",
@@ -574,16 +981,47 @@ static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
 	sched_trx_handle_rx_burst(trx, tn, fn, bits, 148, rssi, toa256);
 
 	/* Correct local clock counter */
-	if (fn % 51 == 0)
-		sched_clck_handle(&trx->sched, fn);
+	if (trx->sched.clock_virt)
+		sched_clck_virt_handle(&trx->sched, fn);
+	else if (fn % 51 == 0)
+		sched_clck_handle(&trx->sched, fn, trx->rx_burst_us);
+}
+
+/* Drain up to TRX_DATA_BATCH_MAX bursts with a single syscall */
+static int trx_data_rx_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trx_instance *trx = ofd->data;
+	uint8_t buf[TRX_DATA_BATCH_MAX][256];
+	struct mmsghdr msgs[TRX_DATA_BATCH_MAX];
+	struct iovec iov[TRX_DATA_BATCH_MAX];
+	int i, rc;
+
+	for (i = 0; i < TRX_DATA_BATCH_MAX; i++) {
+		iov[i].iov_base = buf[i];
+		iov[i].iov_len = sizeof(buf[i]);
+		memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	rc = recvmmsg(ofd->fd, msgs, TRX_DATA_BATCH_MAX, MSG_DONTWAIT, NULL);
+	if (rc <= 0)
+		return rc;
+
+	trx->rx_batch_cnt[rc]++;
+	trx->rx_burst_us = lat_now_us();
+
+	for (i = 0; i < rc; i++)
+		trx_if_handle_burst(trx, buf[i], msgs[i].msg_len);
 
 	return 0;
 }
 
+/* Queue an uplink burst, it is sent by trx_if_flush_bursts() */
 int trx_if_tx_burst(struct trx_instance *trx, uint8_t tn, uint32_t fn,
 	uint8_t pwr, const ubit_t *bits)
 {
-	uint8_t buf[256];
+	uint8_t *buf;
 
 	/**
 	 * We must be sure that we have clock,
@@ -599,6 +1037,20 @@ int trx_if_tx_burst(struct trx_instance *trx, uint8_t tn, uint32_t fn,
 
 	LOGP(DTRXD, LOGL_DEBUG, "TX burst tn=%u fn=%u pwr=%u\n", tn, fn, pwr);
 
+	/* Should not happen, there are only 8 timeslots per frame */
+	if (trx->tx_ring_len == TRX_DATA_BATCH_MAX)
+		trx_if_flush_bursts(trx);
+	if (trx->tx_ring_len == TRX_DATA_BATCH_MAX) {
+		LOGP(DTRXD, LOGL_ERROR, "TX ring overflow, "
+			"dropping the oldest burst\n");
+		trx->tx_ring_head = (trx->tx_ring_head + 1) % TRX_DATA_BATCH_MAX;
+		trx->tx_ring_len--;
+	}
+
+	buf = trx->tx_ring[(trx->tx_ring_head + trx->tx_ring_len)
+		% TRX_DATA_BATCH_MAX];
+	trx->tx_ring_len++;
+
 	buf[0] = tn;
 	buf[1] = (fn >> 24) & 0xff;
 	buf[2] = (fn >> 16) & 0xff;
@@ -609,12 +1061,67 @@ int trx_if_tx_burst(struct trx_instance *trx, uint8_t tn, uint32_t fn,
 	/* Copy ubits {0,1} */
 	memcpy(buf + 6, bits, 148);
 
-	/* Send data to transceiver */
-	send(trx->trx_ofd_data.fd, buf, 154, 0);
-
 	return 0;
 }
 
+/* Send all queued uplink bursts with a single syscall */
+int trx_if_flush_bursts(struct trx_instance *trx)
+{
+	struct mmsghdr msgs[TRX_DATA_BATCH_MAX];
+	struct iovec iov[TRX_DATA_BATCH_MAX];
+	unsigned int i, idx;
+	int rc;
+
+	if (!trx->tx_ring_len)
+		return 0;
+
+	/* There is no transceiver in replay mode */
+	if (trx->trx_ofd_data.fd < 0) {
+		trx->tx_ring_head = trx->tx_ring_len = 0;
+		return 0;
+	}
+
+	for (i = 0; i < trx->tx_ring_len; i++) {
+		idx = (trx->tx_ring_head + i) % TRX_DATA_BATCH_MAX;
+		iov[i].iov_base = trx->tx_ring[idx];
+		iov[i].iov_len = TRX_DATA_TX_LEN;
+		memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	rc = sendmmsg(trx->trx_ofd_data.fd, msgs, trx->tx_ring_len, 0);
+	if (rc < 0) {
+		LOGP(DTRXD, LOGL_ERROR, "Failed to send %u burst(s) "
+			"to transceiver: %s\n", trx->tx_ring_len, strerror(errno));
+		/* Bursts are bound to a frame, there is no point in keeping them */
+		trx->tx_ring_head = trx->tx_ring_len = 0;
+		return -errno;
+	}
+
+	trx->tx_batch_cnt[rc]++;
+
+	/* Whatever was not sent yet is retried with the next frame */
+	trx->tx_ring_head = (trx->tx_ring_head + rc) % TRX_DATA_BATCH_MAX;
+	trx->tx_ring_len -= rc;
+
+	return rc;
+}
+
+static void trx_if_log_batch_stats(struct trx_instance *trx)
+{
+	int i;
+
+	for (i = 1; i <= TRX_DATA_BATCH_MAX; i++) {
+		if (!trx->rx_batch_cnt[i] && !trx->tx_batch_cnt[i])
+			continue;
+
+		LOGP(DTRXD, LOGL_INFO, "Batches of %2d burst(s): "
+			"RX %u, TX %u\n", i, trx->rx_batch_cnt[i],
+			trx->tx_batch_cnt[i]);
+	}
+}
+
 /*
  * Open/close OsmoTRX connection
  */
@@ -623,7 +1130,7 @@ int trx_if_open(struct trx_instance **trx, const char *local_host,
 		const char *remote_host, uint16_t port)
 {
 	struct trx_instance *trx_new;
-	int rc;
+	int rc, i;
 
 	LOGP(DTRX, LOGL_NOTICE, "Init transceiver interface\n");
 
@@ -634,8 +1141,29 @@ int trx_if_open(struct trx_instance **trx, const char *local_host,
 		return -ENOMEM;
 	}
 
-	/* Initialize CTRL queue */
+	/* Initialize CTRL queue and its preallocated slots */
 	INIT_LLIST_HEAD(&trx_new->trx_ctrl_list);
+	INIT_LLIST_HEAD(&trx_new->trx_ctrl_free);
+	for (i = 0; i < TRX_CTRL_SLOTS; i++) {
+		struct trx_ctrl_msg *tcm = &trx_new->trx_ctrl_slots[i];
+
+		tcm->trx = trx_new;
+		tcm->timer.data = tcm;
+		tcm->timer.cb = trx_ctrl_timer_cb;
+		llist_add_tail(&tcm->list, &trx_new->trx_ctrl_free);
+	}
+	trx_if_ctrl_timeout(trx_new, 0);
+
+	/* Power measurement, one request at a time by default */
+	trx_if_pm_config(trx_new, 1, 1);
+	trx_new->pm_timer.data = trx_new;
+	trx_new->pm_timer.cb = trx_pm_timer_cb;
+
+	/* No sockets for offline (replay) operation */
+	trx_new->trx_ofd_ctrl.fd = -1;
+	trx_new->trx_ofd_data.fd = -1;
+	if (remote_host == NULL)
+		goto fsm;
 
 	/* Open sockets */
 	rc = trx_udp_open(trx_new, &trx_new->trx_ofd_ctrl, local_host,
@@ -648,6 +1176,7 @@ int trx_if_open(struct trx_instance **trx, const char *local_host,
 	if (rc < 0)
 		goto error;
 
+fsm:
 	/* Allocate a new dedicated state machine */
 	osmo_fsm_register(&trx_fsm);
 	trx_new->fsm = osmo_fsm_inst_alloc(&trx_fsm, trx_new,
@@ -666,18 +1195,14 @@ error:
 /* Flush pending control messages */
 void trx_if_flush_ctrl(struct trx_instance *trx)
 {
-	struct trx_ctrl_msg *tcm;
-
 	/* Reset state machine */
 	osmo_fsm_inst_state_chg(trx->fsm, TRX_STATE_IDLE, 0, 0);
 
+	/* Abort power measurement */
+	trx_pm_stop(trx);
+
 	/* Clear command queue */
-	while (!llist_empty(&trx->trx_ctrl_list)) {
-		tcm = llist_entry(trx->trx_ctrl_list.next,
-			struct trx_ctrl_msg, list);
-		llist_del(&tcm->list);
-		talloc_free(tcm);
-	}
+	trx_ctrl_flush(trx);
 }
 
 void trx_if_close(struct trx_instance *trx)
@@ -691,6 +1216,9 @@ void trx_if_close(struct trx_instance *trx)
 	/* Flush CTRL message list */
 	trx_if_flush_ctrl(trx);
 
+	/* Print DATA interface batching statistics */
+	trx_if_log_batch_stats(trx);
+
 	/* Close sockets */
 	trx_udp_close(&trx->trx_ofd_ctrl);
 	trx_udp_close(&trx->trx_ofd_data);
@@ -10,6 +10,50 @@
 
 /* Forward declaration to avoid mutual include */
 struct l1ctl_link;
+struct sched_worker_pool;
+
+/* Maximum number of bursts received / sent by one syscall */
+#define TRX_DATA_BATCH_MAX	16
+
+/* Maximum number of MEASURE requests in flight */
+#define TRX_PM_WINDOW_MAX	16
+/* Maximum number of ARFCNs per batched MEASURE request */
+#define TRX_PM_BATCH_MAX	64
+
+/* Number of preallocated CTRL command slots */
+#define TRX_CTRL_SLOTS		32
+/* Maximum number of CTRL commands in flight */
+#define TRX_CTRL_INFLIGHT_MAX	4
+
+/* Length of TRXD messages */
+#define TRX_DATA_RX_LEN		158
+#define TRX_DATA_TX_LEN		154
+
+enum trx_ctrl_cmd_type {
+	TRX_CTRL_ECHO,
+	TRX_CTRL_POWERON,
+	TRX_CTRL_POWEROFF,
+	TRX_CTRL_SETPOWER,
+	TRX_CTRL_ADJPOWER,
+	TRX_CTRL_SETSLOT,
+	TRX_CTRL_RXTUNE,
+	TRX_CTRL_TXTUNE,
+	TRX_CTRL_SETTA,
+	_NUM_TRX_CTRL
+};
+
+struct trx_instance;
+
+struct trx_ctrl_msg {
+	struct llist_head list;
+	struct trx_instance *trx;
+	struct osmo_timer_list timer;
+	enum trx_ctrl_cmd_type type;
+	int params[2];
+	int num_params;
+	int retry_cnt;
+	int in_flight;
+};
 
 enum trx_fsm_states {
 	TRX_STATE_OFFLINE = 0,
@@ -18,18 +62,38 @@ enum trx_fsm_states {
 	TRX_STATE_RSP_WAIT,
 };
 
+/* A MEASURE request in flight, covering ARFCNs of adjacent frequencies */
+struct trx_pm_req {
+	uint16_t arfcn;		/* first ARFCN not measured yet */
+	uint16_t num;		/* number of ARFCNs left, 0 if unused */
+	uint32_t freq_khz;	/* downlink frequency of the first one */
+	int batched;		/* sent as a range request */
+};
+
 struct trx_instance {
 	struct osmo_fd trx_ofd_ctrl;
 	struct osmo_fd trx_ofd_data;
 
-	struct osmo_timer_list trx_ctrl_timer;
-	struct llist_head trx_ctrl_list;
+	struct llist_head trx_ctrl_list;	/* queued and in flight */
+	struct llist_head trx_ctrl_free;	/* unused slots */
+	struct trx_ctrl_msg trx_ctrl_slots[TRX_CTRL_SLOTS];
+	unsigned int trx_ctrl_inflight;
+	unsigned int trx_ctrl_timeout_ms[_NUM_TRX_CTRL];
 	struct osmo_fsm_inst *fsm;
 	uint32_t prev_state;
 
 	/* GSM L1 specific */
 	uint16_t pm_arfcn_start;
 	uint16_t pm_arfcn_stop;
+	uint16_t pm_num;	/* number of ARFCNs in the range */
+	uint16_t pm_req_off;	/* next ARFCN to request */
+	uint16_t pm_conf_off;	/* next ARFCN to confirm to L1CTL */
+	unsigned int pm_window;	/* max. MEASURE requests in flight */
+	unsigned int pm_batch;	/* max. ARFCNs per MEASURE request */
+	struct trx_pm_req pm_req[TRX_PM_WINDOW_MAX];
+	int16_t pm_dbm[TRX_PM_WINDOW_MAX * TRX_PM_BATCH_MAX];
+	struct osmo_timer_list pm_timer;
+	int pm_retry_cnt;
 	uint16_t band_arfcn;
 	uint8_t tx_power;
 	uint8_t bsic;
@@ -40,21 +104,29 @@ struct trx_instance {
 	struct trx_sched sched;
 	struct trx_ts *ts_list[TRX_TS_COUNT];
 
+	/* Uplink bursts waiting to be sent at the end of a frame */
+	uint8_t tx_ring[TRX_DATA_BATCH_MAX][TRX_DATA_TX_LEN];
+	unsigned int tx_ring_head;
+	unsigned int tx_ring_len;
+
+	/* Arrival time of the bursts being processed, 0 for replay */
+	uint64_t rx_burst_us;
+
+	/* Number of recvmmsg() / sendmmsg() calls per batch size */
+	uint32_t rx_batch_cnt[TRX_DATA_BATCH_MAX + 1];
+	uint32_t tx_batch_cnt[TRX_DATA_BATCH_MAX + 1];
+
+	/* Optional pool of burst decoding threads */
+	struct sched_worker_pool *dec_pool;
+
 	/* Bind L1CTL link */
 	struct l1ctl_link *l1l;
 };
 
-struct trx_ctrl_msg {
-	struct llist_head list;
-	char cmd[128];
-	int retry_cnt;
-	int critical;
-	int cmd_len;
-};
-
 int trx_if_open(struct trx_instance **trx, const char *local_host,
 		const char *remote_host, uint16_t port);
 void trx_if_flush_ctrl(struct trx_instance *trx);
+void trx_if_ctrl_timeout(struct trx_instance *trx, unsigned int timeout_ms);
 void trx_if_close(struct trx_instance *trx);
 
 int trx_if_cmd_poweron(struct trx_instance *trx);
@@ -73,6 +145,10 @@ int trx_if_cmd_setslot(struct trx_instance *trx, uint8_t tn, uint8_t type);
 
 int trx_if_cmd_measure(struct trx_instance *trx,
 	uint16_t arfcn_start, uint16_t arfcn_stop);
+void trx_if_pm_config(struct trx_instance *trx,
+	unsigned int window, unsigned int batch);
 
 int trx_if_tx_burst(struct trx_instance *trx, uint8_t tn, uint32_t fn,
 	uint8_t pwr, const ubit_t *bits);
+int trx_if_flush_bursts(struct trx_instance *trx);
+void trx_if_handle_burst(struct trx_instance *trx, const uint8_t *buf, int len);
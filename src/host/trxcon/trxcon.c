@@ -22,6 +22,7 @@
  */
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -49,6 +50,8 @@
 #include "l1ctl_proto.h"
 #include "scheduler.h"
 #include "sched_trx.h"
+#include "sched_worker.h"
+#include "latency.h"
 
 #define COPYRIGHT \
 	"Copyright (C) 2016-2017 by Vadim Yanitskiy <axilirator@gmail.com>\n" \
@@ -61,6 +64,8 @@ static struct {
 	const char *debug_mask;
 	int daemonize;
 	int quit;
+	int dump_stats;
+	const char *stats_socket;
 
 	/* L1CTL specific */
 	struct l1ctl_link *l1l;
@@ -71,6 +76,14 @@ static struct {
 	const char *trx_ip;
 	uint16_t trx_base_port;
 	uint32_t trx_fn_advance;
+	unsigned int dec_threads;
+	unsigned int pm_window;
+	unsigned int pm_batch;
+	unsigned int ctrl_timeout_ms;
+
+	/* Offline processing of recorded bursts */
+	const char *replay_file;
+	const char *replay_output;
 } app_data;
 
 void *tall_trx_ctx = NULL;
@@ -156,6 +169,14 @@ static void print_help(void)
 	printf("  -p --trx-port     Base port of TRX instance (default 6700)\n");
 	printf("  -f --trx-advance  Scheduler clock advance (default 20)\n");
 	printf("  -s --socket       Listening socket for layer23 (default /tmp/osmocom_l2)\n");
+	printf("  -T --ctrl-timeout CTRL response timeout in ms (default 300, 2000 for POWERON/OFF)\n");
+	printf("  -C --decoder-threads  Decode bursts in N threads (default 0, inline)\n");
+	printf("  -W --pm-window    Power measurement requests in flight (default 4)\n");
+	printf("  -B --pm-batch     ARFCNs per power measurement request, needs\n"
+	       "                    a transceiver supporting ranges (default 1)\n");
+	printf("  -r --replay       Process recorded TRXD bursts from a file, no TRX\n");
+	printf("  -o --replay-output  Write L1CTL messages of replay to a file (default: socket)\n");
+	printf("  -S --stats-socket UNIX socket dumping latency statistics on connect\n");
 	printf("  -D --daemonize    Run as daemon\n");
 }
 
@@ -170,11 +191,18 @@ static void handle_options(int argc, char **argv)
 			{"trx-ip", 1, 0, 'i'},
 			{"trx-port", 1, 0, 'p'},
 			{"trx-advance", 1, 0, 'f'},
+			{"ctrl-timeout", 1, 0, 'T'},
+			{"decoder-threads", 1, 0, 'C'},
+			{"pm-window", 1, 0, 'W'},
+			{"pm-batch", 1, 0, 'B'},
+			{"replay", 1, 0, 'r'},
+			{"replay-output", 1, 0, 'o'},
+			{"stats-socket", 1, 0, 'S'},
 			{"daemonize", 0, 0, 'D'},
 			{0, 0, 0, 0}
 		};
 
-		c = getopt_long(argc, argv, "d:i:p:f:s:Dh",
+		c = getopt_long(argc, argv, "d:i:p:f:s:T:C:W:B:r:o:S:Dh",
 				long_options, &option_index);
 		if (c == -1)
 			break;
@@ -200,6 +228,27 @@ static void handle_options(int argc, char **argv)
 		case 's':
 			app_data.bind_socket = optarg;
 			break;
+		case 'T':
+			app_data.ctrl_timeout_ms = atoi(optarg);
+			break;
+		case 'C':
+			app_data.dec_threads = atoi(optarg);
+			break;
+		case 'W':
+			app_data.pm_window = atoi(optarg);
+			break;
+		case 'B':
+			app_data.pm_batch = atoi(optarg);
+			break;
+		case 'r':
+			app_data.replay_file = optarg;
+			break;
+		case 'o':
+			app_data.replay_output = optarg;
+			break;
+		case 'S':
+			app_data.stats_socket = optarg;
+			break;
 		case 'D':
 			app_data.daemonize = 1;
 			break;
@@ -215,9 +264,18 @@ static void init_defaults(void)
 	app_data.trx_ip = "127.0.0.1";
 	app_data.trx_base_port = 6700;
 	app_data.trx_fn_advance = 20;
+	app_data.dec_threads = 0;
+	app_data.ctrl_timeout_ms = 0;
+	app_data.pm_window = 4;
+	app_data.pm_batch = 1;
+
+	app_data.replay_file = NULL;
+	app_data.replay_output = NULL;
 
 	app_data.debug_mask = NULL;
+	app_data.stats_socket = NULL;
 	app_data.daemonize = 0;
+	app_data.dump_stats = 0;
 	app_data.quit = 0;
 }
 
@@ -231,14 +289,97 @@ static void signal_handler(int signal)
 		break;
 	case SIGABRT:
 	case SIGUSR1:
-	case SIGUSR2:
 		talloc_report_full(tall_trx_ctx, stderr);
 		break;
+	case SIGUSR2:
+		/* Dumped from the main loop */
+		app_data.dump_stats = 1;
+		break;
 	default:
 		break;
 	}
 }
 
+/* Hand all pending L1CTL messages over, as fast as they are taken */
+static void replay_flush_l1ctl(void)
+{
+	struct osmo_wqueue *wq = &app_data.l1l->wq;
+
+	while (!app_data.quit && wq->bfd.fd != -1 && wq->current_length > 0)
+		osmo_select_main(1);
+}
+
+/**
+ * Feeds recorded TRXD bursts through the scheduler, clocked by
+ * their frame numbers instead of real time, as fast as possible.
+ */
+static int replay_run(void)
+{
+	struct trx_instance *trx = app_data.trx;
+	uint8_t buf[TRX_DATA_RX_LEN];
+	unsigned long bursts = 0, frames = 0;
+	struct timespec start, stop;
+	uint32_t fn, last_fn = 0;
+	double elapsed;
+	FILE *f;
+
+	f = fopen(app_data.replay_file, "rb");
+	if (f == NULL) {
+		LOGP(DAPP, LOGL_ERROR, "Could not open '%s'\n",
+			app_data.replay_file);
+		return -EIO;
+	}
+
+	/* Wait for layer23, unless writing to a file */
+	while (!app_data.quit && app_data.l1l->fsm->state != L1CTL_STATE_CONNECTED)
+		osmo_select_main(0);
+
+	/* Start on BCCH/CCCH, layer23 may reconfigure it */
+	sched_trx_configure_ts(trx, 0, GSM_PCHAN_CCCH);
+	trx->sched.clock_virt = 1;
+
+	LOGP(DAPP, LOGL_NOTICE, "Replaying bursts from '%s'\n",
+		app_data.replay_file);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!app_data.quit && fread(buf, sizeof(buf), 1, f) == 1) {
+		fn = (buf[1] << 24) | (buf[2] << 16) | (buf[3] << 8) | buf[4];
+		if (bursts == 0 || fn != last_fn)
+			frames++;
+		last_fn = fn;
+		bursts++;
+
+		trx_if_handle_burst(trx, buf, sizeof(buf));
+
+		/* Let layer23 requests in every now and then */
+		if (bursts % 64 == 0) {
+			/* Don't outrun the decoding threads */
+			sched_worker_pool_sync(trx);
+			osmo_select_main(1);
+		}
+
+		replay_flush_l1ctl();
+	}
+
+	sched_worker_pool_sync(trx);
+	replay_flush_l1ctl();
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	fclose(f);
+
+	elapsed = (stop.tv_sec - start.tv_sec)
+		+ (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+	LOGP(DAPP, LOGL_NOTICE, "Replayed %lu bursts (%lu frames) in %.3f s: "
+		"%.0f bursts/s, %.1fx real time\n", bursts, frames, elapsed,
+		elapsed > 0 ? bursts / elapsed : 0.0,
+		elapsed > 0 ? frames * 4.615e-3 / elapsed : 0.0);
+	lat_stats_dump(stderr);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	int rc = 0;
@@ -268,25 +409,38 @@ int main(int argc, char **argv)
 	trxcon_fsm = osmo_fsm_inst_alloc(&trxcon_fsm_def, tall_trx_ctx,
 		NULL, LOGL_DEBUG, "main");
 
-	/* Init L1CTL server */
-	rc = l1ctl_link_init(&app_data.l1l, app_data.bind_socket);
+	/* Init L1CTL server, or a file sink for replay */
+	if (app_data.replay_file && app_data.replay_output)
+		rc = l1ctl_link_init_file(&app_data.l1l, app_data.replay_output);
+	else
+		rc = l1ctl_link_init(&app_data.l1l, app_data.bind_socket);
 	if (rc)
 		goto exit;
 
-	/* Init transceiver interface */
-	rc = trx_if_open(&app_data.trx, "0.0.0.0", app_data.trx_ip, app_data.trx_base_port);
+	/* Init transceiver interface, there is none for replay */
+	rc = trx_if_open(&app_data.trx, "0.0.0.0",
+		app_data.replay_file ? NULL : app_data.trx_ip,
+		app_data.trx_base_port);
 	if (rc)
 		goto exit;
 
 	/* Bind L1CTL with TRX and vice versa */
 	app_data.l1l->trx = app_data.trx;
 	app_data.trx->l1l = app_data.l1l;
+	trx_if_pm_config(app_data.trx, app_data.pm_window, app_data.pm_batch);
+	trx_if_ctrl_timeout(app_data.trx, app_data.ctrl_timeout_ms);
 
 	/* Init scheduler */
 	rc = sched_trx_init(app_data.trx, app_data.trx_fn_advance);
 	if (rc)
 		goto exit;
 
+	if (app_data.stats_socket) {
+		rc = lat_stats_sock_init(app_data.stats_socket);
+		if (rc)
+			goto exit;
+	}
+
 	LOGP(DAPP, LOGL_NOTICE, "Init complete\n");
 
 	if (app_data.daemonize) {
@@ -297,15 +451,34 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* Threads don't survive daemonizing, so start them here */
+	rc = sched_worker_pool_init(app_data.trx, app_data.dec_threads);
+	if (rc)
+		goto exit;
+
 	/* Initialize pseudo-random generator */
 	srand(time(NULL));
 
-	while (!app_data.quit)
+	if (app_data.replay_file) {
+		rc = replay_run();
+		goto exit;
+	}
+
+	while (!app_data.quit) {
 		osmo_select_main(0);
 
+		if (app_data.dump_stats) {
+			app_data.dump_stats = 0;
+			lat_stats_dump(stderr);
+		}
+	}
+
 exit:
 	/* Close active connections */
+	lat_stats_sock_close();
 	l1ctl_link_shutdown(app_data.l1l);
+	if (app_data.trx)
+		sched_worker_pool_free(app_data.trx);
 	sched_trx_shutdown(app_data.trx);
 	trx_if_close(app_data.trx);
 
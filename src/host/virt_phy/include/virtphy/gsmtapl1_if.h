@@ -6,7 +6,9 @@
 #include <virtphy/l1ctl_sock.h>
 #include <virtphy/virt_l1_model.h>
 
-void gsmtapl1_init(struct l1_model_ms *model);
+void gsmtapl1_init(void);
+void gsmtapl1_ms_dl_update(struct l1_model_ms *ms);
+void gsmtapl1_ms_dl_remove(struct l1_model_ms *ms);
 void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
                                       struct msgb *msg);
 void gsmtapl1_tx_to_virt_um_inst(struct l1_model_ms *ms, uint32_t fn, uint8_t tn, struct msgb *msg);
@@ -30,6 +30,8 @@ void l1ctl_sap_init(struct l1_model_ms *model);
 void l1ctl_sap_exit(struct l1_model_ms *model);
 void prim_pm_init(struct l1_model_ms *model);
 void prim_pm_exit(struct l1_model_ms *model);
+void prim_pm_rx(uint16_t arfcn);
+int16_t prim_pm_get_sig_strength(struct l1_model_ms *model, uint16_t arfcn);
 void l1ctl_sap_tx_to_l23_inst(struct l1_model_ms *model, struct msgb *msg);
 void l1ctl_sap_rx_from_l23_inst_cb(struct l1ctl_sock_client *lsc, struct msgb *msg);
 void l1ctl_sap_rx_from_l23(struct msgb *msg);
@@ -39,6 +41,9 @@ void l1ctl_sap_handler(struct l1_model_ms *ms, struct msgb *msg);
 struct msgb *l1ctl_msgb_alloc(uint8_t msg_type);
 struct msgb *l1ctl_create_l2_msg(int msg_type, uint32_t fn, uint16_t snr,
                                  uint16_t arfcn);
+struct msgb *l1ctl_create_data_ind(struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+                                   uint8_t chan_nr, uint32_t fn, uint8_t snr,
+                                   uint8_t signal_dbm, uint8_t num_biterr, uint8_t fire_crc);
 
 /* receive routines */
 void l1ctl_rx_fbsb_req(struct l1_model_ms *, struct msgb *msg);
@@ -47,6 +47,11 @@ struct l1ctl_sock_inst *l1ctl_sock_init(
  */
 int l1ctl_sock_write_msg(struct l1ctl_sock_client *lsc, struct msgb *msg);
 
+/**
+ * @brief Transmit message to l2 without freeing it, e.g. to send the same msg to several clients.
+ */
+int l1ctl_sock_write_shared_msg(struct l1ctl_sock_client *lsc, const struct msgb *msg);
+
 /**
  * @brief Destroy instance.
  */
@@ -10,6 +10,12 @@
 #define L1S_NUM_NEIGH_CELL	6
 #define A5_KEY_LEN		8
 
+/* Number of per-frame slots of the uplink scheduler, i.e. how far
+ * ahead items can be scheduled without going to the overflow list.
+ * Must be a power of two dividing GSM_HYPERFRAME (26 * 51 * 2048),
+ * so that the slot of a frame number is continuous across the wrap. */
+#define VIRT_L1_SCHED_SLOTS	1024
+
 enum ms_state {
 	MS_STATE_IDLE_SEARCHING = 0,
 	MS_STATE_IDLE_SYNCING,
@@ -48,7 +54,12 @@ struct l1_state_ms {
 	struct gsm_time current_time; /* GSM time used internally for scheduling */
 	struct {
 		uint32_t last_exec_fn;
-		struct llist_head mframe_items;
+		/* tdma items, by frame number modulo VIRT_L1_SCHED_SLOTS */
+		struct llist_head slots[VIRT_L1_SCHED_SLOTS];
+		/* tdma items too far in the future for the slots */
+		struct llist_head overflow;
+		/* unused tdma items, to avoid allocations */
+		struct llist_head free_items;
 	} sched;
 
 	enum ms_state state;
@@ -94,16 +105,19 @@ struct l1_state_ms {
 	struct {
 		uint32_t timeout_us;
 		uint32_t timeout_s;
+		/* msgs received before are not taken into account */
+		struct timeval since;
 		struct {
-			int16_t arfcn_sig_lev_dbm[1024];
 			uint8_t arfcn_sig_lev_red_dbm[1024];
-			struct osmo_timer_list arfcn_sig_lev_timers[1024];
 		} meas;
 	} pm;
 };
 
 struct l1_model_ms {
 	uint32_t nr;
+	/* entries in the downlink dispatch lists, see gsmtapl1_if.c */
+	struct llist_head dl_entry;
+	struct llist_head dl_ded_entry;
 	/* pointer to the L1CTL socket client associated with this specific MS */
 	struct l1ctl_sock_client *lsc;
 	/* pointer to the (shared) GSMTAP/VirtUM socket to talk to BTS(s) */
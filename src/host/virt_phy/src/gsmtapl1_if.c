@@ -40,6 +40,25 @@
 #include <virtphy/logging.h>
 #include <virtphy/virt_l1_sched.h>
 
+/* Camped MSs only need the downlink messages of their serving cell, so
+ * they are kept in lists by the arfcn of that cell. Of the dedicated
+ * channels (SDCCH, TCH) they only need those on their own timeslot, so
+ * for these they are kept in lists by arfcn and timeslot as well. All
+ * other MSs (searching, syncing) get all downlink messages. */
+#define DL_ARFCN_BUCKETS 1024
+#define DL_DED_BUCKETS 1024
+#define DL_DED_BUCKET(arfcn, tn) (((arfcn) * 8 + (tn)) % DL_DED_BUCKETS)
+static struct llist_head dl_camped_ms[DL_ARFCN_BUCKETS];
+static struct llist_head dl_ded_ms[DL_DED_BUCKETS];
+static LLIST_HEAD(dl_other_ms);
+
+/* L1CTL_DATA_IND for the downlink message being dispatched, built once and
+ * written to every MS that takes it with the same rx level */
+struct dl_fanout {
+	struct msgb *msg;
+	uint8_t rx_level;
+};
+
 static char *pseudo_lchan_name(uint16_t arfcn, uint8_t ts, uint8_t ss, uint8_t sub_type)
 {
 	static char lname[64];
@@ -107,14 +126,98 @@ void gsmtapl1_tx_to_virt_um_inst(struct l1_model_ms *ms, uint32_t fn, uint8_t tn
 }
 
 /**
- * @see virt_prim_fbsb.c
+ * Init the downlink dispatch lists.
  */
-extern void prim_fbsb_sync(struct l1_model_ms *ms, struct msgb *msg);
+void gsmtapl1_init(void)
+{
+	int i;
+
+	for (i = 0; i < DL_ARFCN_BUCKETS; i++)
+		INIT_LLIST_HEAD(&dl_camped_ms[i]);
+	for (i = 0; i < DL_DED_BUCKETS; i++)
+		INIT_LLIST_HEAD(&dl_ded_ms[i]);
+}
 
 /**
- * @see virt_prim_pm.c
+ * Put the MS into the downlink dispatch lists matching its state.
+ *
+ * Has to be called whenever the MS starts or stops camping on a cell, and
+ * whenever its dedicated timeslot changes.
  */
-extern uint16_t prim_pm_set_sig_strength(struct l1_model_ms *ms, uint16_t arfcn, int16_t sig_lev);
+void gsmtapl1_ms_dl_update(struct l1_model_ms *ms)
+{
+	uint16_t arfcn = ms->state.serving_cell.arfcn;
+
+	llist_del(&ms->dl_entry);
+	llist_del(&ms->dl_ded_entry);
+	INIT_LLIST_HEAD(&ms->dl_ded_entry);
+
+	switch (ms->state.state) {
+	case MS_STATE_IDLE_CAMPING:
+	case MS_STATE_DEDICATED:
+	case MS_STATE_TBF:
+		llist_add_tail(&ms->dl_entry, &dl_camped_ms[arfcn % DL_ARFCN_BUCKETS]);
+		llist_add_tail(&ms->dl_ded_entry,
+			       &dl_ded_ms[DL_DED_BUCKET(arfcn, ms->state.dedicated.tn)]);
+		break;
+	default:
+		llist_add_tail(&ms->dl_entry, &dl_other_ms);
+		break;
+	}
+}
+
+/**
+ * Remove the MS from the downlink dispatch lists.
+ */
+void gsmtapl1_ms_dl_remove(struct l1_model_ms *ms)
+{
+	llist_del(&ms->dl_entry);
+	INIT_LLIST_HEAD(&ms->dl_entry);
+	llist_del(&ms->dl_ded_entry);
+	INIT_LLIST_HEAD(&ms->dl_ded_entry);
+}
+
+/* whether the channel type is one of the dedicated channels, which a camped
+ * MS only takes on its own timeslot */
+static bool dl_chantype_dedicated(uint8_t gsmtap_chantype)
+{
+	switch (gsmtap_chantype & ~GSMTAP_CHANNEL_ACCH & 0xff) {
+	case GSMTAP_CHANNEL_TCH_H:
+	case GSMTAP_CHANNEL_TCH_F:
+	case GSMTAP_CHANNEL_SDCCH4:
+	case GSMTAP_CHANNEL_SDCCH8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* send the L1CTL_DATA_IND of the message being dispatched to the MS */
+static void dl_tx_data_ind(struct l1_model_ms *ms, struct dl_fanout *fo, struct msgb *msg,
+			   uint16_t arfcn, uint8_t link_id, uint8_t chan_nr, uint32_t fn,
+			   uint8_t snr_db, uint8_t signal_dbm)
+{
+	if (fo->msg && fo->rx_level != signal_dbm) {
+		msgb_free(fo->msg);
+		fo->msg = NULL;
+	}
+
+	if (!fo->msg) {
+		fo->msg = l1ctl_create_data_ind(msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm, 0, 0);
+		/* prepend 16bit length, as l1ctl_sap_tx_to_l23_inst() does */
+		msgb_push_u16(fo->msg, fo->msg->len);
+		fo->rx_level = signal_dbm;
+	}
+
+	LOGPMS(DL1P, LOGL_INFO, ms, "TX L1CTL_DATA_IND (link_id=0x%02x) %s\n", link_id,
+		osmo_hexdump(msgb_data(msg), msgb_length(msg)));
+	l1ctl_sock_write_shared_msg(ms->lsc, fo->msg);
+}
+
+/**
+ * @see virt_prim_fbsb.c
+ */
+extern void prim_fbsb_sync(struct l1_model_ms *ms, struct msgb *msg);
 
 /* determine if a received Downlink RLC/MAC block matches the current MS configuration */
 static bool gprs_dl_block_matches_ms(struct l1_model_ms *ms, struct msgb *msg, uint8_t timeslot)
@@ -187,16 +290,16 @@ static void ms_ul_tbf_may_transmit(struct l1_model_ms *ms, uint16_t arfcn, uint8
 	}
 }
 
-static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg, uint32_t fn,
+static void l1ctl_from_virt_um(struct l1_model_ms *ms, struct dl_fanout *fo, struct msgb *msg,
+				uint32_t fn, const struct gsm_time *gtime,
 				uint16_t arfcn, uint8_t timeslot, uint8_t subslot,
 				uint8_t gsmtap_chantype, uint8_t chan_nr, uint8_t link_id,
 				uint8_t snr_db)
 {
-	struct l1_model_ms *ms = lsc->priv;
-	uint8_t signal_dbm = dbm2rxlev(prim_pm_set_sig_strength(ms, arfcn & GSMTAP_ARFCN_MASK, MAX_SIG_LEV_DBM));	/* Power measurement with each received massage */
+	uint8_t signal_dbm;
 	uint8_t usf;
 
-	gsm_fn2gsmtime(&ms->state.downlink_time, fn);
+	ms->state.downlink_time = *gtime;
 
 	/* we do not forward messages to l23 if we are in network search state */
 	if (ms->state.state == MS_STATE_IDLE_SEARCHING)
@@ -212,6 +315,9 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
 		return;
 	}
 
+	/* Power measurement with each received massage */
+	signal_dbm = dbm2rxlev(prim_pm_get_sig_strength(ms, arfcn & GSMTAP_ARFCN_MASK));
+
 	virt_l1_sched_sync_time(ms, ms->state.downlink_time, 0);
 	virt_l1_sched_execute(ms, fn);
 
@@ -232,7 +338,7 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
 		 * the timeslot and subslot is fitting */
 		if (ms->state.dedicated.tn == timeslot
 		    && ms->state.dedicated.subslot == subslot) {
-			l1ctl_tx_data_ind(ms, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm, 0, 0);
+			dl_tx_data_ind(ms, fo, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm);
 		}
 		break;
 	case GSMTAP_CHANNEL_AGCH:
@@ -242,7 +348,7 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
 	case GSMTAP_CHANNEL_CBCH52:
 		/* save to just forward here, as upper layer ignores messages that
 		 * do not fit the current state (e.g.  gsm48_rr.c:2159) */
-		l1ctl_tx_data_ind(ms, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm, 0, 0);
+		dl_tx_data_ind(ms, fo, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm);
 		break;
 	case GSMTAP_CHANNEL_RACH:
 		LOGPMS(DVIRPHY, LOGL_NOTICE, ms, "Ignoring unexpected RACH in downlink ?!?\n");
@@ -250,7 +356,7 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
 	case GSMTAP_CHANNEL_PACCH:
 	case GSMTAP_CHANNEL_PDCH:
 		if (gprs_dl_block_matches_ms(ms, msg, timeslot))
-			l1ctl_tx_data_ind(ms, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm, 0, 0);
+			dl_tx_data_ind(ms, fo, msg, arfcn, link_id, chan_nr, fn, snr_db, signal_dbm);
 		usf = get_usf_from_block(msg);
 		ms_ul_tbf_may_transmit(ms, arfcn, timeslot, fn, usf);
 		break;
@@ -279,8 +385,8 @@ static void l1ctl_from_virt_um(struct l1ctl_sock_client *lsc, struct msgb *msg,
 void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
 				      struct msgb *msg)
 {
-	struct l1ctl_sock_inst *lsi = vui->priv;
-	struct l1ctl_sock_client *lsc;
+	struct l1_model_ms *ms, *ms_tmp;
+	struct dl_fanout fo = { .msg = NULL };
 
 	if (!msg)
 		return;
@@ -314,12 +420,31 @@ void gsmtapl1_rx_from_virt_um_inst_cb(struct virt_um_inst *vui,
 		goto freemsg;
 	}
 
-	/* dispatch the incoming DL message from GSMTAP to each of the registered L1CTL instances */
-	llist_for_each_entry(lsc, &lsi->clients, list) {
-		l1ctl_from_virt_um(lsc, msg, fn, arfcn, timeslot, subslot, gsmtap_chantype,
-				   chan_nr, link_id, snr);
+	prim_pm_rx(arfcn & GSMTAP_ARFCN_MASK);
+
+	/* dispatch the incoming DL message from GSMTAP to the MSs camping on its arfcn
+	 * (and timeslot, for dedicated channels) first, as MSs that get synced by this
+	 * message join these lists */
+	if (dl_chantype_dedicated(gsmtap_chantype)) {
+		llist_for_each_entry_safe(ms, ms_tmp, &dl_ded_ms[DL_DED_BUCKET(arfcn, timeslot)],
+					  dl_ded_entry) {
+			l1ctl_from_virt_um(ms, &fo, msg, fn, &gtime, arfcn, timeslot, subslot,
+					   gsmtap_chantype, chan_nr, link_id, snr);
+		}
+	} else {
+		llist_for_each_entry_safe(ms, ms_tmp, &dl_camped_ms[arfcn % DL_ARFCN_BUCKETS],
+					  dl_entry) {
+			l1ctl_from_virt_um(ms, &fo, msg, fn, &gtime, arfcn, timeslot, subslot,
+					   gsmtap_chantype, chan_nr, link_id, snr);
+		}
+	}
+	llist_for_each_entry_safe(ms, ms_tmp, &dl_other_ms, dl_entry) {
+		l1ctl_from_virt_um(ms, &fo, msg, fn, &gtime, arfcn, timeslot, subslot,
+				   gsmtap_chantype, chan_nr, link_id, snr);
 	}
 
+	if (fo.msg)
+		msgb_free(fo.msg);
 freemsg:
 	talloc_free(msg);
 }
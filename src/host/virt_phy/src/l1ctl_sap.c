@@ -58,7 +58,7 @@ static void l1_model_tch_mode_set(struct l1_model_ms *ms, uint8_t tch_mode)
  */
 void l1ctl_sap_init(struct l1_model_ms *model)
 {
-	INIT_LLIST_HEAD(&model->state.sched.mframe_items);
+	virt_l1_sched_init(model);
 	INIT_LLIST_HEAD(&model->state.tbf.ul.tx_queue);
 
 	prim_pm_init(model);
@@ -293,6 +293,7 @@ void l1ctl_rx_dm_est_req(struct l1_model_ms *ms, struct msgb *msg)
 	ms->state.dedicated.tn = timeslot;
 	ms->state.dedicated.subslot = subslot;
 	ms->state.state = MS_STATE_DEDICATED;
+	gsmtapl1_ms_dl_update(ms);
 
 	/* TCH config */
 	if (rsl_chantype == RSL_CHAN_Bm_ACCHs || rsl_chantype == RSL_CHAN_Lm_ACCHs) {
@@ -377,6 +378,7 @@ void l1ctl_rx_dm_rel_req(struct l1_model_ms *ms, struct msgb *msg)
 	ms->state.dedicated.subslot = 0;
 	ms->state.tch_mode = GSM48_CMODE_SIGN;
 	ms->state.state = MS_STATE_IDLE_CAMPING;
+	gsmtapl1_ms_dl_update(ms);
 
 	/* TODO: disable ciphering */
 	/* TODO: disable audio recording / playing */
@@ -425,6 +427,7 @@ void l1ctl_rx_reset_req(struct l1_model_ms *ms, struct msgb *msg)
 	case L1CTL_RES_T_FULL:
 		DEBUGPMS(DL1C, ms, "Rx L1CTL_RESET_REQ (type=FULL)\n");
 		ms->state.state = MS_STATE_IDLE_SEARCHING;
+		gsmtapl1_ms_dl_update(ms);
 		virt_l1_sched_stop(ms);
 		l1ctl_tx_reset(ms, L1CTL_RESET_CONF, reset_req->type);
 		break;
@@ -573,6 +576,7 @@ static void l1ctl_rx_tbf_cfg_req(struct l1_model_ms *ms, struct msgb *msg)
 			ms->state.tbf.dl.tfi[i] = cfg_req->usf[i];
 	}
 	ms->state.state = MS_STATE_TBF;
+	gsmtapl1_ms_dl_update(ms);
 
 	l1ctl_tx_tbf_cfg_conf(ms, cfg_req);
 }
@@ -197,7 +197,12 @@ void l1ctl_sock_destroy(struct l1ctl_sock_inst *lsi)
 int l1ctl_sock_write_msg(struct l1ctl_sock_client *lsc, struct msgb *msg)
 {
 	int rc;
-	rc = write(lsc->ofd.fd, msgb_data(msg), msgb_length(msg));
+	rc = l1ctl_sock_write_shared_msg(lsc, msg);
 	msgb_free(msg);
 	return rc;
 }
+
+int l1ctl_sock_write_shared_msg(struct l1ctl_sock_client *lsc, const struct msgb *msg)
+{
+	return write(lsc->ofd.fd, msgb_data(msg), msgb_length(msg));
+}
@@ -21,6 +21,7 @@
 
 #include <virtphy/virt_l1_model.h>
 #include <virtphy/l1ctl_sap.h>
+#include <virtphy/gsmtapl1_if.h>
 #include <virtphy/logging.h>
 #include <talloc.h>
 
@@ -38,6 +39,11 @@ struct l1_model_ms *l1_model_ms_init(void *ctx, struct l1ctl_sock_client *lsc, s
 
 	l1ctl_sap_init(model);
 
+	/* not camped yet, gets all downlink messages */
+	INIT_LLIST_HEAD(&model->dl_entry);
+	INIT_LLIST_HEAD(&model->dl_ded_entry);
+	gsmtapl1_ms_dl_update(model);
+
 	LOGPMS(DMAIN, LOGL_INFO, model, "allocated\n");
 
 	return model;
@@ -46,6 +52,7 @@ struct l1_model_ms *l1_model_ms_init(void *ctx, struct l1ctl_sock_client *lsc, s
 void l1_model_ms_destroy(struct l1_model_ms *model)
 {
 	LOGPMS(DMAIN, LOGL_INFO, model, "destryed\n");
+	gsmtapl1_ms_dl_remove(model);
 	l1ctl_sap_exit(model);
 	talloc_free(model);
 }
@@ -25,12 +25,84 @@
 #include <time.h>
 #include <talloc.h>
 
+#define SLOT(fn) ((fn) & (VIRT_L1_SCHED_SLOTS - 1))
+
+/* distance of fn_b after fn_a, modulo the hyperframe */
+static inline uint32_t fn_dist(uint32_t fn_a, uint32_t fn_b)
+{
+	return (fn_b + GSM_HYPERFRAME - fn_a) % GSM_HYPERFRAME;
+}
+
+/* fn lies behind ref, i.e. it is due when executing ref */
+static inline int fn_due(uint32_t fn, uint32_t ref)
+{
+	return fn_dist(fn, ref) < GSM_HYPERFRAME / 2;
+}
+
+/**
+ * @brief Put a tdma item into the slot of its frame number.
+ *
+ * Items that are already due go to the slot of the last executed
+ * frame, which is checked again by the next execution, items beyond
+ * the slot horizon go to the overflow list.
+ */
+static void sched_insert(struct l1_model_ms *ms, struct virt_l1_sched_tdma_item *ti)
+{
+	struct l1_state_ms *l1s = &ms->state;
+	uint32_t last = l1s->sched.last_exec_fn;
+
+	if (fn_due(ti->fn, last))
+		llist_add_tail(&ti->tdma_item_entry, &l1s->sched.slots[SLOT(last)]);
+	else if (fn_dist(last, ti->fn) >= VIRT_L1_SCHED_SLOTS)
+		llist_add_tail(&ti->tdma_item_entry, &l1s->sched.overflow);
+	else
+		llist_add_tail(&ti->tdma_item_entry, &l1s->sched.slots[SLOT(ti->fn)]);
+}
+
+/**
+ * @brief Execute the items of the slot of fn, all of them if flush is set.
+ */
+static void sched_exec_slot(struct l1_model_ms *ms, uint32_t fn, int flush)
+{
+	struct l1_state_ms *l1s = &ms->state;
+	struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
+
+	llist_for_each_entry_safe(ti_next, ti_tmp, &l1s->sched.slots[SLOT(fn)], tdma_item_entry) {
+		if (!flush && !fn_due(ti_next->fn, fn))
+			continue;
+
+		llist_del(&ti_next->tdma_item_entry);
+		/* exec tdma sched item's handler callback */
+		/* TODO: we do not have a TDMA scheduler currently and execute
+		 * all scheduled tdma items here at once */
+		ti_next->handler_cb(ms, ti_next->fn, ti_next->ts, ti_next->msg);
+		/* return handled tdma sched item to the pool */
+		llist_add(&ti_next->tdma_item_entry, &l1s->sched.free_items);
+	}
+}
+
+/**
+ * @brief Init the slots and the item pool of the scheduler.
+ */
+void virt_l1_sched_init(struct l1_model_ms *ms)
+{
+	struct l1_state_ms *l1s = &ms->state;
+	int i;
+
+	for (i = 0; i < VIRT_L1_SCHED_SLOTS; i++)
+		INIT_LLIST_HEAD(&l1s->sched.slots[i]);
+	INIT_LLIST_HEAD(&l1s->sched.overflow);
+	INIT_LLIST_HEAD(&l1s->sched.free_items);
+}
+
 /**
  * @brief Start scheduler thread based on current gsm time from model
  */
 static int virt_l1_sched_start(struct l1_model_ms *ms, struct gsm_time time)
 {
 	virt_l1_sched_sync_time(ms, time, 1);
+	/* the current frame is the first to be executed */
+	ms->state.sched.last_exec_fn = (time.fn + GSM_HYPERFRAME - 1) % GSM_HYPERFRAME;
 	return 0;
 }
 
@@ -51,62 +123,69 @@ void virt_l1_sched_sync_time(struct l1_model_ms *ms, struct gsm_time time, uint8
 	ms->state.current_time = time;
 }
 
+static void sched_clear_list(struct l1_model_ms *ms, struct llist_head *list)
+{
+	struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
+
+	llist_for_each_entry_safe(ti_next, ti_tmp, list, tdma_item_entry) {
+		talloc_free(ti_next->msg);
+		llist_del(&ti_next->tdma_item_entry);
+		llist_add(&ti_next->tdma_item_entry, &ms->state.sched.free_items);
+	}
+}
+
 /**
- * @brief Stop the scheduler thread and cleanup mframe items queue
+ * @brief Stop the scheduler thread and cleanup the scheduled items
  */
 void virt_l1_sched_stop(struct l1_model_ms *ms)
 {
-	struct virt_l1_sched_mframe_item *mi_next, *mi_tmp;
-
-	/* Empty tdma and mframe sched items lists */
-	llist_for_each_entry_safe(mi_next, mi_tmp, &ms->state.sched.mframe_items, mframe_item_entry) {
-		struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
-
-		llist_for_each_entry_safe(ti_next, ti_tmp, &mi_next->tdma_item_list, tdma_item_entry) {
-			talloc_free(ti_next->msg);
-			llist_del(&ti_next->tdma_item_entry);
-		}
-		llist_del(&mi_next->mframe_item_entry);
-		talloc_free(mi_next);
-	}
+	struct l1_state_ms *l1s = &ms->state;
+	int i;
+
+	/* Empty all slots, the items are kept in the pool */
+	for (i = 0; i < VIRT_L1_SCHED_SLOTS; i++)
+		sched_clear_list(ms, &l1s->sched.slots[i]);
+	sched_clear_list(ms, &l1s->sched.overflow);
 }
 
 /**
- * @brief Handle all pending scheduled items for the current frame number.
+ * @brief Handle all pending scheduled items up to the current frame number.
+ *
+ * The slots of all frames since the last execution are visited, so
+ * frames without a received downlink burst are caught up with.
  */
 void virt_l1_sched_execute(struct l1_model_ms *ms, uint32_t fn)
 {
 	struct l1_state_ms *l1s = &ms->state;
-	struct virt_l1_sched_mframe_item *mi_next, *mi_tmp;
-	uint8_t hyperframe_restart = fn < l1s->sched.last_exec_fn;
-
-	llist_for_each_entry_safe(mi_next, mi_tmp, &l1s->sched.mframe_items, mframe_item_entry) {
-		/* execute all registered handler for current mf sched item */
-		uint8_t exec_now = mi_next->fn <= fn || (hyperframe_restart && mi_next->fn > l1s->sched.last_exec_fn);
-		/* break loop, as we have an ordered list in case the hyperframe had not been reset */
-		uint8_t break_now = mi_next->fn > fn && !hyperframe_restart;
-
-		if (exec_now) {
-			struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
-			/* run through all scheduled tdma sched items for that frame number */
-			llist_for_each_entry_safe(ti_next, ti_tmp, &mi_next->tdma_item_list,
-						  tdma_item_entry) {
-				/* exec tdma sched item's handler callback */
-				/* TODO: we do not have a TDMA scheduler currently and execute
-				 * all scheduled tdma items here at once */
-				ti_next->handler_cb(ms, mi_next->fn, ti_next->ts, ti_next->msg);
-				/* remove handled tdma sched item */
-				llist_del(&ti_next->tdma_item_entry);
-			}
-			/* remove handled mframe sched item */
-			llist_del(&mi_next->mframe_item_entry);
-			talloc_free(mi_next);
-		}
-
-		if (break_now)
-			break;
+	struct virt_l1_sched_tdma_item *ti_next, *ti_tmp;
+	uint32_t last = l1s->sched.last_exec_fn;
+	uint32_t elapsed = fn_dist(last, fn);
+	uint32_t i;
+
+	/* a frame before the last executed one, nothing to do */
+	if (elapsed >= GSM_HYPERFRAME / 2)
+		return;
+
+	if (elapsed >= VIRT_L1_SCHED_SLOTS) {
+		/* we have been away for longer than the horizon */
+		for (i = 1; i <= VIRT_L1_SCHED_SLOTS; i++)
+			sched_exec_slot(ms, last + i, 1);
+	} else {
+		/* the last slot may have got due items in the meantime */
+		for (i = 0; i <= elapsed; i++)
+			sched_exec_slot(ms, (last + i) % GSM_HYPERFRAME, 0);
 	}
+
 	l1s->sched.last_exec_fn = fn;
+
+	/* move items that came within the horizon to their slot */
+	llist_for_each_entry_safe(ti_next, ti_tmp, &l1s->sched.overflow, tdma_item_entry) {
+		if (fn_dist(fn, ti_next->fn) >= VIRT_L1_SCHED_SLOTS
+		    && !fn_due(ti_next->fn, fn))
+			continue;
+		llist_del(&ti_next->tdma_item_entry);
+		sched_insert(ms, ti_next);
+	}
 }
 
 /**
@@ -115,33 +194,22 @@ void virt_l1_sched_execute(struct l1_model_ms *ms, uint32_t fn)
 void virt_l1_sched_schedule(struct l1_model_ms *ms, struct msgb *msg, uint32_t fn, uint8_t ts,
                             virt_l1_sched_cb *handler_cb)
 {
-	struct virt_l1_sched_mframe_item *mi_next = NULL, *mi_tmp = NULL, *mi_fn = NULL;
-	struct virt_l1_sched_tdma_item *ti_new = NULL;
-
-	llist_for_each_entry_safe(mi_next, mi_tmp, &ms->state.sched.mframe_items, mframe_item_entry) {
-		if (mi_next->fn == fn) {
-			mi_fn = mi_next;
-			break;
-		} else if (mi_next->fn > fn)
-			break;
-	}
-	if (!mi_fn) {
-		/* list did not contain mframe item with needed fn */
-		mi_fn = talloc_zero(ms, struct virt_l1_sched_mframe_item);
-		mi_fn->fn = fn;
-		/* need to manually init the struct content.... no so happy */
-		mi_fn->tdma_item_list.prev = &mi_fn->tdma_item_list;
-		mi_fn->tdma_item_list.next = &mi_fn->tdma_item_list;
-
-		/* TODO: check if we get an error if list is empty... */
-		llist_add(&mi_fn->mframe_item_entry, mi_next->mframe_item_entry.prev);
+	struct l1_state_ms *l1s = &ms->state;
+	struct virt_l1_sched_tdma_item *ti_new;
+
+	if (!llist_empty(&l1s->sched.free_items)) {
+		ti_new = llist_entry(l1s->sched.free_items.next,
+				     struct virt_l1_sched_tdma_item, tdma_item_entry);
+		llist_del(&ti_new->tdma_item_entry);
+	} else {
+		/* grow the pool, items are released along with the ms */
+		ti_new = talloc_zero(ms, struct virt_l1_sched_tdma_item);
 	}
 
-	ti_new = talloc_zero(mi_fn, struct virt_l1_sched_tdma_item);
 	ti_new->msg = msg;
 	ti_new->handler_cb = handler_cb;
+	ti_new->fn = fn % GSM_HYPERFRAME;
 	ti_new->ts = ts;
 	/* simply add at end, no ordering for tdma sched items currently */
-	llist_add_tail(&ti_new->tdma_item_entry, &mi_fn->tdma_item_list);
-	/* TODO: ordered insert needed if tdma scheduler should be implemented */
+	sched_insert(ms, ti_new);
 }
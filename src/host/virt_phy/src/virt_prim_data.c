@@ -79,9 +79,12 @@ void l1ctl_rx_data_req(struct l1_model_ms *ms, struct msgb *msg)
 	virt_l1_sched_schedule(ms, msg, fn_sched, timeslot, &virt_l1_sched_handler_cb);
 }
 
-void l1ctl_tx_data_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
-                       uint8_t chan_nr, uint32_t fn, uint8_t snr,
-                       uint8_t signal_dbm, uint8_t num_biterr, uint8_t fire_crc)
+/**
+ * @brief Build a L1CTL_DATA_IND carrying the given downlink msg.
+ */
+struct msgb *l1ctl_create_data_ind(struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+                                   uint8_t chan_nr, uint32_t fn, uint8_t snr,
+                                   uint8_t signal_dbm, uint8_t num_biterr, uint8_t fire_crc)
 {
 	struct msgb *l1ctl_msg = NULL;
 	struct l1ctl_data_ind * l1di;
@@ -105,6 +108,16 @@ void l1ctl_tx_data_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn,
 
 	memcpy(l1di->data, msgb_data(msg), msgb_length(msg));
 
+	return l1ctl_msg;
+}
+
+void l1ctl_tx_data_ind(struct l1_model_ms *ms, struct msgb *msg, uint16_t arfcn, uint8_t link_id,
+                       uint8_t chan_nr, uint32_t fn, uint8_t snr,
+                       uint8_t signal_dbm, uint8_t num_biterr, uint8_t fire_crc)
+{
+	struct msgb *l1ctl_msg = l1ctl_create_data_ind(msg, arfcn, link_id, chan_nr, fn, snr,
+	                                               signal_dbm, num_biterr, fire_crc);
+
 	LOGPMS(DL1P, LOGL_INFO, ms, "TX L1CTL_DATA_IND (link_id=0x%02x) %s\n", link_id,
 		 osmo_hexdump(msgb_data(msg), msgb_length(msg)));
 	l1ctl_sap_tx_to_l23_inst(ms, l1ctl_msg);
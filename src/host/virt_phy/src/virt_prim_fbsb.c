@@ -31,6 +31,7 @@
 #include <osmocom/core/msgb.h>
 #include <virtphy/l1ctl_sap.h>
 #include <virtphy/virt_l1_sched.h>
+#include <virtphy/gsmtapl1_if.h>
 #include <osmocom/core/gsmtap.h>
 #include <virtphy/logging.h>
 #include <l1ctl_proto.h>
@@ -62,6 +63,7 @@ void l1ctl_rx_fbsb_req(struct l1_model_ms *ms, struct msgb *msg)
 
 	l1s->state = MS_STATE_IDLE_SYNCING;
 	l1s->fbsb.arfcn = ntohs(sync_req->band_arfcn);
+	gsmtapl1_ms_dl_update(ms);
 }
 
 /**
@@ -83,12 +85,14 @@ void prim_fbsb_sync(struct l1_model_ms *ms, struct msgb *msg)
 		if (sync_count++ > 20) {
 			sync_count = 0;
 			l1s->state = MS_STATE_IDLE_SEARCHING;
+			gsmtapl1_ms_dl_update(ms);
 			l1ctl_tx_fbsb_conf(ms, 1, (l1s->fbsb.arfcn));
 		}
 		return;
 	}
 	l1s->serving_cell.arfcn = arfcn;
 	l1s->state = MS_STATE_IDLE_CAMPING;
+	gsmtapl1_ms_dl_update(ms);
 	/* Not needed in virtual phy */
 	l1s->serving_cell.fn_offset = 0;
 	l1s->serving_cell.time_alignment = 0;
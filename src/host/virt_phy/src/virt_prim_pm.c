@@ -29,41 +29,60 @@
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/timer.h>
 #include <virtphy/l1ctl_sap.h>
 #include <virtphy/virt_l1_sched.h>
 #include <osmocom/core/gsmtap.h>
 #include <virtphy/logging.h>
 #include <l1ctl_proto.h>
 
+/* Time of the last received msg per arfcn. The virtual um is the same
+ * for all MS, so this is kept once and the signal level of a MS is only
+ * calculated when it is needed, instead of updating each MS per msg. */
+static struct timeval arfcn_last_rx[1024];
+
 /**
- * @brief Change the signal strength for a given arfcn.
+ * @brief Note that a msg has been received on the virtual layer for the given arfcn.
  *
- * Should be called if a msg is received on the virtual layer. The configured signal level reduction is applied.
+ * @param [in] arfcn the msg has been received on.
+ */
+void prim_pm_rx(uint16_t arfcn)
+{
+	osmo_gettimeofday(&arfcn_last_rx[arfcn], NULL);
+}
+
+/**
+ * @brief Get the signal strength of a given arfcn.
+ *
+ * A msg must have been received on the arfcn after the MS was set up
+ * and, if a timeout is configured, within that timeout. The configured
+ * signal level reduction is applied.
  *
- * @param [in] arfcn to change sig str for.
- * @param [in] sig_lev the measured signal level value.
+ * @param [in] arfcn to get sig str for.
+ * @return the signal level in dBm.
  */
-uint16_t prim_pm_set_sig_strength(struct l1_model_ms *ms, uint16_t arfcn, int16_t sig_lev)
+int16_t prim_pm_get_sig_strength(struct l1_model_ms *ms, uint16_t arfcn)
 {
 	struct l1_state_ms *l1s = &ms->state;
+	struct timeval *last = &arfcn_last_rx[arfcn];
+	struct timeval now, timeout, expire;
 
+	/* nothing received since the MS is there */
+	if (timercmp(last, &l1s->pm.since, <))
+		return MIN_SIG_LEV_DBM;
+
+	/* reset the signal level to bad value if no messages have been
+	 * received from that arfcn for a given time */
 	if (l1s->pm.timeout_s > 0 || l1s->pm.timeout_us > 0) {
-		osmo_timer_schedule(&l1s->pm.meas.arfcn_sig_lev_timers[arfcn],
-				    l1s->pm.timeout_s, l1s->pm.timeout_us);
+		timeout.tv_sec = l1s->pm.timeout_s + l1s->pm.timeout_us / 1000000;
+		timeout.tv_usec = l1s->pm.timeout_us % 1000000;
+		timeradd(last, &timeout, &expire);
+		osmo_gettimeofday(&now, NULL);
+		if (timercmp(&now, &expire, >))
+			return MIN_SIG_LEV_DBM;
 	}
-	l1s->pm.meas.arfcn_sig_lev_dbm[arfcn] = sig_lev - l1s->pm.meas.arfcn_sig_lev_red_dbm[arfcn];
-	DEBUGPMS(DL1C, ms, "Power measurement set for arfcn %u. Set signal level to %d (== rxlev: %u).\n",
-		arfcn, l1s->pm.meas.arfcn_sig_lev_dbm[arfcn],
-		dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn]));
-	return l1s->pm.meas.arfcn_sig_lev_dbm[arfcn];
-}
 
-void prim_pm_timer_cb(void *data)
-{
-	/* reset the signal level to bad value if no messages have been
-	 * received from that rfcn for a given time */
-	DEBUGP(DL1C, "Timeout occurred for arfcn, signal level reset to worst value.\n");
-	*((int16_t*)data) = MIN_SIG_LEV_DBM;
+	return MAX_SIG_LEV_DBM - l1s->pm.meas.arfcn_sig_lev_red_dbm[arfcn];
 }
 
 /**
@@ -81,7 +100,6 @@ void prim_pm_timer_cb(void *data)
  */
 void l1ctl_rx_pm_req(struct l1_model_ms *ms, struct msgb *msg)
 {
-	struct l1_state_ms *l1s = &ms->state;
 	struct l1ctl_hdr *l1h = (struct l1ctl_hdr *) msg->data;
 	struct l1ctl_pm_req *pm_req = (struct l1ctl_pm_req *) l1h->data;
 	struct msgb *resp_msg = l1ctl_msgb_alloc(L1CTL_PM_CONF);
@@ -100,8 +118,8 @@ void l1ctl_rx_pm_req(struct l1_model_ms *ms, struct msgb *msg)
 		pm_conf->band_arfcn = htons(arfcn_next);
 		/* set min and max to the value calculated for that
 		 * arfcn (IGNORE UPLINKK AND  PCS AND OTHER FLAGS) */
-		pm_conf->pm[0] = dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn_next & ARFCN_NO_FLAGS_MASK]);
-		pm_conf->pm[1] = dbm2rxlev(l1s->pm.meas.arfcn_sig_lev_dbm[arfcn_next & ARFCN_NO_FLAGS_MASK]);
+		pm_conf->pm[0] = dbm2rxlev(prim_pm_get_sig_strength(ms, arfcn_next & ARFCN_NO_FLAGS_MASK));
+		pm_conf->pm[1] = pm_conf->pm[0];
 		if (arfcn_next == pm_req->range.band_arfcn_to) {
 			struct l1ctl_hdr *resp_l1h = msgb_l1(resp_msg);
 			resp_l1h->flags |= L1CTL_F_DONE;
@@ -128,22 +146,11 @@ void l1ctl_rx_pm_req(struct l1_model_ms *ms, struct msgb *msg)
 void prim_pm_init(struct l1_model_ms *model)
 {
 	struct l1_state_ms *l1s = &model->state;
-	int i;
-
-	/* init the signal level of all arfcns with the lowest value possible */
-	memset(l1s->pm.meas.arfcn_sig_lev_dbm, MIN_SIG_LEV_DBM, sizeof (int16_t) * 1024);
-	/* init timers */
-	for (i = 0; i < 1024; ++i) {
-		l1s->pm.meas.arfcn_sig_lev_timers[i].cb = prim_pm_timer_cb;
-		l1s->pm.meas.arfcn_sig_lev_timers[i].data = &l1s->pm.meas.arfcn_sig_lev_dbm[i];
-	}
+
+	/* arfcns only count as received from now on */
+	osmo_gettimeofday(&l1s->pm.since, NULL);
 }
 
 void prim_pm_exit(struct l1_model_ms *model)
 {
-	struct l1_state_ms *l1s = &model->state;
-	int i;
-
-	for (i = 0; i < 1024; ++i)
-		osmo_timer_del(&l1s->pm.meas.arfcn_sig_lev_timers[i]);
 }
@@ -206,6 +206,8 @@ int main(int argc, char *argv[])
 
 	LOGP(DVIRPHY, LOGL_INFO, "Virtual physical layer starting up...\n");
 
+	gsmtapl1_init();
+
 	g_vphy.virt_um = virt_um_init(tall_vphy_ctx, ul_tx_grp, port, dl_rx_grp, port,
 					gsmtapl1_rx_from_virt_um_inst_cb);
 
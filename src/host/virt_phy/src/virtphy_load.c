@@ -0,0 +1,395 @@
+/* Load generator for virtphy: a virtual BTS and any number of L1CTL clients
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* The tool connects N clients to the L1CTL socket of a running virtphy,
+ * lets all of them sync to one ARFCN and then transmits BCCH blocks on
+ * the downlink multicast group, as a virtual BTS would do. Every block
+ * carries its transmit time, so the time until each client receives the
+ * corresponding L1CTL_DATA_IND is measured. */
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <l1ctl_proto.h>
+#include <virtphy/virtual_um.h>
+#include <virtphy/l1ctl_sock.h>
+
+#define LOAD_RX_BUF_LEN		1024
+#define LOAD_TICK_US		10000
+
+struct load_ms {
+	struct osmo_fd ofd;
+	unsigned int nr;
+	int synced;
+	uint8_t rx_buf[LOAD_RX_BUF_LEN];
+	unsigned int rx_len;
+};
+
+/* counters of one reporting interval */
+struct load_stats {
+	unsigned long dl_sent;
+	unsigned long data_ind;
+	uint64_t lat_sum_us;
+	uint64_t lat_max_us;
+};
+
+static char *dl_tx_grp = DEFAULT_MS_MCAST_GROUP;
+static char *ul_rx_grp = DEFAULT_BTS_MCAST_GROUP;
+static int port = GSMTAP_UDP_PORT;
+static char *l1ctl_sock_path = L1CTL_SOCK_PATH;
+static unsigned int num_ms = 100;
+static uint16_t arfcn = 1;
+static unsigned int rate = 1000;
+static unsigned int duration = 10;
+
+static struct virt_um_inst *vui;
+static struct load_ms *ms_list;
+static unsigned int num_synced;
+static struct load_stats stats, total;
+static struct osmo_timer_list tick_timer;
+static unsigned int ticks;
+static uint32_t next_fn;
+static double tx_credit;
+static int quit;
+
+static uint64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void print_help(void)
+{
+	printf(" -s --l1ctl-sock PATH    L1CTL socket of virtphy (default %s)\n", L1CTL_SOCK_PATH);
+	printf(" -n --num-ms N           Number of virtual MSs (default %u)\n", num_ms);
+	printf(" -a --arfcn ARFCN        ARFCN of the virtual BTS (default %u)\n", arfcn);
+	printf(" -r --rate N             Downlink blocks per second (default %u)\n", rate);
+	printf(" -t --duration SECONDS   Duration of the test (default %u)\n", duration);
+	printf(" -z --dl-tx-grp GROUP    Downlink multicast group (default %s)\n", DEFAULT_MS_MCAST_GROUP);
+	printf(" -y --ul-rx-grp GROUP    Uplink multicast group (default %s)\n", DEFAULT_BTS_MCAST_GROUP);
+	printf(" -x --port PORT          GSMTAP port (default %u)\n", GSMTAP_UDP_PORT);
+}
+
+static void handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"l1ctl-sock", required_argument, 0, 's'},
+			{"num-ms", required_argument, 0, 'n'},
+			{"arfcn", required_argument, 0, 'a'},
+			{"rate", required_argument, 0, 'r'},
+			{"duration", required_argument, 0, 't'},
+			{"dl-tx-grp", required_argument, 0, 'z'},
+			{"ul-rx-grp", required_argument, 0, 'y'},
+			{"port", required_argument, 0, 'x'},
+			{0, 0, 0, 0},
+		};
+		c = getopt_long(argc, argv, "hs:n:a:r:t:z:y:x:", long_options,
+		                &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+		case 's':
+			l1ctl_sock_path = optarg;
+			break;
+		case 'n':
+			num_ms = atoi(optarg);
+			break;
+		case 'a':
+			arfcn = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		case 'z':
+			dl_tx_grp = optarg;
+			break;
+		case 'y':
+			ul_rx_grp = optarg;
+			break;
+		case 'x':
+			port = atoi(optarg);
+			break;
+		default:
+			exit(1);
+		}
+	}
+}
+
+static int ms_send(struct load_ms *ms, uint8_t msg_type, const void *data, uint16_t len)
+{
+	uint8_t buf[2 + sizeof(struct l1ctl_hdr) + 32];
+	struct l1ctl_hdr *l1h = (struct l1ctl_hdr *) (buf + 2);
+	uint16_t total_len = sizeof(*l1h) + len;
+
+	buf[0] = total_len >> 8;
+	buf[1] = total_len & 0xff;
+	memset(l1h, 0, sizeof(*l1h));
+	l1h->msg_type = msg_type;
+	memcpy(l1h->data, data, len);
+
+	if (write(ms->ofd.fd, buf, 2 + total_len) != 2 + total_len)
+		return -EIO;
+
+	return 0;
+}
+
+static void ms_rx_msg(struct load_ms *ms, const uint8_t *data, uint16_t len)
+{
+	const struct l1ctl_hdr *l1h = (const struct l1ctl_hdr *) data;
+	const struct l1ctl_info_dl *dl = (const struct l1ctl_info_dl *) l1h->data;
+	const struct l1ctl_fbsb_conf *fbsb;
+	const struct l1ctl_data_ind *di;
+	uint64_t sent_us, lat_us;
+
+	if (len < sizeof(*l1h) + sizeof(*dl))
+		return;
+
+	switch (l1h->msg_type) {
+	case L1CTL_FBSB_CONF:
+		fbsb = (const struct l1ctl_fbsb_conf *) dl->payload;
+		if (fbsb->result == 0 && !ms->synced) {
+			ms->synced = 1;
+			num_synced++;
+		}
+		break;
+	case L1CTL_DATA_IND:
+		if (len < sizeof(*l1h) + sizeof(*dl) + sizeof(*di))
+			return;
+		di = (const struct l1ctl_data_ind *) dl->payload;
+		memcpy(&sent_us, di->data, sizeof(sent_us));
+		lat_us = now_us() - sent_us;
+		stats.data_ind++;
+		stats.lat_sum_us += lat_us;
+		if (lat_us > stats.lat_max_us)
+			stats.lat_max_us = lat_us;
+		break;
+	default:
+		break;
+	}
+}
+
+static int ms_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct load_ms *ms = ofd->data;
+	unsigned int off = 0;
+	uint16_t len;
+	int rc;
+
+	rc = read(ofd->fd, ms->rx_buf + ms->rx_len, sizeof(ms->rx_buf) - ms->rx_len);
+	if (rc <= 0) {
+		fprintf(stderr, "MS %u: L1CTL connection lost\n", ms->nr);
+		osmo_fd_unregister(ofd);
+		close(ofd->fd);
+		ofd->fd = -1;
+		return 0;
+	}
+	ms->rx_len += rc;
+
+	/* handle all complete messages */
+	while (ms->rx_len - off >= 2) {
+		len = (ms->rx_buf[off] << 8) | ms->rx_buf[off + 1];
+		if (len > LOAD_RX_BUF_LEN - 2) {
+			fprintf(stderr, "MS %u: invalid L1CTL length %u\n", ms->nr, len);
+			exit(1);
+		}
+		if (ms->rx_len - off < 2 + len)
+			break;
+		ms_rx_msg(ms, ms->rx_buf + off + 2, len);
+		off += 2 + len;
+	}
+
+	ms->rx_len -= off;
+	if (off > 0 && ms->rx_len > 0)
+		memmove(ms->rx_buf, ms->rx_buf + off, ms->rx_len);
+
+	return 0;
+}
+
+static int ms_connect(struct load_ms *ms)
+{
+	struct l1ctl_fbsb_req req;
+	struct sockaddr_un local;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -errno;
+
+	local.sun_family = AF_UNIX;
+	strncpy(local.sun_path, l1ctl_sock_path, sizeof(local.sun_path));
+	local.sun_path[sizeof(local.sun_path) - 1] = '\0';
+
+	if (connect(fd, (struct sockaddr *) &local, sizeof(local)) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	ms->ofd.fd = fd;
+	ms->ofd.when = BSC_FD_READ;
+	ms->ofd.cb = ms_read_cb;
+	ms->ofd.data = ms;
+	if (osmo_fd_register(&ms->ofd) != 0) {
+		close(fd);
+		return -EIO;
+	}
+
+	/* sync to the ARFCN of our virtual BTS */
+	memset(&req, 0, sizeof(req));
+	req.band_arfcn = htons(arfcn);
+	req.flags = L1CTL_FBSB_F_FB01SB;
+
+	return ms_send(ms, L1CTL_FBSB_REQ, &req, sizeof(req));
+}
+
+/* transmit one BCCH block carrying the current time on the virtual Um */
+static void bts_tx_block(void)
+{
+	uint8_t data[GSM_MACBLOCK_LEN];
+	uint64_t t = now_us();
+	struct msgb *msg;
+
+	memset(data, GSM_MACBLOCK_PADDING, sizeof(data));
+	memcpy(data, &t, sizeof(t));
+
+	msg = gsmtap_makemsg(arfcn, 0, GSMTAP_CHANNEL_BCCH, 0, next_fn, -60, 40,
+			     data, sizeof(data));
+	if (!msg)
+		return;
+
+	next_fn = (next_fn + 1) % GSM_HYPERFRAME;
+	if (virt_um_write_msg(vui, msg) > 0)
+		stats.dl_sent++;
+}
+
+static void report(void)
+{
+	printf("%4us: %4u/%u synced, %7lu blocks/s, %8lu DATA_IND/s, "
+	       "latency avg %6.0f us max %6.0f us\n",
+	       ticks * LOAD_TICK_US / 1000000, num_synced, num_ms,
+	       stats.dl_sent, stats.data_ind,
+	       stats.data_ind ? (double) stats.lat_sum_us / stats.data_ind : 0.0,
+	       (double) stats.lat_max_us);
+
+	total.dl_sent += stats.dl_sent;
+	total.data_ind += stats.data_ind;
+	total.lat_sum_us += stats.lat_sum_us;
+	if (stats.lat_max_us > total.lat_max_us)
+		total.lat_max_us = stats.lat_max_us;
+	memset(&stats, 0, sizeof(stats));
+}
+
+static void tick_cb(void *data)
+{
+	ticks++;
+
+	/* send the blocks of this tick, keeping the fraction for the next */
+	tx_credit += (double) rate * LOAD_TICK_US / 1000000;
+	while (tx_credit >= 1.0) {
+		bts_tx_block();
+		tx_credit -= 1.0;
+	}
+
+	if (ticks % (1000000 / LOAD_TICK_US) == 0) {
+		report();
+		if (ticks * LOAD_TICK_US / 1000000 >= duration) {
+			quit = 1;
+			return;
+		}
+	}
+
+	osmo_timer_schedule(&tick_timer, 0, LOAD_TICK_US);
+}
+
+/* the virtual BTS does not care about uplink */
+static void bts_rx_cb(struct virt_um_inst *vui, struct msgb *msg)
+{
+	if (msg)
+		msgb_free(msg);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 1, "virtphy_load");
+	unsigned int i;
+	int rc;
+
+	handle_options(argc, argv);
+
+	vui = virt_um_init(ctx, dl_tx_grp, port, ul_rx_grp, port, bts_rx_cb);
+	if (!vui || !vui->mcast_sock) {
+		fprintf(stderr, "Failed to set up the virtual Um\n");
+		return EXIT_FAILURE;
+	}
+
+	ms_list = talloc_zero_array(ctx, struct load_ms, num_ms);
+	for (i = 0; i < num_ms; i++) {
+		ms_list[i].nr = i;
+		rc = ms_connect(&ms_list[i]);
+		if (rc < 0) {
+			fprintf(stderr, "MS %u: failed to connect to '%s': %s\n",
+				i, l1ctl_sock_path, strerror(-rc));
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%u MSs connected to %s, %u blocks/s on ARFCN %u\n",
+	       num_ms, l1ctl_sock_path, rate, arfcn);
+
+	tick_timer.cb = tick_cb;
+	osmo_timer_schedule(&tick_timer, 0, LOAD_TICK_US);
+
+	while (!quit)
+		osmo_select_main(0);
+
+	printf("total: %lu blocks, %lu DATA_IND (%.1f per block), "
+	       "latency avg %.0f us max %.0f us\n",
+	       total.dl_sent, total.data_ind,
+	       total.dl_sent ? (double) total.data_ind / total.dl_sent : 0.0,
+	       total.data_ind ? (double) total.lat_sum_us / total.data_ind : 0.0,
+	       (double) total.lat_max_us);
+
+	return EXIT_SUCCESS;
+}
@@ -55,6 +55,7 @@ enum bit_value bitvec_get_bit_pos(const struct bitvec *bv, unsigned int bitnr);
 enum bit_value bitvec_get_bit_pos_high(const struct bitvec *bv,
 					unsigned int bitnr);
 unsigned int bitvec_get_nth_set_bit(const struct bitvec *bv, unsigned int n);
+unsigned int bitvec_popcount(const struct bitvec *bv);
 int bitvec_set_bit_pos(struct bitvec *bv, unsigned int bitnum,
 			enum bit_value bit);
 int bitvec_set_bit(struct bitvec *bv, enum bit_value bit);
@@ -106,6 +106,8 @@ int  osmo_conv_encode(const struct osmo_conv_code *code,
 
 	/* Low level API */
 
+struct osmo_conv_acc;
+
 /*! \brief convolutional decoder state */
 struct osmo_conv_decoder {
 	const struct osmo_conv_code *code; /*!< \brief for which code? */
@@ -120,6 +122,8 @@ struct osmo_conv_decoder {
 	unsigned int *ae;	/*!< \brief accumulated error */
 	unsigned int *ae_next;	/*!< \brief next accumulated error (tmp in scan) */
 	uint8_t *state_history;	/*!< \brief state history [len][n_states] */
+
+	struct osmo_conv_acc *acc; /*!< \brief accelerated ACS state (or NULL) */
 };
 
 void osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
@@ -136,6 +140,27 @@ int osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 int osmo_conv_decode_get_output(struct osmo_conv_decoder *decoder,
                                 ubit_t *output, int has_flush, int end_state);
 
+	/* Add-compare-select acceleration */
+
+/*! \brief Viterbi add-compare-select implementations
+ *
+ *  Codes whose trellis has the usual shift register butterfly structure
+ *  (next states of \a s being \a 2s and \a 2s+1, in any order) are
+ *  decoded by one of the accelerated kernels. All of them are bit-exact
+ *  with the generic trellis scan.
+ */
+enum osmo_conv_acc_type {
+	OSMO_CONV_ACC_AUTO = 0,	/*!< \brief Fastest one supported by the CPU */
+	OSMO_CONV_ACC_NONE,	/*!< \brief Generic trellis scan only */
+	OSMO_CONV_ACC_SCALAR,	/*!< \brief Portable butterfly kernels */
+	OSMO_CONV_ACC_SSE2,	/*!< \brief x86 SSE2 kernels */
+	OSMO_CONV_ACC_AVX2,	/*!< \brief x86 AVX2 kernels */
+	OSMO_CONV_ACC_NEON,	/*!< \brief ARM NEON kernels */
+};
+
+int osmo_conv_acc_set(enum osmo_conv_acc_type type);
+enum osmo_conv_acc_type osmo_conv_acc_get(void);
+
 	/* All-in-one */
 int osmo_conv_decode(const struct osmo_conv_code *code,
                      const sbit_t *input, ubit_t *output);
@@ -36,12 +36,23 @@
 #include <osmocom/core/bits.h>
 
 
+/*! \brief Number of bytes processed per table-driven step */
+#define OSMO_CRCXXGEN_SLICES	(XX / 8)
+
+/*! \brief lookup tables for byte-wise CRC computation of max XX bits */
+struct osmo_crcXXgen_table {
+	/*! \brief CRC of a byte followed by i zero bytes, left aligned */
+	uintXX_t t[OSMO_CRCXXGEN_SLICES][256];
+};
+
 /*! \brief structure describing a given CRC code of max XX bits */
 struct osmo_crcXXgen_code {
 	int bits;           /*!< \brief Actual number of bits of the CRC */
 	uintXX_t poly;      /*!< \brief Polynom (normal representation, MSB omitted */
 	uintXX_t init;      /*!< \brief Initialization value of the CRC state */
 	uintXX_t remainder; /*!< \brief Remainder of the CRC (final XOR) */
+	/*! \brief Tables from \ref osmo_crcXXgen_table_init, NULL for bitwise */
+	const struct osmo_crcXXgen_table *table;
 };
 
 uintXX_t osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
@@ -51,6 +62,11 @@ int osmo_crcXXgen_check_bits(const struct osmo_crcXXgen_code *code,
 void osmo_crcXXgen_set_bits(const struct osmo_crcXXgen_code *code,
                             const ubit_t *in, int len, ubit_t *crc_bits);
 
+void osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *table,
+                              const struct osmo_crcXXgen_code *code);
+uintXX_t osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_code *code,
+                                     const pbit_t *in, int len);
+
 
 /*! @} */
 
@@ -20,8 +20,16 @@
 #define DEBUG
 
 #ifdef DEBUG
-#define DEBUGP(ss, fmt, args...) logp(ss, __FILE__, __LINE__, 0, fmt, ## args)
-#define DEBUGPC(ss, fmt, args...) logp(ss, __FILE__, __LINE__, 1, fmt, ## args)
+#define DEBUGP(ss, fmt, args...) \
+	do { \
+		if (log_check_level(ss, LOGL_DEBUG)) \
+			logp(ss, __FILE__, __LINE__, 0, fmt, ## args); \
+	} while (0)
+#define DEBUGPC(ss, fmt, args...) \
+	do { \
+		if (log_check_level(ss, LOGL_DEBUG)) \
+			logp(ss, __FILE__, __LINE__, 1, fmt, ## args); \
+	} while (0)
 #else
 #define DEBUGP(xss, fmt, args...)
 #define DEBUGPC(ss, fmt, args...)
@@ -38,9 +46,15 @@ void logp(int subsys, const char *file, int line, int cont, const char *format,
  *  \param[in] level logging level (e.g. \ref LOGL_NOTICE)
  *  \param[in] fmt format string
  *  \param[in] args variable argument list
+ *
+ * The arguments are only evaluated if \ref log_check_level says that
+ * at least one target might output the message.
  */
 #define LOGP(ss, level, fmt, args...) \
-	logp2(ss, level, __FILE__, __LINE__, 0, fmt, ##args)
+	do { \
+		if (log_check_level(ss, level)) \
+			logp2(ss, level, __FILE__, __LINE__, 0, fmt, ##args); \
+	} while (0)
 
 /*! \brief Continue a log message through the Osmocom logging framework
  *  \param[in] ss logging subsystem (e.g. \ref DLGLOBAL)
@@ -49,7 +63,10 @@ void logp(int subsys, const char *file, int line, int cont, const char *format,
  *  \param[in] args variable argument list
  */
 #define LOGPC(ss, level, fmt, args...) \
-	logp2(ss, level, __FILE__, __LINE__, 1, fmt, ##args)
+	do { \
+		if (log_check_level(ss, level)) \
+			logp2(ss, level, __FILE__, __LINE__, 1, fmt, ##args); \
+	} while (0)
 
 /*! \brief different log levels */
 #define LOGL_DEBUG	1	/*!< \brief debugging information */
@@ -114,8 +131,11 @@ enum log_target_type {
 	LOG_TGT_TYPE_SYSLOG,	/*!< \brief syslog based logging */
 	LOG_TGT_TYPE_FILE,	/*!< \brief text file logging */
 	LOG_TGT_TYPE_STDERR,	/*!< \brief stderr logging */
+	LOG_TGT_TYPE_BINARY,	/*!< \brief binary record logging */
 };
 
+struct log_binary_ring;
+
 /*! \brief structure representing a logging target */
 struct log_target {
         struct llist_head entry;		/*!< \brief linked list */
@@ -154,6 +174,11 @@ struct log_target {
 		struct {
 			void *vty;
 		} tgt_vty;
+
+		struct {
+			const char *fname;
+			struct log_binary_ring *ring;
+		} tgt_binary;
 	};
 
 	/*! \brief call-back function to be called when the logging framework
@@ -164,6 +189,21 @@ struct log_target {
 	 */
         void (*output) (struct log_target *target, unsigned int level,
 			const char *string);
+
+	/*! \brief optional call-back function replacing the formatting
+	 *	   in the logging core and the \ref output call-back.
+	 *  \param[in] target logging target
+	 *  \param[in] subsys (already mapped) logging subsystem index
+	 *  \param[in] level log level of current message
+	 *  \param[in] file source file name
+	 *  \param[in] line source line number
+	 *  \param[in] cont is this a continuation of the previous message?
+	 *  \param[in] format format string
+	 *  \param[in] ap arguments for the format string
+	 */
+	void (*raw_output) (struct log_target *target, unsigned int subsys,
+			    unsigned int level, const char *file, int line,
+			    int cont, const char *format, va_list ap);
 };
 
 /* use the above macros */
@@ -198,10 +238,42 @@ struct log_target *log_target_create_file(const char *fname);
 struct log_target *log_target_create_syslog(const char *ident, int option,
 					    int facility);
 int log_target_file_reopen(struct log_target *tgt);
+struct log_target *log_target_create_binary(const char *fname);
+int log_target_binary_flush(struct log_target *target);
+int log_binary_decode(FILE *in, FILE *out, int print_timestamp);
 
 void log_add_target(struct log_target *target);
 void log_del_target(struct log_target *target);
 
+void log_cache_update(void);
+
+/*! \brief Per-category mask of log levels any target may output
+ *
+ * Indexed by subsystem + \ref OSMO_NUM_DLIB, bit N is set if level N
+ * passes the category and level settings of at least one target.
+ * Maintained by the log_set_*() functions, see \ref log_cache_update.
+ */
+extern uint16_t *osmo_log_level_mask;
+/*! \brief Number of entries in \ref osmo_log_level_mask */
+extern int osmo_log_level_mask_len;
+
+/*! \brief Check whether a message could be output by any log target
+ *  \param[in] subsys logging subsystem (e.g. \ref DLGLOBAL)
+ *  \param[in] level logging level (e.g. \ref LOGL_NOTICE)
+ *  \returns 0 if no target will output it, 1 if it may be output
+ *
+ * Filters are not taken into account, osmo_vlogp() still applies them.
+ */
+static inline int log_check_level(int subsys, unsigned int level)
+{
+	int idx = subsys + OSMO_NUM_DLIB;
+
+	if (idx < 0 || idx >= osmo_log_level_mask_len || level > 15)
+		return 1;
+
+	return (osmo_log_level_mask[idx] >> level) & 1;
+}
+
 /* Generate command string for VTY use */
 const char *log_vty_command_string(const struct log_info *info);
 const char *log_vty_command_description(const struct log_info *info);
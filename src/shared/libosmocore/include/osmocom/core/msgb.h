@@ -38,6 +38,8 @@
 
 #define MSGB_DEBUG
 
+struct msgb_pool;
+
 /*! \brief Osmocom message buffer */
 struct msgb {
 	struct llist_head list; /*!< \brief linked list header */
@@ -58,6 +60,9 @@ struct msgb {
 
 	unsigned long cb[5]; /*!< \brief control buffer */
 
+	struct msgb_pool *pool; /*!< \brief pool to return to on \ref msgb_free */
+	uint8_t pool_class;     /*!< \brief size class within the pool */
+
 	uint16_t data_len;   /*!< \brief length of underlying data array */
 	uint16_t len;	     /*!< \brief length of bytes used in msgb */
 
@@ -396,6 +401,49 @@ static inline struct msgb *msgb_alloc_headroom(int size, int headroom,
 uint8_t *msgb_data(const struct msgb *msg);
 void msgb_set_talloc_ctx(void *ctx);
 
+/*! \brief Maximum number of size classes of a \ref msgb_pool */
+#define MSGB_POOL_MAX_CLASSES	8
+
+/*! \brief Byte pattern of the data of a free pooled msgb */
+#define MSGB_POOL_POISON	0xdb
+
+/*! \brief Statistics of a \ref msgb_pool or one of its size classes */
+struct msgb_pool_stats {
+	unsigned long allocs;	/*!< \brief number of allocations */
+	unsigned long hits;	/*!< \brief allocations served by a free list */
+	unsigned int in_use;	/*!< \brief msgbs currently allocated */
+	unsigned int in_use_max; /*!< \brief high-water mark of in_use */
+};
+
+/*! \brief One size class of a \ref msgb_pool */
+struct msgb_pool_class {
+	uint16_t size;			/*!< \brief data size of the msgbs */
+	struct llist_head free_list;	/*!< \brief msgbs ready for use */
+	unsigned int free_len;		/*!< \brief length of free_list */
+	struct msgb_pool_stats stats;	/*!< \brief statistics */
+};
+
+/*! \brief Free lists of pre-sized message buffers */
+struct msgb_pool {
+	const char *name;	/*!< \brief human-readable name */
+	unsigned int max_free;	/*!< \brief free msgbs kept per class */
+	int poison;		/*!< \brief poison and check free msgbs */
+	unsigned long oversize;	/*!< \brief requests bigger than any class */
+	unsigned int num_classes;
+	struct msgb_pool_class classes[MSGB_POOL_MAX_CLASSES];
+};
+
+struct msgb_pool *msgb_pool_alloc(void *ctx, const char *name,
+				  const uint16_t *sizes, unsigned int num_sizes,
+				  unsigned int prealloc, unsigned int max_free);
+void msgb_pool_free(struct msgb_pool *pool);
+void msgb_pool_set_poison(struct msgb_pool *pool, int poison);
+void msgb_pool_get_stats(const struct msgb_pool *pool,
+			 struct msgb_pool_stats *stats);
+struct msgb *msgb_alloc_pool(struct msgb_pool *pool, uint16_t size,
+			     const char *name);
+void msgb_set_pool(struct msgb_pool *pool);
+
 /*! @} */
 
 #endif /* _MSGB_H */
@@ -30,7 +30,8 @@ struct rate_ctr_per_intv {
 
 /*! \brief data we keep for each actual value */
 struct rate_ctr {
-	uint64_t current;	/*!< \brief current value */
+	/*! \brief current value, use \ref rate_ctr_get from other threads */
+	uint64_t current;
 	/*! \brief per-interval data */
 	struct rate_ctr_per_intv intv[RATE_CTR_INTV_NUM];
 };
@@ -72,6 +73,7 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 void rate_ctr_group_free(struct rate_ctr_group *grp);
 
 void rate_ctr_add(struct rate_ctr *ctr, int inc);
+uint64_t rate_ctr_get(const struct rate_ctr *ctr);
 
 /*! \brief Increment the counter by 1 */
 static inline void rate_ctr_inc(struct rate_ctr *ctr)
@@ -81,6 +83,9 @@ static inline void rate_ctr_inc(struct rate_ctr *ctr)
 
 int rate_ctr_init(void *tall_ctx);
 
+int rate_ctr_for_each_group(int (*handle_group)(struct rate_ctr_group *, void *),
+			    void *data);
+
 struct rate_ctr_group *rate_ctr_get_group_by_name_idx(const char *name, const unsigned int idx);
 const struct rate_ctr *rate_ctr_get_by_name(const struct rate_ctr_group *ctrg, const char *name);
 
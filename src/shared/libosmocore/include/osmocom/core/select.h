@@ -17,6 +17,8 @@
 #define BSC_FD_WRITE	0x0002
 /*! \brief Indicate interest in exceptions from the file descriptor */
 #define BSC_FD_EXCEPT	0x0004
+/*! \brief Request edge-triggered notification (epoll backend only) */
+#define BSC_FD_EDGE	0x0100
 
 /*! \brief Structure representing a file dsecriptor */
 struct osmo_fd {
@@ -25,7 +27,7 @@ struct osmo_fd {
 	/*! actual operating-system level file decriptor */
 	int fd;
 	/*! bit-mask or of \ref BSC_FD_READ, \ref BSC_FD_WRITE and/or
-	 * \ref BSC_FD_EXCEPT */
+	 * \ref BSC_FD_EXCEPT, optionally with \ref BSC_FD_EDGE */
 	unsigned int when;
 	/*! call-back function to be called once file descriptor becomes
 	 * available */
@@ -36,10 +38,45 @@ struct osmo_fd {
 	unsigned int priv_nr;
 };
 
+/*! \brief Mechanism used by \ref osmo_select_main to wait for events */
+enum osmo_select_backend {
+	OSMO_SELECT_BACKEND_SELECT,	/*!< \brief select(), portable */
+	OSMO_SELECT_BACKEND_EPOLL,	/*!< \brief epoll(), Linux only */
+};
+
 int osmo_fd_register(struct osmo_fd *fd);
 void osmo_fd_unregister(struct osmo_fd *fd);
+void osmo_fd_update_when(struct osmo_fd *fd, unsigned int and_mask,
+			 unsigned int or_mask);
+
+/*! \brief Start waiting for the file descriptor to become readable */
+static inline void osmo_fd_read_enable(struct osmo_fd *fd)
+{
+	osmo_fd_update_when(fd, ~0, BSC_FD_READ);
+}
+
+/*! \brief Stop waiting for the file descriptor to become readable */
+static inline void osmo_fd_read_disable(struct osmo_fd *fd)
+{
+	osmo_fd_update_when(fd, ~BSC_FD_READ, 0);
+}
+
+/*! \brief Start waiting for the file descriptor to become writable */
+static inline void osmo_fd_write_enable(struct osmo_fd *fd)
+{
+	osmo_fd_update_when(fd, ~0, BSC_FD_WRITE);
+}
+
+/*! \brief Stop waiting for the file descriptor to become writable */
+static inline void osmo_fd_write_disable(struct osmo_fd *fd)
+{
+	osmo_fd_update_when(fd, ~BSC_FD_WRITE, 0);
+}
 int osmo_select_main(int polling);
 
+int osmo_select_set_backend(enum osmo_select_backend be);
+enum osmo_select_backend osmo_select_get_backend(void);
+
 /*! @} */
 
 #endif /* _BSC_SELECT_H */
@@ -12,22 +12,34 @@ struct osmo_counter {
 	unsigned long value;		/*!< \brief current value */
 };
 
-/*! \brief Increment counter */
+/* Relaxed atomics where they are lock-free, so that counters can be
+ * bumped from several threads without losing increments */
+#if defined(__GCC_ATOMIC_LONG_LOCK_FREE) && __GCC_ATOMIC_LONG_LOCK_FREE == 2
+#define _OSMO_CTR_INC(p)	__atomic_fetch_add(p, 1, __ATOMIC_RELAXED)
+#define _OSMO_CTR_LOAD(p)	__atomic_load_n(p, __ATOMIC_RELAXED)
+#define _OSMO_CTR_STORE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+#else
+#define _OSMO_CTR_INC(p)	((*(p))++)
+#define _OSMO_CTR_LOAD(p)	(*(p))
+#define _OSMO_CTR_STORE(p, v)	(*(p) = (v))
+#endif
+
+/*! \brief Increment counter, may be called from any thread */
 static inline void osmo_counter_inc(struct osmo_counter *ctr)
 {
-	ctr->value++;
+	_OSMO_CTR_INC(&ctr->value);
 }
 
 /*! \brief Get current value of counter */
 static inline unsigned long osmo_counter_get(struct osmo_counter *ctr)
 {
-	return ctr->value;
+	return _OSMO_CTR_LOAD(&ctr->value);
 }
 
 /*! \brief Reset current value of counter to 0 */
 static inline void osmo_counter_reset(struct osmo_counter *ctr)
 {
-	ctr->value = 0;
+	_OSMO_CTR_STORE(&ctr->value, 0);
 }
 
 /*! \brief Allocate a new counter */
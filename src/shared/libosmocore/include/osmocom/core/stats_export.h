@@ -0,0 +1,33 @@
+#ifndef _OSMOCORE_STATS_EXPORT_H
+#define _OSMOCORE_STATS_EXPORT_H
+
+/*! \defgroup stats_export Pull-based export of counters
+ *  @{
+ */
+
+/*! \file stats_export.h
+ *  \brief Dump rate counter groups and osmo_counters in text formats
+ *  understood by monitoring systems
+ */
+
+#include <stdio.h>
+
+/*! \brief Output format of the counter export */
+enum osmo_stats_fmt {
+	/*! \brief Prometheus text exposition format */
+	OSMO_STATS_FMT_PROMETHEUS,
+	/*! \brief StatsD lines, absolute values as gauges */
+	OSMO_STATS_FMT_STATSD,
+};
+
+int osmo_stats_export(FILE *out, enum osmo_stats_fmt fmt, const char *prefix);
+int osmo_stats_export_file(const char *path, enum osmo_stats_fmt fmt,
+			   const char *prefix);
+
+int osmo_stats_export_sock_init(const char *path, enum osmo_stats_fmt fmt,
+				const char *prefix);
+void osmo_stats_export_sock_close(void);
+
+/*! @} */
+
+#endif /* _OSMOCORE_STATS_EXPORT_H */
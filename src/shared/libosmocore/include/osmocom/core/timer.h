@@ -61,6 +61,12 @@ struct osmo_timer_list {
 	void *data;		  /*!< \brief user data for callback */
 };
 
+/*! \brief Data structure used to manage the pending timers */
+enum osmo_timer_backend {
+	OSMO_TIMER_BACKEND_RBTREE,	/*!< \brief rb-tree, wall-clock time */
+	OSMO_TIMER_BACKEND_WHEEL,	/*!< \brief timer wheel, monotonic time */
+};
+
 /**
  * timer management
  */
@@ -84,6 +90,10 @@ void osmo_timers_prepare(void);
 int osmo_timers_update(void);
 int osmo_timers_check(void);
 
+int osmo_timers_gettime(struct timeval *tv);
+int osmo_timers_set_backend(enum osmo_timer_backend be);
+enum osmo_timer_backend osmo_timers_get_backend(void);
+
 /*! @} */
 
 #endif
@@ -43,7 +43,8 @@ struct osmo_bssgp_prim {
 	uint16_t nsei;
 	uint16_t bvci;
 	uint32_t tlli;
-	struct tlv_parsed *tp;
+	/* IEs of the received PDU, use the TLVP_*() accessors */
+	struct tlv_sparse *tp;
 	struct gprs_ra_id *ra_id;
 
 	/* specific fields */
@@ -155,6 +156,13 @@ static inline int bssgp_tlv_parse(struct tlv_parsed *tp, uint8_t *buf, int len)
 	return tlv_parse(tp, &tvlv_att_def, buf, len, 0, 0);
 }
 
+/* Same as bssgp_tlv_parse(), into the compact representation */
+static inline int bssgp_tlv_parse_sparse(struct tlv_sparse *tp, uint8_t *buf,
+					 int len)
+{
+	return tlv_parse_sparse(tp, &tvlv_att_def, buf, len, 0, 0);
+}
+
 /*! \brief BSSGP Paging mode */
 enum bssgp_paging_mode {
 	BSSGP_PAGING_PS,
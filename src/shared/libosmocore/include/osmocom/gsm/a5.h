@@ -58,6 +58,19 @@ void osmo_a5(int n, const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_1(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 
+	/* Bulk generation (bit-sliced):
+	 *  - the key of stream i is at keys[i * key_step], so key_step
+	 *    is 0 for a common key or 8 for one key per frame number
+	 *  - dl/ul are either NULL or count * 114 bits long for ubits
+	 *    and count * 15 bytes long for packed bits
+	 */
+void osmo_a5_multi(int n, const uint8_t *keys, unsigned int key_step,
+                   const uint32_t *fn, unsigned int count,
+                   ubit_t *dl, ubit_t *ul);
+void osmo_a5_multi_pbit(int n, const uint8_t *keys, unsigned int key_step,
+                        const uint32_t *fn, unsigned int count,
+                        pbit_t *dl, pbit_t *ul);
+
 /*! @} */
 
 #endif /* __OSMO_A5_H__ */
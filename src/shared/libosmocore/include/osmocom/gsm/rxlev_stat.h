@@ -15,6 +15,10 @@ void rxlev_stat_input(struct rxlev_stats *st, uint16_t arfcn, uint8_t rxlev);
 /* get the next ARFCN that has the specified Rxlev */
 int16_t rxlev_stat_get_next(const struct rxlev_stats *st, uint8_t rxlev, int16_t arfcn);
 
+/* get up to n ARFCNs with the highest Rxlev, strongest first */
+int rxlev_stat_get_strongest(const struct rxlev_stats *st, uint16_t *arfcns,
+			     uint8_t *rxlevs, unsigned int n);
+
 void rxlev_stat_reset(struct rxlev_stats *st);
 
 void rxlev_stat_dump(const struct rxlev_stats *st);
@@ -395,6 +395,30 @@ struct tlv_parsed {
 	struct tlv_p_entry lv[256];
 };
 
+/*! \brief Maximum number of IEs in a \ref tlv_sparse */
+#define TLV_SPARSE_MAX_IE	32
+
+/*! \brief Entry of a \ref tlv_sparse, in message order */
+struct tlv_sparse_ie {
+	uint8_t tag;		/*!< \brief tag */
+	uint16_t len;		/*!< \brief length */
+	const uint8_t *val;	/*!< \brief pointer to value */
+};
+
+/*! \brief compact result of the TLV parser
+ *
+ * Unlike \ref tlv_parsed, only the presence bitmap and the number of
+ * IEs need to be cleared before parsing.  The index of a tag is only
+ * valid if its bit is set in the bitmap.  If a tag occurs more than
+ * once, the lookup yields the last occurrence, as with \ref tlv_parse.
+ */
+struct tlv_sparse {
+	uint32_t present[256 / 32];	/*!< \brief bitmap of parsed tags */
+	uint8_t num;			/*!< \brief number of entries in ie */
+	uint8_t idx[256];		/*!< \brief tag to index in ie */
+	struct tlv_sparse_ie ie[TLV_SPARSE_MAX_IE]; /*!< \brief parsed IEs */
+};
+
 extern struct tlv_definition tvlv_att_def;
 extern struct tlv_definition vtvlv_gan_att_def;
 
@@ -403,12 +427,49 @@ int tlv_parse_one(uint8_t *o_tag, uint16_t *o_len, const uint8_t **o_val,
                   const uint8_t *buf, int buf_len);
 int tlv_parse(struct tlv_parsed *dec, const struct tlv_definition *def,
 	      const uint8_t *buf, int buf_len, uint8_t lv_tag, uint8_t lv_tag2);
+int tlv_parse_sparse(struct tlv_sparse *dec, const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		     uint8_t lv_tag2);
 /* take a master (src) tlvdev and fill up all empty slots in 'dst' */
 void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src);
 
-#define TLVP_PRESENT(x, y)	((x)->lv[y].val)
-#define TLVP_LEN(x, y)		(x)->lv[y].len
-#define TLVP_VAL(x, y)		(x)->lv[y].val
+/*! \brief Get the entry of a tag from a \ref tlv_sparse
+ *  \returns the last entry with this tag, NULL if not present */
+static inline const struct tlv_sparse_ie *
+tlv_sparse_get(const struct tlv_sparse *tp, uint8_t tag)
+{
+	if (!(tp->present[tag >> 5] & (1U << (tag & 31))))
+		return NULL;
+	return &tp->ie[tp->idx[tag]];
+}
+
+static inline const uint8_t *
+tlv_sparse_val(const struct tlv_sparse *tp, uint8_t tag)
+{
+	const struct tlv_sparse_ie *ie = tlv_sparse_get(tp, tag);
+	return ie ? ie->val : NULL;
+}
+
+static inline uint16_t
+tlv_sparse_len(const struct tlv_sparse *tp, uint8_t tag)
+{
+	const struct tlv_sparse_ie *ie = tlv_sparse_get(tp, tag);
+	return ie ? ie->len : 0;
+}
+
+/* The accessors below take either a struct tlv_parsed or a tlv_sparse */
+#define _TLVP_IS_SPARSE(x) \
+	__builtin_types_compatible_p(__typeof__(*(x)), struct tlv_sparse)
+
+#define TLVP_PRESENT(x, y)	__builtin_choose_expr(_TLVP_IS_SPARSE(x), \
+	tlv_sparse_val((const struct tlv_sparse *)(x), y),		\
+	((const struct tlv_parsed *)(x))->lv[y].val)
+#define TLVP_LEN(x, y)		__builtin_choose_expr(_TLVP_IS_SPARSE(x), \
+	tlv_sparse_len((const struct tlv_sparse *)(x), y),		\
+	((const struct tlv_parsed *)(x))->lv[y].len)
+#define TLVP_VAL(x, y)		__builtin_choose_expr(_TLVP_IS_SPARSE(x), \
+	tlv_sparse_val((const struct tlv_sparse *)(x), y),		\
+	((const struct tlv_parsed *)(x))->lv[y].val)
 
 /*! @} */
 
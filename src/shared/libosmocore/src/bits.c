@@ -1,5 +1,6 @@
 
 #include <stdint.h>
+#include <string.h>
 
 #include <osmocom/core/bits.h>
 
@@ -12,6 +13,61 @@
  */
 
 
+/*
+ * The conversions below work on 8 bits at a time, kept as the 8 bytes
+ * of a 64 bit word (unpacked side) or as one byte (packed side).  This
+ * relies on byte i of the array being bits 8*i..8*i+7 of the word, so
+ * big endian machines take the bitwise path.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BITS_SWAR
+#endif
+
+#define ONES64		0x0101010101010101ULL
+#define HIGHS64		0x8080808080808080ULL
+
+#ifdef BITS_SWAR
+static inline uint64_t load64(const void *p)
+{
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+static inline void store64(void *p, uint64_t w)
+{
+	memcpy(p, &w, sizeof(w));
+}
+
+/* 0x01 in every byte which is non-zero, 0x00 elsewhere */
+static inline uint64_t nonzero8(uint64_t w)
+{
+	return ((((w & ~HIGHS64) + ~HIGHS64) | w) & HIGHS64) >> 7;
+}
+
+/* Gather 8 unpacked bits into a byte, first one to the MSB or LSB */
+static inline uint8_t pack8(const ubit_t *in, int lsb_mode)
+{
+	uint64_t w = nonzero8(load64(in));
+
+	/* Each product lands in the top byte, without carries */
+	if (lsb_mode)
+		return (w * 0x0102040810204080ULL) >> 56;
+	return (w * 0x8040201008040201ULL) >> 56;
+}
+
+/* Spread a byte into 8 unpacked bits, MSB or LSB first */
+static inline void unpack8(ubit_t *out, uint8_t byte, int lsb_mode)
+{
+	uint64_t w = byte * ONES64;
+
+	/* Keep one bit per byte, then turn it into 0 or 1 */
+	w &= lsb_mode ? 0x8040201008040201ULL : 0x0102040810204080ULL;
+	w = ((w + ~HIGHS64) & HIGHS64) >> 7;
+	store64(out, w);
+}
+#endif
+
 /*! \brief convert unpacked bits to packed bits, return length in bytes
  *  \param[out] out output buffer of packed bits
  *  \param[in] in input buffer of unpacked bits
@@ -23,6 +79,13 @@ int osmo_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
 	uint8_t curbyte = 0;
 	pbit_t *outptr = out;
 
+#ifdef BITS_SWAR
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		*outptr++ = pack8(in + i, 0);
+	in += i;
+	num_bits -= i;
+#endif
+
 	for (i = 0; i < num_bits; i++) {
 		uint8_t bitnum = 7 - (i % 8);
 
@@ -51,6 +114,14 @@ int osmo_pbit2ubit(ubit_t *out, const pbit_t *in, unsigned int num_bits)
 	ubit_t *cur = out;
 	ubit_t *limit = out + num_bits;
 
+#ifdef BITS_SWAR
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		unpack8(cur + i, *in++, 0);
+	cur += i;
+#endif
+	if (cur >= limit)
+		return cur - out;
+
 	for (i = 0; i < (num_bits/8)+1; i++) {
 		pbit_t byte = in[i];
 		*cur++ = (byte >> 7) & 1;
@@ -94,8 +165,24 @@ int osmo_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
                        const ubit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, op, bn;
-	for (i=0; i<num_bits; i++) {
+	int i = 0, op, bn;
+
+#ifdef BITS_SWAR
+	/* Bitwise up to a byte boundary of the output, then whole bytes */
+	while (i < num_bits && ((out_ofs + i) & 7)) {
+		op = out_ofs + i;
+		bn = lsb_mode ? (op&7) : (7-(op&7));
+		if (in[in_ofs+i])
+			out[op>>3] |= 1 << bn;
+		else
+			out[op>>3] &= ~(1 << bn);
+		i++;
+	}
+	for (; i + 8 <= num_bits; i += 8)
+		out[(out_ofs + i) >> 3] = pack8(in + in_ofs + i, lsb_mode);
+#endif
+
+	for (; i<num_bits; i++) {
 		op = out_ofs + i;
 		bn = lsb_mode ? (op&7) : (7-(op&7));
 		if (in[in_ofs+i])
@@ -119,8 +206,21 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
                        const pbit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, ip, bn;
-	for (i=0; i<num_bits; i++) {
+	int i = 0, ip, bn;
+
+#ifdef BITS_SWAR
+	/* Bitwise up to a byte boundary of the input, then whole bytes */
+	while (i < num_bits && ((in_ofs + i) & 7)) {
+		ip = in_ofs + i;
+		bn = lsb_mode ? (ip&7) : (7-(ip&7));
+		out[out_ofs+i] = !!(in[ip>>3] & (1<<bn));
+		i++;
+	}
+	for (; i + 8 <= num_bits; i += 8)
+		unpack8(out + out_ofs + i, in[(in_ofs + i) >> 3], lsb_mode);
+#endif
+
+	for (; i<num_bits; i++) {
 		ip = in_ofs + i;
 		bn = lsb_mode ? (ip&7) : (7-(ip&7));
 		out[out_ofs+i] = !!(in[ip>>3] & (1<<bn));
@@ -128,6 +228,48 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
 	return out_ofs + num_bits;
 }
 
+/*! \brief convert unpacked bits to soft bits
+ *  \param[out] out output buffer of soft bits
+ *  \param[in] in input buffer of unpacked bits
+ *  \param[in] num_bits number of bits
+ *
+ * A 0 becomes 127, a 1 becomes -127.
+ */
+void osmo_ubit2sbit(sbit_t *out, const ubit_t *in, unsigned int num_bits)
+{
+	unsigned int i = 0;
+
+#ifdef BITS_SWAR
+	/* 0x7f + 2 is 0x81, which is -127 */
+	for (; i + 8 <= num_bits; i += 8)
+		store64(out + i, 0x7f * ONES64 + (nonzero8(load64(in + i)) << 1));
+#endif
+
+	for (; i < num_bits; i++)
+		out[i] = in[i] ? -127 : 127;
+}
+
+/*! \brief convert soft bits to unpacked bits
+ *  \param[out] out output buffer of unpacked bits
+ *  \param[in] in input buffer of soft bits
+ *  \param[in] num_bits number of bits
+ *
+ * Negative soft bits become 1, all others 0.
+ */
+void osmo_sbit2ubit(ubit_t *out, const sbit_t *in, unsigned int num_bits)
+{
+	unsigned int i = 0;
+
+#ifdef BITS_SWAR
+	/* The sign bit of each byte */
+	for (; i + 8 <= num_bits; i += 8)
+		store64(out + i, (load64(in + i) >> 7) & ONES64);
+#endif
+
+	for (; i < num_bits; i++)
+		out[i] = in[i] < 0;
+}
+
 /* generalized bit reversal function, Chapter 7 "Hackers Delight" */
 uint32_t osmo_bit_reversal(uint32_t x, enum osmo_br_mode k)
 {
@@ -30,6 +30,7 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <osmocom/core/bitvec.h>
 
@@ -66,6 +67,23 @@ static uint8_t bitval2mask(enum bit_value bit, uint8_t bitnum)
 	return bitval;
 }
 
+/* Load 8 bytes, so that the first bit of the vector is the MSB */
+static inline uint64_t load_be64(const uint8_t *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	return __builtin_bswap64(w);
+#else
+	uint64_t w = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		w = (w << 8) | p[i];
+	return w;
+#endif
+}
+
 /*! \brief check if the bit is 0 or 1 for a given position inside a bitvec
  *  \param[in] bv the bit vector on which to check
  *  \param[in] bitnr the bit number inside the bit vector to check
@@ -117,19 +135,52 @@ enum bit_value bitvec_get_bit_pos_high(const struct bitvec *bv,
  */
 unsigned int bitvec_get_nth_set_bit(const struct bitvec *bv, unsigned int n)
 {
-	unsigned int i, k = 0;
+	unsigned int i = 0, k;
+	uint64_t w;
+	uint8_t b;
+
+	if (n == 0)
+		return 0;
+
+	/* Skip whole words which don't contain the Nth set bit */
+	for (; i + 8 <= bv->data_len; i += 8) {
+		w = load_be64(bv->data + i);
+		k = __builtin_popcountll(w);
+		if (k >= n) {
+			/* Drop the first n - 1 set bits */
+			while (--n)
+				w &= ~(1ULL << (63 - __builtin_clzll(w)));
+			return i * 8 + __builtin_clzll(w);
+		}
+		n -= k;
+	}
 
-	for (i = 0; i < bv->data_len*8; i++) {
-		if (bitvec_get_bit_pos(bv, i) == ONE) {
-			k++;
-			if (k == n)
-				return i;
+	for (; i < bv->data_len; i++) {
+		for (b = bv->data[i], k = 0; k < 8; k++, b <<= 1) {
+			if ((b & 0x80) && --n == 0)
+				return i * 8 + k;
 		}
 	}
 
 	return 0;
 }
 
+/*! \brief count the bits set in a bit vector
+ *  \param[in] bv the bit vector to use
+ *  \returns the number of bits set in \a bv
+ */
+unsigned int bitvec_popcount(const struct bitvec *bv)
+{
+	unsigned int i = 0, cnt = 0;
+
+	for (; i + 8 <= bv->data_len; i += 8)
+		cnt += __builtin_popcountll(load_be64(bv->data + i));
+	for (; i < bv->data_len; i++)
+		cnt += __builtin_popcount(bv->data[i]);
+
+	return cnt;
+}
+
 /*! \brief set a bit at given position in a bit vector
  *  \param[in] bv bit vector on which to operate
  *  \param[in] bitnum number of bit to be set
@@ -247,15 +298,43 @@ int bitvec_spare_padding(struct bitvec *bv, unsigned int up_to_bit)
 	return 0;
 }
 
-/*! \brief find first bit set in bit vector */
+/*! \brief find first bit set in bit vector
+ *  \param[in] bv the bit vector to search
+ *  \param[in] n the bit number to start at
+ *  \param[in] val the value to look for, ZERO or ONE
+ *  \returns number of the first bit from \a n on equal to \a val, -1 if none
+ */
 int bitvec_find_bit_pos(const struct bitvec *bv, unsigned int n,
 			enum bit_value val)
 {
-	unsigned int i;
+	unsigned int i = n / 8;
+	uint64_t w, inv;
+	uint8_t b;
+
+	if (val != ZERO && val != ONE)
+		return -1;
+	if (i >= bv->data_len)
+		return -1;
+
+	/* Look for ONEs, in the complement if searching for ZEROs */
+	inv = val == ONE ? 0 : ~0ULL;
+
+	/* The bits before n in the first byte don't count */
+	b = (bv->data[i] ^ inv) & (0xff >> (n % 8));
+	if (b)
+		return i * 8 + __builtin_clz(b) - (sizeof(int) * 8 - 8);
+	i++;
+
+	for (; i + 8 <= bv->data_len; i += 8) {
+		w = load_be64(bv->data + i) ^ inv;
+		if (w)
+			return i * 8 + __builtin_clzll(w);
+	}
 
-	for (i = n; i < bv->data_len*8; i++) {
-		if (bitvec_get_bit_pos(bv, i) == val)
-			return i;
+	for (; i < bv->data_len; i++) {
+		b = bv->data[i] ^ inv;
+		if (b)
+			return i * 8 + __builtin_clz(b) - (sizeof(int) * 8 - 8);
 	}
 
 	return -1;
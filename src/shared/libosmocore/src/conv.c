@@ -40,6 +40,7 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/conv.h>
 
+#include "conv_acc.h"
 
 /* ------------------------------------------------------------------------ */
 /* Common                                                                   */
@@ -236,8 +237,6 @@ osmo_conv_encode(const struct osmo_conv_code *code,
 /* Decoding (viterbi)                                                       */
 /* ------------------------------------------------------------------------ */
 
-#define MAX_AE 0x00ffffff
-
 void
 osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
                       const struct osmo_conv_code *code, int len, int start_state)
@@ -262,6 +261,9 @@ osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
 
 	decoder->state_history = malloc(sizeof(uint8_t) * n_states * (len + decoder->code->K - 1));
 
+	/* Accelerated add-compare-select, if the code allows it */
+	decoder->acc = osmo_conv_acc_alloc(code, len);
+
 	/* Classic reset */
 	osmo_conv_decode_reset(decoder, start_state);
 }
@@ -313,6 +315,7 @@ osmo_conv_decode_deinit(struct osmo_conv_decoder *decoder)
 	free(decoder->ae);
 	free(decoder->ae_next);
 	free(decoder->state_history);
+	osmo_conv_acc_free(decoder->acc);
 
 	memset(decoder, 0x00, sizeof(struct osmo_conv_decoder));
 }
@@ -333,6 +336,10 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 
 	int i_idx, p_idx;
 
+	/* Use the accelerated kernels when possible */
+	if (decoder->acc)
+		return osmo_conv_acc_scan(decoder, input, n);
+
 	/* Prepare */
 	n_states = decoder->n_states;
 
@@ -0,0 +1,757 @@
+/*
+ * conv_acc.c
+ *
+ * Accelerated Viterbi add-compare-select kernels
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \addtogroup conv
+ *  @{
+ */
+
+/*! \file conv_acc.c
+ *  \file Accelerated add-compare-select for the Viterbi decoder
+ *
+ *  For a code with the shift register butterfly structure, the two
+ *  predecessors of state \a ns are \a ns/2 and \a ns/2 + n_states/2.
+ *  The kernels below walk the trellis by destination state, so that
+ *  consecutive destination states map onto consecutive vector lanes.
+ *
+ *  The branch metric is the same as the one of the generic decoder:
+ *  the sum over all non-erased soft bits of ((is - ov)^2 >> 9). It is
+ *  split into a per-step constant (all expected bits being 0) plus a
+ *  per-bit delta selected by precomputed per-state masks. Ties are
+ *  resolved in favour of the lower predecessor, exactly like the
+ *  generic scan does, so results are bit-exact.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+
+#include "conv_acc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONV_ACC_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CONV_ACC_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*conv_acs_fn)(const struct osmo_conv_acc *acc,
+                            unsigned int **ae, unsigned int **ae_next,
+                            uint8_t *state_history, const sbit_t *in, int n);
+
+/*! \brief internal accelerated decoder state */
+struct osmo_conv_acc {
+	conv_acs_fn acs;	/*!< \brief selected kernel */
+	int N;			/*!< \brief inverse of code rate */
+	int n_states;		/*!< \brief number of states */
+	uint8_t *out;		/*!< \brief output of [ns][pred] transition */
+	int32_t *masks;		/*!< \brief [pred][N][ns] output bit masks */
+	sbit_t *in;		/*!< \brief depunctured input buffer */
+	uint8_t *punct;		/*!< \brief 1 for each punctured coded bit */
+};
+
+static enum osmo_conv_acc_type conv_acc_type = OSMO_CONV_ACC_AUTO;
+
+
+/* ------------------------------------------------------------------------ */
+/* Branch metrics                                                           */
+/* ------------------------------------------------------------------------ */
+
+/* Computes the branch metric of the all-zero output for one trellis step
+ * and, for each of the N coded bits, the delta to add if that bit is 1. */
+static inline int32_t
+conv_step_metrics(const sbit_t *in, int N, int32_t *d)
+{
+	int32_t c0 = 0;
+	int j;
+
+	for (j=0; j<N; j++) {
+		int is = in[j];
+		int32_t e0, e1;
+
+		if (!is) {
+			d[j] = 0;
+			continue;
+		}
+
+		e0 = ((is - 127) * (is - 127)) >> 9;
+		e1 = ((is + 127) * (is + 127)) >> 9;
+
+		c0 += e0;
+		d[j] = e1 - e0;
+	}
+
+	return c0;
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Portable kernels                                                         */
+/* ------------------------------------------------------------------------ */
+
+static inline __attribute__((always_inline)) void
+acs_scalar_impl(const struct osmo_conv_acc *acc, int n_states,
+                unsigned int **ae_p, unsigned int **ae_next_p,
+                uint8_t *sh, const sbit_t *in, int n)
+{
+	const int N = acc->N;
+	const int half = n_states >> 1;
+	unsigned int *ae = *ae_p, *ae_next = *ae_next_p, *tmp;
+	int32_t bm[256], d[8];
+	int i, j, o, ns, size;
+
+	for (i=0; i<n; i++)
+	{
+		/* Branch metric for every possible output word */
+		bm[0] = conv_step_metrics(&in[i * N], N, d);
+		for (j=N-1, size=1; j>=0; j--, size<<=1)
+			for (o=0; o<size; o++)
+				bm[o + size] = bm[o] + d[j];
+
+		/* Butterflies */
+		for (ns=0; ns<n_states; ns++)
+		{
+			unsigned int m0, m1;
+			int s = ns >> 1;
+
+			m0 = ae[s] + bm[acc->out[2 * ns]];
+			m1 = ae[s + half] + bm[acc->out[2 * ns + 1]];
+
+			if (m1 < m0) {
+				m0 = m1;
+				s += half;
+			}
+
+			ae_next[ns] = m0 < MAX_AE ? m0 : MAX_AE;
+			sh[ns] = s;
+		}
+
+		sh += n_states;
+
+		tmp = ae; ae = ae_next; ae_next = tmp;
+	}
+
+	*ae_p = ae;
+	*ae_next_p = ae_next;
+}
+
+static void
+acs_scalar_k5(const struct osmo_conv_acc *acc, unsigned int **ae,
+              unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_scalar_impl(acc, 16, ae, ae_next, sh, in, n);
+}
+
+static void
+acs_scalar_k7(const struct osmo_conv_acc *acc, unsigned int **ae,
+              unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_scalar_impl(acc, 64, ae, ae_next, sh, in, n);
+}
+
+static void
+acs_scalar_gen(const struct osmo_conv_acc *acc, unsigned int **ae,
+               unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_scalar_impl(acc, acc->n_states, ae, ae_next, sh, in, n);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* x86 kernels                                                              */
+/* ------------------------------------------------------------------------ */
+
+#ifdef CONV_ACC_X86
+
+/* Needs n_states >= 8 */
+static inline __attribute__((always_inline, target("sse2"))) void
+acs_sse2_impl(const struct osmo_conv_acc *acc, int n_states,
+              unsigned int **ae_p, unsigned int **ae_next_p,
+              uint8_t *sh, const sbit_t *in, int n)
+{
+	const int N = acc->N;
+	const int half = n_states >> 1;
+	unsigned int *ae = *ae_p, *ae_next = *ae_next_p, *tmp;
+	const __m128i vmax  = _mm_set1_epi32(MAX_AE);
+	const __m128i vhalf = _mm_set1_epi32(half);
+	const __m128i vdup  = _mm_setr_epi32(0, 0, 1, 1);
+	__m128i vc0, vd[8];
+	int32_t d[8];
+	int i, j, k, s;
+
+	for (i=0; i<n; i++)
+	{
+		vc0 = _mm_set1_epi32(conv_step_metrics(&in[i * N], N, d));
+		for (j=0; j<N; j++)
+			vd[j] = _mm_set1_epi32(d[j]);
+
+		for (s=0; s<half; s+=4)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i *) &ae[s]);
+			__m128i a1 = _mm_loadu_si128((const __m128i *) &ae[s + half]);
+			__m128i h[2];
+
+			for (k=0; k<2; k++)
+			{
+				const int ns = 2 * s + 4 * k;
+				const int32_t *m = &acc->masks[ns];
+				__m128i p0, p1, b0, b1, sel, v;
+
+				p0 = k ? _mm_unpackhi_epi32(a0, a0) : _mm_unpacklo_epi32(a0, a0);
+				p1 = k ? _mm_unpackhi_epi32(a1, a1) : _mm_unpacklo_epi32(a1, a1);
+
+				b0 = vc0;
+				b1 = vc0;
+				for (j=0; j<N; j++) {
+					__m128i m0 = _mm_loadu_si128((const __m128i *) &m[j * n_states]);
+					__m128i m1 = _mm_loadu_si128((const __m128i *) &m[(N + j) * n_states]);
+					b0 = _mm_add_epi32(b0, _mm_and_si128(m0, vd[j]));
+					b1 = _mm_add_epi32(b1, _mm_and_si128(m1, vd[j]));
+				}
+
+				p0 = _mm_add_epi32(p0, b0);
+				p1 = _mm_add_epi32(p1, b1);
+
+				/* Select survivor, lower predecessor wins ties */
+				sel = _mm_cmplt_epi32(p1, p0);
+				v = _mm_or_si128(_mm_and_si128(sel, p1), _mm_andnot_si128(sel, p0));
+
+				/* Saturate */
+				p0 = _mm_cmpgt_epi32(v, vmax);
+				v = _mm_or_si128(_mm_and_si128(p0, vmax), _mm_andnot_si128(p0, v));
+
+				_mm_storeu_si128((__m128i *) &ae_next[ns], v);
+
+				/* Survivor predecessor states */
+				h[k] = _mm_add_epi32(_mm_set1_epi32(ns >> 1), vdup);
+				h[k] = _mm_add_epi32(h[k], _mm_and_si128(sel, vhalf));
+			}
+
+			h[0] = _mm_packs_epi32(h[0], h[1]);
+			h[0] = _mm_packus_epi16(h[0], h[0]);
+			_mm_storel_epi64((__m128i *) &sh[2 * s], h[0]);
+		}
+
+		sh += n_states;
+
+		tmp = ae; ae = ae_next; ae_next = tmp;
+	}
+
+	*ae_p = ae;
+	*ae_next_p = ae_next;
+}
+
+__attribute__((target("sse2"))) static void
+acs_sse2_k5(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_sse2_impl(acc, 16, ae, ae_next, sh, in, n);
+}
+
+__attribute__((target("sse2"))) static void
+acs_sse2_k7(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_sse2_impl(acc, 64, ae, ae_next, sh, in, n);
+}
+
+__attribute__((target("sse2"))) static void
+acs_sse2_gen(const struct osmo_conv_acc *acc, unsigned int **ae,
+             unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_sse2_impl(acc, acc->n_states, ae, ae_next, sh, in, n);
+}
+
+/* Needs n_states >= 16 */
+static inline __attribute__((always_inline, target("avx2"))) void
+acs_avx2_impl(const struct osmo_conv_acc *acc, int n_states,
+              unsigned int **ae_p, unsigned int **ae_next_p,
+              uint8_t *sh, const sbit_t *in, int n)
+{
+	const int N = acc->N;
+	const int half = n_states >> 1;
+	unsigned int *ae = *ae_p, *ae_next = *ae_next_p, *tmp;
+	const __m256i vmax  = _mm256_set1_epi32(MAX_AE);
+	const __m256i vhalf = _mm256_set1_epi32(half);
+	const __m256i vdup  = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256i vduph = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+	__m256i vc0, vd[8];
+	int32_t d[8];
+	int i, j, k, s;
+
+	for (i=0; i<n; i++)
+	{
+		vc0 = _mm256_set1_epi32(conv_step_metrics(&in[i * N], N, d));
+		for (j=0; j<N; j++)
+			vd[j] = _mm256_set1_epi32(d[j]);
+
+		for (s=0; s<half; s+=8)
+		{
+			__m256i a0 = _mm256_loadu_si256((const __m256i *) &ae[s]);
+			__m256i a1 = _mm256_loadu_si256((const __m256i *) &ae[s + half]);
+
+			for (k=0; k<2; k++)
+			{
+				const int ns = 2 * s + 8 * k;
+				const int32_t *m = &acc->masks[ns];
+				__m256i p0, p1, b0, b1, sel, v, h;
+				__m128i hp;
+
+				p0 = _mm256_permutevar8x32_epi32(a0, k ? vduph : vdup);
+				p1 = _mm256_permutevar8x32_epi32(a1, k ? vduph : vdup);
+
+				b0 = vc0;
+				b1 = vc0;
+				for (j=0; j<N; j++) {
+					__m256i m0 = _mm256_loadu_si256((const __m256i *) &m[j * n_states]);
+					__m256i m1 = _mm256_loadu_si256((const __m256i *) &m[(N + j) * n_states]);
+					b0 = _mm256_add_epi32(b0, _mm256_and_si256(m0, vd[j]));
+					b1 = _mm256_add_epi32(b1, _mm256_and_si256(m1, vd[j]));
+				}
+
+				p0 = _mm256_add_epi32(p0, b0);
+				p1 = _mm256_add_epi32(p1, b1);
+
+				/* Select survivor, lower predecessor wins ties */
+				sel = _mm256_cmpgt_epi32(p0, p1);
+				v = _mm256_blendv_epi8(p0, p1, sel);
+				v = _mm256_min_epi32(v, vmax);
+
+				_mm256_storeu_si256((__m256i *) &ae_next[ns], v);
+
+				/* Survivor predecessor states */
+				h = _mm256_add_epi32(_mm256_set1_epi32(ns >> 1), vdup);
+				h = _mm256_add_epi32(h, _mm256_and_si256(sel, vhalf));
+
+				hp = _mm_packs_epi32(_mm256_castsi256_si128(h),
+				                     _mm256_extracti128_si256(h, 1));
+				hp = _mm_packus_epi16(hp, hp);
+				_mm_storel_epi64((__m128i *) &sh[ns], hp);
+			}
+		}
+
+		sh += n_states;
+
+		tmp = ae; ae = ae_next; ae_next = tmp;
+	}
+
+	*ae_p = ae;
+	*ae_next_p = ae_next;
+}
+
+__attribute__((target("avx2"))) static void
+acs_avx2_k5(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_avx2_impl(acc, 16, ae, ae_next, sh, in, n);
+}
+
+__attribute__((target("avx2"))) static void
+acs_avx2_k7(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_avx2_impl(acc, 64, ae, ae_next, sh, in, n);
+}
+
+__attribute__((target("avx2"))) static void
+acs_avx2_gen(const struct osmo_conv_acc *acc, unsigned int **ae,
+             unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_avx2_impl(acc, acc->n_states, ae, ae_next, sh, in, n);
+}
+
+#endif /* CONV_ACC_X86 */
+
+
+/* ------------------------------------------------------------------------ */
+/* ARM kernels                                                              */
+/* ------------------------------------------------------------------------ */
+
+#ifdef CONV_ACC_NEON
+
+/* Needs n_states >= 8 */
+static inline __attribute__((always_inline)) void
+acs_neon_impl(const struct osmo_conv_acc *acc, int n_states,
+              unsigned int **ae_p, unsigned int **ae_next_p,
+              uint8_t *sh, const sbit_t *in, int n)
+{
+	const int N = acc->N;
+	const int half = n_states >> 1;
+	unsigned int *ae = *ae_p, *ae_next = *ae_next_p, *tmp;
+	const int32x4_t vmax  = vdupq_n_s32(MAX_AE);
+	const uint32x4_t vhalf = vdupq_n_u32(half);
+	const uint32_t dup[4] = { 0, 0, 1, 1 };
+	const uint32x4_t vdup = vld1q_u32(dup);
+	int32x4_t vc0, vd[8];
+	int32_t d[8];
+	int i, j, k, s;
+
+	for (i=0; i<n; i++)
+	{
+		vc0 = vdupq_n_s32(conv_step_metrics(&in[i * N], N, d));
+		for (j=0; j<N; j++)
+			vd[j] = vdupq_n_s32(d[j]);
+
+		for (s=0; s<half; s+=4)
+		{
+			int32x4x2_t a0, a1;
+			uint16x4_t h[2];
+
+			a0 = vzipq_s32(vld1q_s32((const int32_t *) &ae[s]),
+			               vld1q_s32((const int32_t *) &ae[s]));
+			a1 = vzipq_s32(vld1q_s32((const int32_t *) &ae[s + half]),
+			               vld1q_s32((const int32_t *) &ae[s + half]));
+
+			for (k=0; k<2; k++)
+			{
+				const int ns = 2 * s + 4 * k;
+				const int32_t *m = &acc->masks[ns];
+				int32x4_t p0, p1, b0, b1, v;
+				uint32x4_t sel, hv;
+
+				b0 = vc0;
+				b1 = vc0;
+				for (j=0; j<N; j++) {
+					b0 = vaddq_s32(b0, vandq_s32(vld1q_s32(&m[j * n_states]), vd[j]));
+					b1 = vaddq_s32(b1, vandq_s32(vld1q_s32(&m[(N + j) * n_states]), vd[j]));
+				}
+
+				p0 = vaddq_s32(a0.val[k], b0);
+				p1 = vaddq_s32(a1.val[k], b1);
+
+				/* Select survivor, lower predecessor wins ties */
+				sel = vcltq_s32(p1, p0);
+				v = vbslq_s32(sel, p1, p0);
+				v = vminq_s32(v, vmax);
+
+				vst1q_s32((int32_t *) &ae_next[ns], v);
+
+				/* Survivor predecessor states */
+				hv = vaddq_u32(vdupq_n_u32(ns >> 1), vdup);
+				hv = vaddq_u32(hv, vandq_u32(sel, vhalf));
+				h[k] = vmovn_u32(hv);
+			}
+
+			vst1_u8(&sh[2 * s], vmovn_u16(vcombine_u16(h[0], h[1])));
+		}
+
+		sh += n_states;
+
+		tmp = ae; ae = ae_next; ae_next = tmp;
+	}
+
+	*ae_p = ae;
+	*ae_next_p = ae_next;
+}
+
+static void
+acs_neon_k5(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_neon_impl(acc, 16, ae, ae_next, sh, in, n);
+}
+
+static void
+acs_neon_k7(const struct osmo_conv_acc *acc, unsigned int **ae,
+            unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_neon_impl(acc, 64, ae, ae_next, sh, in, n);
+}
+
+static void
+acs_neon_gen(const struct osmo_conv_acc *acc, unsigned int **ae,
+             unsigned int **ae_next, uint8_t *sh, const sbit_t *in, int n)
+{
+	acs_neon_impl(acc, acc->n_states, ae, ae_next, sh, in, n);
+}
+
+#endif /* CONV_ACC_NEON */
+
+
+/* ------------------------------------------------------------------------ */
+/* Kernel selection                                                         */
+/* ------------------------------------------------------------------------ */
+
+static int
+conv_acc_supported(enum osmo_conv_acc_type type)
+{
+	switch (type) {
+	case OSMO_CONV_ACC_NONE:
+	case OSMO_CONV_ACC_SCALAR:
+		return 1;
+#ifdef CONV_ACC_X86
+	case OSMO_CONV_ACC_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case OSMO_CONV_ACC_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef CONV_ACC_NEON
+	case OSMO_CONV_ACC_NEON:
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+}
+
+static enum osmo_conv_acc_type
+conv_acc_resolve(void)
+{
+	if (conv_acc_type != OSMO_CONV_ACC_AUTO)
+		return conv_acc_type;
+
+	if (conv_acc_supported(OSMO_CONV_ACC_AVX2))
+		return OSMO_CONV_ACC_AVX2;
+	if (conv_acc_supported(OSMO_CONV_ACC_SSE2))
+		return OSMO_CONV_ACC_SSE2;
+	if (conv_acc_supported(OSMO_CONV_ACC_NEON))
+		return OSMO_CONV_ACC_NEON;
+
+	return OSMO_CONV_ACC_SCALAR;
+}
+
+static conv_acs_fn
+conv_acc_pick(enum osmo_conv_acc_type type, int n_states)
+{
+	switch (type) {
+#ifdef CONV_ACC_X86
+	case OSMO_CONV_ACC_AVX2:
+		if (n_states == 16)
+			return acs_avx2_k5;
+		if (n_states == 64)
+			return acs_avx2_k7;
+		if (n_states >= 16)
+			return acs_avx2_gen;
+		/* fall-through */
+	case OSMO_CONV_ACC_SSE2:
+		if (n_states == 16)
+			return acs_sse2_k5;
+		if (n_states == 64)
+			return acs_sse2_k7;
+		if (n_states >= 8)
+			return acs_sse2_gen;
+		break;
+#endif
+#ifdef CONV_ACC_NEON
+	case OSMO_CONV_ACC_NEON:
+		if (n_states == 16)
+			return acs_neon_k5;
+		if (n_states == 64)
+			return acs_neon_k7;
+		if (n_states >= 8)
+			return acs_neon_gen;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (n_states == 16)
+		return acs_scalar_k5;
+	if (n_states == 64)
+		return acs_scalar_k7;
+	return acs_scalar_gen;
+}
+
+/*! \brief Select the add-compare-select implementation
+ *  \param[in] type implementation to use for decoders initialized from now on
+ *  \returns 0 on success, -ENOTSUP if not supported by this build or CPU
+ */
+int
+osmo_conv_acc_set(enum osmo_conv_acc_type type)
+{
+	if (type != OSMO_CONV_ACC_AUTO && !conv_acc_supported(type))
+		return -ENOTSUP;
+
+	conv_acc_type = type;
+
+	return 0;
+}
+
+/*! \brief Get the add-compare-select implementation in use
+ *  \returns the implementation that new decoders will use
+ */
+enum osmo_conv_acc_type
+osmo_conv_acc_get(void)
+{
+	return conv_acc_resolve();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Decoder glue                                                             */
+/* ------------------------------------------------------------------------ */
+
+/* Returns 1 if the transitions of every state s are 2s and 2s+1 */
+static int
+conv_acc_is_butterfly(const struct osmo_conv_code *code, int n_states)
+{
+	int s, ns;
+
+	for (s=0; s<n_states; s++) {
+		ns = (s << 1) & (n_states - 1);
+
+		if (code->next_state[s][0] == ns && code->next_state[s][1] == ns + 1)
+			continue;
+		if (code->next_state[s][1] == ns && code->next_state[s][0] == ns + 1)
+			continue;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/*! \brief Prepare accelerated decoding of a code
+ *  \param[in] code description of the convolutional code
+ *  \param[in] len number of trellis steps (excl. termination)
+ *  \returns accelerated state, NULL if the code can't be accelerated
+ */
+struct osmo_conv_acc *
+osmo_conv_acc_alloc(const struct osmo_conv_code *code, int len)
+{
+	enum osmo_conv_acc_type type;
+	struct osmo_conv_acc *acc;
+	int n_states, n_bits;
+	int ns, p, j, s;
+
+	type = conv_acc_resolve();
+	if (type == OSMO_CONV_ACC_NONE)
+		return NULL;
+
+	n_states = 1 << (code->K - 1);
+	if (n_states < 2 || code->N > 8)
+		return NULL;
+
+	if (!conv_acc_is_butterfly(code, n_states))
+		return NULL;
+
+	acc = calloc(1, sizeof(*acc));
+	if (!acc)
+		return NULL;
+
+	acc->N = code->N;
+	acc->n_states = n_states;
+	acc->acs = conv_acc_pick(type, n_states);
+
+	acc->out   = malloc(sizeof(uint8_t) * n_states * 2);
+	acc->masks = malloc(sizeof(int32_t) * 2 * code->N * n_states);
+	if (!acc->out || !acc->masks)
+		goto err;
+
+	/* Output words and bit masks of the two transitions into each state */
+	for (ns=0; ns<n_states; ns++) {
+		for (p=0; p<2; p++) {
+			uint8_t out;
+
+			s = (ns >> 1) + p * (n_states >> 1);
+			out = code->next_state[s][0] == ns ?
+				code->next_output[s][0] : code->next_output[s][1];
+
+			acc->out[2 * ns + p] = out;
+
+			for (j=0; j<code->N; j++)
+				acc->masks[(p * code->N + j) * n_states + ns] =
+					(out >> (code->N - j - 1)) & 1 ? -1 : 0;
+		}
+	}
+
+	/* Precomputed puncturing mask */
+	if (code->puncture) {
+		n_bits = (len + code->K - 1) * code->N;
+
+		acc->in    = malloc(sizeof(sbit_t) * n_bits);
+		acc->punct = calloc(n_bits, sizeof(uint8_t));
+		if (!acc->in || !acc->punct)
+			goto err;
+
+		for (j=0; code->puncture[j] >= 0; j++)
+			if (code->puncture[j] < n_bits)
+				acc->punct[code->puncture[j]] = 1;
+	}
+
+	return acc;
+
+err:
+	osmo_conv_acc_free(acc);
+	return NULL;
+}
+
+/*! \brief Release accelerated decoding state */
+void
+osmo_conv_acc_free(struct osmo_conv_acc *acc)
+{
+	if (!acc)
+		return;
+
+	free(acc->out);
+	free(acc->masks);
+	free(acc->in);
+	free(acc->punct);
+	free(acc);
+}
+
+/*! \brief Accelerated equivalent of \ref osmo_conv_decode_scan */
+int
+osmo_conv_acc_scan(struct osmo_conv_decoder *decoder,
+                   const sbit_t *input, int n)
+{
+	struct osmo_conv_acc *acc = decoder->acc;
+	const int N = acc->N;
+	const sbit_t *in = input;
+	int i_idx = n * N;
+
+	/* Depuncture in one pass */
+	if (acc->punct) {
+		const uint8_t *punct = &acc->punct[decoder->o_idx * N];
+		int t, p_cnt = 0;
+
+		i_idx = 0;
+
+		for (t=0; t<n*N; t++) {
+			if (punct[t]) {
+				acc->in[t] = 0;	/* Undefined */
+				p_cnt++;
+			} else {
+				acc->in[t] = input[i_idx++];
+			}
+		}
+
+		decoder->p_idx += p_cnt;
+		in = acc->in;
+	}
+
+	acc->acs(acc, &decoder->ae, &decoder->ae_next,
+		&decoder->state_history[decoder->n_states * decoder->o_idx],
+		in, n);
+
+	decoder->o_idx += n;
+
+	return i_idx;
+}
+
+/*! @} */
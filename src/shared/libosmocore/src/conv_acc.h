@@ -0,0 +1,37 @@
+/*
+ * conv_acc.h
+ *
+ * Accelerated Viterbi add-compare-select (internal)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __OSMO_CONV_ACC_H__
+#define __OSMO_CONV_ACC_H__
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+
+/* Maximum accumulated error, shared with the generic decoder */
+#define MAX_AE 0x00ffffff
+
+struct osmo_conv_acc *osmo_conv_acc_alloc(const struct osmo_conv_code *code,
+                                          int len);
+void osmo_conv_acc_free(struct osmo_conv_acc *acc);
+
+int osmo_conv_acc_scan(struct osmo_conv_decoder *decoder,
+                       const sbit_t *input, int n);
+
+#endif /* __OSMO_CONV_ACC_H__ */
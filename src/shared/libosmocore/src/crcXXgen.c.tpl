@@ -31,11 +31,144 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/crcXXgen.h>
 
 
+/*
+ * The table-driven variants keep the CRC state left aligned in the
+ * register, so that the next input byte is always XOR'ed onto the
+ * top 8 bits, whatever the actual width of the code.
+ */
+
+#define TOP_BIT		((uintXX_t)1 << (XX - 1))
+
+static inline uintXX_t
+_crcXX_shift_bit(uintXX_t crc, uintXX_t poly, unsigned int bit)
+{
+	crc ^= (uintXX_t)bit << (XX - 1);
+	if (crc & TOP_BIT)
+		return (crc << 1) ^ poly;
+	return crc << 1;
+}
+
+/* Advance the left aligned state over n whole bytes */
+static uintXX_t
+_crcXX_bytes(const struct osmo_crcXXgen_table *tab, uintXX_t crc,
+             const uint8_t *in, int n)
+{
+	uintXX_t v;
+	int i;
+
+	/* Slicing: a group of bytes as wide as the state at once */
+	while (n >= OSMO_CRCXXGEN_SLICES) {
+		for (i=0; i<OSMO_CRCXXGEN_SLICES; i++)
+			crc ^= (uintXX_t)in[i] << (XX - 8 - 8*i);
+
+		v = 0;
+		for (i=0; i<OSMO_CRCXXGEN_SLICES; i++)
+			v ^= tab->t[OSMO_CRCXXGEN_SLICES-1-i]
+			           [(crc >> (XX - 8 - 8*i)) & 0xff];
+
+		crc = v;
+		in += OSMO_CRCXXGEN_SLICES;
+		n -= OSMO_CRCXXGEN_SLICES;
+	}
+
+	while (n--)
+		crc = (uintXX_t)(crc << 8) ^
+		      tab->t[0][((crc >> (XX - 8)) ^ *in++) & 0xff];
+
+	return crc;
+}
+
+/* Pack 8 hard bits into a byte, MSB first */
+static inline uint8_t
+_crcXX_pack8(const ubit_t *in)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t w;
+
+	/* Multiplication gathers bit 0 of each byte into the top byte */
+	memcpy(&w, in, sizeof(w));
+	w &= 0x0101010101010101ULL;
+	return (w * 0x8040201008040201ULL) >> 56;
+#else
+	uint8_t b = 0;
+	int i;
+
+	for (i=0; i<8; i++)
+		b = (b << 1) | (in[i] & 1);
+	return b;
+#endif
+}
+
+/*! \brief Fill in the lookup tables of a CRC code
+ *  \param[out] table The tables to fill in
+ *  \param[in] code The CRC code description
+ *
+ * Assign the tables to the \a table member of \a code in order to
+ * make \ref osmo_crcXXgen_compute_bits process 8 bits per lookup
+ * instead of one bit at a time. The results are the same.
+ */
+void
+osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *table,
+                         const struct osmo_crcXXgen_code *code)
+{
+	const uintXX_t poly = code->poly << (XX - code->bits);
+	uintXX_t crc;
+	int i, j;
+
+	for (i=0; i<256; i++) {
+		crc = (uintXX_t)i << (XX - 8);
+		for (j=0; j<8; j++)
+			crc = (crc & TOP_BIT) ? (crc << 1) ^ poly : crc << 1;
+		table->t[0][i] = crc;
+	}
+
+	/* Same byte, followed by j zero bytes */
+	for (j=1; j<OSMO_CRCXXGEN_SLICES; j++) {
+		for (i=0; i<256; i++) {
+			crc = table->t[j-1][i];
+			table->t[j][i] = (uintXX_t)(crc << 8) ^
+			                 table->t[0][(crc >> (XX - 8)) & 0xff];
+		}
+	}
+}
+
+static uintXX_t
+_crcXX_compute_bits_table(const struct osmo_crcXXgen_code *code,
+                          const ubit_t *in, int len)
+{
+	const int shift = XX - code->bits;
+	const uintXX_t poly = code->poly << shift;
+	uintXX_t crc = code->init << shift;
+	uint8_t buf[64];
+	int i, n;
+
+	/* Pack a chunk at a time, then run it through the tables */
+	while (len >= 8) {
+		n = len / 8;
+		if (n > sizeof(buf))
+			n = sizeof(buf);
+
+		for (i=0; i<n; i++)
+			buf[i] = _crcXX_pack8(in + 8*i);
+
+		crc = _crcXX_bytes(code->table, crc, buf, n);
+		in += 8*n;
+		len -= 8*n;
+	}
+
+	for (i=0; i<len; i++)
+		crc = _crcXX_shift_bit(crc, poly, in[i] & 1);
+
+	return (crc >> shift) ^ code->remainder;
+}
+
+
 /*! \brief Compute the CRC value of a given array of hard-bits
  *  \param[in] code The CRC code description to apply
  *  \param[in] in Array of hard bits
@@ -50,16 +183,19 @@ osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
 	uintXX_t crc = code->init;
 	int i, n = code->bits-1;
 
+	if (code->table)
+		return _crcXX_compute_bits_table(code, in, len);
+
 	for (i=0; i<len; i++) {
 		uintXX_t bit = in[i] & 1;
 		crc ^= (bit << n);
-		if (crc & (1 << n)) {
+		if (crc & ((uintXX_t)1 << n)) {
 			crc <<= 1;
 			crc ^= poly;
 		} else {
 			crc <<= 1;
 		}
-		crc &= (1ULL << code->bits) - 1;
+		crc &= (uintXX_t)~0 >> (XX - code->bits);
 	}
 
 	crc ^= code->remainder;
@@ -68,6 +204,39 @@ osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
 }
 
 
+/*! \brief Compute the CRC value of a given array of packed bits
+ *  \param[in] code The CRC code description to apply
+ *  \param[in] in Array of packed bits, MSB first
+ *  \param[in] len Number of bits in the array
+ *  \returns The CRC value
+ *
+ * Same as \ref osmo_crcXXgen_compute_bits, without the need to unpack
+ * the bits first. Uses the tables of \a code if set.
+ */
+uintXX_t
+osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_code *code,
+                            const pbit_t *in, int len)
+{
+	const int shift = XX - code->bits;
+	const uintXX_t poly = code->poly << shift;
+	uintXX_t crc = code->init << shift;
+	int i, nbytes = len / 8;
+
+	if (code->table) {
+		crc = _crcXX_bytes(code->table, crc, in, nbytes);
+	} else {
+		for (i=0; i<nbytes*8; i++)
+			crc = _crcXX_shift_bit(crc, poly,
+			                       (in[i/8] >> (7 - i%8)) & 1);
+	}
+
+	for (i=nbytes*8; i<len; i++)
+		crc = _crcXX_shift_bit(crc, poly, (in[i/8] >> (7 - i%8)) & 1);
+
+	return (crc >> shift) ^ code->remainder;
+}
+
+
 /*! \brief Checks the CRC value of a given array of hard-bits
  *  \param[in] code The CRC code description to apply
  *  \param[in] in Array of hard bits
@@ -236,7 +236,7 @@ int bssgp_create_cell_id(uint8_t *buf, const struct gprs_ra_id *raid,
 }
 
 /* Chapter 8.4 BVC-Reset Procedure */
-static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,	
+static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_sparse *tp,	
 			      uint16_t ns_bvci)
 {
 	struct osmo_bssgp_prim nmp;
@@ -288,7 +288,7 @@ static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,
 	return 0;
 }
 
-static int bssgp_rx_bvc_block(struct msgb *msg, struct tlv_parsed *tp)
+static int bssgp_rx_bvc_block(struct msgb *msg, struct tlv_sparse *tp)
 {
 	struct osmo_bssgp_prim nmp;
 	uint16_t bvci;
@@ -326,7 +326,7 @@ static int bssgp_rx_bvc_block(struct msgb *msg, struct tlv_parsed *tp)
 				    bvci, msgb_bvci(msg));
 };
 
-static int bssgp_rx_bvc_unblock(struct msgb *msg, struct tlv_parsed *tp)
+static int bssgp_rx_bvc_unblock(struct msgb *msg, struct tlv_sparse *tp)
 {
 	struct osmo_bssgp_prim nmp;
 	uint16_t bvci;
@@ -364,7 +364,7 @@ static int bssgp_rx_bvc_unblock(struct msgb *msg, struct tlv_parsed *tp)
 };
 
 /* Uplink unit-data */
-static int bssgp_rx_ul_ud(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_ul_ud(struct msgb *msg, struct tlv_sparse *tp,
 			  struct bssgp_bvc_ctx *ctx)
 {
 	struct osmo_bssgp_prim gbp;
@@ -398,7 +398,7 @@ static int bssgp_rx_ul_ud(struct msgb *msg, struct tlv_parsed *tp,
 	return bssgp_prim_cb(&gbp.oph, NULL);
 }
 
-static int bssgp_rx_suspend(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_suspend(struct msgb *msg, struct tlv_sparse *tp,
 			    struct bssgp_bvc_ctx *ctx)
 {
 	struct osmo_bssgp_prim gbp;
@@ -438,7 +438,7 @@ static int bssgp_rx_suspend(struct msgb *msg, struct tlv_parsed *tp,
 	return 0;
 }
 
-static int bssgp_rx_resume(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_resume(struct msgb *msg, struct tlv_sparse *tp,
 			   struct bssgp_bvc_ctx *ctx)
 {
 	struct osmo_bssgp_prim gbp;
@@ -482,7 +482,7 @@ static int bssgp_rx_resume(struct msgb *msg, struct tlv_parsed *tp,
 }
 
 
-static int bssgp_rx_llc_disc(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_llc_disc(struct msgb *msg, struct tlv_sparse *tp,
 			     struct bssgp_bvc_ctx *ctx)
 {
 	struct osmo_bssgp_prim nmp;
@@ -739,7 +739,7 @@ int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
 	return 0;
 }
 
-static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_sparse *tp,
 			   struct bssgp_bvc_ctx *bctx)
 {
 
@@ -775,7 +775,7 @@ static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
 }
 
 /* Receive a BSSGP PDU from a BSS on a PTP BVCI */
-static int bssgp_rx_ptp(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_ptp(struct msgb *msg, struct tlv_sparse *tp,
 			struct bssgp_bvc_ctx *bctx)
 {
 	struct bssgp_normal_hdr *bgph =
@@ -854,7 +854,7 @@ static int bssgp_rx_ptp(struct msgb *msg, struct tlv_parsed *tp,
 }
 
 /* Receive a BSSGP PDU from a BSS on a SIGNALLING BVCI */
-static int bssgp_rx_sign(struct msgb *msg, struct tlv_parsed *tp,
+static int bssgp_rx_sign(struct msgb *msg, struct tlv_sparse *tp,
 			 struct bssgp_bvc_ctx *bctx)
 {
 	struct bssgp_normal_hdr *bgph =
@@ -949,7 +949,7 @@ int bssgp_rcvmsg(struct msgb *msg)
 	struct bssgp_normal_hdr *bgph =
 			(struct bssgp_normal_hdr *) msgb_bssgph(msg);
 	struct bssgp_ud_hdr *budh = (struct bssgp_ud_hdr *) msgb_bssgph(msg);
-	struct tlv_parsed tp;
+	struct tlv_sparse tp;
 	struct bssgp_bvc_ctx *bctx;
 	uint8_t pdu_type = bgph->pdu_type;
 	uint16_t ns_bvci = msgb_bvci(msg);
@@ -962,10 +962,10 @@ int bssgp_rcvmsg(struct msgb *msg)
 	if (pdu_type != BSSGP_PDUT_UL_UNITDATA &&
 	    pdu_type != BSSGP_PDUT_DL_UNITDATA) {
 		data_len = msgb_bssgp_len(msg) - sizeof(*bgph);
-		rc = bssgp_tlv_parse(&tp, bgph->data, data_len);
+		rc = bssgp_tlv_parse_sparse(&tp, bgph->data, data_len);
 	} else {
 		data_len = msgb_bssgp_len(msg) - sizeof(*budh);
-		rc = bssgp_tlv_parse(&tp, budh->data, data_len);
+		rc = bssgp_tlv_parse_sparse(&tp, budh->data, data_len);
 	}
 
 	/* look-up or create the BTS context for this BVC */
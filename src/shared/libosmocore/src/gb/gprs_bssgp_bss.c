@@ -472,14 +472,14 @@ int bssgp_rx_paging(struct bssgp_paging_info *pinfo,
 {
 	struct bssgp_normal_hdr *bgph =
 			(struct bssgp_normal_hdr *) msgb_bssgph(msg);
-	struct tlv_parsed tp;
+	struct tlv_sparse tp;
 	uint8_t ra[6];
 	int rc, data_len;
 
 	memset(ra, 0, sizeof(ra));
 
 	data_len = msgb_bssgp_len(msg) - sizeof(*bgph);
-	rc = bssgp_tlv_parse(&tp, bgph->data, data_len);
+	rc = bssgp_tlv_parse_sparse(&tp, bgph->data, data_len);
 	if (rc < 0)
 		goto err_mand_ie;
 
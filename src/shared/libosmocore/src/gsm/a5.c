@@ -35,6 +35,7 @@
  */
 
 #include <string.h>
+#include <stdint.h>
 
 #include <osmocom/gsm/a5.h>
 
@@ -233,6 +234,10 @@ osmo_a5_1(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 			dl[i] = _a5_1_get_output(r);
 	}
 
+	/* The uplink stream only follows the downlink one */
+	if (!ul)
+		return;
+
 	for (i=0; i<114; i++) {
 		_a5_1_clock(r, 0);
 		if (ul)
@@ -295,7 +300,7 @@ _a5_2_get_output(uint32_t r[])
 	return b;
 }
 
-/*! \brief Generate a GSM A5/1 cipher stream
+/*! \brief Generate a GSM A5/2 cipher stream
  *  \param[in] key 8 byte array for the key (as received from the SIM)
  *  \param[in] fn Frame number
  *  \param[out] dl Pointer to array of ubits to return Downlink cipher stream
@@ -357,6 +362,10 @@ osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 			dl[i] = _a5_2_get_output(r);
 	}
 
+	/* The uplink stream only follows the downlink one */
+	if (!ul)
+		return;
+
 	for (i=0; i<114; i++) {
 		_a5_2_clock(r, 0);
 		if (ul)
@@ -364,4 +373,323 @@ osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 	}
 }
 
+/* ------------------------------------------------------------------------ */
+/* Bit-sliced A5/1&2                                                        */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Each register bit is held in a word whose bit 'l' belongs to lane 'l',
+ * so that one pass over the algorithm generates the cipher streams of
+ * A5_BS_LANES (key, frame number) couples at once. The irregular clocking
+ * becomes a per-lane select between the shifted and unshifted state.
+ * Words are 256, 128 or 64 bit wide depending on the SIMD level the
+ * library is built for.
+ */
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#define A5_BS_WORDS	4
+typedef uint64_t a5_bs_t __attribute__((vector_size(8 * A5_BS_WORDS)));
+#elif defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define A5_BS_WORDS	2
+typedef uint64_t a5_bs_t __attribute__((vector_size(8 * A5_BS_WORDS)));
+#else
+#define A5_BS_WORDS	1
+typedef uint64_t a5_bs_t;
+#endif
+
+#define A5_BS_LANES	(64 * A5_BS_WORDS)
+
+/* Below this number of streams, the plain implementation is faster */
+#define A5_BS_MIN_STREAMS	8
+
+union a5_bs_word {
+	a5_bs_t v;
+	uint64_t w[A5_BS_WORDS];
+};
+
+/*! \brief Bit-sliced register state, one word per register bit */
+struct a5_bs_state {
+	a5_bs_t r1[A5_R1_LEN];
+	a5_bs_t r2[A5_R2_LEN];
+	a5_bs_t r3[A5_R3_LEN];
+	a5_bs_t r4[A5_R4_LEN];
+};
+
+static inline a5_bs_t
+_a5_bs_maj(a5_bs_t a, a5_bs_t b, a5_bs_t c)
+{
+	return (a & b) | (a & c) | (b & c);
+}
+
+/*! \brief Shift a bit-sliced register in the lanes selected by \a clk */
+static inline void
+_a5_bs_shift(a5_bs_t *r, int len, a5_bs_t fb, a5_bs_t clk)
+{
+	int j;
+
+	for (j=len-1; j>0; j--)
+		r[j] ^= (r[j] ^ r[j-1]) & clk;
+	r[0] ^= (r[0] ^ fb) & clk;
+}
+
+/*! \brief Shift all lanes of a bit-sliced register, loading \a fb */
+static inline void
+_a5_bs_shift_all(a5_bs_t *r, int len, a5_bs_t fb)
+{
+	memmove(&r[1], &r[0], sizeof(a5_bs_t) * (len - 1));
+	r[0] = fb;
+}
+
+/* Feedback of the four LFSRs, see the A5_Rx_TAPS polynomials */
+#define A5_BS_R1_FB(s)	((s)->r1[13] ^ (s)->r1[16] ^ (s)->r1[17] ^ (s)->r1[18])
+#define A5_BS_R2_FB(s)	((s)->r2[20] ^ (s)->r2[21])
+#define A5_BS_R3_FB(s)	((s)->r3[7] ^ (s)->r3[20] ^ (s)->r3[21] ^ (s)->r3[22])
+#define A5_BS_R4_FB(s)	((s)->r4[11] ^ (s)->r4[16])
+
+/*! \brief Forced clocking of all registers, xor-ing \a b in (load phase) */
+static inline void
+_a5_bs_clock_load(struct a5_bs_state *s, a5_bs_t b, int a52)
+{
+	_a5_bs_shift_all(s->r1, A5_R1_LEN, A5_BS_R1_FB(s) ^ b);
+	_a5_bs_shift_all(s->r2, A5_R2_LEN, A5_BS_R2_FB(s) ^ b);
+	_a5_bs_shift_all(s->r3, A5_R3_LEN, A5_BS_R3_FB(s) ^ b);
+	if (a52)
+		_a5_bs_shift_all(s->r4, A5_R4_LEN, A5_BS_R4_FB(s) ^ b);
+}
+
+static inline void
+_a5_bs_1_clock(struct a5_bs_state *s)
+{
+	a5_bs_t c1 = s->r1[8], c2 = s->r2[10], c3 = s->r3[10];
+	a5_bs_t maj = _a5_bs_maj(c1, c2, c3);
+
+	_a5_bs_shift(s->r1, A5_R1_LEN, A5_BS_R1_FB(s), ~(c1 ^ maj));
+	_a5_bs_shift(s->r2, A5_R2_LEN, A5_BS_R2_FB(s), ~(c2 ^ maj));
+	_a5_bs_shift(s->r3, A5_R3_LEN, A5_BS_R3_FB(s), ~(c3 ^ maj));
+}
+
+static inline a5_bs_t
+_a5_bs_1_get_output(const struct a5_bs_state *s)
+{
+	return s->r1[18] ^ s->r2[21] ^ s->r3[22];
+}
+
+static inline void
+_a5_bs_2_clock(struct a5_bs_state *s)
+{
+	a5_bs_t c1 = s->r4[10], c2 = s->r4[3], c3 = s->r4[7];
+	a5_bs_t maj = _a5_bs_maj(c1, c2, c3);
+
+	_a5_bs_shift(s->r1, A5_R1_LEN, A5_BS_R1_FB(s), ~(c1 ^ maj));
+	_a5_bs_shift(s->r2, A5_R2_LEN, A5_BS_R2_FB(s), ~(c2 ^ maj));
+	_a5_bs_shift(s->r3, A5_R3_LEN, A5_BS_R3_FB(s), ~(c3 ^ maj));
+	_a5_bs_shift_all(s->r4, A5_R4_LEN, A5_BS_R4_FB(s));
+}
+
+static inline a5_bs_t
+_a5_bs_2_get_output(const struct a5_bs_state *s)
+{
+	return s->r1[18] ^ s->r2[21] ^ s->r3[22] ^
+	       _a5_bs_maj( s->r1[15], ~s->r1[14],  s->r1[12]) ^
+	       _a5_bs_maj(~s->r2[16],  s->r2[13],  s->r2[9]) ^
+	       _a5_bs_maj( s->r3[18],  s->r3[16], ~s->r3[13]);
+}
+
+/*! \brief Spread output word \a o of clock \a i over the lane streams */
+static inline void
+_a5_bs_store(a5_bs_t o, int i, unsigned int lanes,
+             ubit_t *u, pbit_t *p)
+{
+	union a5_bs_word w = { .v = o };
+	unsigned int l;
+
+	for (l=0; l<lanes; l++) {
+		uint8_t b = (w.w[l >> 6] >> (l & 63)) & 1;
+
+		if (u)
+			u[l * 114 + i] = b;
+		else
+			p[l * 15 + (i >> 3)] |= b << (7 - (i & 7));
+	}
+}
+
+/*! \brief Generate the streams of up to A5_BS_LANES (key, fn) couples */
+static void
+_a5_bs(int a52, const uint8_t *keys, unsigned int key_step,
+       const uint32_t *fn, unsigned int lanes,
+       ubit_t *dl, ubit_t *ul, pbit_t *dl_p, pbit_t *ul_p)
+{
+	struct a5_bs_state s;
+	union a5_bs_word b;
+	uint32_t fn_count[A5_BS_LANES];
+	unsigned int l;
+	int i;
+
+	memset(&s, 0x00, sizeof(s));
+
+	for (l=0; l<lanes; l++)
+		fn_count[l] = osmo_a5_fn_count(fn[l]);
+
+	/* Key load */
+	for (i=0; i<64; i++)
+	{
+		memset(&b, 0x00, sizeof(b));
+
+		for (l=0; l<lanes; l++) {
+			const uint8_t *key = &keys[l * key_step];
+			if ((key[7 - (i>>3)] >> (i&7)) & 1)
+				b.w[l >> 6] |= 1ULL << (l & 63);
+		}
+
+		_a5_bs_clock_load(&s, b.v, a52);
+	}
+
+	/* Frame count load */
+	for (i=0; i<22; i++)
+	{
+		memset(&b, 0x00, sizeof(b));
+
+		for (l=0; l<lanes; l++)
+			if ((fn_count[l] >> i) & 1)
+				b.w[l >> 6] |= 1ULL << (l & 63);
+
+		_a5_bs_clock_load(&s, b.v, a52);
+	}
+
+	if (a52) {
+		memset(&b, 0xff, sizeof(b));
+
+		s.r1[15] = b.v;
+		s.r2[16] = b.v;
+		s.r3[18] = b.v;
+		s.r4[10] = b.v;
+
+		/* Mix */
+		for (i=0; i<99; i++)
+			_a5_bs_2_clock(&s);
+	} else {
+		/* Mix */
+		for (i=0; i<100; i++)
+			_a5_bs_1_clock(&s);
+	}
+
+	/* Output */
+	for (i=0; i<114; i++) {
+		a5_bs_t o;
+
+		if (a52) {
+			_a5_bs_2_clock(&s);
+			o = _a5_bs_2_get_output(&s);
+		} else {
+			_a5_bs_1_clock(&s);
+			o = _a5_bs_1_get_output(&s);
+		}
+
+		if (dl || dl_p)
+			_a5_bs_store(o, i, lanes, dl, dl_p);
+	}
+
+	if (!ul && !ul_p)
+		return;
+
+	for (i=0; i<114; i++) {
+		a5_bs_t o;
+
+		if (a52) {
+			_a5_bs_2_clock(&s);
+			o = _a5_bs_2_get_output(&s);
+		} else {
+			_a5_bs_1_clock(&s);
+			o = _a5_bs_1_get_output(&s);
+		}
+
+		_a5_bs_store(o, i, lanes, ul, ul_p);
+	}
+}
+
+static void
+_a5_multi(int n, const uint8_t *keys, unsigned int key_step,
+          const uint32_t *fn, unsigned int count,
+          ubit_t *dl, ubit_t *ul, pbit_t *dl_p, pbit_t *ul_p)
+{
+	unsigned int i, lanes;
+
+	if (dl_p)
+		memset(dl_p, 0x00, 15 * count);
+	if (ul_p)
+		memset(ul_p, 0x00, 15 * count);
+
+	if (n == 0) {
+		if (dl)
+			memset(dl, 0x00, 114 * count);
+		if (ul)
+			memset(ul, 0x00, 114 * count);
+		return;
+	}
+
+	/* a5/[3..7] not supported here/yet */
+	if (n != 1 && n != 2)
+		return;
+
+	for (i=0; i<count; i+=lanes)
+	{
+		lanes = count - i;
+		if (lanes > A5_BS_LANES)
+			lanes = A5_BS_LANES;
+
+		_a5_bs(n == 2, &keys[i * key_step], key_step, &fn[i], lanes,
+			dl ? &dl[i * 114] : NULL, ul ? &ul[i * 114] : NULL,
+			dl_p ? &dl_p[i * 15] : NULL, ul_p ? &ul_p[i * 15] : NULL);
+	}
+}
+
+/*! \brief Generate many A5/x cipher streams at once
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] keys 8 byte keys, the one of stream i is at keys[i * key_step]
+ *  \param[in] key_step 0 to use the same key for all streams, 8 otherwise
+ *  \param[in] fn Array of \a count frame numbers
+ *  \param[in] count Number of cipher streams to generate
+ *  \param[out] dl Array of count * 114 ubits for the Downlink cipher streams
+ *  \param[out] ul Array of count * 114 ubits for the Uplink cipher streams
+ *
+ * Produces the same output as \a count calls of \ref osmo_a5, but computes
+ * up to A5_BS_LANES streams in parallel using a bit-sliced implementation.
+ * Either (or both) of dl/ul can be NULL if not needed.
+ */
+void
+osmo_a5_multi(int n, const uint8_t *keys, unsigned int key_step,
+              const uint32_t *fn, unsigned int count, ubit_t *dl, ubit_t *ul)
+{
+	unsigned int i;
+
+	if (count < A5_BS_MIN_STREAMS) {
+		for (i=0; i<count; i++)
+			osmo_a5(n, &keys[i * key_step], fn[i],
+				dl ? &dl[i * 114] : NULL, ul ? &ul[i * 114] : NULL);
+		return;
+	}
+
+	_a5_multi(n, keys, key_step, fn, count, dl, ul, NULL, NULL);
+}
+
+/*! \brief Generate many A5/x cipher streams at once, as packed bits
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] keys 8 byte keys, the one of stream i is at keys[i * key_step]
+ *  \param[in] key_step 0 to use the same key for all streams, 8 otherwise
+ *  \param[in] fn Array of \a count frame numbers
+ *  \param[in] count Number of cipher streams to generate
+ *  \param[out] dl Array of count * 15 bytes for the Downlink cipher streams
+ *  \param[out] ul Array of count * 15 bytes for the Uplink cipher streams
+ *
+ * Same as \ref osmo_a5_multi but each 114 bit stream is stored as 15 bytes
+ * of packed bits (MSB first, last 6 bits zero).
+ */
+void
+osmo_a5_multi_pbit(int n, const uint8_t *keys, unsigned int key_step,
+                   const uint32_t *fn, unsigned int count,
+                   pbit_t *dl, pbit_t *ul)
+{
+	_a5_multi(n, keys, key_step, fn, count, NULL, NULL, dl, ul);
+}
+
 /*! @} */
@@ -61,6 +61,40 @@ int16_t rxlev_stat_get_next(const struct rxlev_stats *st, uint8_t rxlev, int16_t
 	return bitvec_find_bit_pos(&bv, arfcn+1, ONE);
 }
 
+/* get up to n ARFCNs with the highest Rxlev, strongest first. ARFCNs of
+ * equal Rxlev are returned in ascending order. rxlevs may be NULL. An
+ * ARFCN recorded at several Rxlevs is only returned at the highest. */
+int rxlev_stat_get_strongest(const struct rxlev_stats *st, uint16_t *arfcns,
+			     uint8_t *rxlevs, unsigned int n)
+{
+	uint8_t seen[NUM_ARFCNS/8];
+	struct bitvec bv;
+	unsigned int num = 0;
+	int rxlev, arfcn;
+
+	memset(seen, 0, sizeof(seen));
+
+	bv.data_len = NUM_ARFCNS/8;
+
+	for (rxlev = NUM_RXLEVS-1; rxlev >= 0 && num < n; rxlev--) {
+		bv.data = (uint8_t *) st->rxlev_buckets[rxlev];
+
+		arfcn = bitvec_find_bit_pos(&bv, 0, ONE);
+		while (arfcn >= 0 && num < n) {
+			if (!(seen[arfcn >> 3] & (1 << (arfcn & 7)))) {
+				seen[arfcn >> 3] |= 1 << (arfcn & 7);
+				arfcns[num] = arfcn;
+				if (rxlevs)
+					rxlevs[num] = rxlev;
+				num++;
+			}
+			arfcn = bitvec_find_bit_pos(&bv, arfcn+1, ONE);
+		}
+	}
+
+	return num;
+}
+
 void rxlev_stat_reset(struct rxlev_stats *st)
 {
 	memset(st, 0, sizeof(*st));
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/gsm/tlv.h>
 
@@ -183,6 +184,81 @@ int tlv_parse(struct tlv_parsed *dec, const struct tlv_definition *def,
 	return num_parsed;
 }
 
+static int tlv_sparse_add(struct tlv_sparse *dec, uint8_t tag,
+			  uint16_t len, const uint8_t *val)
+{
+	struct tlv_sparse_ie *ie;
+
+	if (dec->num >= TLV_SPARSE_MAX_IE)
+		return -4;
+
+	ie = &dec->ie[dec->num];
+	ie->tag = tag;
+	ie->len = len;
+	ie->val = val;
+
+	dec->present[tag >> 5] |= 1U << (tag & 31);
+	dec->idx[tag] = dec->num++;
+
+	return 0;
+}
+
+/*! \brief Parse an entire buffer of TLV encoded IEs into a \ref tlv_sparse
+ *  \param[out] dec caller-allocated pointer to \ref tlv_sparse
+ *  \param[in] def structure defining the valid TLV tags / configurations
+ *  \param[in] buf the input data buffer to be parsed
+ *  \param[in] buf_len length of the input data buffer
+ *  \param[in] lv_tag an initial LV tag at the start of the buffer
+ *  \param[in] lv_tag2 a second initial LV tag following the \a lv_tag
+ *  \returns number of IEs parsed, negative in case of error
+ *
+ * Same as \ref tlv_parse, but only touches as much memory as there
+ * are IEs in the buffer.  Fails with -4 if there are more than
+ * \ref TLV_SPARSE_MAX_IE of them.
+ */
+int tlv_parse_sparse(struct tlv_sparse *dec, const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		     uint8_t lv_tag2)
+{
+	const uint8_t lv_tags[2] = { lv_tag, lv_tag2 };
+	int ofs = 0, i, rc;
+	uint16_t len;
+
+	memset(dec->present, 0, sizeof(dec->present));
+	dec->num = 0;
+
+	for (i = 0; i < 2; i++) {
+		if (!lv_tags[i])
+			continue;
+		if (ofs >= buf_len)
+			return -1;
+		len = buf[ofs] + 1;
+		if (ofs + len > buf_len)
+			return -2;
+		rc = tlv_sparse_add(dec, lv_tags[i], buf[ofs], &buf[ofs+1]);
+		if (rc < 0)
+			return rc;
+		ofs += len;
+	}
+
+	while (ofs < buf_len) {
+		uint8_t tag;
+		const uint8_t *val;
+
+		rc = tlv_parse_one(&tag, &len, &val, def,
+				   &buf[ofs], buf_len-ofs);
+		if (rc < 0)
+			return rc;
+		ofs += rc;
+
+		rc = tlv_sparse_add(dec, tag, len, val);
+		if (rc < 0)
+			return rc;
+	}
+
+	return dec->num;
+}
+
 /*! \brief take a master (src) tlvdev and fill up all empty slots in 'dst' */
 void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src)
 {
@@ -52,6 +52,9 @@ static struct log_context log_context;
 static void *tall_log_ctx = NULL;
 LLIST_HEAD(osmo_log_target_list);
 
+uint16_t *osmo_log_level_mask = NULL;
+int osmo_log_level_mask_len = 0;
+
 #define LOGLEVEL_DEFS	6	/* Number of loglevels.*/
 
 static const struct value_string loglevel_strs[LOGLEVEL_DEFS+1] = {
@@ -205,6 +208,46 @@ void log_parse_category_mask(struct log_target* target, const char *_mask)
 	} while ((category_token = strtok(NULL, ":")));
 
 	free(mask);
+	log_cache_update();
+}
+
+/*! \brief Recompute \ref osmo_log_level_mask from all registered targets
+ *
+ * Called by the log_set_*() functions and on target (de)registration,
+ * needs to be called explicitly after modifying a registered
+ * \ref log_target or its categories directly.
+ */
+void log_cache_update(void)
+{
+	struct log_target *tar;
+	int i;
+
+	if (!osmo_log_level_mask)
+		return;
+
+	for (i = 0; i < osmo_log_level_mask_len; i++) {
+		int subsys = i - OSMO_NUM_DLIB;
+		uint16_t mask = 0;
+
+		if (subsys < 0)
+			subsys = subsys_lib2index(subsys);
+
+		llist_for_each_entry(tar, &osmo_log_target_list, entry) {
+			struct log_category *category;
+			int level;
+
+			category = &tar->categories[subsys];
+			if (!category->enabled)
+				continue;
+
+			/* same precedence as in osmo_vlogp() */
+			level = tar->loglevel ? tar->loglevel : category->loglevel;
+			if (level < 16)
+				mask |= 0xffff << level;
+		}
+
+		osmo_log_level_mask[i] = mask;
+	}
 }
 
 static const char* color(int subsys)
@@ -313,7 +356,12 @@ void osmo_vlogp(int subsys, int level, const char *file, int line,
 		 * in undefined state. Since _output uses vsnprintf and it may
 		 * be called several times, we have to pass a copy of ap. */
 		va_copy(bp, ap);
-		_output(tar, subsys, level, file, line, cont, format, bp);
+		if (tar->raw_output)
+			tar->raw_output(tar, subsys, level, file, line, cont,
+					format, bp);
+		else
+			_output(tar, subsys, level, file, line, cont,
+				format, bp);
 		va_end(bp);
 	}
 }
@@ -343,6 +391,7 @@ void logp2(int subsys, unsigned int level, const char *file, int line, int cont,
 void log_add_target(struct log_target *target)
 {
 	llist_add_tail(&target->entry, &osmo_log_target_list);
+	log_cache_update();
 }
 
 /*! \brief Unregister a log target from the logging core
@@ -351,6 +400,7 @@ void log_add_target(struct log_target *target)
 void log_del_target(struct log_target *target)
 {
 	llist_del(&target->entry);
+	log_cache_update();
 }
 
 /*! \brief Reset (clear) the logging context */
@@ -429,6 +479,7 @@ void log_set_print_filename(struct log_target *target, int print_filename)
 void log_set_log_level(struct log_target *target, int log_level)
 {
 	target->loglevel = log_level;
+	log_cache_update();
 }
 
 void log_set_category_filter(struct log_target *target, int category,
@@ -438,6 +489,7 @@ void log_set_category_filter(struct log_target *target, int category,
 		return;
 	target->categories[category].enabled = !!enable;
 	target->categories[category].loglevel = level;
+	log_cache_update();
 }
 
 static void _file_output(struct log_target *target, unsigned int level,
@@ -543,6 +595,9 @@ struct log_target *log_target_find(int type, const char *fname)
 		if (tgt->type == LOG_TGT_TYPE_FILE) {
 			if (!strcmp(fname, tgt->tgt_file.fname))
 				return tgt;
+		} else if (tgt->type == LOG_TGT_TYPE_BINARY) {
+			if (!strcmp(fname, tgt->tgt_binary.fname))
+				return tgt;
 		} else
 			return tgt;
 	}
@@ -766,6 +821,16 @@ int log_init(const struct log_info *inf, void *ctx)
 			&internal_cat[i], sizeof(struct log_info_cat));
 	}
 
+	osmo_log_level_mask = talloc_zero_array(osmo_log_info, uint16_t,
+						osmo_log_info->num_cat);
+	if (!osmo_log_level_mask) {
+		talloc_free(osmo_log_info);
+		osmo_log_info = NULL;
+		return -ENOMEM;
+	}
+	osmo_log_level_mask_len = osmo_log_info->num_cat;
+	log_cache_update();
+
 	return 0;
 }
 
@@ -0,0 +1,843 @@
+/* Binary log target: compact records, written out at idle time */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup logging
+ *  @{
+ */
+
+/*! \file logging_binary.c
+ *
+ * Instead of formatting the message, the binary target stores the
+ * time stamp, subsystem, level, a call site id and the raw arguments
+ * of the format string in a ring buffer.  The format string and the
+ * source location are written only once per call site.  The ring is
+ * written to the file from a timer, i.e. once the main loop is idle,
+ * and rendered to text offline by \ref log_binary_decode.
+ *
+ * If the ring is full, records are dropped and the number of dropped
+ * records is stored in the file as soon as there is room again.
+ */
+
+#include "../config.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
+
+#define LOG_BIN_MAGIC		"OSMOBLOG"
+#define LOG_BIN_VERSION		1
+#define LOG_BIN_BYTE_ORDER	0x0102
+
+#define LOG_BIN_RING_SIZE	(256 * 1024)	/* power of two */
+#define LOG_BIN_REC_MAX		1024
+#define LOG_BIN_SITES		4096		/* power of two */
+#define LOG_BIN_FLUSH_US	20000
+
+enum log_bin_rec_type {
+	LOG_BIN_REC_SITE = 1,	/* call site: id, line, file and format */
+	LOG_BIN_REC_MSG,	/* message: site id, time stamp, raw args */
+	LOG_BIN_REC_DROP,	/* number of dropped records */
+};
+
+/* flags of a message record */
+#define LOG_BIN_F_CONT		0x01	/* continuation of previous message */
+#define LOG_BIN_F_TEXT		0x02	/* args are the formatted message */
+
+struct log_bin_file_hdr {
+	char magic[8];
+	uint16_t version;
+	uint16_t byte_order;
+	uint32_t reserved;
+} __attribute__((packed));
+
+struct log_bin_rec_hdr {
+	uint16_t type;
+	uint16_t len;		/* including this header */
+} __attribute__((packed));
+
+struct log_bin_site {
+	uint32_t id;
+	uint32_t line;
+	char strings[0];	/* file and format, both NUL terminated */
+} __attribute__((packed));
+
+struct log_bin_msg {
+	uint32_t site;
+	uint32_t sec;
+	uint32_t usec;
+	uint16_t subsys;
+	uint8_t level;
+	uint8_t flags;
+	uint8_t args[0];
+} __attribute__((packed));
+
+struct log_bin_drop {
+	uint32_t count;
+} __attribute__((packed));
+
+/* call sites already described in the file, id is index + 1 */
+struct log_bin_site_ent {
+	const char *file;
+	const char *format;
+	int line;
+};
+
+struct log_binary_ring {
+	int fd;
+	uint8_t *buf;
+	uint32_t head;		/* free running read offset */
+	uint32_t tail;		/* free running write offset */
+	uint32_t dropped;
+	unsigned int num_sites;
+	struct osmo_timer_list flush_timer;
+	struct log_bin_site_ent sites[LOG_BIN_SITES];
+};
+
+/* The arguments are stored in the order of the conversions: integers,
+ * pointers and the '*' width/precision as 64 bit values, floating point
+ * as double, strings as 16 bit length followed by the characters. */
+
+enum log_bin_arg {
+	ARG_INT,
+	ARG_UINT,
+	ARG_DOUBLE,
+	ARG_STRING,
+	ARG_POINTER,
+	ARG_NONE,	/* %n, nothing stored or printed */
+};
+
+/* parsed conversion specification */
+struct log_bin_conv {
+	const char *start;	/* '%' */
+	const char *end;	/* conversion character */
+	int stars;		/* number of '*' (0..2) */
+	int prec;		/* precision, -1 if none or '*' */
+	int prec_star;		/* precision given by the last '*' */
+	char lmod[3];		/* length modifier */
+	enum log_bin_arg type;
+};
+
+/* parse the conversion starting at '%', returns 0 or -1 if unsupported */
+static int parse_conv(const char *p, struct log_bin_conv *c)
+{
+	int i = 0;
+
+	memset(c, 0, sizeof(*c));
+	c->prec = -1;
+	c->start = p++;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		c->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			c->stars++;
+			c->prec_star = 1;
+			p++;
+		} else {
+			c->prec = 0;
+			while (*p >= '0' && *p <= '9' && c->prec < 0xffff)
+				c->prec = c->prec * 10 + *p++ - '0';
+			if (*p >= '0' && *p <= '9')
+				return -1;
+		}
+	}
+	while (*p && strchr("hlLqjzt", *p) && i < 2)
+		c->lmod[i++] = *p++;
+
+	switch (*p) {
+	case 'd': case 'i':
+		c->type = ARG_INT;
+		break;
+	case 'o': case 'u': case 'x': case 'X':
+		c->type = ARG_UINT;
+		break;
+	case 'c':
+		if (c->lmod[0])
+			return -1;	/* no wide chars */
+		c->type = ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		c->type = ARG_DOUBLE;
+		break;
+	case 's':
+		if (c->lmod[0])
+			return -1;	/* no wide strings */
+		c->type = ARG_STRING;
+		break;
+	case 'p':
+		c->type = ARG_POINTER;
+		break;
+	case 'n':
+		c->type = ARG_NONE;
+		break;
+	default:
+		return -1;
+	}
+	c->end = p;
+
+	return 0;
+}
+
+static int put_u64(uint8_t **out, uint8_t *end, uint64_t v)
+{
+	if (end - *out < sizeof(v))
+		return -1;
+	memcpy(*out, &v, sizeof(v));
+	*out += sizeof(v);
+	return 0;
+}
+
+/* fetch an integer argument according to the length modifier */
+static uint64_t va_arg_int(va_list *ap, const char *lmod, int is_signed)
+{
+	if (!strcmp(lmod, "l"))
+		return is_signed ? (uint64_t) va_arg(*ap, long)
+				 : va_arg(*ap, unsigned long);
+	if (!strcmp(lmod, "ll") || !strcmp(lmod, "q"))
+		return is_signed ? (uint64_t) va_arg(*ap, long long)
+				 : va_arg(*ap, unsigned long long);
+	if (!strcmp(lmod, "j"))
+		return is_signed ? (uint64_t) va_arg(*ap, intmax_t)
+				 : va_arg(*ap, uintmax_t);
+	if (!strcmp(lmod, "z"))
+		return va_arg(*ap, size_t);
+	if (!strcmp(lmod, "t"))
+		return (uint64_t) va_arg(*ap, ptrdiff_t);
+
+	/* char and short are promoted to int */
+	return is_signed ? (uint64_t) va_arg(*ap, int)
+			 : va_arg(*ap, unsigned int);
+}
+
+/* store the arguments of format, returns number of bytes or -1 */
+static int encode_args(uint8_t *out, unsigned int room,
+		       const char *format, va_list *ap)
+{
+	uint8_t *cur = out, *end = out + room;
+	struct log_bin_conv c;
+	const char *p;
+	int i, star = 0;
+
+	for (p = format; *p; p++) {
+		if (*p != '%')
+			continue;
+		if (p[1] == '%') {
+			p++;
+			continue;
+		}
+		if (parse_conv(p, &c) < 0)
+			return -1;
+		p = c.end;
+
+		for (i = 0; i < c.stars; i++) {
+			star = va_arg(*ap, int);
+			if (put_u64(&cur, end, star) < 0)
+				return -1;
+		}
+		/* a negative precision is taken as if it was omitted */
+		if (c.prec_star && star >= 0)
+			c.prec = star;
+
+		switch (c.type) {
+		case ARG_INT:
+		case ARG_UINT:
+			if (put_u64(&cur, end, va_arg_int(ap, c.lmod,
+						c.type == ARG_INT)) < 0)
+				return -1;
+			break;
+		case ARG_DOUBLE:
+		{
+			double d;
+
+			if (c.lmod[0] == 'L')
+				d = va_arg(*ap, long double);
+			else
+				d = va_arg(*ap, double);
+			if (end - cur < sizeof(d))
+				return -1;
+			memcpy(cur, &d, sizeof(d));
+			cur += sizeof(d);
+			break;
+		}
+		case ARG_STRING:
+		{
+			const char *str = va_arg(*ap, const char *);
+			uint16_t len;
+			size_t n;
+
+			if (!str)
+				str = "(null)";
+			/* no more than the precision, it need not be
+			 * terminated then */
+			n = (c.prec >= 0) ? strnlen(str, c.prec) : strlen(str);
+			/* the length has 16 bit, store longer ones as text */
+			if (n > UINT16_MAX || end - cur < sizeof(len) + n)
+				return -1;
+			len = n;
+			memcpy(cur, &len, sizeof(len));
+			memcpy(cur + sizeof(len), str, len);
+			cur += sizeof(len) + len;
+			break;
+		}
+		case ARG_POINTER:
+			if (put_u64(&cur, end,
+				    (uintptr_t) va_arg(*ap, void *)) < 0)
+				return -1;
+			break;
+		case ARG_NONE:
+			va_arg(*ap, void *);
+			break;
+		}
+	}
+
+	return cur - out;
+}
+
+static inline uint32_t ring_space(const struct log_binary_ring *r)
+{
+	return LOG_BIN_RING_SIZE - (r->tail - r->head);
+}
+
+static int ring_push(struct log_binary_ring *r, const void *data,
+		     unsigned int len)
+{
+	uint32_t off = r->tail & (LOG_BIN_RING_SIZE - 1);
+	uint32_t n = LOG_BIN_RING_SIZE - off;
+
+	if (ring_space(r) < len)
+		return -ENOSPC;
+
+	if (n > len)
+		n = len;
+	memcpy(r->buf + off, data, n);
+	memcpy(r->buf, (const uint8_t *) data + n, len - n);
+	r->tail += len;
+
+	return 0;
+}
+
+static int push_record(struct log_binary_ring *r, uint8_t *rec,
+		       unsigned int len, uint16_t type)
+{
+	struct log_bin_rec_hdr *rh = (struct log_bin_rec_hdr *) rec;
+
+	rh->type = type;
+	rh->len = len;
+
+	return ring_push(r, rec, len);
+}
+
+/* returns the id of the call site (0 if unknown), emits it if needed */
+static uint32_t site_lookup(struct log_binary_ring *r, const char *file,
+			    int line, const char *format)
+{
+	uint8_t rec[LOG_BIN_REC_MAX];
+	struct log_bin_site *site;
+	struct log_bin_site_ent *ent;
+	size_t flen, slen;
+	uint32_t h;
+
+	h = ((uintptr_t) format >> 2) ^ ((uintptr_t) file >> 2) ^ (line * 31);
+	for (;; h++) {
+		ent = &r->sites[h & (LOG_BIN_SITES - 1)];
+		if (!ent->format)
+			break;
+		if (ent->format == format && ent->file == file &&
+		    ent->line == line)
+			return (h & (LOG_BIN_SITES - 1)) + 1;
+	}
+
+	/* keep some slots free to limit the length of the probing */
+	if (r->num_sites >= LOG_BIN_SITES / 4 * 3)
+		return 0;
+
+	flen = strlen(file) + 1;
+	slen = strlen(format) + 1;
+	if (sizeof(struct log_bin_rec_hdr) + sizeof(*site) + flen + slen
+							> sizeof(rec))
+		return 0;
+
+	site = (struct log_bin_site *) (rec + sizeof(struct log_bin_rec_hdr));
+	site->id = (h & (LOG_BIN_SITES - 1)) + 1;
+	site->line = line;
+	memcpy(site->strings, file, flen);
+	memcpy(site->strings + flen, format, slen);
+	if (push_record(r, rec, sizeof(struct log_bin_rec_hdr) +
+			sizeof(*site) + flen + slen, LOG_BIN_REC_SITE) < 0)
+		return 0;
+
+	ent->file = file;
+	ent->line = line;
+	ent->format = format;
+	r->num_sites++;
+
+	return site->id;
+}
+
+static void _binary_raw_output(struct log_target *target, unsigned int subsys,
+			       unsigned int level, const char *file, int line,
+			       int cont, const char *format, va_list ap)
+{
+	struct log_binary_ring *r = target->tgt_binary.ring;
+	uint8_t rec[LOG_BIN_REC_MAX];
+	struct log_bin_msg *msg;
+	unsigned int hdr_len = sizeof(struct log_bin_rec_hdr) + sizeof(*msg);
+	unsigned int drop_len = sizeof(struct log_bin_rec_hdr) +
+				sizeof(struct log_bin_drop);
+	struct timeval tv;
+	va_list bp;
+	int len;
+
+	if (!osmo_timer_pending(&r->flush_timer))
+		osmo_timer_schedule(&r->flush_timer, 0, LOG_BIN_FLUSH_US);
+
+	/* don't bother encoding if not even an empty message would fit */
+	if (ring_space(r) < hdr_len + drop_len) {
+		r->dropped++;
+		return;
+	}
+
+	msg = (struct log_bin_msg *) (rec + sizeof(struct log_bin_rec_hdr));
+	gettimeofday(&tv, NULL);
+	msg->sec = tv.tv_sec;
+	msg->usec = tv.tv_usec;
+	msg->subsys = subsys;
+	msg->level = level;
+	msg->flags = cont ? LOG_BIN_F_CONT : 0;
+	msg->site = site_lookup(r, file, line, format);
+
+	len = -1;
+	if (msg->site) {
+		va_copy(bp, ap);
+		len = encode_args(msg->args, sizeof(rec) - hdr_len,
+				  format, &bp);
+		va_end(bp);
+	}
+
+	/* unknown call site, odd conversions or too long: store as text */
+	if (len < 0) {
+		msg->flags |= LOG_BIN_F_TEXT;
+		len = vsnprintf((char *) msg->args, sizeof(rec) - hdr_len,
+				format, ap);
+		if (len < 0)
+			len = 0;
+		else if (len >= sizeof(rec) - hdr_len) {
+			len = sizeof(rec) - hdr_len;
+			msg->args[len - 1] = '\n';
+		}
+	}
+
+	if (ring_space(r) < hdr_len + len + (r->dropped ? drop_len : 0)) {
+		r->dropped++;
+		return;
+	}
+
+	if (r->dropped) {
+		uint8_t drec[drop_len];
+		struct log_bin_drop *drop;
+
+		drop = (struct log_bin_drop *)
+			(drec + sizeof(struct log_bin_rec_hdr));
+		drop->count = r->dropped;
+		push_record(r, drec, drop_len, LOG_BIN_REC_DROP);
+		r->dropped = 0;
+	}
+
+	push_record(r, rec, hdr_len + len, LOG_BIN_REC_MSG);
+}
+
+/*! \brief Write all pending records of a binary log target to its file
+ *  \param[in] target Log target created by \ref log_target_create_binary
+ *  \returns 0 in case of success, negative errno in case of error
+ */
+int log_target_binary_flush(struct log_target *target)
+{
+	struct log_binary_ring *r = target->tgt_binary.ring;
+
+	while (r->head != r->tail) {
+		uint32_t off = r->head & (LOG_BIN_RING_SIZE - 1);
+		uint32_t len = r->tail - r->head;
+		ssize_t rc;
+
+		if (len > LOG_BIN_RING_SIZE - off)
+			len = LOG_BIN_RING_SIZE - off;
+
+		rc = write(r->fd, r->buf + off, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		r->head += rc;
+	}
+
+	return 0;
+}
+
+static void flush_timer_cb(void *data)
+{
+	log_target_binary_flush(data);
+}
+
+static int ring_destructor(struct log_binary_ring *r)
+{
+	osmo_timer_del(&r->flush_timer);
+	close(r->fd);
+	return 0;
+}
+
+static int talloc_log_target_destructor(struct log_target *target)
+{
+	log_target_binary_flush(target);
+	return 0;
+}
+
+/*! \brief Create a new binary log target
+ *  \param[in] fname File name of the new log file
+ *  \returns Log target in case of success, NULL otherwise
+ *
+ * The file can be rendered to text by \ref log_binary_decode, e.g.
+ * using the osmo-logdecode utility.
+ */
+struct log_target *log_target_create_binary(const char *fname)
+{
+	struct log_bin_file_hdr fh;
+	struct log_binary_ring *r;
+	struct log_target *target;
+
+	target = log_target_create();
+	if (!target)
+		return NULL;
+
+	r = talloc_zero(target, struct log_binary_ring);
+	if (!r)
+		goto err;
+	r->buf = talloc_size(r, LOG_BIN_RING_SIZE);
+	if (!r->buf)
+		goto err;
+
+	r->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+	if (r->fd < 0)
+		goto err;
+	talloc_set_destructor(r, ring_destructor);
+
+	memset(&fh, 0, sizeof(fh));
+	memcpy(fh.magic, LOG_BIN_MAGIC, sizeof(fh.magic));
+	fh.version = LOG_BIN_VERSION;
+	fh.byte_order = LOG_BIN_BYTE_ORDER;
+	ring_push(r, &fh, sizeof(fh));
+
+	r->flush_timer.cb = flush_timer_cb;
+	r->flush_timer.data = target;
+
+	target->type = LOG_TGT_TYPE_BINARY;
+	target->raw_output = _binary_raw_output;
+	target->tgt_binary.ring = r;
+	target->tgt_binary.fname = talloc_strdup(target, fname);
+	/* flush before the ring (a child of target) is freed */
+	talloc_set_destructor(target, talloc_log_target_destructor);
+
+	return target;
+
+err:
+	talloc_free(target);
+	return NULL;
+}
+
+/* render one message record, returns length of the text */
+static int render_msg(char *buf, int size, const char *format,
+		      const uint8_t *args, unsigned int args_len)
+{
+	const uint8_t *cur = args, *end = args + args_len;
+	struct log_bin_conv c;
+	const char *p, *lit = format;
+	int off = 0, n, i;
+
+#define POS	(buf + (off < size ? off : size))
+#define REM	(off < size ? size - off : 0)
+#define EMIT(val) do {							\
+		switch (c.stars) {					\
+		case 0:							\
+			n = snprintf(POS, REM, spec, val);	\
+			break;						\
+		case 1:							\
+			n = snprintf(POS, REM, spec, star[0], val); \
+			break;						\
+		default:						\
+			n = snprintf(POS, REM, spec,		\
+				     star[0], star[1], val);		\
+			break;						\
+		}							\
+	} while (0)
+
+	for (p = format; *p; p++) {
+		char spec[32];
+		int star[2] = { 0, 0 };
+		uint64_t v;
+
+		if (*p != '%')
+			continue;
+		if (p[1] == '%') {
+			/* copy literal text including one '%' */
+			n = snprintf(POS, REM, "%.*s",
+				     (int) (p + 1 - lit), lit);
+			off += n;
+			lit = p + 2;
+			p++;
+			continue;
+		}
+		if (parse_conv(p, &c) < 0 || c.end - c.start + 2 > sizeof(spec))
+			return -EINVAL;
+
+		n = snprintf(POS, REM, "%.*s", (int) (p - lit), lit);
+		off += n;
+		lit = c.end + 1;
+		p = c.end;
+
+		memcpy(spec, c.start, c.end - c.start + 1);
+		spec[c.end - c.start + 1] = '\0';
+
+		for (i = 0; i < c.stars; i++) {
+			if (end - cur < sizeof(v))
+				return -EINVAL;
+			memcpy(&v, cur, sizeof(v));
+			cur += sizeof(v);
+			star[i] = (int) v;
+		}
+
+		n = 0;
+		switch (c.type) {
+		case ARG_INT:
+		case ARG_UINT:
+		case ARG_POINTER:
+			if (end - cur < sizeof(v))
+				return -EINVAL;
+			memcpy(&v, cur, sizeof(v));
+			cur += sizeof(v);
+			if (c.type == ARG_POINTER)
+				EMIT((void *) (uintptr_t) v);
+			else if (!strcmp(c.lmod, "l"))
+				EMIT((long) v);
+			else if (!strcmp(c.lmod, "ll") || !strcmp(c.lmod, "q"))
+				EMIT((long long) v);
+			else if (!strcmp(c.lmod, "j"))
+				EMIT((intmax_t) v);
+			else if (!strcmp(c.lmod, "z"))
+				EMIT((size_t) v);
+			else if (!strcmp(c.lmod, "t"))
+				EMIT((ptrdiff_t) v);
+			else
+				EMIT((int) v);
+			break;
+		case ARG_DOUBLE:
+		{
+			double d;
+
+			if (end - cur < sizeof(d))
+				return -EINVAL;
+			memcpy(&d, cur, sizeof(d));
+			cur += sizeof(d);
+			if (c.lmod[0] == 'L')
+				EMIT((long double) d);
+			else
+				EMIT(d);
+			break;
+		}
+		case ARG_STRING:
+		{
+			char str[LOG_BIN_REC_MAX];
+			uint16_t len;
+
+			if (end - cur < sizeof(len))
+				return -EINVAL;
+			memcpy(&len, cur, sizeof(len));
+			cur += sizeof(len);
+			if (end - cur < len)
+				return -EINVAL;
+			memcpy(str, cur, len);
+			str[len] = '\0';
+			cur += len;
+			EMIT(str);
+			break;
+		}
+		case ARG_NONE:
+			break;
+		}
+		if (n > 0)
+			off += n;
+	}
+	n = snprintf(POS, REM, "%s", lit);
+	off += n;
+
+#undef EMIT
+#undef REM
+#undef POS
+
+	return off < size ? off : size - 1;
+}
+
+/*! \brief Render a file written by a binary log target as text
+ *  \param[in] in File written by a \ref log_target_create_binary target
+ *  \param[in] out File to write the text to
+ *  \param[in] print_timestamp Prefix each message with its time stamp
+ *  \returns 0 in case of success, negative errno in case of error
+ */
+int log_binary_decode(FILE *in, FILE *out, int print_timestamp)
+{
+	struct log_bin_site_ent *sites;
+	struct log_bin_file_hdr fh;
+	struct log_bin_rec_hdr rh;
+	uint8_t rec[LOG_BIN_REC_MAX];
+	char text[4096];
+	int rc = 0;
+
+	if (fread(&fh, sizeof(fh), 1, in) != 1 ||
+	    memcmp(fh.magic, LOG_BIN_MAGIC, sizeof(fh.magic)) ||
+	    fh.version != LOG_BIN_VERSION)
+		return -EINVAL;
+	/* no byte swapping, decode on a host like the one that logged */
+	if (fh.byte_order != LOG_BIN_BYTE_ORDER)
+		return -EINVAL;
+
+	sites = talloc_zero_array(NULL, struct log_bin_site_ent,
+				  LOG_BIN_SITES + 1);
+	if (!sites)
+		return -ENOMEM;
+
+	while (fread(&rh, sizeof(rh), 1, in) == 1) {
+		unsigned int len = rh.len - sizeof(rh);
+
+		if (rh.len < sizeof(rh) || len > sizeof(rec) ||
+		    fread(rec, len, 1, in) != 1) {
+			rc = -EINVAL;
+			break;
+		}
+
+		switch (rh.type) {
+		case LOG_BIN_REC_SITE:
+		{
+			struct log_bin_site *site = (struct log_bin_site *) rec;
+			const char *file = site->strings;
+			size_t flen;
+
+			if (len < sizeof(*site) || rec[len - 1] != '\0' ||
+			    site->id == 0 || site->id > LOG_BIN_SITES) {
+				rc = -EINVAL;
+				break;
+			}
+			flen = strlen(file) + 1;
+			if (sizeof(*site) + flen >= len) {
+				rc = -EINVAL;
+				break;
+			}
+			talloc_free((char *) sites[site->id].file);
+			talloc_free((char *) sites[site->id].format);
+			sites[site->id].file = talloc_strdup(sites, file);
+			sites[site->id].format =
+				talloc_strdup(sites, file + flen);
+			sites[site->id].line = site->line;
+			break;
+		}
+		case LOG_BIN_REC_MSG:
+		{
+			struct log_bin_msg *msg = (struct log_bin_msg *) rec;
+			const struct log_bin_site_ent *site;
+			unsigned int args_len = len - sizeof(*msg);
+			int n;
+
+			if (len < sizeof(*msg) || msg->site > LOG_BIN_SITES) {
+				rc = -EINVAL;
+				break;
+			}
+			site = &sites[msg->site];
+			if (msg->site && !site->format) {
+				rc = -EINVAL;
+				break;
+			}
+
+			if (msg->flags & LOG_BIN_F_TEXT)
+				n = snprintf(text, sizeof(text), "%.*s",
+					     (int) args_len,
+					     (const char *) msg->args);
+			else
+				n = render_msg(text, sizeof(text),
+					       site->format, msg->args,
+					       args_len);
+			if (n < 0) {
+				rc = n;
+				break;
+			}
+
+			if (!(msg->flags & LOG_BIN_F_CONT)) {
+				if (print_timestamp)
+					fprintf(out, "%u.%06u ",
+						msg->sec, msg->usec);
+				fprintf(out, "<%4.4x> %s:%d ", msg->subsys,
+					site->file ? site->file : "?",
+					site->line);
+			}
+			fputs(text, out);
+			break;
+		}
+		case LOG_BIN_REC_DROP:
+		{
+			struct log_bin_drop *drop = (struct log_bin_drop *) rec;
+
+			if (len < sizeof(*drop)) {
+				rc = -EINVAL;
+				break;
+			}
+			fprintf(out, "*** %u log records dropped ***\n",
+				drop->count);
+			break;
+		}
+		default:
+			/* skip unknown records */
+			break;
+		}
+		if (rc < 0)
+			break;
+	}
+
+	talloc_free(sites);
+
+	return rc;
+}
+
+/*! @} */
@@ -29,22 +29,22 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "../config.h"
+
 #include <osmocom/core/msgb.h>
 //#include <openbsc/gsm_data.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/panic.h>
 //#include <openbsc/debug.h>
 
 void *tall_msgb_ctx;
 
-/*! \brief Allocate a new message buffer
- * \param[in] size Length in octets, including headroom
- * \param[in] name Human-readable name to be associated with msgb
- *
- * This function allocates a 'struct msgb' as well as the underlying
- * memory buffer for the actual message data (size specified by \a size)
- * using the talloc memory context previously set by \ref msgb_set_talloc_ctx
- */
-struct msgb *msgb_alloc(uint16_t size, const char *name)
+#ifndef EMBEDDED
+/* Pool used by msgb_alloc(), if any */
+static struct msgb_pool *default_pool;
+#endif
+
+static struct msgb *msgb_alloc_talloc(uint16_t size, const char *name)
 {
 	struct msgb *msg;
 
@@ -64,11 +64,42 @@ struct msgb *msgb_alloc(uint16_t size, const char *name)
 	return msg;
 }
 
+/*! \brief Allocate a new message buffer
+ * \param[in] size Length in octets, including headroom
+ * \param[in] name Human-readable name to be associated with msgb
+ *
+ * This function allocates a 'struct msgb' as well as the underlying
+ * memory buffer for the actual message data (size specified by \a size)
+ * using the talloc memory context previously set by \ref msgb_set_talloc_ctx
+ */
+struct msgb *msgb_alloc(uint16_t size, const char *name)
+{
+#ifndef EMBEDDED
+	if (default_pool)
+		return msgb_alloc_pool(default_pool, size, name);
+#endif
+
+	return msgb_alloc_talloc(size, name);
+}
+
+#ifndef EMBEDDED
+static void msgb_pool_put(struct msgb *m);
+#endif
+
 /*! \brief Release given message buffer
  * \param[in] m Message buffer to be free'd
+ *
+ * Message buffers allocated from a \ref msgb_pool are returned to it.
  */
 void msgb_free(struct msgb *m)
 {
+#ifndef EMBEDDED
+	if (m->pool) {
+		msgb_pool_put(m);
+		return;
+	}
+#endif
+
 	talloc_free(m);
 }
 
@@ -153,4 +184,258 @@ void msgb_set_talloc_ctx(void *ctx)
 	tall_msgb_ctx = ctx;
 }
 
+/* Pools rely on talloc, not available in embedded builds */
+#ifndef EMBEDDED
+
+static struct msgb *msgb_pool_new(struct msgb_pool *pool, uint8_t idx)
+{
+	struct msgb_pool_class *cls = &pool->classes[idx];
+	struct msgb *msg;
+
+	msg = talloc_size(pool, sizeof(*msg) + cls->size);
+	if (!msg)
+		return NULL;
+
+	msg->pool = pool;
+	msg->pool_class = idx;
+
+	return msg;
+}
+
+/* Put a msgb onto the free list of its class */
+static void msgb_pool_release(struct msgb_pool_class *cls, struct msgb *msg,
+			      int poison)
+{
+	if (poison) {
+		memset(msg->_data, MSGB_POOL_POISON, cls->size);
+		/* Catches double msgb_free() */
+		msg->head = NULL;
+	}
+
+	llist_add(&msg->list, &cls->free_list);
+	cls->free_len++;
+}
+
+/*! \brief Create a pool of message buffers
+ *  \param[in] ctx talloc context of the pool and its msgbs
+ *  \param[in] name human-readable name of the pool
+ *  \param[in] sizes data sizes of the classes, in ascending order
+ *  \param[in] num_sizes number of size classes
+ *  \param[in] prealloc number of msgbs to allocate per class upfront
+ *  \param[in] max_free number of free msgbs to keep per class
+ *  \returns newly allocated pool, NULL on error
+ *
+ * \ref msgb_alloc_pool takes the msgbs from the free list of the
+ * smallest class fitting the requested size, and \ref msgb_free puts
+ * them back, so that a busy message path doesn't go through talloc.
+ * All msgbs of the pool have to be freed before the pool itself.
+ */
+struct msgb_pool *msgb_pool_alloc(void *ctx, const char *name,
+				  const uint16_t *sizes, unsigned int num_sizes,
+				  unsigned int prealloc, unsigned int max_free)
+{
+	struct msgb_pool *pool;
+	struct msgb *msg;
+	unsigned int i, j;
+
+	if (num_sizes == 0 || num_sizes > MSGB_POOL_MAX_CLASSES)
+		return NULL;
+	for (i = 1; i < num_sizes; i++) {
+		if (sizes[i] <= sizes[i - 1])
+			return NULL;
+	}
+
+	pool = talloc_zero(ctx, struct msgb_pool);
+	if (!pool)
+		return NULL;
+
+	talloc_set_name_const(pool, name);
+	pool->name = name;
+	pool->max_free = max_free > prealloc ? max_free : prealloc;
+	pool->num_classes = num_sizes;
+
+	for (i = 0; i < num_sizes; i++) {
+		pool->classes[i].size = sizes[i];
+		INIT_LLIST_HEAD(&pool->classes[i].free_list);
+
+		for (j = 0; j < prealloc; j++) {
+			msg = msgb_pool_new(pool, i);
+			if (!msg) {
+				talloc_free(pool);
+				return NULL;
+			}
+			msgb_pool_release(&pool->classes[i], msg, 0);
+		}
+	}
+
+	return pool;
+}
+
+/*! \brief Release a pool of message buffers with all its msgbs
+ *  \param[in] pool pool to be released
+ */
+void msgb_pool_free(struct msgb_pool *pool)
+{
+	if (pool == default_pool)
+		default_pool = NULL;
+
+	talloc_free(pool);
+}
+
+/*! \brief Enable or disable poisoning of free msgbs
+ *  \param[in] pool pool to be configured
+ *  \param[in] poison 1 to enable, 0 to disable
+ *
+ * When enabled, the data of a msgb is overwritten on \ref msgb_free
+ * and checked for modifications on reuse, and a double free causes a
+ * panic.  Meant for debugging, as it touches every byte twice.
+ */
+void msgb_pool_set_poison(struct msgb_pool *pool, int poison)
+{
+	struct msgb_pool_class *cls;
+	struct msgb *msg;
+	unsigned int i;
+
+	if (poison && !pool->poison) {
+		/* Poison what is on the free lists already */
+		for (i = 0; i < pool->num_classes; i++) {
+			cls = &pool->classes[i];
+			llist_for_each_entry(msg, &cls->free_list, list) {
+				memset(msg->_data, MSGB_POOL_POISON, cls->size);
+				msg->head = NULL;
+			}
+		}
+	}
+
+	pool->poison = poison;
+}
+
+/*! \brief Sum up the statistics of all size classes of a pool
+ *  \param[in] pool pool to be queried
+ *  \param[out] stats caller-allocated statistics to be filled in
+ *
+ * The high-water mark is the sum of those of the classes.  Requests
+ * bigger than the biggest class are counted as allocations, not as hits.
+ */
+void msgb_pool_get_stats(const struct msgb_pool *pool,
+			 struct msgb_pool_stats *stats)
+{
+	const struct msgb_pool_stats *cs;
+	unsigned int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < pool->num_classes; i++) {
+		cs = &pool->classes[i].stats;
+		stats->allocs += cs->allocs;
+		stats->hits += cs->hits;
+		stats->in_use += cs->in_use;
+		stats->in_use_max += cs->in_use_max;
+	}
+
+	stats->allocs += pool->oversize;
+}
+
+static void msgb_pool_check_poison(struct msgb_pool *pool,
+				   struct msgb_pool_class *cls,
+				   struct msgb *msg)
+{
+	unsigned int i;
+
+	for (i = 0; i < cls->size; i++) {
+		if (msg->_data[i] != MSGB_POOL_POISON)
+			osmo_panic("msgb(%p) of pool '%s' modified after "
+				   "free at offset %u\n", msg, pool->name, i);
+	}
+}
+
+/*! \brief Allocate a new message buffer from a pool
+ *  \param[in] pool pool to allocate from
+ *  \param[in] size Length in octets, including headroom
+ *  \param[in] name Human-readable name to be associated with msgb
+ *
+ * Same as \ref msgb_alloc, but the msgb is taken from the smallest
+ * size class of \a pool fitting \a size.  Sizes bigger than any class
+ * are allocated the usual way.
+ */
+struct msgb *msgb_alloc_pool(struct msgb_pool *pool, uint16_t size,
+			     const char *name)
+{
+	struct msgb_pool_class *cls;
+	struct msgb *msg;
+	uint8_t idx;
+
+	for (idx = 0; idx < pool->num_classes; idx++) {
+		if (pool->classes[idx].size >= size)
+			break;
+	}
+
+	if (idx == pool->num_classes) {
+		pool->oversize++;
+		return msgb_alloc_talloc(size, name);
+	}
+
+	cls = &pool->classes[idx];
+
+	if (!llist_empty(&cls->free_list)) {
+		msg = llist_entry(cls->free_list.next, struct msgb, list);
+		llist_del(&msg->list);
+		cls->free_len--;
+		cls->stats.hits++;
+
+		if (pool->poison)
+			msgb_pool_check_poison(pool, cls, msg);
+	} else {
+		msg = msgb_pool_new(pool, idx);
+		if (!msg)
+			return NULL;
+	}
+
+	cls->stats.allocs++;
+	if (++cls->stats.in_use > cls->stats.in_use_max)
+		cls->stats.in_use_max = cls->stats.in_use;
+
+	/* Look the same as a freshly allocated msgb */
+	memset(msg, 0, sizeof(*msg) + size);
+	talloc_set_name_const(msg, name);
+
+	msg->pool = pool;
+	msg->pool_class = idx;
+	msg->data_len = size;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+
+	return msg;
+}
+
+static void msgb_pool_put(struct msgb *m)
+{
+	struct msgb_pool *pool = m->pool;
+	struct msgb_pool_class *cls = &pool->classes[m->pool_class];
+
+	if (pool->poison && m->head == NULL)
+		osmo_panic("msgb(%p) of pool '%s' freed twice\n",
+			   m, pool->name);
+
+	cls->stats.in_use--;
+
+	if (cls->free_len >= pool->max_free) {
+		talloc_free(m);
+		return;
+	}
+
+	msgb_pool_release(cls, m, pool->poison);
+}
+
+/*! \brief Make \ref msgb_alloc allocate from a pool
+ *  \param[in] pool pool to be used, NULL for plain talloc allocations
+ */
+void msgb_set_pool(struct msgb_pool *pool)
+{
+	default_pool = pool;
+}
+
+#endif /* EMBEDDED */
+
 /*! @} */
@@ -26,7 +26,6 @@
 
 /*! \file rate_ctr.c */
 
-
 #include <stdint.h>
 #include <string.h>
 
@@ -36,6 +35,18 @@
 #include <osmocom/core/timer.h>
 #include <osmocom/core/rate_ctr.h>
 
+/* Counters may be bumped from other threads than the one running the
+ * interval timer.  Where 64 bit atomics are lock-free we use relaxed
+ * ones, which only guarantee that no increment is lost or torn; the
+ * ordering against other memory does not matter for statistics. */
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define CTR_ADD(p, v)	__atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#define CTR_LOAD(p)	__atomic_load_n(p, __ATOMIC_RELAXED)
+#else
+#define CTR_ADD(p, v)	(*(p) += (v))
+#define CTR_LOAD(p)	(*(p))
+#endif
+
 static LLIST_HEAD(rate_ctr_groups);
 
 static void *tall_rate_ctr_ctx;
@@ -65,7 +76,7 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 	group->desc = desc;
 	group->idx = idx;
 
-	llist_add(&group->list, &rate_ctr_groups);
+	llist_add_tail(&group->list, &rate_ctr_groups);
 
 	return group;
 }
@@ -77,18 +88,32 @@ void rate_ctr_group_free(struct rate_ctr_group *grp)
 	talloc_free(grp);
 }
 
-/*! \brief Add a number to the counter */
+/*! \brief Add a number to the counter
+ *
+ * This may be called from any thread, concurrently with the interval
+ * timer and with \ref rate_ctr_get.
+ */
 void rate_ctr_add(struct rate_ctr *ctr, int inc)
 {
-	ctr->current += inc;
+	CTR_ADD(&ctr->current, (int64_t) inc);
 }
 
+/*! \brief Get the current value of the counter */
+uint64_t rate_ctr_get(const struct rate_ctr *ctr)
+{
+	return CTR_LOAD(&ctr->current);
+}
+
+/* The per-interval data is only touched by the timer, so only the
+ * current value needs care */
 static void interval_expired(struct rate_ctr *ctr, enum rate_ctr_intv intv)
 {
+	uint64_t current = CTR_LOAD(&ctr->current);
+
 	/* calculate rate over last interval */
-	ctr->intv[intv].rate = ctr->current - ctr->intv[intv].last;
+	ctr->intv[intv].rate = current - ctr->intv[intv].last;
 	/* save current counter for next interval */
-	ctr->intv[intv].last = ctr->current;
+	ctr->intv[intv].last = current;
 
 	/* update the rate of the next bigger interval.  This will
 	 * be overwritten when that next larger interval expires */
@@ -141,6 +166,25 @@ int rate_ctr_init(void *tall_ctx)
 	return 0;
 }
 
+/*! \brief Iterate over all counter groups, in order of allocation
+ *  \param[in] handle_group Call-back function, a negative return stops
+ *  \param[in] data Private data handed through to \a handle_group
+ */
+int rate_ctr_for_each_group(int (*handle_group)(struct rate_ctr_group *, void *),
+			    void *data)
+{
+	struct rate_ctr_group *ctrg;
+	int rc = 0;
+
+	llist_for_each_entry(ctrg, &rate_ctr_groups, list) {
+		rc = handle_group(ctrg, data);
+		if (rc < 0)
+			return rc;
+	}
+
+	return rc;
+}
+
 /*! \brief Search for counter group based on group name and index */
 struct rate_ctr_group *rate_ctr_get_group_by_name_idx(const char *name, const unsigned int idx)
 {
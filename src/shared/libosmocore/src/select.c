@@ -25,11 +25,22 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
 
 #include "../config.h"
 
 #ifdef HAVE_SYS_SELECT_H
 
+#ifdef USE_EPOLL
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
 /*! \addtogroup select
  *  @{
  */
@@ -42,6 +53,344 @@ static int maxfd = 0;
 static LLIST_HEAD(osmo_fds);
 static int unregistered_count;
 
+#ifdef USE_EPOLL
+
+/*
+ * epoll backend
+ *
+ * Every registered fd has a slot, indexed by the fd number, holding the
+ * event mask the kernel currently knows about. Changes of 'when' are
+ * passed on by osmo_fd_update_when() right away, after every callback
+ * for changes the callback made to its own fd, and before waiting for
+ * changes made anywhere else, which only costs a compare per fd and no
+ * system call unless the mask did change. Each registration gets a new
+ * sequence number which is stored along with the fd in the epoll event,
+ * so that events of fds unregistered (or closed and reused) by an earlier
+ * callback of the same iteration are simply dropped.
+ */
+
+#define EP_MAX_EVENTS	64
+#define EP_WHEN_MASK	(BSC_FD_READ | BSC_FD_WRITE | BSC_FD_EXCEPT | BSC_FD_EDGE)
+#define EP_TIMER_DATA	UINT64_MAX
+
+struct ep_slot {
+	struct osmo_fd *ofd;	/* registered osmo_fd, NULL if none */
+	uint32_t seq;		/* sequence number of the registration */
+	unsigned int when;	/* 'when' the kernel knows about */
+	uint8_t in_set;		/* fd is part of the epoll set */
+	uint8_t always;		/* fd not pollable (regular file), always ready */
+};
+
+static enum osmo_select_backend backend = OSMO_SELECT_BACKEND_EPOLL;
+static struct ep_slot *ep_slots;
+static unsigned int ep_slots_len;
+static unsigned int ep_n_always;
+static uint32_t ep_seq;
+static int ep_fd = -1;
+static int ep_tfd = -1;
+
+static int ep_sync(struct osmo_fd *ofd)
+{
+	struct ep_slot *slot = &ep_slots[ofd->fd];
+	unsigned int when = ofd->when & EP_WHEN_MASK;
+	struct epoll_event ev;
+	int op, rc;
+
+	if (slot->when == when || slot->always)
+		return 0;
+
+	memset(&ev, 0, sizeof(ev));
+	if (when & BSC_FD_READ)
+		ev.events |= EPOLLIN;
+	if (when & BSC_FD_WRITE)
+		ev.events |= EPOLLOUT;
+	if (when & BSC_FD_EXCEPT)
+		ev.events |= EPOLLPRI;
+
+	/* Errors and hang-ups are always reported, which would make an
+	 * fd without any interest spin: take it out of the set instead */
+	if (!ev.events) {
+		if (slot->in_set && epoll_ctl(ep_fd, EPOLL_CTL_DEL,
+					      ofd->fd, &ev) < 0)
+			LOGP(DLGLOBAL, LOGL_ERROR, "epoll: cannot remove "
+			     "fd %d: %s\n", ofd->fd, strerror(errno));
+		slot->in_set = 0;
+		slot->when = when;
+		return 0;
+	}
+
+	if (when & BSC_FD_EDGE)
+		ev.events |= EPOLLET;
+	ev.data.u64 = ((uint64_t) slot->seq << 32) | (uint32_t) ofd->fd;
+
+	op = slot->in_set ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	rc = epoll_ctl(ep_fd, op, ofd->fd, &ev);
+	if (rc < 0 && errno == EPERM) {
+		/* regular files are always ready for select() */
+		slot->always = 1;
+		ep_n_always++;
+		return 0;
+	}
+	if (rc < 0) {
+		rc = -errno;
+		LOGP(DLGLOBAL, LOGL_ERROR, "epoll: cannot %s fd %d: %s\n",
+		     op == EPOLL_CTL_ADD ? "add" : "modify", ofd->fd,
+		     strerror(-rc));
+		return rc;
+	}
+
+	slot->in_set = 1;
+	slot->when = when;
+
+	return 0;
+}
+
+static int ep_add(struct osmo_fd *ofd)
+{
+	struct ep_slot *slot;
+	int rc;
+
+	if (ofd->fd >= ep_slots_len) {
+		unsigned int len = ep_slots_len ? ep_slots_len : 64;
+		struct ep_slot *slots;
+
+		while (len <= ofd->fd)
+			len *= 2;
+
+		slots = realloc(ep_slots, len * sizeof(*slots));
+		if (!slots)
+			return -ENOMEM;
+
+		memset(&slots[ep_slots_len], 0,
+			(len - ep_slots_len) * sizeof(*slots));
+		ep_slots = slots;
+		ep_slots_len = len;
+	}
+
+	slot = &ep_slots[ofd->fd];
+	if (slot->in_set) {
+		struct epoll_event ev;
+		epoll_ctl(ep_fd, EPOLL_CTL_DEL, ofd->fd, &ev);
+	}
+	if (slot->always)
+		ep_n_always--;
+
+	memset(slot, 0, sizeof(*slot));
+	slot->ofd = ofd;
+	slot->seq = ++ep_seq;
+	slot->when = ~0;	/* force the first sync */
+
+	rc = ep_sync(ofd);
+	if (rc < 0)
+		memset(slot, 0, sizeof(*slot));
+
+	return rc;
+}
+
+static void ep_del(struct osmo_fd *ofd)
+{
+	struct ep_slot *slot;
+	struct epoll_event ev;
+
+	if (ofd->fd < 0 || ofd->fd >= ep_slots_len)
+		return;
+
+	slot = &ep_slots[ofd->fd];
+	if (slot->ofd != ofd)
+		return;
+
+	/* may fail if the fd was already closed, which is fine */
+	if (slot->in_set)
+		epoll_ctl(ep_fd, EPOLL_CTL_DEL, ofd->fd, &ev);
+	if (slot->always)
+		ep_n_always--;
+
+	memset(slot, 0, sizeof(*slot));
+}
+
+static int ep_init(void)
+{
+	struct epoll_event ev;
+	struct osmo_fd *ofd;
+
+	if (ep_fd >= 0)
+		return 0;
+
+	ep_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (ep_fd < 0)
+		return -errno;
+
+	/* timers are waited for with a timerfd, for sub-millisecond
+	 * precision that epoll_wait() would not give us */
+	ep_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (ep_tfd < 0)
+		goto err;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = EP_TIMER_DATA;
+	if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, ep_tfd, &ev) < 0)
+		goto err;
+
+	/* pick up what was registered so far */
+	llist_for_each_entry(ofd, &osmo_fds, list) {
+		if (ep_add(ofd) < 0)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	if (ep_tfd >= 0)
+		close(ep_tfd);
+	close(ep_fd);
+	ep_tfd = -1;
+	ep_fd = -1;
+	free(ep_slots);
+	ep_slots = NULL;
+	ep_slots_len = 0;
+	ep_n_always = 0;
+	return -EIO;
+}
+
+static void ep_exit(void)
+{
+	if (ep_fd < 0)
+		return;
+
+	close(ep_tfd);
+	close(ep_fd);
+	ep_tfd = -1;
+	ep_fd = -1;
+
+	free(ep_slots);
+	ep_slots = NULL;
+	ep_slots_len = 0;
+	ep_n_always = 0;
+}
+
+static int ep_dispatch(struct osmo_fd *ufd, unsigned int flags)
+{
+	unsigned int fd = ufd->fd;
+	uint32_t seq = ep_slots[fd].seq;
+
+	flags &= ufd->when;
+	if (!flags)
+		return 0;
+
+	ufd->cb(ufd, flags);
+
+	/* pick up what the callback changed, unless it unregistered the
+	 * fd, in which case ufd may not even exist anymore. The slots may
+	 * have moved if the callback registered another fd. */
+	if (fd < ep_slots_len && ep_slots[fd].ofd == ufd
+	 && ep_slots[fd].seq == seq)
+		ep_sync(ufd);
+
+	return 1;
+}
+
+static int osmo_select_main_epoll(int polling)
+{
+	struct epoll_event evs[EP_MAX_EVENTS];
+	struct osmo_fd *ufd, *tmp;
+	struct timeval *tv;
+	int timeout = -1;
+	int always = 0;
+	int work = 0;
+	int i, n;
+
+	/* pick up changes of 'when' made by assigning the member outside
+	 * of the fd's own call-back, which costs a compare per fd unless
+	 * the mask did change */
+	llist_for_each_entry(ufd, &osmo_fds, list) {
+		if (ufd->fd < 0 || ufd->fd >= ep_slots_len)
+			continue;
+		ep_sync(ufd);
+		if (ep_slots[ufd->fd].always
+		 && (ufd->when & (BSC_FD_READ | BSC_FD_WRITE)))
+			always = 1;
+	}
+
+	osmo_timers_check();
+
+	if (!polling)
+		osmo_timers_prepare();
+
+	tv = osmo_timers_nearest();
+	if (polling || always || (tv && !timerisset(tv))) {
+		timeout = 0;
+	} else if (tv) {
+		struct itimerspec its;
+
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = tv->tv_sec;
+		its.it_value.tv_nsec = tv->tv_usec * 1000;
+		timerfd_settime(ep_tfd, 0, &its, NULL);
+	}
+
+	n = epoll_wait(ep_fd, evs, EP_MAX_EVENTS, timeout);
+	if (n < 0)
+		return 0;
+
+	/* fire timers */
+	osmo_timers_update();
+
+	/* call registered callback functions */
+	for (i = 0; i < n; i++) {
+		uint32_t events = evs[i].events;
+		unsigned int fd, flags = 0;
+		struct ep_slot *slot;
+
+		if (evs[i].data.u64 == EP_TIMER_DATA) {
+			uint64_t exp;
+			/* just clear the expiration count */
+			while (read(ep_tfd, &exp, sizeof(exp)) > 0);
+			continue;
+		}
+
+		/* skip events of fds gone in the meantime */
+		fd = evs[i].data.u64 & 0xffffffff;
+		if (fd >= ep_slots_len)
+			continue;
+		slot = &ep_slots[fd];
+		if (!slot->ofd || slot->seq != evs[i].data.u64 >> 32)
+			continue;
+
+		/* same mapping as the select() implementation of Linux */
+		if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			flags |= BSC_FD_READ;
+		if (events & (EPOLLOUT | EPOLLERR))
+			flags |= BSC_FD_WRITE;
+		if (events & EPOLLPRI)
+			flags |= BSC_FD_EXCEPT;
+
+		work |= ep_dispatch(slot->ofd, flags);
+	}
+
+	/* non-pollable fds, which are rare: stop at the first unregistration
+	 * as the list may not be safe to walk anymore, the next iteration
+	 * will take care of the remaining ones */
+	if (always) {
+		unregistered_count = 0;
+		llist_for_each_entry_safe(ufd, tmp, &osmo_fds, list) {
+			if (!ep_slots[ufd->fd].always)
+				continue;
+			work |= ep_dispatch(ufd, BSC_FD_READ | BSC_FD_WRITE);
+			if (unregistered_count >= 1)
+				break;
+		}
+	}
+
+	return work;
+}
+
+#else
+
+static enum osmo_select_backend backend = OSMO_SELECT_BACKEND_SELECT;
+
+#endif /* USE_EPOLL */
+
 /*! \brief Register a new file descriptor with select loop abstraction
  *  \param[in] fd osmocom file descriptor to be registered
  */
@@ -81,11 +430,43 @@ int osmo_fd_register(struct osmo_fd *fd)
 	}
 #endif
 
+#ifdef USE_EPOLL
+	if (backend == OSMO_SELECT_BACKEND_EPOLL) {
+		if (ep_init() == 0) {
+			flags = ep_add(fd);
+			if (flags < 0)
+				return flags;
+		} else
+			backend = OSMO_SELECT_BACKEND_SELECT;
+	}
+#endif
+
 	llist_add_tail(&fd->list, &osmo_fds);
 
 	return 0;
 }
 
+/*! \brief Change the events a registered file descriptor is waited for
+ *  \param[in] fd osmocom file descriptor
+ *  \param[in] and_mask bits of \a when to keep
+ *  \param[in] or_mask bits of \a when to set
+ *
+ * With the epoll backend, changes of \a when made by assigning the
+ * member directly are noticed before the next wait. This function passes
+ * them on right away.
+ */
+void osmo_fd_update_when(struct osmo_fd *fd, unsigned int and_mask,
+			 unsigned int or_mask)
+{
+	fd->when = (fd->when & and_mask) | or_mask;
+
+#ifdef USE_EPOLL
+	if (ep_fd >= 0 && fd->fd >= 0 && fd->fd < ep_slots_len
+	 && ep_slots[fd->fd].ofd == fd)
+		ep_sync(fd);
+#endif
+}
+
 /*! \brief Unregister a file descriptor from select loop abstraction
  *  \param[in] fd osmocom file descriptor to be unregistered
  */
@@ -93,6 +474,48 @@ void osmo_fd_unregister(struct osmo_fd *fd)
 {
 	unregistered_count++;
 	llist_del(&fd->list);
+
+#ifdef USE_EPOLL
+	if (ep_fd >= 0)
+		ep_del(fd);
+#endif
+}
+
+/*! \brief Select the backend used to wait for file descriptors
+ *  \param[in] be backend to use from now on
+ *  \returns 0 on success, negative in case of error
+ *
+ * The epoll backend is the default if the library was built with it.
+ * It has no FD_SETSIZE limit and only dispatches ready descriptors.
+ * File descriptors already registered are carried over.
+ */
+int osmo_select_set_backend(enum osmo_select_backend be)
+{
+	switch (be) {
+	case OSMO_SELECT_BACKEND_SELECT:
+#ifdef USE_EPOLL
+		ep_exit();
+#endif
+		break;
+#ifdef USE_EPOLL
+	case OSMO_SELECT_BACKEND_EPOLL:
+		if (ep_init() < 0)
+			return -EIO;
+		break;
+#endif
+	default:
+		return -1;
+	}
+
+	backend = be;
+
+	return 0;
+}
+
+/*! \brief Get the backend used to wait for file descriptors */
+enum osmo_select_backend osmo_select_get_backend(void)
+{
+	return backend;
 }
 
 /*! \brief select main loop integration
@@ -105,6 +528,14 @@ int osmo_select_main(int polling)
 	int work = 0, rc;
 	struct timeval no_time = {0, 0};
 
+#ifdef USE_EPOLL
+	if (backend == OSMO_SELECT_BACKEND_EPOLL) {
+		if (ep_init() == 0)
+			return osmo_select_main_epoll(polling);
+		backend = OSMO_SELECT_BACKEND_SELECT;
+	}
+#endif
+
 	FD_ZERO(&readset);
 	FD_ZERO(&writeset);
 	FD_ZERO(&exceptset);
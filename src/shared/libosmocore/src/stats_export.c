@@ -0,0 +1,537 @@
+/* Pull-based export of rate counters and osmo_counters */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup stats_export
+ *  @{
+ */
+
+/*! \file stats_export.c
+ *  \brief Dump counters in Prometheus text or StatsD format
+ *
+ * Nothing is pushed anywhere: the counters are written when a dump is
+ * requested, either to a FILE, atomically to a file (e.g. for the
+ * textfile collector of node_exporter) or to every client connecting
+ * to a unix domain socket.
+ */
+
+#include "../config.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/statistics.h>
+#include <osmocom/core/stats_export.h>
+
+struct export_state {
+	FILE *out;
+	enum osmo_stats_fmt fmt;
+	const char *prefix;
+	/* group whose description is being exported */
+	const struct rate_ctr_group *first;
+	/* counter of those groups being exported */
+	unsigned int ctr_idx;
+};
+
+/* Print a metric name component, replacing anything the format does
+ * not allow in names with '_' */
+static void put_name(FILE *out, enum osmo_stats_fmt fmt, const char *name)
+{
+	const char *c;
+
+	for (c = name; *c; c++) {
+		switch (fmt) {
+		case OSMO_STATS_FMT_PROMETHEUS:
+			if ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z')
+			    || (*c >= '0' && *c <= '9'))
+				fputc(*c, out);
+			else
+				fputc('_', out);
+			break;
+		case OSMO_STATS_FMT_STATSD:
+			if (*c == ':' || *c == '|' || *c == '@' || *c <= ' ')
+				fputc('_', out);
+			else
+				fputc(*c, out);
+			break;
+		}
+	}
+}
+
+/* Print "prefix_group_name_total" resp. "prefix.group.idx.name" */
+static void put_metric(struct export_state *st, const char *group,
+		       unsigned int idx, const char *name)
+{
+	char sep = st->fmt == OSMO_STATS_FMT_PROMETHEUS ? '_' : '.';
+	const char *first = st->prefix && st->prefix[0] ? st->prefix :
+			    group ? group : name;
+	size_t len = strlen(name);
+
+	/* Prometheus names must not start with a digit */
+	if (st->fmt == OSMO_STATS_FMT_PROMETHEUS
+	    && first[0] >= '0' && first[0] <= '9')
+		fputc('_', st->out);
+
+	if (st->prefix && st->prefix[0]) {
+		put_name(st->out, st->fmt, st->prefix);
+		fputc(sep, st->out);
+	}
+	if (group) {
+		put_name(st->out, st->fmt, group);
+		fputc(sep, st->out);
+		if (st->fmt == OSMO_STATS_FMT_STATSD)
+			fprintf(st->out, "%u.", idx);
+	}
+	put_name(st->out, st->fmt, name);
+
+	/* Counters are suffixed by convention, unless the name has it */
+	if (st->fmt == OSMO_STATS_FMT_PROMETHEUS
+	    && (len < 6 || strcmp(name + len - 5, "total")
+		|| isalnum((unsigned char) name[len - 6])))
+		fputs("_total", st->out);
+}
+
+/* HELP lines end at the newline and treat backslashes as escapes */
+static void put_help(struct export_state *st, const char *group,
+		     const char *name, const char *help)
+{
+	const char *c;
+
+	fputs("# HELP ", st->out);
+	put_metric(st, group, 0, name);
+	fputc(' ', st->out);
+
+	for (c = help ? help : name; *c; c++) {
+		if (*c == '\\')
+			fputs("\\\\", st->out);
+		else if (*c == '\n')
+			fputs("\\n", st->out);
+		else
+			fputc(*c, st->out);
+	}
+	fputc('\n', st->out);
+
+	fputs("# TYPE ", st->out);
+	put_metric(st, group, 0, name);
+	fputs(" counter\n", st->out);
+}
+
+static void put_ctr(struct export_state *st, const struct rate_ctr_group *ctrg,
+		    unsigned int i)
+{
+	const struct rate_ctr_group_desc *desc = ctrg->desc;
+
+	put_metric(st, desc->group_name_prefix, ctrg->idx,
+		   desc->ctr_desc[i].name);
+
+	switch (st->fmt) {
+	case OSMO_STATS_FMT_PROMETHEUS:
+		fprintf(st->out, "{idx=\"%u\"} %" PRIu64 "\n", ctrg->idx,
+			rate_ctr_get(&ctrg->ctr[i]));
+		break;
+	case OSMO_STATS_FMT_STATSD:
+		fprintf(st->out, ":%" PRIu64 "|g\n",
+			rate_ctr_get(&ctrg->ctr[i]));
+		break;
+	}
+}
+
+/* Prints one counter of all groups sharing the description of st->first */
+static int export_ctr_of_groups(struct rate_ctr_group *ctrg, void *data)
+{
+	struct export_state *st = data;
+
+	if (ctrg->desc == st->first->desc)
+		put_ctr(st, ctrg, st->ctr_idx);
+
+	return 0;
+}
+
+/* Stops the iteration at the first group with the same description */
+static int find_first_group(struct rate_ctr_group *ctrg, void *data)
+{
+	struct export_state *st = data;
+
+	if (ctrg->desc != st->first->desc)
+		return 0;
+
+	st->first = ctrg;
+	return -1;
+}
+
+static int export_group(struct rate_ctr_group *ctrg, void *data)
+{
+	struct export_state *st = data;
+	unsigned int i;
+
+	if (!ctrg->desc)
+		return 0;
+
+	if (st->fmt == OSMO_STATS_FMT_STATSD) {
+		for (i = 0; i < ctrg->desc->num_ctr; i++)
+			put_ctr(st, ctrg, i);
+		return 0;
+	}
+
+	/* All samples of a metric must be adjacent, so the groups of one
+	 * description are exported together when we see the first one */
+	st->first = ctrg;
+	rate_ctr_for_each_group(find_first_group, st);
+	if (st->first != ctrg)
+		return 0;
+
+	for (i = 0; i < ctrg->desc->num_ctr; i++) {
+		put_help(st, ctrg->desc->group_name_prefix,
+			 ctrg->desc->ctr_desc[i].name,
+			 ctrg->desc->ctr_desc[i].description);
+		st->ctr_idx = i;
+		rate_ctr_for_each_group(export_ctr_of_groups, st);
+	}
+
+	return 0;
+}
+
+static int export_counter(struct osmo_counter *ctr, void *data)
+{
+	struct export_state *st = data;
+
+	if (st->fmt == OSMO_STATS_FMT_PROMETHEUS)
+		put_help(st, NULL, ctr->name, ctr->description);
+
+	put_metric(st, NULL, 0, ctr->name);
+	fprintf(st->out, st->fmt == OSMO_STATS_FMT_PROMETHEUS ?
+		" %lu\n" : ":%lu|g\n", osmo_counter_get(ctr));
+
+	return 0;
+}
+
+/*! \brief Write all rate counters and osmo_counters to a stream
+ *  \param[in] out stream to write to
+ *  \param[in] fmt output format
+ *  \param[in] prefix prepended to all metric names, may be NULL
+ *  \returns 0 on success, -EIO if writing failed
+ *
+ * Prometheus metrics are named prefix_group_counter_total with the
+ * group index as label "idx", StatsD ones prefix.group.idx.counter.
+ * The values are read without stopping writers in other threads.
+ */
+int osmo_stats_export(FILE *out, enum osmo_stats_fmt fmt, const char *prefix)
+{
+	struct export_state st = {
+		.out = out,
+		.fmt = fmt,
+		.prefix = prefix,
+	};
+
+	rate_ctr_for_each_group(export_group, &st);
+	osmo_counters_for_each(export_counter, &st);
+
+	if (fflush(out) != 0 || ferror(out))
+		return -EIO;
+
+	return 0;
+}
+
+/*! \brief Atomically replace a file with a dump of all counters
+ *  \param[in] path file to write, a temporary file next to it is used
+ *  \param[in] fmt output format
+ *  \param[in] prefix prepended to all metric names, may be NULL
+ *  \returns 0 on success, negative errno otherwise
+ */
+int osmo_stats_export_file(const char *path, enum osmo_stats_fmt fmt,
+			   const char *prefix)
+{
+	char *tmp;
+	FILE *out;
+	int rc;
+
+	tmp = talloc_asprintf(NULL, "%s.tmp", path);
+	if (!tmp)
+		return -ENOMEM;
+
+	out = fopen(tmp, "w");
+	if (!out) {
+		rc = -errno;
+		goto out_free;
+	}
+
+	rc = osmo_stats_export(out, fmt, prefix);
+	if (fclose(out) != 0 && rc == 0)
+		rc = -errno;
+
+	if (rc == 0 && rename(tmp, path) != 0)
+		rc = -errno;
+	if (rc < 0)
+		unlink(tmp);
+
+out_free:
+	talloc_free(tmp);
+	return rc;
+}
+
+#ifdef HAVE_SYS_SOCKET_H
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/linuxlist.h>
+
+/* Clients whose dump is still being sent, beyond that the oldest one is
+ * dropped */
+#define EXPORT_SOCK_MAX_PENDING	8
+
+/* A client the dump could not be sent to at once */
+struct export_client {
+	struct llist_head list;
+	struct osmo_fd ofd;
+	char *buf;
+	size_t len;
+	size_t off;
+};
+
+static struct {
+	struct osmo_fd ofd;
+	enum osmo_stats_fmt fmt;
+	char *prefix;
+	char *path;
+	struct llist_head clients;
+	unsigned int num_clients;
+} export_sock = {
+	.ofd = { .fd = -1 },
+	.clients = LLIST_HEAD_INIT(export_sock.clients),
+};
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Send as much of the dump as the socket takes. The dump is sent with
+ * send(), so a client that is already gone doesn't raise SIGPIPE.
+ * Returns 1 once all is sent, 0 if the rest has to wait until the
+ * client reads, negative errno otherwise */
+static int export_send(int fd, const char *buf, size_t len, size_t *off)
+{
+	ssize_t n;
+
+	while (*off < len) {
+		n = send(fd, buf + *off, len - *off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (n < 0)
+			return -errno;
+		*off += n;
+	}
+
+	return 1;
+}
+
+static void export_client_free(struct export_client *cl)
+{
+	osmo_fd_unregister(&cl->ofd);
+	close(cl->ofd.fd);
+	llist_del(&cl->list);
+	export_sock.num_clients--;
+	free(cl->buf);
+	talloc_free(cl);
+}
+
+static int export_client_write(struct osmo_fd *ofd, unsigned int what)
+{
+	struct export_client *cl = ofd->data;
+	int rc;
+
+	rc = export_send(ofd->fd, cl->buf, cl->len, &cl->off);
+	if (rc != 0)
+		export_client_free(cl);
+
+	return rc < 0 ? rc : 0;
+}
+
+/* Every client gets a dump and is disconnected once it is sent. The
+ * socket is non-blocking: what doesn't fit into the socket buffer is
+ * sent as the client reads, so a client that doesn't read can't stall
+ * the main loop. */
+static int export_sock_accept(struct osmo_fd *ofd, unsigned int what)
+{
+	struct export_client *cl;
+	char *buf = NULL;
+	size_t len = 0, off = 0;
+	FILE *out;
+	int fd, rc;
+
+	fd = accept(ofd->fd, NULL, NULL);
+	if (fd < 0)
+		return -errno;
+
+	rc = fcntl(fd, F_GETFL);
+	if (rc < 0 || fcntl(fd, F_SETFL, rc | O_NONBLOCK) < 0) {
+		rc = -errno;
+		goto out_close;
+	}
+
+	out = open_memstream(&buf, &len);
+	if (!out) {
+		rc = -errno;
+		goto out_close;
+	}
+	osmo_stats_export(out, export_sock.fmt, export_sock.prefix);
+	if (fclose(out) != 0) {
+		rc = -errno;
+		goto out_free;
+	}
+
+	rc = export_send(fd, buf, len, &off);
+	if (rc != 0)
+		goto out_free;
+
+	/* The rest is sent from the write callback */
+	if (export_sock.num_clients >= EXPORT_SOCK_MAX_PENDING)
+		export_client_free(llist_entry(export_sock.clients.next,
+					       struct export_client, list));
+
+	cl = talloc_zero(NULL, struct export_client);
+	if (!cl) {
+		rc = -ENOMEM;
+		goto out_free;
+	}
+	cl->buf = buf;
+	cl->len = len;
+	cl->off = off;
+	cl->ofd.fd = fd;
+	cl->ofd.when = BSC_FD_WRITE;
+	cl->ofd.cb = export_client_write;
+	cl->ofd.data = cl;
+	rc = osmo_fd_register(&cl->ofd);
+	if (rc < 0) {
+		talloc_free(cl);
+		goto out_free;
+	}
+	llist_add_tail(&cl->list, &export_sock.clients);
+	export_sock.num_clients++;
+
+	return 0;
+
+out_free:
+	free(buf);
+out_close:
+	close(fd);
+	return rc < 0 ? rc : 0;
+}
+
+/*! \brief Dump all counters to clients of a unix domain socket
+ *  \param[in] path file system path of the socket, replaced if it exists
+ *  \param[in] fmt output format
+ *  \param[in] prefix prepended to all metric names, may be NULL
+ *  \returns 0 on success, negative errno otherwise
+ *
+ * E.g. "socat - UNIX-CONNECT:path" prints the current values.
+ */
+int osmo_stats_export_sock_init(const char *path, enum osmo_stats_fmt fmt,
+				const char *prefix)
+{
+	struct sockaddr_un local;
+	int fd, rc;
+
+	if (export_sock.ofd.fd >= 0)
+		return -EBUSY;
+
+	if (strlen(path) >= sizeof(local.sun_path))
+		return -ENAMETOOLONG;
+
+	memset(&local, 0, sizeof(local));
+	local.sun_family = AF_UNIX;
+	strcpy(local.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -errno;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *) &local, sizeof(local)) < 0
+	    || listen(fd, 8) < 0) {
+		rc = -errno;
+		goto err_close;
+	}
+
+	export_sock.ofd.fd = fd;
+	export_sock.ofd.when = BSC_FD_READ;
+	export_sock.ofd.cb = export_sock_accept;
+	rc = osmo_fd_register(&export_sock.ofd);
+	if (rc < 0)
+		goto err_unlink;
+
+	export_sock.fmt = fmt;
+	export_sock.prefix = prefix ? talloc_strdup(NULL, prefix) : NULL;
+	export_sock.path = talloc_strdup(NULL, path);
+
+	return 0;
+
+err_unlink:
+	unlink(path);
+err_close:
+	export_sock.ofd.fd = -1;
+	close(fd);
+	return rc;
+}
+
+/*! \brief Close the socket opened by \ref osmo_stats_export_sock_init */
+void osmo_stats_export_sock_close(void)
+{
+	if (export_sock.ofd.fd < 0)
+		return;
+
+	osmo_fd_unregister(&export_sock.ofd);
+	close(export_sock.ofd.fd);
+	export_sock.ofd.fd = -1;
+
+	while (!llist_empty(&export_sock.clients))
+		export_client_free(llist_entry(export_sock.clients.next,
+					       struct export_client, list));
+
+	unlink(export_sock.path);
+	talloc_free(export_sock.path);
+	talloc_free(export_sock.prefix);
+	export_sock.path = export_sock.prefix = NULL;
+}
+
+#else
+
+int osmo_stats_export_sock_init(const char *path, enum osmo_stats_fmt fmt,
+				const char *prefix)
+{
+	return -ENOTSUP;
+}
+
+void osmo_stats_export_sock_close(void)
+{
+}
+
+#endif /* HAVE_SYS_SOCKET_H */
+
+/*! @} */
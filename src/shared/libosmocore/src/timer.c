@@ -35,14 +35,245 @@ static struct timeval *nearest_p;
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/timer_compat.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/utils.h>
 
 static struct rb_root timer_root = RB_ROOT;
 
+static enum osmo_timer_backend timer_backend = OSMO_TIMER_BACKEND_RBTREE;
+
+#ifdef CLOCK_MONOTONIC
+#define HAVE_TIMER_WHEEL
+#endif
+
+#ifdef HAVE_TIMER_WHEEL
+
+/*
+ * Hierarchical timer wheel, in the spirit of the classic Linux kernel
+ * timer wheel: level 0 has one slot per tick, each further level covers
+ * 64 slots of the level below.  Timers are cascaded down one level each
+ * time the level below wraps around.  Arming and cancelling a timer is
+ * O(1), the timers of a slot are only ever looked at once it is due.
+ *
+ * Unlike the kernel, the exact expiration time is kept in the timer, so
+ * timers never fire early and are not rounded to the tick granularity.
+ */
+#define TW_TICK_SHIFT	10	/* one tick is 1.024ms */
+#define TW_L0_BITS	8
+#define TW_L0_SIZE	(1 << TW_L0_BITS)
+#define TW_L0_MASK	(TW_L0_SIZE - 1)
+#define TW_LN_BITS	6
+#define TW_LN_SIZE	(1 << TW_LN_BITS)
+#define TW_LN_MASK	(TW_LN_SIZE - 1)
+#define TW_LEVELS	4	/* in addition to level 0 */
+#define TW_MAX_IDX	(1ULL << (TW_L0_BITS + TW_LEVELS * TW_LN_BITS))
+
+static struct llist_head tw_l0[TW_L0_SIZE];
+static struct llist_head tw_ln[TW_LEVELS][TW_LN_SIZE];
+/* non-empty level 0 slots, may contain stale bits of emptied slots */
+static uint64_t tw_l0_map[TW_L0_SIZE / 64];
+/* the tick up to which the wheel has been processed */
+static uint64_t tw_jiffies;
+static unsigned int tw_count;
+
+static inline uint64_t tv_to_us(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static void tw_enqueue(struct osmo_timer_list *timer)
+{
+	uint64_t expires = tv_to_us(&timer->timeout) >> TW_TICK_SHIFT;
+	uint64_t idx;
+	unsigned int i, l;
+
+	/* already expired timers go into the slot processed next */
+	if (expires < tw_jiffies)
+		expires = tw_jiffies;
+
+	idx = expires - tw_jiffies;
+	if (idx < TW_L0_SIZE) {
+		i = expires & TW_L0_MASK;
+		tw_l0_map[i / 64] |= 1ULL << (i % 64);
+		llist_add_tail(&timer->list, &tw_l0[i]);
+		return;
+	}
+
+	if (idx >= TW_MAX_IDX) {
+		/* will be cascaded into the right place later on */
+		expires = tw_jiffies + TW_MAX_IDX - 1;
+		idx = TW_MAX_IDX - 1;
+	}
+
+	for (l = 0; l < TW_LEVELS - 1; l++) {
+		if (idx < 1ULL << (TW_L0_BITS + (l + 1) * TW_LN_BITS))
+			break;
+	}
+	i = (expires >> (TW_L0_BITS + l * TW_LN_BITS)) & TW_LN_MASK;
+	llist_add_tail(&timer->list, &tw_ln[l][i]);
+}
+
+static void tw_cascade(void)
+{
+	struct osmo_timer_list *this, *tmp;
+	LLIST_HEAD(cascade);
+	unsigned int i, l;
+
+	for (l = 0; l < TW_LEVELS; l++) {
+		i = (tw_jiffies >> (TW_L0_BITS + l * TW_LN_BITS)) & TW_LN_MASK;
+		llist_splice_init(&tw_ln[l][i], &cascade);
+		llist_for_each_entry_safe(this, tmp, &cascade, list) {
+			llist_del(&this->list);
+			tw_enqueue(this);
+		}
+		/* stop unless this level wrapped around as well */
+		if (i)
+			break;
+	}
+}
+
+/* first non-empty level 0 slot at or after 'start', TW_L0_SIZE if none */
+static unsigned int tw_next_slot(unsigned int start)
+{
+	unsigned int w;
+	uint64_t bits;
+
+	for (w = start / 64; w < ARRAY_SIZE(tw_l0_map); w++) {
+		bits = tw_l0_map[w];
+		if (w == start / 64)
+			bits &= ~0ULL << (start % 64);
+		while (bits) {
+			unsigned int i = w * 64 + __builtin_ctzll(bits);
+			if (!llist_empty(&tw_l0[i]))
+				return i;
+			/* drop the stale bit of an emptied slot */
+			tw_l0_map[w] &= ~(1ULL << (i % 64));
+			bits &= bits - 1;
+		}
+	}
+
+	return TW_L0_SIZE;
+}
+
+static void tw_init(const struct timeval *now)
+{
+	unsigned int i, l;
+
+	for (i = 0; i < TW_L0_SIZE; i++)
+		INIT_LLIST_HEAD(&tw_l0[i]);
+	for (l = 0; l < TW_LEVELS; l++) {
+		for (i = 0; i < TW_LN_SIZE; i++)
+			INIT_LLIST_HEAD(&tw_ln[l][i]);
+	}
+	memset(tw_l0_map, 0, sizeof(tw_l0_map));
+	tw_jiffies = tv_to_us(now) >> TW_TICK_SHIFT;
+	tw_count = 0;
+}
+
+static void tw_add(struct osmo_timer_list *timer)
+{
+	tw_count++;
+	tw_enqueue(timer);
+}
+
+static void tw_del(struct osmo_timer_list *timer)
+{
+	tw_count--;
+	llist_del_init(&timer->list);
+}
+
+/* return the expiration time of the nearest timer, if any */
+static int tw_nearest(struct timeval *cand)
+{
+	struct osmo_timer_list *this;
+	uint64_t min = UINT64_MAX, us;
+	unsigned int i;
+
+	if (!tw_count)
+		return 0;
+
+	i = tw_next_slot(tw_jiffies & TW_L0_MASK);
+	if (i == TW_L0_SIZE) {
+		/* Nothing due before the next cascade, so just wake up
+		 * for it.  This is at most every 262ms. */
+		min = ((tw_jiffies | TW_L0_MASK) + 1) << TW_TICK_SHIFT;
+	} else {
+		llist_for_each_entry(this, &tw_l0[i], list) {
+			us = tv_to_us(&this->timeout);
+			if (us < min)
+				min = us;
+		}
+	}
+
+	cand->tv_sec = min / 1000000;
+	cand->tv_usec = min % 1000000;
+
+	return 1;
+}
+
+/* move all expired timers to 'expired' and advance the wheel */
+static void tw_expire(const struct timeval *now, struct llist_head *expired)
+{
+	uint64_t now_us = tv_to_us(now);
+	uint64_t now_tick = now_us >> TW_TICK_SHIFT;
+	struct osmo_timer_list *this, *tmp;
+	unsigned int i, next;
+
+	if (!tw_count) {
+		if (now_tick > tw_jiffies)
+			tw_jiffies = now_tick;
+		return;
+	}
+
+	while (1) {
+		i = tw_jiffies & TW_L0_MASK;
+		llist_for_each_entry_safe(this, tmp, &tw_l0[i], list) {
+			/* only the slot of the current tick may hold
+			 * timers that are not due yet */
+			if (tv_to_us(&this->timeout) > now_us)
+				continue;
+			llist_move_tail(&this->list, expired);
+		}
+
+		if (tw_jiffies >= now_tick)
+			break;
+
+		/* skip the empty slots up to the next cascade */
+		next = tw_next_slot(i + 1);
+		if (tw_jiffies - i + next > now_tick)
+			tw_jiffies = now_tick;
+		else
+			tw_jiffies += next - i;
+
+		if (!(tw_jiffies & TW_L0_MASK))
+			tw_cascade();
+	}
+}
+
+/* move all pending timers to 'timers' */
+static void tw_drain(struct llist_head *timers)
+{
+	unsigned int i, l;
+
+	for (i = 0; i < TW_L0_SIZE; i++)
+		llist_splice_init(&tw_l0[i], timers);
+	for (l = 0; l < TW_LEVELS; l++) {
+		for (i = 0; i < TW_LN_SIZE; i++)
+			llist_splice_init(&tw_ln[l][i], timers);
+	}
+	memset(tw_l0_map, 0, sizeof(tw_l0_map));
+	tw_count = 0;
+}
+
+#endif /* HAVE_TIMER_WHEEL */
+
 static void __add_timer(struct osmo_timer_list *timer)
 {
 	struct rb_node **new = &(timer_root.rb_node);
@@ -72,6 +303,12 @@ void osmo_timer_add(struct osmo_timer_list *timer)
 	osmo_timer_del(timer);
 	timer->active = 1;
 	INIT_LLIST_HEAD(&timer->list);
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		tw_add(timer);
+		return;
+	}
+#endif
 	__add_timer(timer);
 }
 
@@ -90,7 +327,7 @@ osmo_timer_schedule(struct osmo_timer_list *timer, int seconds, int microseconds
 {
 	struct timeval current_time;
 
-	gettimeofday(&current_time, NULL);
+	osmo_timers_gettime(&current_time);
 	timer->timeout.tv_sec = seconds;
 	timer->timeout.tv_usec = microseconds;
 	timeradd(&timer->timeout, &current_time, &timer->timeout);
@@ -107,6 +344,12 @@ void osmo_timer_del(struct osmo_timer_list *timer)
 {
 	if (timer->active) {
 		timer->active = 0;
+#ifdef HAVE_TIMER_WHEEL
+		if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+			tw_del(timer);
+			return;
+		}
+#endif
 		rb_erase(&timer->node, &timer_root);
 		/* make sure this is not already scheduled for removal. */
 		if (!llist_empty(&timer->list))
@@ -142,11 +385,11 @@ int osmo_timer_remaining(const struct osmo_timer_list *timer,
 	struct timeval current_time;
 
 	if (!now) {
-		gettimeofday(&current_time, NULL);
+		osmo_timers_gettime(&current_time);
 		now = &current_time;
 	}
 
-	timersub(&timer->timeout, &current_time, remaining);
+	timersub(&timer->timeout, now, remaining);
 
 	if (remaining->tv_sec < 0)
 		return -1;
@@ -192,7 +435,19 @@ void osmo_timers_prepare(void)
 	struct rb_node *node;
 	struct timeval current;
 
-	gettimeofday(&current, NULL);
+	osmo_timers_gettime(&current);
+
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		struct timeval cand;
+
+		if (tw_nearest(&cand))
+			update_nearest(&cand, &current);
+		else
+			nearest_p = NULL;
+		return;
+	}
+#endif
 
 	node = rb_first(&timer_root);
 	if (node) {
@@ -215,9 +470,14 @@ int osmo_timers_update(void)
 	struct osmo_timer_list *this;
 	int work = 0;
 
-	gettimeofday(&current_time, NULL);
+	osmo_timers_gettime(&current_time);
 
 	INIT_LLIST_HEAD(&timer_eviction_list);
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		tw_expire(&current_time, &timer_eviction_list);
+	else
+#endif
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		this = container_of(node, struct osmo_timer_list, node);
 
@@ -255,10 +515,109 @@ int osmo_timers_check(void)
 	struct rb_node *node;
 	int i = 0;
 
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		return tw_count;
+#endif
+
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		i++;
 	}
 	return i;
 }
 
+/*! \brief get the current time in the clock base of the timer backend
+ *  \param[out] tv the current time
+ *  \returns 0 on success, negative in case of error
+ *
+ * The rb-tree backend uses the wall-clock time of gettimeofday(), the
+ * timer wheel backend uses CLOCK_MONOTONIC.  Use this rather than
+ * gettimeofday() when filling in the timeout for osmo_timer_add().
+ */
+int osmo_timers_gettime(struct timeval *tv)
+{
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		struct timespec ts;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+			return -errno;
+		tv->tv_sec = ts.tv_sec;
+		tv->tv_usec = ts.tv_nsec / 1000;
+		return 0;
+	}
+#endif
+	return gettimeofday(tv, NULL);
+}
+
+/*! \brief select the data structure used for timer management
+ *  \param[in] be backend to use from now on
+ *  \returns 0 on success, negative in case of error
+ *
+ * The rb-tree is the default.  The timer wheel arms and cancels timers
+ * in O(1) and runs on CLOCK_MONOTONIC, so it is not affected by jumps
+ * of the wall-clock time.  Pending timers are carried over, keeping
+ * their remaining time.  Must not be called from a timer callback.
+ */
+int osmo_timers_set_backend(enum osmo_timer_backend be)
+{
+	struct osmo_timer_list *this, *tmp;
+	struct timeval old_now, new_now;
+	struct rb_node *node;
+	LLIST_HEAD(pending);
+
+	switch (be) {
+	case OSMO_TIMER_BACKEND_RBTREE:
+		break;
+#ifdef HAVE_TIMER_WHEEL
+	case OSMO_TIMER_BACKEND_WHEEL:
+		break;
+#endif
+	default:
+		return -ENOTSUP;
+	}
+
+	if (be == timer_backend)
+		return 0;
+
+	/* collect the pending timers of the old backend */
+	osmo_timers_gettime(&old_now);
+#ifdef HAVE_TIMER_WHEEL
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		tw_drain(&pending);
+	else
+#endif
+	while ((node = rb_first(&timer_root))) {
+		this = container_of(node, struct osmo_timer_list, node);
+		rb_erase(node, &timer_root);
+		llist_add_tail(&this->list, &pending);
+	}
+
+	timer_backend = be;
+	osmo_timers_gettime(&new_now);
+#ifdef HAVE_TIMER_WHEEL
+	if (be == OSMO_TIMER_BACKEND_WHEEL)
+		tw_init(&new_now);
+#endif
+
+	/* and move them over to the new clock base */
+	llist_for_each_entry_safe(this, tmp, &pending, list) {
+		llist_del(&this->list);
+		timersub(&this->timeout, &old_now, &this->timeout);
+		timeradd(&this->timeout, &new_now, &this->timeout);
+		this->active = 0;
+		osmo_timer_add(this);
+	}
+
+	osmo_timers_prepare();
+
+	return 0;
+}
+
+/*! \brief get the data structure used for timer management */
+enum osmo_timer_backend osmo_timers_get_backend(void)
+{
+	return timer_backend;
+}
+
 /*! @} */
@@ -177,8 +177,7 @@ DEFUN(logging_level,
 		return CMD_WARNING;
 	}
 
-	tgt->categories[category].enabled = 1;
-	tgt->categories[category].loglevel = level;
+	log_set_category_filter(tgt, category, 1, level);
 
 	return CMD_SUCCESS;
 }
@@ -510,6 +509,50 @@ DEFUN(cfg_no_log_file, cfg_no_log_file_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_log_binary, cfg_log_binary_cmd,
+	"log binary .FILENAME",
+	LOG_STR "Logging to binary file, see osmo-logdecode\n" "Filename\n")
+{
+	const char *fname = argv[0];
+	struct log_target *tgt;
+
+	tgt = log_target_find(LOG_TGT_TYPE_BINARY, fname);
+	if (!tgt) {
+		tgt = log_target_create_binary(fname);
+		if (!tgt) {
+			vty_out(vty, "%% Unable to create file `%s'%s",
+				fname, VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+		log_add_target(tgt);
+	}
+
+	vty->index = tgt;
+	vty->node = CFG_LOG_NODE;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_log_binary, cfg_no_log_binary_cmd,
+	"no log binary .FILENAME",
+	NO_STR LOG_STR "Logging to binary file, see osmo-logdecode\n"
+	"Filename\n")
+{
+	const char *fname = argv[0];
+	struct log_target *tgt;
+
+	tgt = log_target_find(LOG_TGT_TYPE_BINARY, fname);
+	if (!tgt) {
+		vty_out(vty, "%% No such log file `%s'%s",
+			fname, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	log_target_destroy(tgt);
+
+	return CMD_SUCCESS;
+}
+
 static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 {
 	int i;
@@ -533,6 +576,10 @@ static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 	case LOG_TGT_TYPE_FILE:
 		vty_out(vty, "log file %s%s", tgt->tgt_file.fname, VTY_NEWLINE);
 		break;
+	case LOG_TGT_TYPE_BINARY:
+		vty_out(vty, "log binary %s%s", tgt->tgt_binary.fname,
+			VTY_NEWLINE);
+		break;
 	}
 
 	vty_out(vty, "  logging filter all %u%s",
@@ -602,6 +649,8 @@ void logging_vty_add_cmds(const struct log_info *cat)
 	install_element(CONFIG_NODE, &cfg_no_log_stderr_cmd);
 	install_element(CONFIG_NODE, &cfg_log_file_cmd);
 	install_element(CONFIG_NODE, &cfg_no_log_file_cmd);
+	install_element(CONFIG_NODE, &cfg_log_binary_cmd);
+	install_element(CONFIG_NODE, &cfg_no_log_binary_cmd);
 #ifdef HAVE_SYSLOG_H
 	install_element(CONFIG_NODE, &cfg_log_syslog_cmd);
 	install_element(CONFIG_NODE, &cfg_log_syslog_local_cmd);
@@ -54,7 +54,7 @@ void vty_out_rate_ctr_group(struct vty *vty, const char *prefix,
 		struct rate_ctr *ctr = &ctrg->ctr[i];
 		vty_out(vty, " %s%s: %8" PRIu64 " "
 			"(%" PRIu64 "/s %" PRIu64 "/m %" PRIu64 "/h %" PRIu64 "/d)%s",
-			prefix, ctrg->desc->ctr_desc[i].description, ctr->current,
+			prefix, ctrg->desc->ctr_desc[i].description, rate_ctr_get(ctr),
 			ctr->intv[RATE_CTR_INTV_SEC].rate,
 			ctr->intv[RATE_CTR_INTV_MIN].rate,
 			ctr->intv[RATE_CTR_INTV_HOUR].rate,
@@ -50,6 +50,51 @@ binstr(ubit_t *d, int n)
 	return str;
 }
 
+#define MULTI_COUNT	300
+
+/* Compare the bulk generators with the plain one */
+static int
+test_multi(int n, unsigned int key_step)
+{
+	static uint8_t keys[MULTI_COUNT * 8];
+	static uint32_t fns[MULTI_COUNT];
+	static ubit_t dl_m[MULTI_COUNT * 114], ul_m[MULTI_COUNT * 114];
+	static pbit_t dl_p[MULTI_COUNT * 15], ul_p[MULTI_COUNT * 15];
+	ubit_t dl_r[114], ul_r[114], tmp[114];
+	int i;
+
+	for (i=0; i<sizeof(keys); i++)
+		keys[i] = key[i % 8] ^ (i * 37);
+	for (i=0; i<MULTI_COUNT; i++)
+		fns[i] = (fn + i * 1234567) % (2048 * 26 * 51);
+
+	osmo_a5_multi(n, keys, key_step, fns, MULTI_COUNT, dl_m, ul_m);
+	osmo_a5_multi_pbit(n, keys, key_step, fns, MULTI_COUNT, dl_p, ul_p);
+
+	for (i=0; i<MULTI_COUNT; i++) {
+		osmo_a5(n, &keys[i * key_step], fns[i], dl_r, ul_r);
+
+		if (memcmp(dl_r, &dl_m[i * 114], 114) ||
+		    memcmp(ul_r, &ul_m[i * 114], 114))
+			return -1;
+
+		osmo_pbit2ubit(tmp, &dl_p[i * 15], 114);
+		if (memcmp(dl_r, tmp, 114))
+			return -1;
+
+		osmo_pbit2ubit(tmp, &ul_p[i * 15], 114);
+		if (memcmp(ul_r, tmp, 114))
+			return -1;
+	}
+
+	/* Downlink only */
+	osmo_a5_multi(n, keys, key_step, fns, MULTI_COUNT, ul_m, NULL);
+	if (memcmp(dl_m, ul_m, sizeof(dl_m)))
+		return -1;
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	ubit_t exp[114];
@@ -92,6 +137,15 @@ int main(int argc, char **argv)
 			fprintf(stderr, "[!] A5/%d UL failed", n);
 			exit(1);
 		}
+
+		/* Bulk generation */
+		if (!test_multi(n, 0) && !test_multi(n, 8))
+			printf("A5/%d - multi: OK\n", n);
+		else {
+			printf("A5/%d - multi: BAD\n", n);
+			fprintf(stderr, "[!] A5/%d multi failed", n);
+			exit(1);
+		}
 	}
 
 	return 0;
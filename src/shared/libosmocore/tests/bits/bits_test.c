@@ -0,0 +1,259 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bits.h>
+
+#define MAX_BITS	300
+#define MAX_OFS		17
+
+static ubit_t ubits[MAX_BITS + MAX_OFS + 8];
+static pbit_t pbits[(MAX_BITS + MAX_OFS) / 8 + 8];
+static sbit_t sbits[MAX_BITS + 8];
+
+/* Plain bit by bit versions to compare against */
+
+static void ref_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
+			      const ubit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	unsigned int i, op, bn;
+
+	for (i = 0; i < num_bits; i++) {
+		op = out_ofs + i;
+		bn = lsb_mode ? (op & 7) : (7 - (op & 7));
+		if (in[in_ofs + i])
+			out[op >> 3] |= 1 << bn;
+		else
+			out[op >> 3] &= ~(1 << bn);
+	}
+}
+
+static void ref_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
+			      const pbit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	unsigned int i, ip, bn;
+
+	for (i = 0; i < num_bits; i++) {
+		ip = in_ofs + i;
+		bn = lsb_mode ? (ip & 7) : (7 - (ip & 7));
+		out[out_ofs + i] = !!(in[ip >> 3] & (1 << bn));
+	}
+}
+
+static void fill_random(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(ubits); i++)
+		ubits[i] = rand() & 1;
+	for (i = 0; i < sizeof(pbits); i++)
+		pbits[i] = rand();
+	for (i = 0; i < sizeof(sbits); i++)
+		sbits[i] = rand();
+}
+
+static int check_pack(void)
+{
+	pbit_t out[sizeof(pbits)], ref[sizeof(pbits)];
+	unsigned int len, ofs, lsb;
+	int rc, fail = 0;
+
+	for (len = 0; len <= MAX_BITS; len++) {
+		fill_random();
+
+		memset(out, 0xa5, sizeof(out));
+		memset(ref, 0xa5, sizeof(ref));
+		rc = osmo_ubit2pbit(out, ubits, len);
+		ref_ubit2pbit_ext(ref, 0, ubits, 0, len, 0);
+		/* Unused bits of the last byte are cleared */
+		if (len % 8)
+			ref[len / 8] &= 0xff << (8 - len % 8);
+		if (rc != (len + 7) / 8 || memcmp(out, ref, sizeof(out)))
+			fail = 1;
+
+		for (ofs = 0; ofs < MAX_OFS; ofs++) {
+			for (lsb = 0; lsb < 2; lsb++) {
+				memcpy(out, pbits, sizeof(out));
+				memcpy(ref, pbits, sizeof(ref));
+				osmo_ubit2pbit_ext(out, ofs, ubits, ofs / 3,
+						   len, lsb);
+				ref_ubit2pbit_ext(ref, ofs, ubits, ofs / 3,
+						  len, lsb);
+				if (memcmp(out, ref, sizeof(out)))
+					fail = 1;
+			}
+		}
+	}
+
+	printf("pack: %s\n", fail ? "MISMATCH" : "ok");
+	return fail;
+}
+
+static int check_unpack(void)
+{
+	ubit_t out[sizeof(ubits)], ref[sizeof(ubits)];
+	unsigned int len, ofs, lsb;
+	int rc, fail = 0;
+
+	for (len = 0; len <= MAX_BITS; len++) {
+		fill_random();
+
+		memset(out, 0xa5, sizeof(out));
+		memset(ref, 0xa5, sizeof(ref));
+		rc = osmo_pbit2ubit(out, pbits, len);
+		ref_pbit2ubit_ext(ref, 0, pbits, 0, len, 0);
+		/* Nothing written beyond len, not even for 0 bits */
+		if (rc != len || memcmp(out, ref, sizeof(out)))
+			fail = 1;
+
+		for (ofs = 0; ofs < MAX_OFS; ofs++) {
+			for (lsb = 0; lsb < 2; lsb++) {
+				memset(out, 0xa5, sizeof(out));
+				memset(ref, 0xa5, sizeof(ref));
+				rc = osmo_pbit2ubit_ext(out, ofs / 3, pbits,
+							ofs, len, lsb);
+				ref_pbit2ubit_ext(ref, ofs / 3, pbits, ofs,
+						  len, lsb);
+				/* Nothing written outside of the range */
+				if (rc != ofs / 3 + len
+				 || memcmp(out, ref, sizeof(out)))
+					fail = 1;
+			}
+		}
+	}
+
+	printf("unpack: %s\n", fail ? "MISMATCH" : "ok");
+	return fail;
+}
+
+static int check_soft(void)
+{
+	sbit_t sout[MAX_BITS + 8];
+	ubit_t uout[MAX_BITS + 8];
+	unsigned int len, i;
+	int fail = 0;
+
+	for (len = 0; len <= MAX_BITS; len++) {
+		fill_random();
+
+		memset(sout, 0x55, sizeof(sout));
+		osmo_ubit2sbit(sout, ubits, len);
+		for (i = 0; i < len; i++)
+			fail |= sout[i] != (ubits[i] ? -127 : 127);
+		fail |= sout[len] != 0x55;
+
+		memset(uout, 0x55, sizeof(uout));
+		osmo_sbit2ubit(uout, sbits, len);
+		for (i = 0; i < len; i++)
+			fail |= uout[i] != (sbits[i] < 0);
+		fail |= uout[len] != 0x55;
+	}
+
+	/* Every possible soft bit value */
+	for (i = 0; i < 256; i++)
+		sbits[i] = i;
+	osmo_sbit2ubit(uout, sbits, 256);
+	for (i = 0; i < 256; i++)
+		fail |= uout[i] != (sbits[i] < 0);
+
+	printf("soft: %s\n", fail ? "MISMATCH" : "ok");
+	return fail;
+}
+
+static double elapsed_ns(struct timeval *start, int loops)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+
+	return (diff.tv_sec * 1e9 + diff.tv_usec * 1e3) / loops;
+}
+
+/* One normal burst worth of bits, as in trxcon and gprsdecode */
+static void bench(void)
+{
+	const int loops = 2000000, len = 148;
+	pbit_t pout[sizeof(pbits)];
+	ubit_t uout[sizeof(ubits)];
+	sbit_t sout[sizeof(sbits)];
+	struct timeval start;
+	int l;
+
+	fill_random();
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		ref_ubit2pbit_ext(pout, 0, ubits, l & 1, len, 0);
+	printf("ubit2pbit_ext   bitwise: %6.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		osmo_ubit2pbit_ext(pout, 0, ubits, l & 1, len, 0);
+	printf("ubit2pbit_ext:           %6.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		ref_pbit2ubit_ext(uout, 0, pbits, l & 1, len, 0);
+	printf("pbit2ubit_ext   bitwise: %6.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		osmo_pbit2ubit_ext(uout, 0, pbits, l & 1, len, 0);
+	printf("pbit2ubit_ext:           %6.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		osmo_ubit2sbit(sout, ubits + (l & 1), len);
+	printf("ubit2sbit:               %6.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		osmo_sbit2ubit(uout, sbits + (l & 1), len);
+	printf("sbit2ubit:               %6.1f ns\n", elapsed_ns(&start, loops));
+}
+
+int main(int argc, char **argv)
+{
+	int c, fail = 0;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	srand(0x1234);
+
+	fail |= check_pack();
+	fail |= check_unpack();
+	fail |= check_soft();
+
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bitvec.h>
+#include <osmocom/gsm/rxlev_stat.h>
+
+#define MAX_BYTES	40
+
+static uint8_t data[MAX_BYTES];
+
+/* Plain bit by bit versions to compare against */
+
+static int ref_find_bit_pos(const struct bitvec *bv, unsigned int n,
+			    enum bit_value val)
+{
+	unsigned int i;
+
+	for (i = n; i < bv->data_len*8; i++) {
+		if (bitvec_get_bit_pos(bv, i) == val)
+			return i;
+	}
+
+	return -1;
+}
+
+static unsigned int ref_get_nth_set_bit(const struct bitvec *bv,
+					unsigned int n)
+{
+	unsigned int i, k = 0;
+
+	for (i = 0; i < bv->data_len*8; i++) {
+		if (bitvec_get_bit_pos(bv, i) == ONE) {
+			k++;
+			if (k == n)
+				return i;
+		}
+	}
+
+	return 0;
+}
+
+/* Mostly sparse, so that runs of zero and one bytes are covered */
+static void fill_random(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(data); i++) {
+		switch (rand() % 4) {
+		case 0:
+			data[i] = 0x00;
+			break;
+		case 1:
+			data[i] = 0xff;
+			break;
+		case 2:
+			data[i] = 1 << (rand() % 8);
+			break;
+		default:
+			data[i] = rand();
+		}
+	}
+}
+
+static int check_find(void)
+{
+	struct bitvec bv = { .data = data };
+	unsigned int len, n;
+	int iter, fail = 0;
+
+	for (iter = 0; iter < 200; iter++) {
+		fill_random();
+
+		for (len = 0; len <= MAX_BYTES; len++) {
+			bv.data_len = len;
+
+			for (n = 0; n <= len * 8 + 9; n++) {
+				fail |= bitvec_find_bit_pos(&bv, n, ONE)
+					!= ref_find_bit_pos(&bv, n, ONE);
+				fail |= bitvec_find_bit_pos(&bv, n, ZERO)
+					!= ref_find_bit_pos(&bv, n, ZERO);
+			}
+			fail |= bitvec_find_bit_pos(&bv, 0, L) != -1;
+			fail |= bitvec_find_bit_pos(&bv, 0, H) != -1;
+		}
+	}
+
+	printf("find_bit_pos: %s\n", fail ? "MISMATCH" : "ok");
+	return fail;
+}
+
+static int check_nth_set(void)
+{
+	struct bitvec bv = { .data = data };
+	unsigned int len, n, cnt;
+	int iter, fail = 0;
+
+	for (iter = 0; iter < 200; iter++) {
+		fill_random();
+
+		for (len = 0; len <= MAX_BYTES; len++) {
+			bv.data_len = len;
+
+			cnt = 0;
+			for (n = 0; n < len * 8; n++)
+				cnt += bitvec_get_bit_pos(&bv, n) == ONE;
+			fail |= bitvec_popcount(&bv) != cnt;
+
+			for (n = 0; n <= cnt + 2; n++)
+				fail |= bitvec_get_nth_set_bit(&bv, n)
+					!= ref_get_nth_set_bit(&bv, n);
+		}
+	}
+
+	printf("get_nth_set_bit: %s\n", fail ? "MISMATCH" : "ok");
+	return fail;
+}
+
+static int check_strongest(void)
+{
+	static struct rxlev_stats st;
+	uint16_t arfcns[8];
+	uint8_t rxlevs[8];
+	int i, num;
+
+	rxlev_stat_reset(&st);
+	rxlev_stat_input(&st, 1023, 40);	/* clipped to 31 */
+	rxlev_stat_input(&st, 871, 20);
+	rxlev_stat_input(&st, 0, 20);
+	rxlev_stat_input(&st, 512, 31);
+	rxlev_stat_input(&st, 17, 5);
+	rxlev_stat_input(&st, 17, 25);	/* only returned once, at 25 */
+
+	num = rxlev_stat_get_strongest(&st, arfcns, rxlevs, 4);
+	for (i = 0; i < num; i++)
+		printf("strongest %d: ARFCN %u RxLev %u\n", i,
+			arfcns[i], rxlevs[i]);
+
+	num = rxlev_stat_get_strongest(&st, arfcns, NULL, ARRAY_SIZE(arfcns));
+	printf("total: %d, last ARFCN %u\n", num, arfcns[num - 1]);
+
+	return 0;
+}
+
+static double elapsed_ns(struct timeval *start, int loops)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+
+	return (diff.tv_sec * 1e9 + diff.tv_usec * 1e3) / loops;
+}
+
+/* A full power scan result, as reported back to layer23 */
+static void bench(void)
+{
+	const int loops = 2000;
+	static struct rxlev_stats st;
+	struct bitvec bv;
+	struct timeval start;
+	uint16_t arfcns[32];
+	int l, rxlev, arfcn, cnt = 0;
+
+	rxlev_stat_reset(&st);
+	for (arfcn = 0; arfcn < NUM_ARFCNS; arfcn++)
+		rxlev_stat_input(&st, arfcn, rand() % NUM_RXLEVS);
+
+	bv.data_len = NUM_ARFCNS/8;
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++) {
+		for (rxlev = 0; rxlev < NUM_RXLEVS; rxlev++) {
+			bv.data = st.rxlev_buckets[rxlev];
+			arfcn = -1;
+			while ((arfcn = ref_find_bit_pos(&bv, arfcn + 1, ONE)) >= 0)
+				cnt++;
+		}
+	}
+	printf("walk all buckets bitwise: %8.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++) {
+		for (rxlev = 0; rxlev < NUM_RXLEVS; rxlev++) {
+			arfcn = -1;
+			while ((arfcn = rxlev_stat_get_next(&st, rxlev, arfcn)) >= 0)
+				cnt++;
+		}
+	}
+	printf("walk all buckets:         %8.1f ns\n", elapsed_ns(&start, loops));
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++)
+		cnt += rxlev_stat_get_strongest(&st, arfcns, NULL,
+						ARRAY_SIZE(arfcns));
+	printf("strongest 32:             %8.1f ns\n", elapsed_ns(&start, loops));
+
+	/* Keep the loops from being optimized away */
+	if (cnt == 0)
+		printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int c, fail = 0;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	srand(0x1234);
+
+	fail |= check_find();
+	fail |= check_nth_set();
+	fail |= check_strongest();
+
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <osmocom/core/bits.h>
@@ -354,6 +355,52 @@ sbit_to_ubit(ubit_t *dst, sbit_t *src, int n)
 		dst[i] = src[i] < 0;
 }
 
+static void
+add_noise(sbit_t *b, int n)
+{
+	int i;
+	for (i=0; i<n; i++) {
+		int v = b[i] + (int)(random() % 301) - 150;
+		b[i] = v > 127 ? 127 : (v < -127 ? -127 : v);
+	}
+}
+
+static const enum osmo_conv_acc_type acc_types[] = {
+	OSMO_CONV_ACC_SCALAR,
+	OSMO_CONV_ACC_SSE2,
+	OSMO_CONV_ACC_AVX2,
+	OSMO_CONV_ACC_NEON,
+};
+
+/* Decodes a noisy vector with every supported add-compare-select
+ * implementation and checks that all of them match the generic one */
+static int
+check_acc(const struct conv_test_vector *tst, sbit_t *bs,
+          ubit_t *bu0, ubit_t *bu1)
+{
+	int i, rv_ref, rv;
+
+	osmo_conv_acc_set(OSMO_CONV_ACC_NONE);
+	rv_ref = osmo_conv_decode(tst->code, bs, bu0);
+
+	for (i=0; i<ARRAY_SIZE(acc_types); i++) {
+		if (osmo_conv_acc_set(acc_types[i]) < 0)
+			continue;
+
+		rv = osmo_conv_decode(tst->code, bs, bu1);
+		if (rv != rv_ref || memcmp(bu0, bu1, tst->in_len)) {
+			fprintf(stderr, "[!] ACS implementation %d mismatch "
+				"(%d vs %d)\n", acc_types[i], rv, rv_ref);
+			osmo_conv_acc_set(OSMO_CONV_ACC_AUTO);
+			return -1;
+		}
+	}
+
+	osmo_conv_acc_set(OSMO_CONV_ACC_AUTO);
+
+	return 0;
+}
+
 
 int main(int argc, char argv[])
 {
@@ -474,6 +521,26 @@ int main(int argc, char argv[])
 			printf("OK\n");
 		}
 
+		/* Check accelerated decoders against the generic one */
+		printf("[.] Accelerated decoding checks:\n");
+
+		for (i=0; i<3; i++) {
+			printf("[..] Noisy vector, all implementations : ");
+
+			fill_random(bu0, tst->in_len);
+
+			l = osmo_conv_encode(tst->code, bu0, bu1);
+			ubit_to_sbit(bs, bu1, l);
+			add_noise(bs, l);
+
+			if (check_acc(tst, bs, bu0, bu1)) {
+				printf("ERROR !\n");
+				return -1;
+			}
+
+			printf("OK\n");
+		}
+
 		/* Spacing */
 		printf("\n");
 	}
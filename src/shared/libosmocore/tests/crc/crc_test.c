@@ -0,0 +1,227 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/crcgen.h>
+#include <osmocom/core/utils.h>
+
+#define MAX_BITS	1200
+
+static struct osmo_crc8gen_code crc8_codes[] = {
+	{ 3, 0x3, 0x0, 0x7 },		/* TCH/FR class 1a parity */
+	{ 6, 0x2f, 0x0, 0x3f },		/* TCH/AFS */
+	{ 8, 0x07, 0xff, 0x00 },
+};
+
+static struct osmo_crc16gen_code crc16_codes[] = {
+	{ 10, 0x175, 0x000, 0x3ff },	/* RACH with BSIC */
+	{ 12, 0xd31, 0x000, 0xfff },	/* CS-2 / CS-3 */
+	{ 16, 0x1021, 0xffff, 0x0000 },	/* CCITT */
+};
+
+static struct osmo_crc32gen_code crc32_codes[] = {
+	{ 24, 0x864cfb, 0x000000, 0x000000 },
+	{ 32, 0x04c11db7, 0xffffffff, 0x00000000 }, /* MPEG-2 */
+};
+
+static struct osmo_crc64gen_code crc64_codes[] = {
+	{ 40, 0x0004820009ULL, 0x0, 0xffffffffffULL }, /* FIRE */
+	{ 64, 0x42f0e1eba9ea3693ULL, 0x0, 0x0 },	/* ECMA-182 */
+};
+
+static ubit_t ubits[MAX_BITS];
+static pbit_t pbits[MAX_BITS / 8];
+
+static void fill_random(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_BITS; i++)
+		ubits[i] = rand() & 1;
+	osmo_ubit2pbit(pbits, ubits, MAX_BITS);
+}
+
+/* Compare every variant against the bitwise one, for every length */
+#define CHECK_WIDTH(W, codes)						\
+static int check_crc##W(void)						\
+{									\
+	struct osmo_crc##W##gen_table tab;				\
+	struct osmo_crc##W##gen_code *code;				\
+	uint##W##_t ref, crc;						\
+	int c, len, round, fail = 0;					\
+									\
+	for (c = 0; c < ARRAY_SIZE(codes); c++) {			\
+		code = &codes[c];					\
+		osmo_crc##W##gen_table_init(&tab, code);		\
+									\
+		for (round = 0; round < 4; round++) {			\
+			fill_random();					\
+			for (len = 0; len <= MAX_BITS; len++) {		\
+				code->table = NULL;			\
+				ref = osmo_crc##W##gen_compute_bits(	\
+					code, ubits, len);		\
+				crc = osmo_crc##W##gen_compute_pbits(	\
+					code, pbits, len);		\
+				fail |= crc != ref;			\
+									\
+				code->table = &tab;			\
+				crc = osmo_crc##W##gen_compute_bits(	\
+					code, ubits, len);		\
+				fail |= crc != ref;			\
+				crc = osmo_crc##W##gen_compute_pbits(	\
+					code, pbits, len);		\
+				fail |= crc != ref;			\
+			}						\
+		}							\
+									\
+		code->table = NULL;					\
+		printf("crc%d: %2d bits: %s\n", W, code->bits,		\
+			fail ? "MISMATCH" : "ok");			\
+	}								\
+									\
+	return fail;							\
+}
+
+CHECK_WIDTH(8, crc8_codes)
+CHECK_WIDTH(16, crc16_codes)
+CHECK_WIDTH(32, crc32_codes)
+CHECK_WIDTH(64, crc64_codes)
+
+static void check_known(void)
+{
+	const char *str = "123456789";
+	struct osmo_crc16gen_table tab16;
+	struct osmo_crc32gen_table tab32;
+	ubit_t in[72];
+
+	osmo_pbit2ubit(in, (const pbit_t *) str, 72);
+
+	printf("CRC-16/CCITT-FALSE: 0x%04x\n",
+		osmo_crc16gen_compute_bits(&crc16_codes[2], in, 72));
+	osmo_crc16gen_table_init(&tab16, &crc16_codes[2]);
+	crc16_codes[2].table = &tab16;
+	printf("CRC-16/CCITT-FALSE: 0x%04x (table)\n",
+		osmo_crc16gen_compute_pbits(&crc16_codes[2],
+			(const pbit_t *) str, 72));
+	crc16_codes[2].table = NULL;
+
+	printf("CRC-32/MPEG-2: 0x%08x\n",
+		osmo_crc32gen_compute_bits(&crc32_codes[1], in, 72));
+	osmo_crc32gen_table_init(&tab32, &crc32_codes[1]);
+	crc32_codes[1].table = &tab32;
+	printf("CRC-32/MPEG-2: 0x%08x (table)\n",
+		osmo_crc32gen_compute_pbits(&crc32_codes[1],
+			(const pbit_t *) str, 72));
+	crc32_codes[1].table = NULL;
+}
+
+static double elapsed_ns(struct timeval *start)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+
+	return diff.tv_sec * 1e9 + diff.tv_usec * 1e3;
+}
+
+/* Typical block: 184 data bits protected by the FIRE code, and friends */
+#define BENCH_WIDTH(W, code)						\
+static void bench_crc##W(int len, int loops)				\
+{									\
+	struct osmo_crc##W##gen_table tab;				\
+	struct timeval start;						\
+	volatile uint##W##_t sink = 0;					\
+	double t_bit, t_tab, t_pbit;					\
+	int l;								\
+									\
+	osmo_crc##W##gen_table_init(&tab, &code);			\
+									\
+	code.table = NULL;						\
+	gettimeofday(&start, NULL);					\
+	for (l = 0; l < loops; l++)					\
+		sink ^= osmo_crc##W##gen_compute_bits(&code, ubits, len); \
+	t_bit = elapsed_ns(&start) / loops;				\
+									\
+	code.table = &tab;						\
+	gettimeofday(&start, NULL);					\
+	for (l = 0; l < loops; l++)					\
+		sink ^= osmo_crc##W##gen_compute_bits(&code, ubits, len); \
+	t_tab = elapsed_ns(&start) / loops;				\
+									\
+	gettimeofday(&start, NULL);					\
+	for (l = 0; l < loops; l++)					\
+		sink ^= osmo_crc##W##gen_compute_pbits(&code, pbits, len); \
+	t_pbit = elapsed_ns(&start) / loops;				\
+	code.table = NULL;						\
+									\
+	printf("crc%-2d %2d bits, %4d bit input: bitwise %7.1f ns, "	\
+		"table %6.1f ns, packed %6.1f ns\n", W, code.bits, len,	\
+		t_bit, t_tab, t_pbit);					\
+}
+
+BENCH_WIDTH(8, crc8_codes[1])
+BENCH_WIDTH(16, crc16_codes[1])
+BENCH_WIDTH(32, crc32_codes[1])
+BENCH_WIDTH(64, crc64_codes[0])
+
+static void bench(void)
+{
+	static const int lens[] = { 50, 184, 1024 };
+	int i;
+
+	fill_random();
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		bench_crc8(lens[i], 200000);
+		bench_crc16(lens[i], 200000);
+		bench_crc32(lens[i], 200000);
+		bench_crc64(lens[i], 200000);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int c, fail = 0;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	srand(0x4a5);
+
+	check_known();
+
+	fail |= check_crc8();
+	fail |= check_crc16();
+	fail |= check_crc32();
+	fail |= check_crc64();
+
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -18,6 +18,8 @@
  *
  */
 
+#include <stdio.h>
+
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 
@@ -48,6 +50,14 @@ static const struct log_info_cat default_categories[] = {
 	},
 };
 
+static int eval_count;
+
+static const char *count_eval(void)
+{
+	eval_count++;
+	return "";
+}
+
 const struct log_info log_info = {
 	.cat = default_categories,
 	.num_cat = ARRAY_SIZE(default_categories),
@@ -72,5 +82,15 @@ int main(int argc, char **argv)
 	DEBUGP(DCC, "You should see this\n");
 	DEBUGP(DMM, "You should not see this\n");
 
+	/* arguments of suppressed messages are not evaluated */
+	DEBUGP(DMM, "%s", count_eval());
+	log_set_log_level(stderr_target, LOGL_NOTICE);
+	LOGP(DRLL, LOGL_INFO, "%s", count_eval());
+	LOGP(DLGLOBAL, LOGL_INFO, "%s", count_eval());
+	LOGP(DRLL, LOGL_NOTICE, "You should see this%s\n", count_eval());
+	log_del_target(stderr_target);
+	LOGP(DRLL, LOGL_FATAL, "%s", count_eval());
+	printf("arguments evaluated %d time(s)\n", eval_count);
+
 	return 0;
 }
@@ -0,0 +1,155 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+
+#define LOG_FILE	"logging_binary_test.bin"
+
+enum {
+	DRLL,
+	DCC,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DRLL] = {
+		.name = "DRLL",
+		.description = "A-bis Radio Link Layer (RLL)",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+	[DCC] = {
+		.name = "DCC",
+		.description = "Layer3 Call Control (CC)",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+};
+
+const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+/* print the decoded file without the source path, which depends on the
+ * build directory, and only count the long messages if requested */
+static void decode(int count_long)
+{
+	FILE *in = fopen(LOG_FILE, "r");
+	FILE *out = tmpfile();
+	char line[4096];
+	int n = 0;
+
+	if (!in || !out) {
+		perror(LOG_FILE);
+		exit(1);
+	}
+
+	if (log_binary_decode(in, out, 0) < 0)
+		printf("decoding failed\n");
+	fclose(in);
+
+	rewind(out);
+	while (fgets(line, sizeof(line), out)) {
+		char *file = strstr(line, "logging_binary_test.c:");
+		char *path = strchr(line, ' ');
+
+		if (count_long && strstr(line, "xxxx")) {
+			n++;
+			continue;
+		}
+		if (file && path && path < file)
+			memmove(path + 1, file, strlen(file) + 1);
+		printf("%s", line);
+	}
+	fclose(out);
+
+	if (count_long)
+		printf("%d long messages\n", n);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t data[] = { 0xde, 0xad, 0xbe, 0xef };
+	char raw[4] = { 'w', 'x', 'y', 'z' };	/* not terminated */
+	struct log_target *tgt;
+	char big[900], *huge;
+	int i;
+
+	log_init(&log_info, NULL);
+
+	tgt = log_target_create_binary(LOG_FILE);
+	if (!tgt) {
+		perror(LOG_FILE);
+		exit(1);
+	}
+	log_add_target(tgt);
+	log_set_all_filter(tgt, 1);
+
+	for (i = 0; i < 3; i++)
+		LOGP(DRLL, LOGL_NOTICE, "loop %d\n", i);
+	LOGP(DCC, LOGL_ERROR, "ints: %hhd %hu %ld %lld %zu %x %05o %c\n",
+	     (signed char) -1, (unsigned short) 65535, -123456789L,
+	     -1234567890123LL, (size_t) 42, 0xcafe, 8, 'z');
+	LOGP(DCC, LOGL_NOTICE, "doubles: %.3f %e %g\n", 3.14159, 1e-3, 2.5);
+	LOGP(DCC, LOGL_NOTICE, "strings: '%s' '%-6s' '%.3s' %s\n",
+	     "foo", "bar", "bazbaz", osmo_hexdump(data, sizeof(data)));
+	LOGP(DCC, LOGL_NOTICE, "null: %s, stars: '%*d' '%.*s', 100%%\n",
+	     (char *) NULL, 4, 7, 2, "abc");
+	LOGP(DCC, LOGL_NOTICE, "precision: '%.4s' '%.*s' '%.*s'\n",
+	     raw, 2, raw, -1, "neg");
+	LOGP(DRLL, LOGL_NOTICE, "continued ");
+	LOGPC(DRLL, LOGL_NOTICE, "line\n");
+	LOGP(DLGLOBAL, LOGL_NOTICE, "library category\n");
+	LOGP(DCC, LOGL_DEBUG, "You should not see this\n");
+
+	/* too long for one record, stored as (truncated) text */
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	LOGP(DCC, LOGL_NOTICE, "long: %s %s %zu\n", big, big, strlen(big));
+
+	/* the binary length has 16 bit, not to be wrapped around */
+	huge = malloc(65536 + 4);
+	memset(huge, 'h', 65536 + 3);
+	huge[65536 + 3] = '\0';
+	LOGP(DCC, LOGL_NOTICE, "huge: %.10s %s\n", huge, huge + 65536 - 10);
+	LOGP(DCC, LOGL_NOTICE, "too huge: %s\n", huge);
+	free(huge);
+
+	log_target_destroy(tgt);
+	decode(0);
+
+	/* fill the ring without ever writing it out */
+	tgt = log_target_create_binary(LOG_FILE);
+	log_add_target(tgt);
+	log_set_all_filter(tgt, 1);
+	for (i = 0; i < 400; i++)
+		LOGP(DRLL, LOGL_NOTICE, "%s\n", big);
+	log_target_binary_flush(tgt);
+	LOGP(DRLL, LOGL_NOTICE, "after overflow\n");
+	log_target_destroy(tgt);
+
+	decode(1);
+
+	unlink(LOG_FILE);
+
+	return 0;
+}
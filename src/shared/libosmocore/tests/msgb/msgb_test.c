@@ -0,0 +1,251 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/panic.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#define ASSERT(exp)    \
+	if (!(exp)) { \
+		printf("Assert failed %s %s:%d\n", #exp, __FILE__, __LINE__); \
+		abort(); \
+	}
+
+static const uint16_t sizes[] = { 64, 256, 1024 };
+
+static jmp_buf panic_jmp;
+
+static void panic_handler(const char *fmt, va_list args)
+{
+	/* Only the format, the arguments contain pointers */
+	printf("panic: %s", fmt);
+	longjmp(panic_jmp, 1);
+}
+
+static void print_stats(struct msgb_pool *pool)
+{
+	struct msgb_pool_stats st;
+
+	msgb_pool_get_stats(pool, &st);
+	printf("allocs=%lu hits=%lu in_use=%u in_use_max=%u oversize=%lu\n",
+		st.allocs, st.hits, st.in_use, st.in_use_max, pool->oversize);
+}
+
+static void test_pool(void)
+{
+	struct msgb_pool *pool;
+	struct msgb *msg, *msg2, *big;
+	void *ctx = talloc_named_const(NULL, 0, "msgb_test");
+
+	printf("Testing size classes and reuse\n");
+
+	pool = msgb_pool_alloc(ctx, "test", sizes, ARRAY_SIZE(sizes), 2, 4);
+	ASSERT(pool);
+
+	/* The smallest fitting class is used */
+	msg = msgb_alloc_pool(pool, 100, "msg");
+	ASSERT(msg && msg->pool == pool && msg->pool_class == 1);
+	ASSERT(msg->data_len == 100 && msgb_tailroom(msg) == 100);
+	ASSERT(msg->len == 0 && msg->data == msg->head);
+
+	memset(msgb_put(msg, 100), 0xaa, 100);
+	msgb_free(msg);
+
+	/* A freed msgb is handed out again, looking fresh */
+	msg2 = msgb_alloc_pool(pool, 80, "msg2");
+	ASSERT(msg2 == msg);
+	ASSERT(msg2->len == 0 && msg2->data_len == 80);
+	ASSERT(msg2->_data[0] == 0 && msg2->_data[79] == 0);
+	msgb_free(msg2);
+
+	/* Too big for any class */
+	big = msgb_alloc_pool(pool, 2000, "big");
+	ASSERT(big && big->pool == NULL);
+	msgb_free(big);
+
+	print_stats(pool);
+
+	/* Sizes have to be ascending */
+	ASSERT(msgb_pool_alloc(ctx, "bad", (uint16_t []) { 64, 64 },
+		2, 0, 0) == NULL);
+
+	msgb_pool_free(pool);
+	talloc_free(ctx);
+}
+
+static void test_watermark(void)
+{
+	struct msgb_pool *pool;
+	struct msgb *msgs[10];
+	int i;
+
+	printf("Testing high-water mark and free list limit\n");
+
+	pool = msgb_pool_alloc(NULL, "test", sizes, ARRAY_SIZE(sizes), 0, 4);
+	ASSERT(pool);
+
+	for (i = 0; i < ARRAY_SIZE(msgs); i++)
+		msgs[i] = msgb_alloc_pool(pool, 32, "msg");
+	for (i = 0; i < ARRAY_SIZE(msgs); i++)
+		msgb_free(msgs[i]);
+
+	/* At most max_free msgbs are kept */
+	printf("free_len=%u\n", pool->classes[0].free_len);
+
+	for (i = 0; i < ARRAY_SIZE(msgs); i++)
+		msgs[i] = msgb_alloc_pool(pool, 32, "msg");
+	for (i = 0; i < ARRAY_SIZE(msgs); i++)
+		msgb_free(msgs[i]);
+
+	print_stats(pool);
+
+	msgb_pool_free(pool);
+}
+
+static void test_default_pool(void)
+{
+	struct msgb_pool *pool;
+	struct msgb *msg;
+
+	printf("Testing msgb_alloc() with a default pool\n");
+
+	pool = msgb_pool_alloc(NULL, "test", sizes, ARRAY_SIZE(sizes), 1, 1);
+	ASSERT(pool);
+
+	msgb_set_pool(pool);
+	msg = msgb_alloc_headroom(200, 20, "msg");
+	ASSERT(msg && msg->pool == pool);
+	ASSERT(msgb_headroom(msg) == 20 && msgb_tailroom(msg) == 180);
+	msgb_free(msg);
+
+	/* Freeing the pool resets the default */
+	msgb_pool_free(pool);
+	msg = msgb_alloc(200, "msg");
+	ASSERT(msg && msg->pool == NULL);
+	msgb_free(msg);
+}
+
+static void test_poison(void)
+{
+	struct msgb_pool *pool;
+	struct msgb *volatile msg;
+
+	printf("Testing poisoning\n");
+
+	pool = msgb_pool_alloc(NULL, "test", sizes, ARRAY_SIZE(sizes), 1, 4);
+	ASSERT(pool);
+	msgb_pool_set_poison(pool, 1);
+	osmo_set_panic_handler(panic_handler);
+
+	/* A clean round trip */
+	msg = msgb_alloc_pool(pool, 10, "msg");
+	msgb_put_u8(msg, 0x42);
+	msgb_free(msg);
+	ASSERT(msg->_data[0] == MSGB_POOL_POISON);
+
+	/* Use after free */
+	msg->_data[5] = 0x00;
+	if (setjmp(panic_jmp) == 0) {
+		msgb_alloc_pool(pool, 10, "msg");
+		printf("use after free not detected\n");
+	}
+
+	/* Double free */
+	msg = msgb_alloc_pool(pool, 10, "msg");
+	msgb_free(msg);
+	if (setjmp(panic_jmp) == 0) {
+		msgb_free(msg);
+		printf("double free not detected\n");
+	}
+
+	osmo_set_panic_handler(NULL);
+	msgb_pool_free(pool);
+}
+
+static double bench_loop(struct msgb_pool *pool, int loops)
+{
+	struct timeval start, stop, diff;
+	struct msgb *msg[4];
+	int l, i;
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++) {
+		/* A few msgbs in flight, as on an L1CTL link */
+		for (i = 0; i < ARRAY_SIZE(msg); i++) {
+			msg[i] = pool ? msgb_alloc_pool(pool, 256, "bench")
+				: msgb_alloc(256, "bench");
+			msgb_put(msg[i], 23);
+		}
+		for (i = 0; i < ARRAY_SIZE(msg); i++)
+			msgb_free(msg[i]);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return (diff.tv_sec * 1e9 + diff.tv_usec * 1e3) / (loops * 4.0);
+}
+
+static void bench(void)
+{
+	struct msgb_pool *pool;
+	struct msgb_pool_stats st;
+	const int loops = 1000000;
+
+	pool = msgb_pool_alloc(NULL, "bench", sizes, ARRAY_SIZE(sizes), 8, 8);
+	ASSERT(pool);
+
+	printf("talloc: %6.1f ns per msgb\n", bench_loop(NULL, loops));
+	printf("pool:   %6.1f ns per msgb\n", bench_loop(pool, loops));
+
+	msgb_pool_get_stats(pool, &st);
+	printf("pool hit rate: %.2f%%\n", 100.0 * st.hits / st.allocs);
+
+	msgb_pool_free(pool);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	test_pool();
+	test_watermark();
+	test_default_pool();
+	test_poison();
+
+	printf("Done\n");
+
+	return 0;
+}
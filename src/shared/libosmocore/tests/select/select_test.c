@@ -0,0 +1,363 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+#include "../../config.h"
+
+#define NUM_PIPES	32
+
+struct test_pipe {
+	struct osmo_fd rd;
+	struct osmo_fd wr;
+	unsigned int read_cnt;
+	unsigned int write_cnt;
+	int read_len;		/* bytes consumed per read callback */
+	int rd_registered;
+	struct test_pipe *victim; /* unregistered by the read callback */
+	struct osmo_fd *newcomer; /* registered by the read callback */
+};
+
+static struct test_pipe pipes[NUM_PIPES];
+
+static const enum osmo_select_backend backends[] = {
+	OSMO_SELECT_BACKEND_SELECT,
+	OSMO_SELECT_BACKEND_EPOLL,
+};
+
+static int pipe_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct test_pipe *p = ofd->data;
+	char buf[16];
+
+	if (read(ofd->fd, buf, p->read_len) < 0)
+		return -1;
+	p->read_cnt++;
+
+	if (p->victim) {
+		osmo_fd_unregister(&p->victim->rd);
+		p->victim->rd_registered = 0;
+		p->victim = NULL;
+	}
+
+	if (p->newcomer) {
+		osmo_fd_register(p->newcomer);
+		p->newcomer = NULL;
+	}
+
+	return 0;
+}
+
+static int pipe_write_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct test_pipe *p = ofd->data;
+
+	p->write_cnt++;
+	ofd->when &= ~BSC_FD_WRITE;
+
+	return 0;
+}
+
+static int setup(unsigned int num)
+{
+	unsigned int i;
+	int fds[2];
+
+	for (i = 0; i < num; i++) {
+		struct test_pipe *p = &pipes[i];
+
+		memset(p, 0, sizeof(*p));
+		if (pipe(fds) < 0)
+			return -1;
+
+		p->read_len = 16;
+
+		p->rd.fd = fds[0];
+		p->rd.when = BSC_FD_READ;
+		p->rd.cb = pipe_read_cb;
+		p->rd.data = p;
+
+		p->wr.fd = fds[1];
+		p->wr.when = 0;
+		p->wr.cb = pipe_write_cb;
+		p->wr.data = p;
+
+		if (osmo_fd_register(&p->rd) || osmo_fd_register(&p->wr))
+			return -1;
+		p->rd_registered = 1;
+	}
+
+	return 0;
+}
+
+static void teardown(unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (pipes[i].rd_registered)
+			osmo_fd_unregister(&pipes[i].rd);
+		osmo_fd_unregister(&pipes[i].wr);
+		close(pipes[i].rd.fd);
+		close(pipes[i].wr.fd);
+	}
+}
+
+static int run_checks(void)
+{
+	struct osmo_fd high;
+	int i;
+
+	if (setup(NUM_PIPES))
+		return -1;
+
+	/* Only the readable fds are dispatched */
+	for (i = 0; i < NUM_PIPES; i += 3)
+		if (write(pipes[i].wr.fd, "x", 1) != 1)
+			return -1;
+
+	osmo_select_main(1);
+
+	for (i = 0; i < NUM_PIPES; i++)
+		if (pipes[i].read_cnt != (i % 3 == 0))
+			return -2;
+
+	/* Level triggered: a partial read gets notified again */
+	pipes[1].read_cnt = 0;
+	pipes[1].read_len = 1;
+	if (write(pipes[1].wr.fd, "xy", 2) != 2)
+		return -1;
+
+	osmo_select_main(1);
+	osmo_select_main(1);
+	osmo_select_main(1);
+
+	if (pipes[1].read_cnt != 2)
+		return -3;
+
+	/* Changes of 'when' are picked up */
+	osmo_fd_write_enable(&pipes[2].wr);
+	osmo_select_main(1);
+	osmo_select_main(1);
+
+	if (pipes[2].write_cnt != 1)
+		return -4;
+
+	/* ... also when assigned directly, as write queues do */
+	pipes[3].wr.when |= BSC_FD_WRITE;
+	osmo_select_main(1);
+	osmo_select_main(1);
+
+	if (pipes[3].write_cnt != 1)
+		return -4;
+
+	/* An fd unregistered by an earlier callback is not dispatched */
+	pipes[4].read_cnt = 0;
+	pipes[5].read_cnt = 0;
+	pipes[4].victim = &pipes[5];
+	if (write(pipes[4].wr.fd, "x", 1) != 1)
+		return -1;
+	if (write(pipes[5].wr.fd, "x", 1) != 1)
+		return -1;
+
+	osmo_select_main(1);
+
+	if (pipes[4].read_cnt != 1 || pipes[5].read_cnt != 0)
+		return -5;
+
+	/* A callback registering a high fd, as after accept() */
+	memset(&high, 0, sizeof(high));
+	high.fd = fcntl(pipes[6].rd.fd, F_DUPFD, 900);
+	if (high.fd < 0)
+		return -1;
+	high.cb = pipe_write_cb;
+	pipes[6].read_cnt = 0;
+	pipes[6].newcomer = &high;
+	if (write(pipes[6].wr.fd, "x", 1) != 1)
+		return -1;
+
+	osmo_select_main(1);
+	osmo_fd_unregister(&high);
+	close(high.fd);
+
+	if (pipes[6].read_cnt != 1)
+		return -7;
+
+	teardown(NUM_PIPES);
+
+	return 0;
+}
+
+static int run_edge_check(void)
+{
+	int rc = 0;
+
+	if (setup(1))
+		return -1;
+
+	/* Edge triggered: a partial read is not notified again */
+	osmo_fd_update_when(&pipes[0].rd, ~0, BSC_FD_EDGE);
+	pipes[0].read_len = 1;
+	if (write(pipes[0].wr.fd, "xy", 2) != 2)
+		return -1;
+
+	osmo_select_main(1);
+	osmo_select_main(1);
+
+	if (pipes[0].read_cnt != 1)
+		rc = -6;
+
+	teardown(1);
+
+	return rc;
+}
+
+static void run_bench(unsigned int num_fds, unsigned int active, int loops)
+{
+	struct test_pipe *bp;
+	struct timeval start, stop, diff;
+	unsigned int i, b;
+	int fds[2], l;
+
+	bp = calloc(num_fds, sizeof(*bp));
+	if (!bp)
+		return;
+
+	for (i = 0; i < num_fds; i++) {
+		if (pipe(fds) < 0) {
+			fprintf(stderr, "cannot create %u pipes\n", num_fds);
+			exit(EXIT_FAILURE);
+		}
+
+		bp[i].read_len = 16;
+		bp[i].rd.fd = fds[0];
+		bp[i].rd.when = BSC_FD_READ;
+		bp[i].rd.cb = pipe_read_cb;
+		bp[i].rd.data = &bp[i];
+		bp[i].wr.fd = fds[1];
+	}
+
+	for (b = 0; b < ARRAY_SIZE(backends); b++) {
+		if (osmo_select_set_backend(backends[b]) < 0)
+			continue;
+
+		/* select() can't deal with fds above FD_SETSIZE */
+		if (backends[b] == OSMO_SELECT_BACKEND_SELECT
+		 && bp[num_fds - 1].wr.fd >= FD_SETSIZE) {
+			printf("%-6s %6u fds: skipped (FD_SETSIZE)\n",
+				"select", num_fds);
+			continue;
+		}
+
+		for (i = 0; i < num_fds; i++)
+			osmo_fd_register(&bp[i].rd);
+
+		gettimeofday(&start, NULL);
+		for (l = 0; l < loops; l++) {
+			for (i = 0; i < active; i++) {
+				unsigned int n = (l * 7919 + i * 104729) % num_fds;
+				if (write(bp[n].wr.fd, "x", 1) != 1)
+					break;
+			}
+			osmo_select_main(1);
+		}
+		gettimeofday(&stop, NULL);
+		timersub(&stop, &start, &diff);
+
+		printf("%-6s %6u fds, %3u active: %8.2f us per iteration\n",
+			backends[b] == OSMO_SELECT_BACKEND_EPOLL ? "epoll" : "select",
+			num_fds, active,
+			(diff.tv_sec * 1e6 + diff.tv_usec) / loops);
+
+		for (i = 0; i < num_fds; i++)
+			osmo_fd_unregister(&bp[i].rd);
+	}
+
+	for (i = 0; i < num_fds; i++) {
+		close(bp[i].rd.fd);
+		close(bp[i].wr.fd);
+	}
+	free(bp);
+}
+
+static void bench(void)
+{
+	struct rlimit rl;
+
+	/* thousands of pipes need more than the default limit */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	run_bench(100, 4, 20000);
+	run_bench(480, 4, 20000);
+	run_bench(4000, 4, 20000);
+	run_bench(8000, 16, 5000);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int b;
+	int c, rc;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (b = 0; b < ARRAY_SIZE(backends); b++) {
+		if (osmo_select_set_backend(backends[b]) < 0)
+			continue;
+
+		rc = run_checks();
+		if (rc < 0) {
+			fprintf(stderr, "backend %u: check failed (%d)\n",
+				backends[b], rc);
+			exit(EXIT_FAILURE);
+		}
+
+		if (backends[b] != OSMO_SELECT_BACKEND_EPOLL)
+			continue;
+
+		rc = run_edge_check();
+		if (rc < 0) {
+			fprintf(stderr, "backend %u: edge check failed (%d)\n",
+				backends[b], rc);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("select checks: OK\n");
+
+	return 0;
+}
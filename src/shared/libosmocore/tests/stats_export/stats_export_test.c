@@ -0,0 +1,244 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/statistics.h>
+#include <osmocom/core/stats_export.h>
+
+#define NUM_THREADS	4
+#define NUM_INCS	100000
+
+#define EXPORT_FILE	"stats_export_test.prom"
+#define EXPORT_SOCK	"stats_export_test.sock"
+/* enough groups for a dump that doesn't fit into a socket buffer */
+#define NUM_BIG_GROUPS	20000
+
+enum {
+	BTS_CTR_CHREQ,
+	BTS_CTR_PAGING,
+};
+
+static const struct rate_ctr_desc bts_ctr_desc[] = {
+	[BTS_CTR_CHREQ] = { "chreq.total", "Channel requests" },
+	[BTS_CTR_PAGING] = { "paging:sent", "Paging \\ requests" },
+};
+
+static const struct rate_ctr_group_desc bts_ctrg_desc = {
+	.group_name_prefix = "bts",
+	.group_description = "BTS statistics",
+	.num_ctr = ARRAY_SIZE(bts_ctr_desc),
+	.ctr_desc = bts_ctr_desc,
+};
+
+static const struct rate_ctr_desc ms_ctr_desc[] = {
+	{ "rx-bursts", "Received bursts" },
+};
+
+static const struct rate_ctr_group_desc ms_ctrg_desc = {
+	.group_name_prefix = "ms",
+	.group_description = "MS statistics",
+	.num_ctr = ARRAY_SIZE(ms_ctr_desc),
+	.ctr_desc = ms_ctr_desc,
+};
+
+static struct rate_ctr_group *bts0, *bts1, *ms;
+static struct osmo_counter *loc_upd;
+
+static void *bump_thread(void *arg)
+{
+	int i;
+
+	for (i = 0; i < NUM_INCS; i++) {
+		rate_ctr_inc(&bts0->ctr[BTS_CTR_CHREQ]);
+		osmo_counter_inc(loc_upd);
+	}
+
+	return NULL;
+}
+
+/* Increments from several threads must not get lost */
+static void test_threads(void)
+{
+	pthread_t threads[NUM_THREADS];
+	int i;
+
+	printf("Testing concurrent increments\n");
+
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_create(&threads[i], NULL, bump_thread, NULL);
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("rate_ctr: %llu, expected %d\n", (unsigned long long)
+		rate_ctr_get(&bts0->ctr[BTS_CTR_CHREQ]), NUM_THREADS * NUM_INCS);
+	printf("osmo_counter: %lu, expected %d\n",
+		osmo_counter_get(loc_upd), NUM_THREADS * NUM_INCS);
+}
+
+static void test_formats(void)
+{
+	printf("Testing Prometheus format\n");
+	osmo_stats_export(stdout, OSMO_STATS_FMT_PROMETHEUS, "osmo");
+
+	printf("Testing StatsD format\n");
+	osmo_stats_export(stdout, OSMO_STATS_FMT_STATSD, NULL);
+}
+
+static void cat(FILE *in)
+{
+	char line[256];
+
+	while (fgets(line, sizeof(line), in))
+		fputs(line, stdout);
+}
+
+static void test_file(void)
+{
+	FILE *in;
+	int rc;
+
+	printf("Testing file export\n");
+
+	rc = osmo_stats_export_file(EXPORT_FILE, OSMO_STATS_FMT_STATSD, "f");
+	printf("rc=%d, temporary file left: %d\n", rc,
+		access(EXPORT_FILE ".tmp", F_OK) == 0);
+
+	in = fopen(EXPORT_FILE, "r");
+	cat(in);
+	fclose(in);
+	unlink(EXPORT_FILE);
+}
+
+/* A client that doesn't read must not keep others from getting a dump */
+static void test_sock_slow(const struct sockaddr_un *addr)
+{
+	struct rate_ctr_group *big[NUM_BIG_GROUPS];
+	int fd[2], lines[2] = { 0, 0 }, open_fds = 2;
+	char buf[4096];
+	ssize_t n;
+	int i, j;
+
+	printf("Testing socket export to slow clients\n");
+
+	for (i = 0; i < NUM_BIG_GROUPS; i++)
+		big[i] = rate_ctr_group_alloc(NULL, &ms_ctrg_desc, i + 1);
+
+	/* neither client reads until both are connected and accepted */
+	for (i = 0; i < 2; i++) {
+		fd[i] = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (connect(fd[i], (struct sockaddr *) addr, sizeof(*addr)) < 0)
+			printf("connect failed\n");
+		fcntl(fd[i], F_SETFL, O_NONBLOCK);
+		osmo_select_main(1);
+	}
+
+	while (open_fds) {
+		osmo_select_main(1);
+		for (i = 0; i < 2; i++) {
+			if (fd[i] < 0)
+				continue;
+			n = read(fd[i], buf, sizeof(buf));
+			if (n < 0)
+				continue;
+			for (j = 0; j < n; j++)
+				lines[i] += buf[j] == '\n';
+			if (n == 0) {
+				close(fd[i]);
+				fd[i] = -1;
+				open_fds--;
+			}
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+		printf("client %d: %d lines\n", i, lines[i]);
+
+	for (i = 0; i < NUM_BIG_GROUPS; i++)
+		rate_ctr_group_free(big[i]);
+}
+
+static void test_sock(void)
+{
+	struct sockaddr_un addr;
+	FILE *in;
+	int fd, rc;
+
+	printf("Testing socket export\n");
+
+	rc = osmo_stats_export_sock_init(EXPORT_SOCK, OSMO_STATS_FMT_STATSD, "s");
+	printf("rc=%d\n", rc);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, EXPORT_SOCK);
+
+	/* a client that is gone already must not raise SIGPIPE */
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	rc = connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+	close(fd);
+	osmo_select_main(0);
+	printf("connect and close: %d\n", rc);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	rc = connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+	printf("connect: %d\n", rc);
+
+	/* accept and dump */
+	osmo_select_main(0);
+
+	in = fdopen(fd, "r");
+	cat(in);
+	fclose(in);
+
+	test_sock_slow(&addr);
+
+	osmo_stats_export_sock_close();
+	printf("socket removed: %d\n", access(EXPORT_SOCK, F_OK) != 0);
+}
+
+int main(int argc, char **argv)
+{
+	bts0 = rate_ctr_group_alloc(NULL, &bts_ctrg_desc, 0);
+	ms = rate_ctr_group_alloc(NULL, &ms_ctrg_desc, 0);
+	bts1 = rate_ctr_group_alloc(NULL, &bts_ctrg_desc, 1);
+
+	loc_upd = osmo_counter_alloc("net.loc_upd");
+	loc_upd->description = "Location updates";
+
+	test_threads();
+
+	rate_ctr_add(&bts1->ctr[BTS_CTR_PAGING], 42);
+	rate_ctr_inc(&ms->ctr[0]);
+
+	test_formats();
+	test_file();
+	test_sock();
+
+	printf("Done\n");
+	return 0;
+}
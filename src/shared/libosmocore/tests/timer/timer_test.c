@@ -139,6 +139,93 @@ static void secondary_timer_fired(void *data)
 	}
 }
 
+#define BENCH_TIMERS	100000
+
+static unsigned int bench_fired, bench_early;
+
+static void bench_timer_fired(void *data)
+{
+	struct osmo_timer_list *timer = data;
+	struct timeval now;
+
+	osmo_timers_gettime(&now);
+	if (timercmp(&now, &timer->timeout, <))
+		bench_early++;
+	bench_fired++;
+}
+
+static double bench_us(const struct timeval *start)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+
+	return diff.tv_sec * 1e6 + diff.tv_usec;
+}
+
+static void run_bench(enum osmo_timer_backend be, const char *name)
+{
+	struct osmo_timer_list *timers;
+	struct timeval start;
+	double us;
+	int i;
+
+	if (osmo_timers_set_backend(be) < 0) {
+		printf("%-6s: not supported\n", name);
+		return;
+	}
+
+	timers = calloc(BENCH_TIMERS, sizeof(*timers));
+	if (!timers)
+		exit(EXIT_FAILURE);
+
+	for (i = 0; i < BENCH_TIMERS; i++) {
+		timers[i].cb = bench_timer_fired;
+		timers[i].data = &timers[i];
+	}
+
+	/* T3xxx style timers, seconds to minutes */
+	srandom(1);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], random() % 600, random() % 1000000);
+	us = bench_us(&start);
+	printf("%-6s: arm    %6.1f ns per timer\n", name, us * 1e3 / BENCH_TIMERS);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], random() % 600, random() % 1000000);
+	us = bench_us(&start);
+	printf("%-6s: re-arm %6.1f ns per timer\n", name, us * 1e3 / BENCH_TIMERS);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_TIMERS; i++)
+		osmo_timer_del(&timers[i]);
+	us = bench_us(&start);
+	printf("%-6s: cancel %6.1f ns per timer\n", name, us * 1e3 / BENCH_TIMERS);
+
+	/* let them all expire within 100ms, then dispatch them at once */
+	bench_fired = bench_early = 0;
+	for (i = 0; i < BENCH_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], 0, random() % 100000);
+	usleep(150000);
+	gettimeofday(&start, NULL);
+	osmo_timers_prepare();
+	osmo_timers_update();
+	us = bench_us(&start);
+	printf("%-6s: expire %6.1f ns per timer, %u fired, %u early\n", name,
+		us * 1e3 / BENCH_TIMERS, bench_fired, bench_early);
+
+	free(timers);
+}
+
+static void bench(void)
+{
+	run_bench(OSMO_TIMER_BACKEND_RBTREE, "rbtree");
+	run_bench(OSMO_TIMER_BACKEND_WHEEL, "wheel");
+}
+
 static void alarm_handler(int signum)
 {
 	fprintf(stderr, "ERROR: We took too long to run the timer test, "
@@ -155,8 +242,18 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	while ((c = getopt_long(argc, argv, "s:", NULL, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "s:wb", NULL, NULL)) != -1) {
 	switch(c) {
+		case 'w':
+			if (osmo_timers_set_backend(OSMO_TIMER_BACKEND_WHEEL) < 0) {
+				fprintf(stderr, "%s: timer wheel not supported\n",
+					argv[0]);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
 		case 's':
 			timer_nsteps = atoi(optarg);
 			if (timer_nsteps <= 0) {
@@ -0,0 +1,171 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/tlv.h>
+
+static struct tlv_definition test_def = {
+	.def = {
+		[0x01] = { TLV_TYPE_TV },
+		[0x02] = { TLV_TYPE_TLV },
+		[0x03] = { TLV_TYPE_FIXED, 3 },
+		[0x04] = { TLV_TYPE_T },
+		[0x05] = { TLV_TYPE_TL16V },
+		[0x06] = { TLV_TYPE_TvLV },
+		[0x90] = { TLV_TYPE_SINGLE_TV },
+	},
+};
+
+static const uint8_t msg_ok[] = {
+	0x01, 0x11,			/* LV (lv_tag) */
+	0x01, 0x42,			/* TV */
+	0x02, 0x02, 0xaa, 0xbb,		/* TLV */
+	0x03, 0x01, 0x02, 0x03,		/* FIXED */
+	0x04,				/* T */
+	0x05, 0x00, 0x01, 0xcc,		/* TL16V */
+	0x06, 0x81, 0xdd,		/* TvLV */
+	0x97,				/* SINGLE_TV */
+	0x02, 0x01, 0xee,		/* TLV, again */
+};
+
+static const uint8_t msg_short[] = {
+	0x02, 0x05, 0xaa,		/* TLV running past the end */
+};
+
+/* Both layouts have to agree on every tag */
+static int compare(const struct tlv_parsed *dp, const struct tlv_sparse *sp)
+{
+	int i;
+
+	for (i = 0; i <= 0xff; i++) {
+		if (!TLVP_PRESENT(dp, i) != !TLVP_PRESENT(sp, i))
+			return -1;
+		if (!TLVP_PRESENT(dp, i))
+			continue;
+		if (TLVP_LEN(dp, i) != TLVP_LEN(sp, i))
+			return -1;
+		if (TLVP_VAL(dp, i) != TLVP_VAL(sp, i))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void test_parse(void)
+{
+	struct tlv_parsed dp;
+	struct tlv_sparse sp;
+	int rc_d, rc_s, i;
+
+	rc_d = tlv_parse(&dp, &test_def, msg_ok, sizeof(msg_ok), 0x0a, 0);
+	rc_s = tlv_parse_sparse(&sp, &test_def, msg_ok, sizeof(msg_ok),
+				0x0a, 0);
+	printf("parsed %d / %d IEs, %s\n", rc_d, rc_s,
+		compare(&dp, &sp) ? "MISMATCH" : "same");
+
+	/* Message order is kept, duplicates included */
+	for (i = 0; i < sp.num; i++)
+		printf(" T=%02x L=%u\n", sp.ie[i].tag, sp.ie[i].len);
+
+	/* The last occurrence wins */
+	printf("tag 0x02: len=%u val=%02x\n", TLVP_LEN(&sp, 0x02),
+		TLVP_VAL(&sp, 0x02)[0]);
+	printf("tag 0x7f present: %d\n", TLVP_PRESENT(&sp, 0x7f) != NULL);
+
+	/* A previous result must not leak into the next one */
+	rc_s = tlv_parse_sparse(&sp, &test_def, msg_ok + 2, 2, 0, 0);
+	printf("reparsed %d IE, tag 0x02 present: %d\n", rc_s,
+		TLVP_PRESENT(&sp, 0x02) != NULL);
+
+	rc_d = tlv_parse(&dp, &test_def, msg_short, sizeof(msg_short), 0, 0);
+	rc_s = tlv_parse_sparse(&sp, &test_def, msg_short,
+				sizeof(msg_short), 0, 0);
+	printf("short message: %d / %d\n", rc_d, rc_s);
+}
+
+static void test_overflow(void)
+{
+	uint8_t buf[2 * (TLV_SPARSE_MAX_IE + 1)];
+	struct tlv_sparse sp;
+	int i;
+
+	for (i = 0; i < TLV_SPARSE_MAX_IE + 1; i++) {
+		buf[2 * i] = 0x01;
+		buf[2 * i + 1] = i;
+	}
+
+	printf("%d IEs: %d\n", TLV_SPARSE_MAX_IE,
+		tlv_parse_sparse(&sp, &test_def, buf, sizeof(buf) - 2, 0, 0));
+	printf("%d IEs: %d\n", TLV_SPARSE_MAX_IE + 1,
+		tlv_parse_sparse(&sp, &test_def, buf, sizeof(buf), 0, 0));
+}
+
+static void bench(void)
+{
+	struct timeval start, stop, diff;
+	struct tlv_parsed dp;
+	struct tlv_sparse sp;
+	const int loops = 2000000;
+	volatile int sink = 0;
+	int l;
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++) {
+		tlv_parse(&dp, &test_def, msg_ok + 2, 6, 0, 0);
+		sink += TLVP_LEN(&dp, 0x02);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	printf("tlv_parse:        %6.1f ns per message\n",
+		(diff.tv_sec * 1e9 + diff.tv_usec * 1e3) / loops);
+
+	gettimeofday(&start, NULL);
+	for (l = 0; l < loops; l++) {
+		tlv_parse_sparse(&sp, &test_def, msg_ok + 2, 6, 0, 0);
+		sink += TLVP_LEN(&sp, 0x02);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	printf("tlv_parse_sparse: %6.1f ns per message\n",
+		(diff.tv_sec * 1e9 + diff.tv_usec * 1e3) / loops);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "b")) != -1) {
+		switch (c) {
+		case 'b':
+			bench();
+			exit(EXIT_SUCCESS);
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	test_parse();
+	test_overflow();
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/* Utility program rendering binary log files as text */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <osmocom/core/logging.h>
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-h] [-T] FILE\n", progname);
+	printf("  -T  Don't print the time stamps\n");
+}
+
+int main(int argc, char **argv)
+{
+	int opt, rc, print_timestamp = 1;
+	FILE *in;
+
+	while ((opt = getopt(argc, argv, "hT")) != -1) {
+		switch (opt) {
+		case 'T':
+			print_timestamp = 0;
+			break;
+		case 'h':
+			help(argv[0]);
+			exit(0);
+			break;
+		default:
+			help(argv[0]);
+			exit(2);
+			break;
+		}
+	}
+
+	if (optind >= argc) {
+		help(argv[0]);
+		exit(2);
+	}
+
+	in = fopen(argv[optind], "r");
+	if (!in) {
+		perror(argv[optind]);
+		exit(1);
+	}
+
+	rc = log_binary_decode(in, stdout, print_timestamp);
+	fclose(in);
+	if (rc < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(-rc));
+		exit(1);
+	}
+
+	exit(0);
+}
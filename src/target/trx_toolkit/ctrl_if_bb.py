@@ -91,6 +91,24 @@ class CTRLInterfaceBB(CTRLInterface):
 
 			return (0, [meas_dbm])
 
+		# Power measurement of a range, in 200 kHz steps
+		elif self.verify_cmd(request, "MEASURE", 2):
+			print("[i] Recv MEASURE range cmd")
+
+			if self.pm is None:
+				return -1
+
+			freq_start = int(request[1])
+			freq_stop = int(request[2])
+			if freq_stop < freq_start:
+				return -1
+
+			meas_dbm = []
+			for freq in range(freq_start, freq_stop + 1, 200):
+				meas_dbm.append(str(self.pm.measure(freq * 1000)))
+
+			return (0, meas_dbm)
+
 		elif self.verify_cmd(request, "SETSLOT", 2):
 			print("[i] Recv SETSLOT cmd")
 